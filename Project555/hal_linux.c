@@ -0,0 +1,645 @@
+#define _GNU_SOURCE  // accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "scope_hal.h"
+#include "siggen.h"
+#include "scope_record.h"
+#include "loopback.h"
+#include "scope_usb.h"
+
+// Linux主机实现: ADC由合成信号发生器或录制文件代替, LCD画到内存帧缓冲
+
+#define HAL_MAX_KEY_PRESSES 32
+
+struct HalFile {
+    FILE* fp;
+};
+
+static SigChannel sigChannels[MAX_CHANNELS];
+static uint32_t sampleRate = ADC_SAMPLE_RATE;
+static uint32_t rateOverride = 0;
+static long frameLimit = 1000;
+static long frameCount = 0;
+static int pacing = 0;
+static int verbose = 0;
+static const char* replayPath = NULL;
+static const char* framePath = NULL;
+static const char* usbPath = NULL;
+static Recorder replay;
+static int replaying = 0;
+static uint64_t replayPos = 0;
+static double replayStart = 0;             // 回放起点: 距录制开始的秒数
+static int usbFd = -1;                     // pty主设备或输出文件
+static void (*usbTxDone)(void) = NULL;
+static pthread_t usbThread;
+static pthread_mutex_t usbLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t usbCond = PTHREAD_COND_INITIALIZER;
+static const uint8_t* usbPending = NULL;   // 等待USB线程写出的传输
+static uint32_t usbPendingSize = 0;
+static int usbRunning = 0;
+static long usbErrorEvery = 0;             // 每隔多少次传输注入一次丢失和一次损坏
+static uint64_t usbTransfers = 0;
+static void usbStop(void);
+static uint64_t startTime = 0;
+static uint64_t samplesRead = 0;
+static int keyState[HAL_KEY_COUNT];
+static struct {
+    int key;
+    long frame;
+} keyPresses[HAL_MAX_KEY_PRESSES];  // -k指定的按键脚本
+static int keyPressCount = 0;
+static const char* keyNames[HAL_KEY_COUNT] = {
+    "channel", "timebase", "trigger", "cursor", "menu", "setting"
+};
+static pthread_t acqThread;
+static atomic_int acqRunning;
+
+static const HalNetHandler* netHandler = NULL;
+static int listenFd = -1;
+static int epollFd = -1;
+static int clientFds[HAL_NET_MAX_CLIENTS];
+static int loopbackFast = 0, loopbackSlow = 0;
+
+static uint8_t frameBuffer[LCD_HEIGHT][LCD_WIDTH];
+static int cursorX, cursorY;
+
+static uint64_t nowMicros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+        "用法: %s [-r 采样率] [-n 帧数] [-c 通道=信号] [-f 录制文件[@秒]] [-p] [-v] [-o 帧图像.pgm] [-u USB输出文件] [-k 按键@帧] [-l 客户端数[:慢客户端数]] [-e 间隔]\n"
+        "  信号格式: sine|square|noise|chirp|uart|spiclk|spidata|i2cscl|i2csda[:频率[:幅度[:噪声]]], 如 -c 1=square:200:0.5\n"
+        "  协议信号的频率为位速率, 如 -c 1=i2cscl:100000 -c 2=i2csda:100000\n"
+        "  -n 0 表示一直运行, -p 按实际采样率节拍运行, -f 回放waveform.rec格式的录制文件, @秒 从录制开始后的该时刻回放\n"
+        "  -k 在指定帧按下一次按键, 可重复, 按键: channel|timebase|trigger|cursor|menu|setting\n"
+        "  -l 启动回环客户端连接本机网络服务, 结束时输出各客户端吞吐量\n"
+        "  -u pty 用伪终端代替USB CDC并启动校验接收端, 否则写入指定文件; -e 每隔若干次传输丢弃和损坏各一次\n",
+        name);
+}
+
+static int parseKeyPress(const char* spec) {
+    // 格式: 按键名[@帧号], 省略帧号时在第1帧按下
+    const char* at = strchr(spec, '@');
+    size_t len = at != NULL ? (size_t)(at - spec) : strlen(spec);
+    if (keyPressCount >= HAL_MAX_KEY_PRESSES) {
+        return -1;
+    }
+    for (int k = 0; k < HAL_KEY_COUNT; k++) {
+        if (strlen(keyNames[k]) == len && strncmp(spec, keyNames[k], len) == 0) {
+            keyPresses[keyPressCount].key = k;
+            keyPresses[keyPressCount].frame = at != NULL ? strtol(at + 1, NULL, 10) : 1;
+            keyPressCount++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void halInit(int argc, char* argv[]) {
+    // 默认四个通道: 正弦、方波、噪声、扫频
+    sigInit(&sigChannels[0], SIG_SINE, 50.0f, 1.0f);
+    sigInit(&sigChannels[1], SIG_SQUARE, 20.0f, 0.8f);
+    sigInit(&sigChannels[2], SIG_NOISE, 0.0f, 0.3f);
+    sigInit(&sigChannels[3], SIG_CHIRP, 5.0f, 1.2f);
+    sigChannels[3].freqEnd = 200.0f;
+    sigChannels[3].sweepTime = 4.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:n:c:f:pvo:u:k:l:e:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            rateOverride = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            frameLimit = strtol(optarg, NULL, 10);
+            break;
+        case 'c': {
+            int ch = atoi(optarg) - 1;
+            const char* spec = strchr(optarg, '=');
+            if (ch < 0 || ch >= MAX_CHANNELS || spec == NULL || sigParse(&sigChannels[ch], spec + 1) != 0) {
+                fprintf(stderr, "无效的通道信号: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        }
+        case 'f': {
+            char* at = strrchr(optarg, '@');
+            if (at != NULL) {
+                *at = 0;
+                replayStart = strtod(at + 1, NULL);
+            }
+            replayPath = optarg;
+            break;
+        }
+        case 'p':
+            pacing = 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'o':
+            framePath = optarg;
+            break;
+        case 'u':
+            usbPath = optarg;
+            break;
+        case 'e':
+            usbErrorEvery = strtol(optarg, NULL, 10);
+            break;
+        case 'l': {
+            const char* slow = strchr(optarg, ':');
+            loopbackFast = atoi(optarg);
+            loopbackSlow = slow != NULL ? atoi(slow + 1) : 0;
+            break;
+        }
+        case 'k':
+            if (parseKeyPress(optarg) != 0) {
+                fprintf(stderr, "无效的按键: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        default:
+            usage(argv[0]);
+            exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    startTime = nowMicros();
+}
+
+int halRunning(void) {
+    if (frameLimit > 0 && frameCount >= frameLimit) {
+        if (loopbackFast + loopbackSlow > 0) {
+            loopbackStop();
+            loopbackFast = loopbackSlow = 0;
+        }
+        usbStop();
+        // 结束时保存最后一帧画面
+        if (framePath != NULL) {
+            FILE* fp = fopen(framePath, "wb");
+            if (fp != NULL) {
+                fprintf(fp, "P5\n%d %d\n255\n", LCD_WIDTH, LCD_HEIGHT);
+                fwrite(frameBuffer, 1, sizeof(frameBuffer), fp);
+                fclose(fp);
+            }
+        }
+        return 0;
+    }
+    frameCount++;
+    return 1;
+}
+
+uint32_t halMicros(void) {
+    return (uint32_t)(nowMicros() - startTime);
+}
+
+void halIdle(void) {
+    sched_yield();
+}
+
+void halAdcInit(uint32_t rate) {
+    sampleRate = rateOverride ? rateOverride : rate;
+    if (replayPath != NULL) {
+        if (recordOpen(&replay, replayPath) != 0 || replay.samples == 0) {
+            fprintf(stderr, "无法打开录制文件: %s\n", replayPath);
+            exit(1);
+        }
+        if (replayStart > 0) {
+            // 按块时间戳定位, 从不早于该时刻的第一块开始
+            replayPos = recordFindTime(&replay, replay.index[0].timestamp + (uint32_t)(replayStart * 1e6));
+            if (replayPos >= replay.samples) {
+                fprintf(stderr, "回放起点超出录制长度: %s@%g\n", replayPath, replayStart);
+                exit(1);
+            }
+        }
+        replaying = 1;
+    }
+}
+
+uint32_t halAdcSampleRate(void) {
+    return sampleRate;
+}
+
+void halAdcRead(uint16_t buffer[][ADC_BUFFER_SIZE], int channels, int count) {
+    if (replaying) {
+        // 按索引读取录制文件, 读到结尾后从头循环
+        uint32_t done = 0;
+        uint16_t part[MAX_CHANNELS][ADC_BUFFER_SIZE];
+        while (done < (uint32_t)count) {
+            uint32_t n = recordRead(&replay, replayPos, count - done, part);
+            if (n == 0 && replayPos == 0) {
+                for (int i = 0; i < channels; i++) {
+                    memset(buffer[i] + done, 0, (count - done) * sizeof(uint16_t));
+                }
+                break;  // 文件损坏, 补零
+            }
+            for (int i = 0; i < channels; i++) {
+                memcpy(buffer[i] + done, part[i], n * sizeof(uint16_t));
+            }
+            done += n;
+            replayPos = n > 0 ? replayPos + n : 0;
+            if (replayPos >= replay.samples) {
+                replayPos = 0;
+            }
+        }
+    } else {
+        for (int i = 0; i < channels; i++) {
+            sigGenerate(&sigChannels[i], sampleRate, buffer[i], count);
+        }
+    }
+
+    samplesRead += count;
+    if (pacing) {
+        // 按采样率节拍等待, 模拟真实采集耗时
+        uint64_t due = startTime + samplesRead * 1000000u / sampleRate;
+        uint64_t now = nowMicros();
+        if (due > now) {
+            usleep((useconds_t)(due - now));
+        }
+    }
+}
+
+static void* acqThreadMain(void* arg) {
+    // 采集线程充当DMA: 按实际节拍运行时队列满就丢块,
+    // 不按节拍运行时等待消费者腾出空间, 用于测量处理吞吐量
+    AcqRing* ring = arg;
+    while (atomic_load(&acqRunning)) {
+        if (!pacing && ringFull(ring)) {
+            sched_yield();
+            continue;
+        }
+        AcqBlock* block = ringProducerSlot(ring);
+        halAdcRead(block->data, MAX_CHANNELS, ADC_BUFFER_SIZE);
+        block->timestamp = halMicros();
+        ringProducerCommit(ring);
+    }
+    return NULL;
+}
+
+void halAcqStart(AcqRing* ring) {
+    atomic_store(&acqRunning, 1);
+    if (pthread_create(&acqThread, NULL, acqThreadMain, ring) != 0) {
+        fprintf(stderr, "无法创建采集线程\n");
+        exit(1);
+    }
+}
+
+void halAcqStop(void) {
+    atomic_store(&acqRunning, 0);
+    pthread_join(acqThread, NULL);
+}
+
+void halLcdInit(void) {
+    memset(frameBuffer, 0, sizeof(frameBuffer));
+}
+
+void halLcdClear(void) {
+    memset(frameBuffer, 0, sizeof(frameBuffer));
+}
+
+void halLcdDrawLine(int x0, int y0, int x1, int y1) {
+    // Bresenham画线, 超出屏幕的点丢弃
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+        if (x0 >= 0 && x0 < LCD_WIDTH && y0 >= 0 && y0 < LCD_HEIGHT) {
+            frameBuffer[y0][x0] = 255;
+        }
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void halLcdDrawImage(int x, int y, int width, int height, const uint8_t* pixels) {
+    // 与已有内容取较亮者, 图像之上仍可叠加线条
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            int px = x + col, py = y + row;
+            uint8_t v = pixels[row * width + col];
+            if (px >= 0 && px < LCD_WIDTH && py >= 0 && py < LCD_HEIGHT && v > frameBuffer[py][px]) {
+                frameBuffer[py][px] = v;
+            }
+        }
+    }
+}
+
+void halLcdSetCursor(int x, int y) {
+    cursorX = x;
+    cursorY = y;
+}
+
+void halLcdPrint(const char* format, ...) {
+    char line[96];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (verbose) {
+        printf("[%3d,%3d] %s\n", cursorX, cursorY, line);
+    }
+}
+
+void halKeyInit(void) {
+    memset(keyState, 0, sizeof(keyState));
+}
+
+int halKeyRead(int key) {
+    // 脚本中的按键只在指定的那一帧保持按下
+    keyState[key] = 0;
+    for (int i = 0; i < keyPressCount; i++) {
+        if (keyPresses[i].key == key && keyPresses[i].frame == frameCount) {
+            keyState[key] = 1;
+        }
+    }
+    return keyState[key];
+}
+
+void halStorageInit(void) {
+}
+
+HalFile* halFileOpen(const char* path, int write) {
+    FILE* fp = fopen(path, write ? "wb" : "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    HalFile* file = malloc(sizeof(HalFile));
+    if (file == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+    file->fp = fp;
+    return file;
+}
+
+uint32_t halFileWrite(HalFile* file, const void* data, uint32_t size) {
+    return (uint32_t)fwrite(data, 1, size, file->fp);
+}
+
+uint32_t halFileRead(HalFile* file, void* data, uint32_t size) {
+    return (uint32_t)fread(data, 1, size, file->fp);
+}
+
+int halFileSeek(HalFile* file, uint32_t offset) {
+    return fseek(file->fp, offset, SEEK_SET);
+}
+
+void halFileClose(HalFile* file) {
+    fclose(file->fp);
+    free(file);
+}
+
+static void usbWrite(const uint8_t* data, uint32_t size) {
+    // 按-e注入错误: 整段丢弃模拟丢包, 翻转一个字节模拟传输错误
+    uint8_t corrupt[USB_PACKET_BYTES];
+    usbTransfers++;
+    if (usbErrorEvery > 0 && usbTransfers % usbErrorEvery == 0) {
+        return;
+    }
+    if (usbErrorEvery > 1 && usbTransfers % usbErrorEvery == (uint64_t)usbErrorEvery / 2 && size <= sizeof(corrupt)) {
+        memcpy(corrupt, data, size);
+        corrupt[size / 2] ^= 0x10;
+        data = corrupt;
+    }
+    while (size > 0) {
+        ssize_t n = write(usbFd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        size -= (uint32_t)n;
+    }
+}
+
+static void* usbThreadMain(void* arg) {
+    // 充当USB控制器: 写出一次传输后回调txDone, 写满时阻塞即为链路背压
+    (void)arg;
+    pthread_mutex_lock(&usbLock);
+    while (usbRunning) {
+        if (usbPending == NULL) {
+            pthread_cond_wait(&usbCond, &usbLock);
+            continue;
+        }
+        const uint8_t* data = usbPending;
+        uint32_t size = usbPendingSize;
+        pthread_mutex_unlock(&usbLock);
+        usbWrite(data, size);
+        pthread_mutex_lock(&usbLock);
+        usbPending = NULL;
+        pthread_mutex_unlock(&usbLock);
+        usbTxDone();
+        pthread_mutex_lock(&usbLock);
+    }
+    pthread_mutex_unlock(&usbLock);
+    return NULL;
+}
+
+static int openPty(void) {
+    // 主设备由USB线程写入, 从设备设为原始模式交给校验接收端读取
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        return -1;
+    }
+    const char* slave = ptsname(fd);
+    int sfd = open(slave, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (sfd < 0 || tcgetattr(sfd, &tio) != 0) {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(sfd, TCSANOW, &tio);
+    close(sfd);
+    printf("USB CDC pty: %s\n", slave);
+    usbLoopbackStart(slave);
+    return fd;
+}
+
+void halUsbInit(void (*txDone)(void)) {
+    usbTxDone = txDone;
+    if (usbPath == NULL) {
+        return;
+    }
+    usbFd = strcmp(usbPath, "pty") == 0 ? openPty() : open(usbPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (usbFd < 0) {
+        fprintf(stderr, "无法打开USB输出: %s\n", usbPath);
+        exit(1);
+    }
+    usbRunning = 1;
+    if (pthread_create(&usbThread, NULL, usbThreadMain, NULL) != 0) {
+        fprintf(stderr, "无法创建USB线程\n");
+        exit(1);
+    }
+}
+
+static void usbStop(void) {
+    // 等当前传输写完再停止USB线程, 然后让接收端读完缓冲区中的数据
+    if (!usbRunning) {
+        return;
+    }
+    pthread_mutex_lock(&usbLock);
+    usbRunning = 0;
+    pthread_cond_signal(&usbCond);
+    pthread_mutex_unlock(&usbLock);
+    pthread_join(usbThread, NULL);
+    if (strcmp(usbPath, "pty") == 0) {
+        usbLoopbackStop();
+    }
+    close(usbFd);
+    usbFd = -1;
+}
+
+int halUsbTxReady(void) {
+    pthread_mutex_lock(&usbLock);
+    int ready = usbRunning && usbPending == NULL;
+    pthread_mutex_unlock(&usbLock);
+    return ready;
+}
+
+void halUsbTransmit(const uint8_t* data, uint32_t size) {
+    pthread_mutex_lock(&usbLock);
+    usbPending = data;
+    usbPendingSize = size;
+    pthread_cond_signal(&usbCond);
+    pthread_mutex_unlock(&usbLock);
+}
+
+uint32_t halUsbReceive(uint8_t* data, uint32_t size) {
+    (void)data;
+    (void)size;
+    return 0;
+}
+
+int halNetInit(const HalNetHandler* handler) {
+    // 非阻塞监听套接字和客户端都登记到同一个epoll实例
+    netHandler = handler;
+    for (int i = 0; i < HAL_NET_MAX_CLIENTS; i++) {
+        clientFds[i] = -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(HAL_NET_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    int on = 1;
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    epollFd = epoll_create1(0);
+    if (listenFd < 0 || epollFd < 0
+        || setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+        || bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || listen(listenFd, HAL_NET_MAX_CLIENTS) != 0) {
+        fprintf(stderr, "网络服务启动失败(端口%d): %s\n", HAL_NET_PORT, strerror(errno));
+        if (listenFd >= 0) {
+            close(listenFd);
+        }
+        listenFd = -1;
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = HAL_NET_MAX_CLIENTS };
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    if (loopbackFast + loopbackSlow > 0) {
+        loopbackStart(loopbackFast, loopbackSlow);
+    }
+    return 0;
+}
+
+static void netAccept(void) {
+    int fd;
+    while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+        int slot = 0;
+        while (slot < HAL_NET_MAX_CLIENTS && clientFds[slot] >= 0) {
+            slot++;
+        }
+        if (slot == HAL_NET_MAX_CLIENTS) {
+            close(fd);  // 客户端已满
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)slot };
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        clientFds[slot] = fd;
+        netHandler->accepted(slot);
+    }
+}
+
+void halNetService(void) {
+    // 只取已就绪的事件, 超时为0, 不阻塞主循环
+    struct epoll_event events[HAL_NET_MAX_CLIENTS + 1];
+    if (listenFd < 0) {
+        return;
+    }
+    int n = epoll_wait(epollFd, events, HAL_NET_MAX_CLIENTS + 1, 0);
+    for (int i = 0; i < n; i++) {
+        int slot = (int)events[i].data.u32;
+        if (slot == HAL_NET_MAX_CLIENTS) {
+            netAccept();
+            continue;
+        }
+        if (clientFds[slot] < 0) {
+            continue;
+        }
+        uint8_t data[512];
+        ssize_t len;
+        while (clientFds[slot] >= 0 && (len = recv(clientFds[slot], data, sizeof(data), 0)) > 0) {
+            netHandler->received(slot, data, (uint32_t)len);
+        }
+        if (clientFds[slot] >= 0 && (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))) {
+            halNetClose(slot);
+        }
+    }
+}
+
+uint32_t halNetSend(int client, const void* data, uint32_t size) {
+    int fd = clientFds[client];
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t sent = send(fd, data, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            halNetClose(client);
+        }
+        return 0;
+    }
+    return (uint32_t)sent;
+}
+
+void halNetClose(int client) {
+    if (clientFds[client] < 0) {
+        return;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, clientFds[client], NULL);
+    close(clientFds[client]);
+    clientFds[client] = -1;
+    netHandler->closed(client);
+}
@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <stm32f4xx.h>
+#include <ff.h>        // FatFS文件系统库
+#include <lwip/tcp.h>  // LwIP网络协议栈(raw API)
+#include <lwip/timeouts.h>
+#include <netif/ethernet.h>
+#include <usbd_cdc_if.h>  // USB CDC类驱动
+#include "scope_hal.h"
+
+#define HAL_MAX_FILES 2  // 同时打开的文件数
+
+struct HalFile {
+    FIL fil;
+    int used;
+};
+
+ADC_InitTypeDef ADC_InitStructure;
+GPIO_InitTypeDef GPIO_InitStructure;
+FATFS FatFS;
+USBD_HandleTypeDef USBD_Device;
+struct netif netif;
+ip4_addr_t ipaddr, netmask, gw;
+
+static uint32_t adcSampleRate = ADC_SAMPLE_RATE;
+static AcqRing* acqRing;
+static uint16_t dmaBuffer[2][MAX_CHANNELS * ADC_BUFFER_SIZE];  // DMA双缓冲, 通道交错存放
+static HalFile fileTable[HAL_MAX_FILES];
+static const HalNetHandler* netHandler;
+static void (*usbTxDone)(void);
+static struct tcp_pcb* clientPcbs[HAL_NET_MAX_CLIENTS];
+
+_Static_assert(sizeof(ADC_InitStructure) + sizeof(GPIO_InitStructure) + sizeof(FatFS) + sizeof(USBD_Device)
+    + sizeof(netif) + 3 * sizeof(ip4_addr_t) + sizeof(adcSampleRate) + sizeof(acqRing) + sizeof(dmaBuffer)
+    + sizeof(fileTable) + sizeof(netHandler) + sizeof(usbTxDone) + sizeof(clientPcbs) <= HAL_STATIC_BYTES,
+    "HAL_STATIC_BYTES does not cover the statics of hal_stm32.c");
+static const uint16_t keyPins[HAL_KEY_COUNT] = {
+    GPIO_Pin_0, GPIO_Pin_1, GPIO_Pin_2, GPIO_Pin_3, GPIO_Pin_4, GPIO_Pin_5
+};
+
+void halInit(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    // 32位的TIM2按1MHz自由计数作为微秒时钟, 满2^32us才回绕, 各处的无符号差值和(int32_t)比较始终成立;
+    // DWT周期计数器在168MHz下约25.6秒就回绕, 除以每微秒周期数后得不到完整的32位微秒数
+    // APB1分频为4时定时器时钟是PCLK1的2倍, 即SystemCoreClock / 2
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+    TIM_TimeBaseInitTypeDef tim;
+    TIM_TimeBaseStructInit(&tim);
+    tim.TIM_Prescaler = (uint16_t)(SystemCoreClock / 2 / 1000000 - 1);
+    tim.TIM_Period = 0xFFFFFFFF;
+    tim.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseInit(TIM2, &tim);
+    TIM_Cmd(TIM2, ENABLE);
+}
+
+int halRunning(void) {
+    return 1;
+}
+
+uint32_t halMicros(void) {
+    return TIM2->CNT;
+}
+
+void halIdle(void) {
+    __WFI();
+}
+
+void halAdcInit(uint32_t sampleRate) {
+    adcSampleRate = sampleRate;
+    ADC_Init(ADC1, &ADC_InitStructure);
+    ADC_Cmd(ADC1, ENABLE);
+    ADC_RegularChannelConfig(ADC1, ADC_Channel_0, 1, ADC_SampleTime_84Cycles);
+    ADC_RegularChannelConfig(ADC1, ADC_Channel_1, 2, ADC_SampleTime_84Cycles);
+    ADC_RegularChannelConfig(ADC1, ADC_Channel_2, 3, ADC_SampleTime_84Cycles);
+    ADC_RegularChannelConfig(ADC1, ADC_Channel_3, 4, ADC_SampleTime_84Cycles);
+}
+
+uint32_t halAdcSampleRate(void) {
+    return adcSampleRate;
+}
+
+void halAdcRead(uint16_t buffer[][ADC_BUFFER_SIZE], int channels, int count) {
+    // 触发ADC采样
+    ADC_SoftwareStartConv(ADC1);
+
+    // 读取ADC转换结果并存入缓冲区
+    for (int i = 0; i < channels; i++) {
+        for (int j = 0; j < count; j++) {
+            buffer[i][j] = ADC_GetInjectedConversionValue(ADC1, i + 1);
+        }
+    }
+}
+
+void halAcqStart(AcqRing* ring) {
+    acqRing = ring;
+
+    // DMA2 Stream0通道0: ADC1->dmaBuffer, 双缓冲模式, 每个缓冲区是一整块
+    DMA_InitTypeDef dma;
+    DMA_StructInit(&dma);
+    dma.DMA_Channel = DMA_Channel_0;
+    dma.DMA_PeripheralBaseAddr = (uint32_t)&ADC1->DR;
+    dma.DMA_Memory0BaseAddr = (uint32_t)dmaBuffer[0];
+    dma.DMA_DIR = DMA_DIR_PeripheralToMemory;
+    dma.DMA_BufferSize = MAX_CHANNELS * ADC_BUFFER_SIZE;
+    dma.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    dma.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    dma.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    dma.DMA_Mode = DMA_Mode_Circular;
+    dma.DMA_Priority = DMA_Priority_High;
+    DMA_Init(DMA2_Stream0, &dma);
+    DMA_DoubleBufferModeConfig(DMA2_Stream0, (uint32_t)dmaBuffer[1], DMA_Memory_0);
+    DMA_DoubleBufferModeCmd(DMA2_Stream0, ENABLE);
+    DMA_ITConfig(DMA2_Stream0, DMA_IT_TC, ENABLE);
+    NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+    DMA_Cmd(DMA2_Stream0, ENABLE);
+
+    ADC_DMARequestAfterLastTransferCmd(ADC1, ENABLE);
+    ADC_DMACmd(ADC1, ENABLE);
+    ADC_SoftwareStartConv(ADC1);
+}
+
+void halAcqStop(void) {
+    ADC_DMACmd(ADC1, DISABLE);
+    DMA_Cmd(DMA2_Stream0, DISABLE);
+}
+
+void DMA2_Stream0_IRQHandler(void) {
+    if (DMA_GetITStatus(DMA2_Stream0, DMA_IT_TCIF0) == RESET) {
+        return;
+    }
+    DMA_ClearITPendingBit(DMA2_Stream0, DMA_IT_TCIF0);
+
+    // DMA已切换到另一个缓冲区, 把刚写满的缓冲区按通道拆开放入队列
+    const uint16_t* done = dmaBuffer[DMA_GetCurrentMemoryTarget(DMA2_Stream0) ? 0 : 1];
+    AcqBlock* block = ringProducerSlot(acqRing);
+    for (int j = 0; j < ADC_BUFFER_SIZE; j++) {
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            block->data[i][j] = done[j * MAX_CHANNELS + i];
+        }
+    }
+    block->timestamp = halMicros();
+    ringProducerCommit(acqRing);
+}
+
+void halLcdInit(void) {
+    LCD_Init();
+    LCD_SetBackColor(LCD_COLOR_BLACK);
+    LCD_SetTextColor(LCD_COLOR_WHITE);
+}
+
+void halLcdClear(void) {
+    LCD_Clear(LCD_COLOR_BLACK);
+}
+
+void halLcdDrawLine(int x0, int y0, int x1, int y1) {
+    LCD_DrawLine(x0, y0, x1, y1);
+}
+
+void halLcdDrawImage(int x, int y, int width, int height, const uint8_t* pixels) {
+    // 灰度转换为RGB565, 每行设置一次写入位置后连续写显存
+    for (int row = 0; row < height; row++) {
+        LCD_SetCursor(x, y + row);
+        LCD_WriteRAM_Prepare();
+        for (int col = 0; col < width; col++) {
+            uint8_t g = pixels[row * width + col];
+            LCD_WriteRAM((uint16_t)(((g >> 3) << 11) | ((g >> 2) << 5) | (g >> 3)));
+        }
+    }
+}
+
+void halLcdSetCursor(int x, int y) {
+    LCD_SetCursor(x, y);
+}
+
+void halLcdPrint(const char* format, ...) {
+    char line[96];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    LCD_Print("%s", line);
+}
+
+void halKeyInit(void) {
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0 | GPIO_Pin_1 | GPIO_Pin_2 | GPIO_Pin_3 | GPIO_Pin_4 | GPIO_Pin_5;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN;
+    GPIO_Init(GPIOA, &GPIO_InitStructure);
+}
+
+int halKeyRead(int key) {
+    return GPIO_ReadInputDataBit(GPIOA, keyPins[key]);
+}
+
+void halStorageInit(void) {
+    f_mount(&FatFS, "/", 1);
+}
+
+HalFile* halFileOpen(const char* path, int write) {
+    for (int i = 0; i < HAL_MAX_FILES; i++) {
+        HalFile* file = &fileTable[i];
+        if (file->used) {
+            continue;
+        }
+        BYTE mode = write ? (FA_WRITE | FA_CREATE_ALWAYS) : FA_READ;
+        if (f_open(&file->fil, path, mode) != FR_OK) {
+            return NULL;
+        }
+        file->used = 1;
+        return file;
+    }
+    return NULL;
+}
+
+uint32_t halFileWrite(HalFile* file, const void* data, uint32_t size) {
+    UINT written = 0;
+    f_write(&file->fil, data, size, &written);
+    return written;
+}
+
+uint32_t halFileRead(HalFile* file, void* data, uint32_t size) {
+    UINT read = 0;
+    f_read(&file->fil, data, size, &read);
+    return read;
+}
+
+int halFileSeek(HalFile* file, uint32_t offset) {
+    return f_lseek(&file->fil, offset) == FR_OK ? 0 : -1;
+}
+
+void halFileClose(HalFile* file) {
+    f_close(&file->fil);
+    file->used = 0;
+}
+
+void halUsbInit(void (*txDone)(void)) {
+    usbTxDone = txDone;
+    USBD_Init(&USBD_Device, &VCP_CDC_desc, 0);
+    USBD_RegisterClass(&USBD_Device, &USBD_CDC);
+    USBD_CDC_RegisterInterface(&USBD_Device, &USBD_CDC_fops);
+    USBD_Start(&USBD_Device);
+}
+
+int halUsbTxReady(void) {
+    // 主机枚举完成前pClassData为空
+    USBD_CDC_HandleTypeDef* hcdc = (USBD_CDC_HandleTypeDef*)USBD_Device.pClassData;
+    return USBD_Device.dev_state == USBD_STATE_CONFIGURED && hcdc != NULL && hcdc->TxState == 0;
+}
+
+void halUsbTransmit(const uint8_t* data, uint32_t size) {
+    USBD_CDC_SetTxBuffer(&USBD_Device, (uint8_t*)data, size);
+    USBD_CDC_TransmitPacket(&USBD_Device);
+}
+
+void halUsbTxComplete(void) {
+    // 由usbd_cdc_if.c的CDC_TransmitCplt_FS在发送完成中断中调用
+    if (usbTxDone != NULL) {
+        usbTxDone();
+    }
+}
+
+uint32_t halUsbReceive(uint8_t* data, uint32_t size) {
+    USBD_CDC_HandleTypeDef* hcdc = (USBD_CDC_HandleTypeDef*)USBD_Device.pClassData;
+    if (USBD_CDC_GetRxState(&USBD_Device) != 1) {
+        return 0;
+    }
+    uint32_t rxLen = hcdc->RxLength < size ? hcdc->RxLength : size;
+    memcpy(data, hcdc->RxBuffer, rxLen);
+    USBD_CDC_ReceivePacket(&USBD_Device);
+    return rxLen;
+}
+
+static void netClosed(int client) {
+    clientPcbs[client] = NULL;
+    netHandler->closed(client);
+}
+
+static err_t netRecv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err) {
+    int client = (int)(intptr_t)arg;
+    (void)err;
+    if (p == NULL) {
+        // 对端关闭
+        tcp_arg(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_err(pcb, NULL);
+        tcp_close(pcb);
+        netClosed(client);
+        return ERR_OK;
+    }
+    for (struct pbuf* q = p; q != NULL; q = q->next) {
+        netHandler->received(client, q->payload, q->len);
+    }
+    if (clientPcbs[client] == pcb) {
+        tcp_recved(pcb, p->tot_len);
+    }
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static void netError(void* arg, err_t err) {
+    // 连接已被协议栈释放, 只需清理本地记录
+    (void)err;
+    netClosed((int)(intptr_t)arg);
+}
+
+static err_t netAccept(void* arg, struct tcp_pcb* pcb, err_t err) {
+    (void)arg;
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+    int slot = 0;
+    while (slot < HAL_NET_MAX_CLIENTS && clientPcbs[slot] != NULL) {
+        slot++;
+    }
+    if (slot == HAL_NET_MAX_CLIENTS) {
+        tcp_abort(pcb);  // 客户端已满
+        return ERR_ABRT;
+    }
+    clientPcbs[slot] = pcb;
+    tcp_arg(pcb, (void*)(intptr_t)slot);
+    tcp_recv(pcb, netRecv);
+    tcp_err(pcb, netError);
+    tcp_nagle_disable(pcb);
+    netHandler->accepted(slot);
+    return ERR_OK;
+}
+
+int halNetInit(const HalNetHandler* handler) {
+    // NO_SYS方式: 不用netconn和任务, 主循环中轮询网卡并处理协议栈定时器
+    netHandler = handler;
+    lwip_init();
+    netif_add(&netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, ethernet_input);
+    netif_set_default(&netif);
+    netif_set_up(&netif);
+
+    struct tcp_pcb* pcb = tcp_new();
+    if (pcb == NULL || tcp_bind(pcb, IP_ADDR_ANY, HAL_NET_PORT) != ERR_OK) {
+        return -1;
+    }
+    pcb = tcp_listen(pcb);
+    tcp_accept(pcb, netAccept);
+    return 0;
+}
+
+void halNetService(void) {
+    // 处理已收到的以太网帧和到期的定时器后立即返回
+    ethernetif_input(&netif);
+    sys_check_timeouts();
+}
+
+uint32_t halNetSend(int client, const void* data, uint32_t size) {
+    // 只写入发送缓冲区剩余的空间, 由协议栈复制后异步发出
+    struct tcp_pcb* pcb = clientPcbs[client];
+    if (pcb == NULL) {
+        return 0;
+    }
+    uint32_t space = tcp_sndbuf(pcb);
+    uint32_t len = size < space ? size : space;
+    if (len > 0xFFFF) {
+        len = 0xFFFF;
+    }
+    if (len == 0 || tcp_write(pcb, data, (u16_t)len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        return 0;
+    }
+    tcp_output(pcb);
+    return len;
+}
+
+void halNetClose(int client) {
+    struct tcp_pcb* pcb = clientPcbs[client];
+    if (pcb == NULL) {
+        return;
+    }
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_err(pcb, NULL);
+    if (tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+    }
+    netClosed(client);
+}
@@ -0,0 +1,379 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arm_math.h"
+
+#define RFFT_MAX_PLANS 8  // 缓存的FFT长度种类数
+
+typedef struct {
+    uint16_t fftLen;
+    float32_t* twiddle;
+    float32_t* twiddleRFFT;
+    uint16_t* bitRev;
+} RfftPlan;
+
+static RfftPlan plans[RFFT_MAX_PLANS];
+
+typedef struct {
+    uint32_t fftLen;
+    q15_t* twiddle;
+    uint16_t* bitRev;
+} RfftPlanQ15;
+
+static RfftPlanQ15 plansQ15[RFFT_MAX_PLANS];
+
+static q15_t saturateQ15(int64_t v) {
+    return (q15_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+void arm_fir_init_f32(arm_fir_instance_f32* S, uint16_t numTaps, const float32_t* pCoeffs,
+    float32_t* pState, uint32_t blockSize) {
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->pState = pState;
+    memset(pState, 0, (numTaps + blockSize - 1) * sizeof(float32_t));
+}
+
+void arm_fir_f32(const arm_fir_instance_f32* S, const float32_t* pSrc, float32_t* pDst, uint32_t blockSize) {
+    // 状态缓冲区前numTaps-1个是上一块的历史样本, 系数按CMSIS约定逆序存放
+    uint16_t numTaps = S->numTaps;
+    float32_t* state = S->pState;
+    memcpy(state + numTaps - 1, pSrc, blockSize * sizeof(float32_t));
+    for (uint32_t n = 0; n < blockSize; n++) {
+        float32_t acc = 0;
+        for (uint16_t k = 0; k < numTaps; k++) {
+            acc += S->pCoeffs[k] * state[n + k];
+        }
+        pDst[n] = acc;
+    }
+    memmove(state, state + blockSize, (numTaps - 1) * sizeof(float32_t));
+}
+
+arm_status arm_fir_decimate_init_f32(arm_fir_decimate_instance_f32* S, uint16_t numTaps, uint8_t M,
+    const float32_t* pCoeffs, float32_t* pState, uint32_t blockSize) {
+    if (M == 0 || blockSize % M != 0) {
+        return ARM_MATH_ARGUMENT_ERROR;
+    }
+    S->M = M;
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->pState = pState;
+    memset(pState, 0, (numTaps + blockSize - 1) * sizeof(float32_t));
+    return ARM_MATH_SUCCESS;
+}
+
+void arm_fir_decimate_f32(const arm_fir_decimate_instance_f32* S, const float32_t* pSrc, float32_t* pDst,
+    uint32_t blockSize) {
+    // 只计算保留下来的输出, 每个输入样本平均numTaps/M次乘加, 与多相结构的运算量相同
+    uint16_t numTaps = S->numTaps;
+    float32_t* state = S->pState;
+    memcpy(state + numTaps - 1, pSrc, blockSize * sizeof(float32_t));
+    for (uint32_t n = 0; n < blockSize / S->M; n++) {
+        const float32_t* x = state + n * S->M;
+        float32_t acc = 0;
+        for (uint16_t k = 0; k < numTaps; k++) {
+            acc += S->pCoeffs[k] * x[k];
+        }
+        pDst[n] = acc;
+    }
+    memmove(state, state + blockSize, (numTaps - 1) * sizeof(float32_t));
+}
+
+arm_status arm_fir_init_q15(arm_fir_instance_q15* S, uint16_t numTaps, const q15_t* pCoeffs,
+    q15_t* pState, uint32_t blockSize) {
+    // 与CMSIS一致: 抽头数须为不小于4的偶数, 状态缓冲区长度numTaps + blockSize
+    if (numTaps < 4 || (numTaps & 1) != 0) {
+        return ARM_MATH_ARGUMENT_ERROR;
+    }
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->pState = pState;
+    memset(pState, 0, (numTaps + blockSize) * sizeof(q15_t));
+    return ARM_MATH_SUCCESS;
+}
+
+void arm_fir_q15(const arm_fir_instance_q15* S, const q15_t* pSrc, q15_t* pDst, uint32_t blockSize) {
+    // 64位累加Q30乘积, 右移15位后饱和到Q15, 与CMSIS的__SSAT(acc >> 15, 16)相同
+    uint16_t numTaps = S->numTaps;
+    q15_t* state = S->pState;
+    memcpy(state + numTaps - 1, pSrc, blockSize * sizeof(q15_t));
+    for (uint32_t n = 0; n < blockSize; n++) {
+        int64_t acc = 0;
+        for (uint16_t k = 0; k < numTaps; k++) {
+            acc += (int32_t)S->pCoeffs[k] * state[n + k];
+        }
+        pDst[n] = saturateQ15(acc >> 15);
+    }
+    memmove(state, state + blockSize, (numTaps - 1) * sizeof(q15_t));
+}
+
+arm_status arm_rfft_init_q15(arm_rfft_instance_q15* S, uint32_t fftLenReal, uint32_t ifftFlagR,
+    uint32_t bitReverseFlag) {
+    if (fftLenReal < 32 || fftLenReal > 8192 || (fftLenReal & (fftLenReal - 1)) != 0 || ifftFlagR != 0) {
+        return ARM_MATH_ARGUMENT_ERROR;
+    }
+    RfftPlanQ15* plan = NULL;
+    for (int i = 0; i < RFFT_MAX_PLANS; i++) {
+        if (plansQ15[i].fftLen == fftLenReal || plansQ15[i].fftLen == 0) {
+            plan = &plansQ15[i];
+            break;
+        }
+    }
+    if (plan == NULL) {
+        return ARM_MATH_ARGUMENT_ERROR;
+    }
+    if (plan->fftLen == 0) {
+        int bits = 0;
+        while ((1u << bits) < fftLenReal) {
+            bits++;
+        }
+        plan->twiddle = malloc(fftLenReal * sizeof(q15_t));
+        plan->bitRev = malloc(fftLenReal * sizeof(uint16_t));
+        for (uint32_t k = 0; k < fftLenReal / 2; k++) {
+            plan->twiddle[2 * k] = saturateQ15(lrint(cos(2 * M_PI * k / fftLenReal) * 32768));
+            plan->twiddle[2 * k + 1] = saturateQ15(lrint(-sin(2 * M_PI * k / fftLenReal) * 32768));
+        }
+        for (uint32_t k = 0; k < fftLenReal; k++) {
+            uint32_t r = 0;
+            for (int b = 0; b < bits; b++) {
+                r |= ((k >> b) & 1) << (bits - 1 - b);
+            }
+            plan->bitRev[k] = (uint16_t)r;
+        }
+        plan->fftLen = fftLenReal;
+    }
+    S->fftLenReal = fftLenReal;
+    S->ifftFlagR = 0;
+    S->bitReverseFlagR = (uint8_t)bitReverseFlag;
+    S->pTwiddle = plan->twiddle;
+    S->pBitRevTable = plan->bitRev;
+    return ARM_MATH_SUCCESS;
+}
+
+void arm_rfft_q15(const arm_rfft_instance_q15* S, q15_t* pSrc, q15_t* pDst) {
+    // 定点基2复数FFT, 每级蝶形运算后右移1位防止溢出, 输出为DFT / fftLenReal;
+    // 与CMSIS一样输出全部fftLenReal个复数频点(后一半与前一半共轭对称)
+    uint32_t n = S->fftLenReal;
+    for (uint32_t i = 0; i < n; i++) {
+        pDst[2 * S->pBitRevTable[i]] = pSrc[i];
+        pDst[2 * S->pBitRevTable[i] + 1] = 0;
+    }
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        uint32_t step = n / len;
+        for (uint32_t i = 0; i < n; i += len) {
+            for (uint32_t k = 0; k < len / 2; k++) {
+                int32_t wr = S->pTwiddle[2 * k * step];
+                int32_t wi = S->pTwiddle[2 * k * step + 1];
+                q15_t* a = &pDst[2 * (i + k)];
+                q15_t* b = &pDst[2 * (i + k + len / 2)];
+                int32_t tr = (b[0] * wr - b[1] * wi) >> 15;
+                int32_t ti = (b[0] * wi + b[1] * wr) >> 15;
+                int32_t ar = a[0], ai = a[1];
+                a[0] = (q15_t)((ar + tr) >> 1);
+                a[1] = (q15_t)((ai + ti) >> 1);
+                b[0] = (q15_t)((ar - tr) >> 1);
+                b[1] = (q15_t)((ai - ti) >> 1);
+            }
+        }
+    }
+}
+
+void arm_float_to_q15(const float32_t* pSrc, q15_t* pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = saturateQ15(lrintf(pSrc[i] * 32768.0f));
+    }
+}
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32* S, uint16_t fftLen) {
+    if (fftLen < 4 || (fftLen & (fftLen - 1)) != 0) {
+        return ARM_MATH_ARGUMENT_ERROR;
+    }
+
+    // 与CMSIS一样使用常量表, 同一长度只计算一次
+    RfftPlan* plan = NULL;
+    for (int i = 0; i < RFFT_MAX_PLANS; i++) {
+        if (plans[i].fftLen == fftLen || plans[i].fftLen == 0) {
+            plan = &plans[i];
+            break;
+        }
+    }
+    if (plan == NULL) {
+        return ARM_MATH_ARGUMENT_ERROR;
+    }
+
+    if (plan->fftLen == 0) {
+        uint16_t half = fftLen / 2;
+        int bits = 0;
+        while ((1 << bits) < half) {
+            bits++;
+        }
+        plan->twiddle = malloc(half * sizeof(float32_t));
+        plan->twiddleRFFT = malloc(fftLen * sizeof(float32_t));
+        plan->bitRev = malloc(half * sizeof(uint16_t));
+        for (int k = 0; k < half / 2; k++) {
+            plan->twiddle[2 * k] = cosf(2 * PI * k / half);
+            plan->twiddle[2 * k + 1] = -sinf(2 * PI * k / half);
+        }
+        for (int k = 0; k < half; k++) {
+            plan->twiddleRFFT[2 * k] = cosf(2 * PI * k / fftLen);
+            plan->twiddleRFFT[2 * k + 1] = -sinf(2 * PI * k / fftLen);
+            int r = 0;
+            for (int b = 0; b < bits; b++) {
+                r |= ((k >> b) & 1) << (bits - 1 - b);
+            }
+            plan->bitRev[k] = (uint16_t)r;
+        }
+        plan->fftLen = fftLen;
+    }
+
+    S->fftLenRFFT = fftLen;
+    S->pTwiddle = plan->twiddle;
+    S->pTwiddleRFFT = plan->twiddleRFFT;
+    S->pBitRevTable = plan->bitRev;
+    return ARM_MATH_SUCCESS;
+}
+
+static void cfftRadix2(const arm_rfft_fast_instance_f32* S, float32_t* buf, int inverse) {
+    // 原地基2复数FFT, 长度为fftLenRFFT/2
+    int n = S->fftLenRFFT / 2;
+    for (int i = 0; i < n; i++) {
+        int j = S->pBitRevTable[i];
+        if (j > i) {
+            float32_t re = buf[2 * i], im = buf[2 * i + 1];
+            buf[2 * i] = buf[2 * j];
+            buf[2 * i + 1] = buf[2 * j + 1];
+            buf[2 * j] = re;
+            buf[2 * j + 1] = im;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        int step = n / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < len / 2; k++) {
+                float32_t wr = S->pTwiddle[2 * k * step];
+                float32_t wi = S->pTwiddle[2 * k * step + 1];
+                if (inverse) {
+                    wi = -wi;
+                }
+                float32_t* a = &buf[2 * (i + k)];
+                float32_t* b = &buf[2 * (i + k + len / 2)];
+                float32_t tr = b[0] * wr - b[1] * wi;
+                float32_t ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+void arm_rfft_fast_f32(const arm_rfft_fast_instance_f32* S, float32_t* p, float32_t* pOut, uint8_t ifftFlag) {
+    // 输出按CMSIS格式打包: pOut[0]=直流, pOut[1]=奈奎斯特, 其后为复数频点
+    int half = S->fftLenRFFT / 2;
+    const float32_t* w = S->pTwiddleRFFT;
+
+    if (!ifftFlag) {
+        memcpy(pOut, p, S->fftLenRFFT * sizeof(float32_t));
+        cfftRadix2(S, pOut, 0);
+        float32_t z0r = pOut[0], z0i = pOut[1];
+        for (int k = 1; k <= half / 2; k++) {
+            int m = half - k;
+            float32_t ar = pOut[2 * k], ai = pOut[2 * k + 1];
+            float32_t br = pOut[2 * m], bi = pOut[2 * m + 1];
+            // Fe = (Z[k] + conj(Z[m])) / 2, Fo = (Z[k] - conj(Z[m])) / 2j
+            float32_t er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+            float32_t or_ = 0.5f * (ai + bi), oi = -0.5f * (ar - br);
+            float32_t tr = w[2 * k] * or_ - w[2 * k + 1] * oi;
+            float32_t ti = w[2 * k] * oi + w[2 * k + 1] * or_;
+            // X[m]由同一对Fe/Fo共轭求得
+            float32_t e2r = er, e2i = -ei;
+            float32_t o2r = or_, o2i = -oi;
+            float32_t t2r = w[2 * m] * o2r - w[2 * m + 1] * o2i;
+            float32_t t2i = w[2 * m] * o2i + w[2 * m + 1] * o2r;
+            pOut[2 * k] = er + tr;
+            pOut[2 * k + 1] = ei + ti;
+            pOut[2 * m] = e2r + t2r;
+            pOut[2 * m + 1] = e2i + t2i;
+        }
+        pOut[0] = z0r + z0i;
+        pOut[1] = z0r - z0i;
+    } else {
+        float32_t x0 = p[0], xn = p[1];
+        for (int k = 1; k <= half / 2; k++) {
+            int m = half - k;
+            float32_t ar = p[2 * k], ai = p[2 * k + 1];
+            float32_t br = p[2 * m], bi = p[2 * m + 1];
+            // Fe = (X[k] + conj(X[m])) / 2, Fo = (X[k] - conj(X[m])) * W^-k / 2
+            float32_t er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+            float32_t dr = 0.5f * (ar - br), di = 0.5f * (ai + bi);
+            float32_t or_ = dr * w[2 * k] + di * w[2 * k + 1];
+            float32_t oi = di * w[2 * k] - dr * w[2 * k + 1];
+            // Z[k] = Fe + j*Fo, Z[m] = conj(Fe) + j*conj(Fo)
+            pOut[2 * k] = er - oi;
+            pOut[2 * k + 1] = ei + or_;
+            pOut[2 * m] = er + oi;
+            pOut[2 * m + 1] = -ei + or_;
+        }
+        pOut[0] = 0.5f * (x0 + xn);
+        pOut[1] = 0.5f * (x0 - xn);
+        cfftRadix2(S, pOut, 1);
+        float32_t scale = 1.0f / half;
+        for (int i = 0; i < S->fftLenRFFT; i++) {
+            pOut[i] *= scale;
+        }
+    }
+}
+
+void arm_cmplx_mag_f32(const float32_t* pSrc, float32_t* pDst, uint32_t numSamples) {
+    for (uint32_t i = 0; i < numSamples; i++) {
+        float32_t re = pSrc[2 * i], im = pSrc[2 * i + 1];
+        pDst[i] = sqrtf(re * re + im * im);
+    }
+}
+
+void arm_cmplx_mag_squared_f32(const float32_t* pSrc, float32_t* pDst, uint32_t numSamples) {
+    for (uint32_t i = 0; i < numSamples; i++) {
+        float32_t re = pSrc[2 * i], im = pSrc[2 * i + 1];
+        pDst[i] = re * re + im * im;
+    }
+}
+
+void arm_add_f32(const float32_t* pSrcA, const float32_t* pSrcB, float32_t* pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = pSrcA[i] + pSrcB[i];
+    }
+}
+
+void arm_sub_f32(const float32_t* pSrcA, const float32_t* pSrcB, float32_t* pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = pSrcA[i] - pSrcB[i];
+    }
+}
+
+void arm_scale_f32(const float32_t* pSrc, float32_t scale, float32_t* pDst, uint32_t blockSize) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = pSrc[i] * scale;
+    }
+}
+
+void arm_min_f32(const float32_t* pSrc, uint32_t blockSize, float32_t* pResult, uint32_t* pIndex) {
+    uint32_t index = 0;
+    for (uint32_t i = 1; i < blockSize; i++) {
+        if (pSrc[i] < pSrc[index]) {
+            index = i;
+        }
+    }
+    *pResult = pSrc[index];
+    *pIndex = index;
+}
+
+void arm_max_f32(const float32_t* pSrc, uint32_t blockSize, float32_t* pResult, uint32_t* pIndex) {
+    uint32_t index = 0;
+    for (uint32_t i = 1; i < blockSize; i++) {
+        if (pSrc[i] > pSrc[index]) {
+            index = i;
+        }
+    }
+    *pResult = pSrc[index];
+    *pIndex = index;
+}
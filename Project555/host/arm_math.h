@@ -0,0 +1,86 @@
+#ifndef ARM_MATH_HOST_H
+#define ARM_MATH_HOST_H
+
+// 主机构建用的CMSIS-DSP替身, 只实现示波器用到的函数, 接口与arm_math.h一致
+
+#include <stdint.h>
+#include <math.h>
+
+#ifndef PI
+#define PI 3.14159265358979f
+#endif
+
+typedef float float32_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+typedef enum {
+    ARM_MATH_SUCCESS = 0,
+    ARM_MATH_ARGUMENT_ERROR = -1
+} arm_status;
+
+typedef struct {
+    uint16_t numTaps;
+    float32_t* pState;
+    const float32_t* pCoeffs;
+} arm_fir_instance_f32;
+
+typedef struct {
+    uint8_t M;          // 抽取倍数
+    uint16_t numTaps;
+    const float32_t* pCoeffs;
+    float32_t* pState;
+} arm_fir_decimate_instance_f32;
+
+typedef struct {
+    uint16_t numTaps;
+    q15_t* pState;
+    const q15_t* pCoeffs;
+} arm_fir_instance_q15;
+
+typedef struct {
+    uint32_t fftLenReal;
+    uint8_t ifftFlagR;
+    uint8_t bitReverseFlagR;
+    const q15_t* pTwiddle;          // 长度为fftLenReal的复数FFT旋转因子(Q15)
+    const uint16_t* pBitRevTable;
+} arm_rfft_instance_q15;
+
+typedef struct {
+    uint16_t fftLenRFFT;
+    const float32_t* pTwiddle;      // 长度为fftLenRFFT/2的复数FFT旋转因子
+    const float32_t* pTwiddleRFFT;  // 实数FFT拆分用旋转因子
+    const uint16_t* pBitRevTable;
+} arm_rfft_fast_instance_f32;
+
+void arm_fir_init_f32(arm_fir_instance_f32* S, uint16_t numTaps, const float32_t* pCoeffs,
+    float32_t* pState, uint32_t blockSize);
+void arm_fir_f32(const arm_fir_instance_f32* S, const float32_t* pSrc, float32_t* pDst, uint32_t blockSize);
+arm_status arm_fir_decimate_init_f32(arm_fir_decimate_instance_f32* S, uint16_t numTaps, uint8_t M,
+    const float32_t* pCoeffs, float32_t* pState, uint32_t blockSize);
+void arm_fir_decimate_f32(const arm_fir_decimate_instance_f32* S, const float32_t* pSrc, float32_t* pDst,
+    uint32_t blockSize);
+
+arm_status arm_fir_init_q15(arm_fir_instance_q15* S, uint16_t numTaps, const q15_t* pCoeffs,
+    q15_t* pState, uint32_t blockSize);
+void arm_fir_q15(const arm_fir_instance_q15* S, const q15_t* pSrc, q15_t* pDst, uint32_t blockSize);
+
+arm_status arm_rfft_init_q15(arm_rfft_instance_q15* S, uint32_t fftLenReal, uint32_t ifftFlagR,
+    uint32_t bitReverseFlag);
+void arm_rfft_q15(const arm_rfft_instance_q15* S, q15_t* pSrc, q15_t* pDst);
+
+void arm_float_to_q15(const float32_t* pSrc, q15_t* pDst, uint32_t blockSize);
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32* S, uint16_t fftLen);
+void arm_rfft_fast_f32(const arm_rfft_fast_instance_f32* S, float32_t* p, float32_t* pOut, uint8_t ifftFlag);
+
+void arm_cmplx_mag_f32(const float32_t* pSrc, float32_t* pDst, uint32_t numSamples);
+void arm_cmplx_mag_squared_f32(const float32_t* pSrc, float32_t* pDst, uint32_t numSamples);
+
+void arm_add_f32(const float32_t* pSrcA, const float32_t* pSrcB, float32_t* pDst, uint32_t blockSize);
+void arm_sub_f32(const float32_t* pSrcA, const float32_t* pSrcB, float32_t* pDst, uint32_t blockSize);
+void arm_scale_f32(const float32_t* pSrc, float32_t scale, float32_t* pDst, uint32_t blockSize);
+void arm_min_f32(const float32_t* pSrc, uint32_t blockSize, float32_t* pResult, uint32_t* pIndex);
+void arm_max_f32(const float32_t* pSrc, uint32_t blockSize, float32_t* pResult, uint32_t* pIndex);
+
+#endif
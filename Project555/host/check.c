@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "scope.h"
+#include "scope_usb.h"
+#include "scope_measure.h"
+#include "scope_record.h"
+#include "scope_fir.h"
+#include "scope_logic.h"
+#include "siggen.h"
+
+// 主机自检(make check): 用构造的输入检查各模块在边界和异常输入下的行为, 全部通过时返回0
+
+#define FIR_FFT_TOLERANCE 0.02f  // FFT与直接型之差(码值), 实测不到0.003
+#define FIR_Q15_TOLERANCE 2.0f   // Q15与浮点直接型之差(码值), 系数量化和舍入实测不到1
+
+static int failures = 0;
+
+static void expect(int ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static uint8_t usbData[USB_BLOCK_BYTES];
+
+static uint32_t usbPacket(uint8_t* out, uint32_t seq, uint32_t block, uint16_t index, uint16_t length,
+    const uint8_t* payload) {
+    // 按发送端的格式组一个包, CRC总是正确的, 返回包的总长度
+    UsbPacket h;
+    h.magic = USB_MAGIC;
+    h.length = length;
+    h.seq = seq;
+    h.block = block;
+    h.index = index;
+    h.count = USB_BLOCK_PACKETS;
+    h.crc = usbCrc32(usbCrc32(0, &h, offsetof(UsbPacket, crc)), payload, length);
+    memcpy(out, &h, sizeof(h));
+    memcpy(out + sizeof(h), payload, length);
+    return (uint32_t)sizeof(h) + length;
+}
+
+static int usbBlock(UsbReceiver* r, uint32_t* seq, uint32_t block) {
+    // 发送一个完整的块, 返回收齐的块数
+    uint8_t packet[USB_PACKET_BYTES];
+    int completed = 0;
+    for (uint32_t i = 0; i < USB_BLOCK_PACKETS; i++) {
+        uint32_t offset = i * USB_PACKET_PAYLOAD;
+        uint32_t length = USB_BLOCK_BYTES - offset < USB_PACKET_PAYLOAD ? USB_BLOCK_BYTES - offset : USB_PACKET_PAYLOAD;
+        uint32_t size = usbPacket(packet, (*seq)++, block, (uint16_t)i, (uint16_t)length, usbData + offset);
+        completed += usbReceive(r, packet, size);
+    }
+    return completed;
+}
+
+static void checkUsbReceiver(void) {
+    // CRC正确但长度与包的位置不符、序号越界的包都要丢弃, 不能写出接收缓冲区, 之后仍能收齐完整的块
+    static UsbReceiver r;
+    static uint8_t payload[USB_PACKET_BYTES];
+    uint8_t packet[USB_PACKET_BYTES + sizeof(UsbPacket)];
+    uint32_t last = USB_BLOCK_PACKETS - 1;
+    uint32_t lastLength = USB_BLOCK_BYTES - last * USB_PACKET_PAYLOAD;
+    struct {
+        uint32_t index;
+        uint32_t length;
+        const char* what;
+    } bad[] = {
+        { last, USB_PACKET_PAYLOAD, "usb: full-length last packet" },
+        { last, lastLength + 1, "usb: last packet one byte too long" },
+        { last, lastLength - 1, "usb: short last packet" },
+        { 0, USB_PACKET_PAYLOAD - 1, "usb: short middle packet" },
+        { 3, 0, "usb: empty packet" },
+        { USB_BLOCK_PACKETS, 16, "usb: index past the block" },
+        { 0xFFFF, USB_PACKET_PAYLOAD, "usb: index 0xFFFF" },
+    };
+    uint32_t seq = 0;
+
+    // 负载避开魔数的两个字节, 重新同步时不会在负载中途认出假包头
+    for (uint32_t i = 0; i < sizeof(usbData); i++) {
+        usbData[i] = (uint8_t)(i * 7 % 61);
+    }
+    memset(payload, 0x11, sizeof(payload));
+    usbReceiverInit(&r);
+    expect(usbBlock(&r, &seq, 1) == 1, "usb: complete block");
+    expect(memcmp(r.data, usbData, sizeof(usbData)) == 0, "usb: block contents");
+
+    for (uint32_t k = 0; k < sizeof(bad) / sizeof(bad[0]); k++) {
+        uint32_t packets = r.packets;
+        uint32_t size = usbPacket(packet, seq, 2, (uint16_t)bad[k].index, (uint16_t)bad[k].length, payload);
+        usbReceive(&r, packet, size);
+        expect(r.packets == packets, bad[k].what);
+    }
+    expect(memcmp(r.data, usbData, sizeof(usbData)) == 0, "usb: malformed packets left the data untouched");
+    expect(usbBlock(&r, &seq, 3) == 1, "usb: block after malformed packets");
+    expect(r.lostPackets == 0 && r.crcErrors == 0, "usb: no loss reported for well-formed packets");
+}
+
+static int sameFloat(float a, float b) {
+    // 累加顺序不同时浮点结果允许有舍入误差
+    return fabsf(a - b) <= 1e-5f * (fabsf(a) > 1 ? fabsf(a) : 1);
+}
+
+static int sameMeasurement(const Measurement* a, const Measurement* b) {
+    return a->min == b->min && a->max == b->max && sameFloat(a->mean, b->mean) && sameFloat(a->rms, b->rms)
+        && sameFloat(a->top, b->top) && sameFloat(a->base, b->base)
+        && a->risingEdges == b->risingEdges && a->fallingEdges == b->fallingEdges
+        && sameFloat(a->riseTime, b->riseTime) && sameFloat(a->fallTime, b->fallTime)
+        && sameFloat(a->frequency, b->frequency) && sameFloat(a->duty, b->duty)
+        && sameFloat(a->overshoot, b->overshoot) && a->next.low == b->next.low
+        && a->next.mid == b->next.mid && a->next.high == b->next.high;
+}
+
+static void checkMeasure(void) {
+    // 向量测量核与标量参考实现对每种合成信号、每个长度和起点的结果必须一致:
+    // 长度取比一个向量还短的、奇数的和整块的, 起点错开一个样本检查不对齐的输入和尾部
+    static const char* signals[] = {
+        "sine:1000:1.0", "sine:1000:1.0:0.05", "square:5000:1.5", "square:333:0.2:0.02",
+        "noise:0:1.0", "chirp:100:1.0", "uart:115200:1.5", "i2csda:100000:1.5",
+    };
+    static const int lengths[] = { 1, 2, 3, 7, 15, 16, 17, 31, 33, 63, 255, 257, 1021, 2047, ADC_BUFFER_SIZE - 1 };
+    static uint16_t x[ADC_BUFFER_SIZE];
+    const uint32_t rate = 1000000;
+    char what[128];
+    for (uint32_t s = 0; s < sizeof(signals) / sizeof(signals[0]); s++) {
+        SigChannel ch;
+        sigParse(&ch, signals[s]);
+        sigGenerate(&ch, rate, x, ADC_BUFFER_SIZE);
+        Measurement whole;
+        MeasureLevels levels = { 0, 0, 0 };
+        measureBlockScalar(x, ADC_BUFFER_SIZE, &levels, rate, &whole);
+        for (int pass = 0; pass < 2; pass++) {
+            // 先用整块算出的参考电平, 再用全零电平(边沿状态机的极端情况)
+            MeasureLevels use = pass == 0 ? whole.next : levels;
+            for (uint32_t k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++) {
+                for (int from = 0; from < 2; from++) {
+                    Measurement a, b;
+                    memset(&a, 0, sizeof(a));
+                    memset(&b, 0, sizeof(b));
+                    measureBlock(x + from, lengths[k], &use, rate, &a);
+                    measureBlockScalar(x + from, lengths[k], &use, rate, &b);
+                    snprintf(what, sizeof(what), "measure: %s kernel vs scalar, %s, n=%d, offset %d, levels %d",
+                        measureKernelName(), signals[s], lengths[k], from, pass);
+                    expect(sameMeasurement(&a, &b), what);
+                }
+            }
+        }
+    }
+}
+
+static const uint32_t firChunks[] = { ADC_BUFFER_SIZE, 1, 37, 63, 64, 65, 500, 1000, 7 };
+enum { FIR_TOTAL = 3 * ADC_BUFFER_SIZE };
+static uint16_t firCodes[FIR_TOTAL];
+static float32_t firX[FIR_TOTAL], firDirect[FIR_TOTAL];
+static float32_t firH[512];
+
+static void firSetup(int taps) {
+    // 输入是带噪声的方波, 去掉ADC中点后与Q15路径的初始状态相同;
+    // 系数是汉明窗sinc低通(截止0.1倍采样率), 归一化为单位直流增益, 与test.c的设计方法相同
+    SigChannel ch;
+    sigParse(&ch, "square:3000:1.5:0.1");
+    sigGenerate(&ch, 1000000, firCodes, FIR_TOTAL);
+    for (int i = 0; i < FIR_TOTAL; i++) {
+        firX[i] = (float32_t)firCodes[i] - (ADC_FULL_SCALE + 1) / 2;
+    }
+    float sum = 0;
+    for (int i = 0; i < taps; i++) {
+        float m = i - (taps - 1) / 2.0f;
+        float v = m == 0 ? 0.2f : sinf(2 * PI * 0.1f * m) / (PI * m);
+        firH[i] = taps > 1 ? v * (0.54f - 0.46f * cosf(2 * PI * i / (taps - 1))) : 1;
+        sum += firH[i];
+    }
+    for (int i = 0; i < taps; i++) {
+        firH[i] /= sum;
+    }
+}
+
+static uint32_t firChunk(uint32_t k, uint32_t done) {
+    // 每次送入的样本数不断变化, 覆盖段边界、不足一段的末尾和整块
+    uint32_t n = firChunks[k % (sizeof(firChunks) / sizeof(firChunks[0]))];
+    return n < FIR_TOTAL - done ? n : FIR_TOTAL - done;
+}
+
+static int firRunDirect(int taps) {
+    FirFilter a;
+    if (firInit(&a, firH, (uint16_t)taps, ADC_BUFFER_SIZE, FIR_DIRECT) != 0) {
+        return -1;
+    }
+    for (uint32_t k = 0, done = 0, n; done < FIR_TOTAL; k++, done += n) {
+        n = firChunk(k, done);
+        firProcess(&a, firX + done, firDirect + done, n);
+    }
+    firFree(&a);
+    return 0;
+}
+
+static void checkFir(void) {
+    // FFT重叠保留路径与直接型对同一输入流的输出必须一致, 误差在浮点舍入范围内
+    static const int taps[] = { 1, 3, 16, 31, 32, 63, 100, 255, 511 };
+    static float32_t y[FIR_TOTAL];
+    char what[128];
+    for (uint32_t t = 0; t < sizeof(taps) / sizeof(taps[0]); t++) {
+        FirFilter b;
+        firSetup(taps[t]);
+        int ok = firRunDirect(taps[t]) == 0 && firInit(&b, firH, (uint16_t)taps[t], ADC_BUFFER_SIZE, FIR_FFT) == 0;
+        snprintf(what, sizeof(what), "fir: init %d taps", taps[t]);
+        expect(ok, what);
+        if (!ok) {
+            continue;
+        }
+        for (uint32_t k = 0, done = 0, n; done < FIR_TOTAL; k++, done += n) {
+            n = firChunk(k, done);
+            firProcess(&b, firX + done, y + done, n);
+        }
+        float error = 0;
+        for (int i = 0; i < FIR_TOTAL; i++) {
+            float e = fabsf(y[i] - firDirect[i]);
+            error = e > error ? e : error;
+        }
+        snprintf(what, sizeof(what), "fir: FFT vs direct, %d taps (FFT %u, max error %g)", taps[t], b.fftLen, error);
+        expect(error < FIR_FFT_TOLERANCE, what);
+        firFree(&b);
+    }
+}
+
+static void checkFirQ15(void) {
+    // Q15路径与浮点直接型之差不超过几个码值; 浮点结果超出ADC量程的地方按定点路径的饱和限幅后比较.
+    // arm_fir_q15要求抽头数为不小于4的偶数
+    static const int taps[] = { 4, 16, 32, 100, 254 };
+    static q15_t x[FIR_TOTAL], y[FIR_TOTAL];
+    static uint16_t codes[FIR_TOTAL];
+    char what[128];
+    for (uint32_t t = 0; t < sizeof(taps) / sizeof(taps[0]); t++) {
+        FirFilterQ15 q;
+        firSetup(taps[t]);
+        int ok = firRunDirect(taps[t]) == 0 && firInitQ15(&q, firH, (uint16_t)taps[t], ADC_BUFFER_SIZE) == 0;
+        snprintf(what, sizeof(what), "fir: Q15 init %d taps", taps[t]);
+        expect(ok, what);
+        if (!ok) {
+            continue;
+        }
+        adcToQ15(firCodes, x, FIR_TOTAL);
+        for (uint32_t k = 0, done = 0, n; done < FIR_TOTAL; k++, done += n) {
+            n = firChunk(k, done);
+            firProcessQ15(&q, x + done, y + done, n);
+        }
+        q15ToAdc(y, codes, FIR_TOTAL);
+        float error = 0;
+        for (int i = 0; i < FIR_TOTAL; i++) {
+            float ref = firDirect[i] + (ADC_FULL_SCALE + 1) / 2;
+            ref = ref < 0 ? 0 : ref > ADC_FULL_SCALE ? ADC_FULL_SCALE : ref;
+            float e = fabsf(codes[i] - ref);
+            error = e > error ? e : error;
+        }
+        snprintf(what, sizeof(what), "fir: Q15 vs float, %d taps (max error %g codes)", taps[t], error);
+        expect(error <= FIR_Q15_TOLERANCE, what);
+        firFreeQ15(&q);
+    }
+}
+
+enum { LOGIC_SAMPLES = 64 * 1024, LOGIC_RATE = 1000000, LOGIC_BITRATE = 100000 };
+static DeepCapture logicCaps[MAX_CHANNELS];
+static LogicAnalyzer logicAnalyzer;
+
+static void logicCapture(const char* const* specs, int channels) {
+    // 各通道用siggen产生协议信号(每位10个样本), 按ADC块写入深存储
+    uint16_t block[ADC_BUFFER_SIZE];
+    for (int c = 0; c < channels; c++) {
+        SigChannel ch;
+        sigParse(&ch, specs[c]);
+        captureInit(&logicCaps[c]);
+        for (uint32_t done = 0; done < LOGIC_SAMPLES; done += ADC_BUFFER_SIZE) {
+            sigGenerate(&ch, LOGIC_RATE, block, ADC_BUFFER_SIZE);
+            captureAppend(&logicCaps[c], block, ADC_BUFFER_SIZE);
+        }
+    }
+}
+
+static uint32_t logicRun(const LogicConfig* cfg) {
+    logicInit(&logicAnalyzer, cfg);
+    logicLoad(&logicAnalyzer, logicCaps, 0, LOGIC_SAMPLES);
+    return logicDecode(&logicAnalyzer);
+}
+
+static void checkLogic(void) {
+    // siggen产生的UART/SPI/I2C帧数据字节从0依次递增, 解码结果必须逐字相符且没有错误标志
+    const uint32_t slots = LOGIC_RATE / LOGIC_BITRATE;
+    LogicConfig cfg = { 0 };
+    cfg.threshold = ADC_FULL_SCALE / 2;
+    cfg.miso = cfg.cs = -1;
+    cfg.wordBits = 8;
+    char what[128];
+
+    static const char* const uart[] = { "uart:100000:1.5" };
+    logicCapture(uart, 1);
+    cfg.protocol = LOGIC_UART;
+    cfg.samplesPerBit = (float)slots;
+    uint32_t count = logicRun(&cfg);  // 第0帧的起始位前没有空闲高电平, 从第1帧开始解码
+    uint32_t bad = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const LogicEvent* e = &logicAnalyzer.events[i];
+        bad += e->type != EVT_UART_BYTE || e->flags != 0 || e->data != ((i + 1) & 0xFF);
+    }
+    snprintf(what, sizeof(what), "logic: UART %u bytes, %u wrong", count, bad);
+    expect(count + 2 >= LOGIC_SAMPLES / (12 * slots) && bad == 0, what);
+
+    static const char* const spi[] = { "spiclk:100000:1.5", "spidata:100000:1.5" };
+    logicCapture(spi, 2);
+    cfg.protocol = LOGIC_SPI;
+    cfg.clk = 0;
+    cfg.mosi = 1;
+    count = logicRun(&cfg);
+    bad = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const LogicEvent* e = &logicAnalyzer.events[i];
+        bad += e->type != EVT_SPI_WORD || e->data != (i & 0xFF);
+    }
+    snprintf(what, sizeof(what), "logic: SPI %u words, %u wrong", count, bad);
+    expect(count + 1 >= LOGIC_SAMPLES / (10 * slots) && bad == 0, what);
+
+    // 片选在第frame帧的中途变为无效并保持到该帧结束: 该帧不完整的字被丢弃, 下一字必须恰好是下一帧
+    const uint32_t frame = 100, cut = frame * 10 * slots + 4 * slots;
+    uint16_t block[ADC_BUFFER_SIZE];
+    captureInit(&logicCaps[2]);
+    for (uint32_t done = 0; done < LOGIC_SAMPLES; done += ADC_BUFFER_SIZE) {
+        for (uint32_t i = 0; i < ADC_BUFFER_SIZE; i++) {
+            block[i] = done + i >= cut && done + i < (frame + 1) * 10 * slots ? ADC_FULL_SCALE : 0;
+        }
+        captureAppend(&logicCaps[2], block, ADC_BUFFER_SIZE);
+    }
+    cfg.cs = 2;
+    count = logicRun(&cfg);
+    bad = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const LogicEvent* e = &logicAnalyzer.events[i];
+        bad += e->data != (i < frame ? i : i + 1) % 256;
+    }
+    snprintf(what, sizeof(what), "logic: SPI with chip select dropped mid-word, %u words, %u wrong", count, bad);
+    expect(count > frame && bad == 0, what);
+    cfg.cs = -1;
+
+    // I2C: 每帧依次为起始、地址0x50(写)、数据字节、停止, 末尾不完整的帧不检查
+    static const char* const i2c[] = { "i2cscl:100000:1.5", "i2csda:100000:1.5" };
+    logicCapture(i2c, 2);
+    cfg.protocol = LOGIC_I2C;
+    cfg.scl = 0;
+    cfg.sda = 1;
+    count = logicRun(&cfg);
+    bad = 0;
+    for (uint32_t i = 0; i + 4 <= count; i += 4) {
+        const LogicEvent* e = &logicAnalyzer.events[i];
+        bad += e[0].type != EVT_I2C_START || e[0].flags != 0
+            || e[1].type != EVT_I2C_ADDRESS || e[1].flags != 0 || e[1].data != 0x50
+            || e[2].type != EVT_I2C_DATA || e[2].flags != 0 || e[2].data != (i / 4 & 0xFF)
+            || e[3].type != EVT_I2C_STOP;
+    }
+    snprintf(what, sizeof(what), "logic: I2C %u events, %u wrong frames", count, bad);
+    expect(count / 4 + 1 >= LOGIC_SAMPLES / (22 * slots) && bad == 0, what);
+}
+
+#define RECORD_FILE "check.rec"
+#define RECORD_CHUNKS 4
+
+static uint8_t recordFile[RECORD_CHUNKS * RECORD_CHUNK_BYTES + 4096];
+
+static uint32_t writeRecordFile(const uint8_t* data, uint32_t size) {
+    FILE* fp = fopen(RECORD_FILE, "wb");
+    uint32_t written = fp ? (uint32_t)fwrite(data, 1, size, fp) : 0;
+    if (fp) {
+        fclose(fp);
+    }
+    return written;
+}
+
+static void checkRecordIndex(void) {
+    // 索引被篡改的录制文件要么打不开, 要么读出的样本数不足, 不能越界读取或返回错位的数据
+    static Recorder r;
+    static uint16_t data[MAX_CHANNELS][ADC_BUFFER_SIZE];
+    static uint16_t read[MAX_CHANNELS][ADC_BUFFER_SIZE];
+    static uint8_t bad[sizeof(recordFile)];
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        for (int k = 0; k < ADC_BUFFER_SIZE; k++) {
+            data[i][k] = (uint16_t)((k * (i + 3) + i * 1000) & 0xFFF);
+        }
+    }
+    int ok = recordCreate(&r, RECORD_FILE, 1000) == 0;
+    for (uint32_t c = 0; c < RECORD_CHUNKS && ok; c++) {
+        ok = recordAppend(&r, data, ADC_BUFFER_SIZE, c * 1000) == 0;
+    }
+    recordClose(&r);
+    FILE* fp = fopen(RECORD_FILE, "rb");
+    uint32_t size = fp ? (uint32_t)fread(recordFile, 1, sizeof(recordFile), fp) : 0;
+    if (fp) {
+        fclose(fp);
+    }
+    expect(ok && size > sizeof(RecordHeader) && size < sizeof(recordFile), "record: write a recording");
+    if (!ok || size <= sizeof(RecordHeader) || size >= sizeof(recordFile)) {
+        return;
+    }
+
+    expect(recordOpen(&r, RECORD_FILE) == 0 && r.samples == RECORD_CHUNKS * ADC_BUFFER_SIZE, "record: open a valid file");
+    expect(recordRead(&r, ADC_BUFFER_SIZE + 5, ADC_BUFFER_SIZE, read) == ADC_BUFFER_SIZE
+        && memcmp(read[1], data[1] + 5, (ADC_BUFFER_SIZE - 5) * sizeof(uint16_t)) == 0
+        && memcmp(read[1] + ADC_BUFFER_SIZE - 5, data[1], 5 * sizeof(uint16_t)) == 0, "record: read across chunks");
+    recordClose(&r);
+
+    RecordHeader header;
+    memcpy(&header, recordFile, sizeof(header));
+    RecordIndexEntry* index = (RecordIndexEntry*)(bad + header.indexOffset);
+    enum { SWAP, GAP, OVERLAP, SHORT, NOT_ZERO, PAST_END, IN_HEADER, BACKWARDS, COUNT, CASES };
+    static const char* names[CASES] = {
+        "record: index out of order", "record: gap between chunks", "record: overlapping chunks",
+        "record: index shorter than the chunk", "record: first chunk not at sample 0", "record: offset past the index",
+        "record: offset inside the file header", "record: offsets out of order", "record: chunk count larger than the file",
+    };
+    for (int k = 0; k < CASES; k++) {
+        memcpy(bad, recordFile, size);
+        switch (k) {
+        case SWAP:
+            index[1].firstSample = 2 * ADC_BUFFER_SIZE;
+            index[2].firstSample = ADC_BUFFER_SIZE;
+            break;
+        case GAP:
+            index[2].firstSample += ADC_BUFFER_SIZE + 1;
+            break;
+        case OVERLAP:
+            index[2].firstSample -= 1;
+            break;
+        case SHORT:
+            index[3].firstSample -= 1;
+            break;
+        case NOT_ZERO:
+            index[0].firstSample = 1;
+            break;
+        case PAST_END:
+            index[1].offset = header.indexOffset;
+            break;
+        case IN_HEADER:
+            index[0].offset = 4;
+            break;
+        case BACKWARDS:
+            index[2].offset = index[1].offset;
+            break;
+        case COUNT:
+            ((RecordHeader*)bad)->chunkCount = 0x40000000u;
+            break;
+        }
+        if (writeRecordFile(bad, size) != size) {
+            expect(0, "record: write a corrupted file");
+            continue;
+        }
+        // 打开失败即通过; 能打开时整个文件都必须读不全, 或者读出的每个样本都与原始数据一致
+        if (recordOpen(&r, RECORD_FILE) == 0) {
+            int good = 1;
+            for (uint64_t start = 0; start < r.samples && good; start += ADC_BUFFER_SIZE) {
+                uint32_t count = recordRead(&r, start, ADC_BUFFER_SIZE, read);
+                good = count == ADC_BUFFER_SIZE && memcmp(read[0], data[0], sizeof(read[0])) == 0;
+            }
+            expect(!good, names[k]);
+        }
+        recordClose(&r);
+    }
+    remove(RECORD_FILE);
+}
+
+int main(void) {
+    checkUsbReceiver();
+    checkMeasure();
+    checkRecordIndex();
+    checkFir();
+    checkFirQ15();
+    checkLogic();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
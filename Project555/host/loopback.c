@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "loopback.h"
+#include "scope_hal.h"
+#include "scope_net.h"
+#include "scope_usb.h"
+
+#define LOOPBACK_MAX 8
+#define LOOPBACK_BUFFER (64 * 1024)
+#define SLOW_DELAY_US 20000   // 慢客户端每次接收后的停顿
+#define SLOW_DECIMATION 8
+
+typedef struct {
+    pthread_t thread;
+    atomic_int fd;
+    int slow;
+    uint64_t bytes;
+    uint32_t frames[NET_CMD_SUBSCRIBE];
+    uint32_t badFrames;
+    uint32_t skippedBlocks;
+    uint32_t lastSeq;
+    int haveSeq;
+    uint64_t start, end;
+} LoopClient;
+
+static LoopClient loopClients[LOOPBACK_MAX];
+static int loopCount = 0;
+static atomic_int loopRunning;
+
+static uint64_t loopMicros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static void sendCommand(int fd, int type, uint32_t param) {
+    NetFrame cmd = { NET_MAGIC, (uint8_t)type, 0, 0, 0, param, 0 };
+    if (send(fd, &cmd, sizeof(cmd), MSG_NOSIGNAL) != sizeof(cmd)) {
+        perror("loopback send");
+    }
+}
+
+static int connectServer(void) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(HAL_NET_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while (atomic_load(&loopRunning)) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        usleep(1000);
+    }
+    return -1;
+}
+
+static uint32_t parseFrames(LoopClient* c, const uint8_t* data, uint32_t size) {
+    // 返回已处理的字节数, 不完整的帧留到下次
+    uint32_t used = 0;
+    while (size - used >= sizeof(NetFrame)) {
+        NetFrame frame;
+        memcpy(&frame, data + used, sizeof(frame));
+        if (frame.magic != NET_MAGIC || frame.type >= NET_CMD_SUBSCRIBE || frame.channel >= MAX_CHANNELS) {
+            c->badFrames++;
+            return size;  // 失去同步, 丢弃缓冲区
+        }
+        if (size - used < sizeof(NetFrame) + frame.length) {
+            break;
+        }
+        if (c->haveSeq && frame.seq != c->lastSeq) {
+            if ((int32_t)(frame.seq - c->lastSeq) < 0) {
+                c->badFrames++;
+            } else {
+                c->skippedBlocks += frame.seq - c->lastSeq - 1;
+            }
+        }
+        c->lastSeq = frame.seq;
+        c->haveSeq = 1;
+        c->frames[frame.type]++;
+        used += sizeof(NetFrame) + frame.length;
+    }
+    return used;
+}
+
+static void* clientMain(void* arg) {
+    LoopClient* c = arg;
+    static __thread uint8_t buffer[LOOPBACK_BUFFER];
+    uint32_t filled = 0;
+    int fd = connectServer();
+    if (fd < 0) {
+        return NULL;
+    }
+    atomic_store(&c->fd, fd);
+    uint32_t types = (1u << NET_FRAME_WAVEFORM) | (1u << NET_FRAME_SPECTRUM) | (1u << NET_FRAME_MEASURE);
+    sendCommand(fd, NET_CMD_SUBSCRIBE, types | (((1u << MAX_CHANNELS) - 1) << 8));
+    sendCommand(fd, NET_CMD_DECIMATE, c->slow ? SLOW_DECIMATION : 1);
+    c->start = loopMicros();
+
+    while (atomic_load(&loopRunning)) {
+        ssize_t n = recv(fd, buffer + filled, LOOPBACK_BUFFER - filled, 0);
+        if (n <= 0) {
+            break;
+        }
+        c->bytes += n;
+        filled += (uint32_t)n;
+        uint32_t used = parseFrames(c, buffer, filled);
+        memmove(buffer, buffer + used, filled - used);
+        filled -= used;
+        if (c->slow) {
+            usleep(SLOW_DELAY_US);
+        }
+    }
+    c->end = loopMicros();
+    return NULL;
+}
+
+void loopbackStart(int fast, int slow) {
+    atomic_store(&loopRunning, 1);
+    loopCount = fast + slow < LOOPBACK_MAX ? fast + slow : LOOPBACK_MAX;
+    for (int i = 0; i < loopCount; i++) {
+        LoopClient* c = &loopClients[i];
+        memset(c, 0, sizeof(*c));
+        atomic_store(&c->fd, -1);
+        c->slow = i >= fast;
+        if (pthread_create(&c->thread, NULL, clientMain, c) != 0) {
+            fprintf(stderr, "无法创建回环客户端线程\n");
+            loopCount = i;
+            break;
+        }
+    }
+}
+
+void loopbackStop(void) {
+    atomic_store(&loopRunning, 0);
+    for (int i = 0; i < loopCount; i++) {
+        int fd = atomic_load(&loopClients[i].fd);
+        if (fd >= 0) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    for (int i = 0; i < loopCount; i++) {
+        LoopClient* c = &loopClients[i];
+        pthread_join(c->thread, NULL);
+        int fd = atomic_load(&c->fd);
+        if (fd >= 0) {
+            close(fd);
+        }
+        double seconds = c->end > c->start ? (c->end - c->start) / 1e6 : 0;
+        printf("loopback %d (%s): %.1f MB, %.1f MB/s, frames wave/fft/meas %u/%u/%u, skipped blocks %u, bad frames %u\n",
+            i, c->slow ? "slow" : "fast", c->bytes / 1e6, seconds > 0 ? c->bytes / 1e6 / seconds : 0,
+            c->frames[NET_FRAME_WAVEFORM], c->frames[NET_FRAME_SPECTRUM], c->frames[NET_FRAME_MEASURE],
+            c->skippedBlocks, c->badFrames);
+    }
+    loopCount = 0;
+}
+
+static UsbReceiver usbReceiver;
+static pthread_t usbReaderThread;
+static atomic_int usbReaderRunning;
+static int usbReaderFd = -1;
+static uint64_t usbReaderBytes = 0;
+static uint64_t usbReaderStart = 0;
+
+static void* usbReaderMain(void* arg) {
+    // 轮询等待数据, 便于停止; 停止前读完缓冲区中剩余的数据
+    static uint8_t buffer[LOOPBACK_BUFFER];
+    (void)arg;
+    struct pollfd pfd = { usbReaderFd, POLLIN, 0 };
+    for (;;) {
+        int ready = poll(&pfd, 1, 10);
+        if (ready <= 0) {
+            if (!atomic_load(&usbReaderRunning)) {
+                break;
+            }
+            continue;
+        }
+        ssize_t n = read(usbReaderFd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        usbReaderBytes += n;
+        usbReceive(&usbReceiver, buffer, (uint32_t)n);
+    }
+    return NULL;
+}
+
+void usbLoopbackStart(const char* path) {
+    usbReaderFd = open(path, O_RDONLY | O_NOCTTY);
+    if (usbReaderFd < 0) {
+        perror("usb reader");
+        return;
+    }
+    usbReceiverInit(&usbReceiver);
+    usbReaderStart = loopMicros();
+    atomic_store(&usbReaderRunning, 1);
+    if (pthread_create(&usbReaderThread, NULL, usbReaderMain, NULL) != 0) {
+        fprintf(stderr, "无法创建USB接收线程\n");
+        close(usbReaderFd);
+        usbReaderFd = -1;
+    }
+}
+
+void usbLoopbackStop(void) {
+    if (usbReaderFd < 0) {
+        return;
+    }
+    atomic_store(&usbReaderRunning, 0);
+    pthread_join(usbReaderThread, NULL);
+    close(usbReaderFd);
+    usbReaderFd = -1;
+    const UsbReceiver* r = &usbReceiver;
+    double seconds = (loopMicros() - usbReaderStart) / 1e6;
+    printf("usb reader: %.1f MB, %.1f MB/s, %u blocks, %u packets, %u lost, %u CRC errors, "
+        "%u incomplete blocks, %llu bytes resynced\n",
+        usbReaderBytes / 1e6, usbReaderBytes / 1e6 / seconds, r->blocks, r->packets, r->lostPackets,
+        r->crcErrors, r->incomplete, (unsigned long long)r->discarded);
+}
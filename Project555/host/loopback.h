@@ -0,0 +1,14 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+// 主机回环测试客户端: 连接本机网络服务, 校验收到的帧并统计吞吐量
+// 慢客户端每次接收后停顿, 并请求波形抽取, 用于验证背压不会拖慢采集
+
+void loopbackStart(int fast, int slow);
+void loopbackStop(void);
+
+// USB伪终端校验接收端: 按包校验CRC和序号, 统计吞吐量、丢包和重新同步
+void usbLoopbackStart(const char* path);
+void usbLoopbackStop(void);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <stdint.h>
+#include <arm_math.h>  // 用于信号处理算法(主机构建时由host/arm_math.h代替)
+
+#define ADC_SAMPLE_RATE 1000  // 采样率1kHz
+#ifdef SCOPE_HOST
+#define ADC_BUFFER_SIZE 2048  // 采样缓冲区大小
+#define FFT_SIZE 2048         // FFT点数
+#else
+#define ADC_BUFFER_SIZE 512   // 目标板按下面的内存预算缩小
+#define FFT_SIZE 256          // 每通道频谱只占80列, 128个频点足够
+#endif
+#define MAX_CHANNELS 4        // 最大通道数
+
+#define ADC_FULL_SCALE 4095   // 12位ADC满量程
+#define ADC_Q15_SHIFT 4       // 码值减去中点后转为Q15的左移位数
+#define ADC_VREF 3.3f         // ADC参考电压(V)
+
+#define LCD_WIDTH 320         // LCD宽度(像素)
+#define LCD_HEIGHT 240        // LCD高度(像素)
+
+// 目标板(STM32F4)内存预算: 128KB SRAM(112KB + 16KB, 地址连续) + 64KB CCM
+// CCM只有CPU能访问, DMA(ADC、SDIO、以太网、USB)用到的缓冲区必须留在SRAM中;
+// 只由CPU读写的大对象用SCOPE_CCM放进.ccmram段(STM32CubeIDE生成的链接脚本自带该段, 启动时从Flash复制初值)
+// SRAM中应用的静态数据不超过SCOPE_SRAM_BUDGET, 其余24KB留给lwIP、FatFS、栈和堆(FIR状态、数学通道数据、录制索引)
+// test.c按区域对全部静态数据做静态检查, 其他模块内部的静态数据通过各头文件的*_STATIC_BYTES计入
+#define SCOPE_SRAM_BUDGET (104 * 1024)
+#define SCOPE_CCM_BUDGET (64 * 1024)
+#ifdef SCOPE_HOST
+#define SCOPE_CCM
+#else
+#define SCOPE_CCM __attribute__((section(".ccmram")))
+#endif
+
+#endif
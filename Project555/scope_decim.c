@@ -0,0 +1,131 @@
+#include <string.h>
+#include <math.h>
+#include "scope_decim.h"
+
+#define DESIGN_GRID 256       // 频率采样设计的频点数(0到奈奎斯特)
+#define COMP_MAX_GAIN 4.0f    // 补偿增益上限, 避免过渡带噪声被放大
+
+static float32_t work[ADC_BUFFER_SIZE];                 // CIC输出, 各通道共用
+static float32_t out[ADC_BUFFER_SIZE / DECIM_FIR_RATE];  // FIR输出
+
+_Static_assert(sizeof(work) + sizeof(out) <= DECIM_STATIC_BYTES, "DECIM_STATIC_BYTES does not cover the statics of scope_decim.c");
+
+static float cicResponse(float f, uint32_t rate) {
+    // CIC在输出采样率下的幅频响应, f为相对输出采样率的频率
+    if (f == 0 || rate == 1) {
+        return 1;
+    }
+    float h = sinf(PI * f) / (rate * sinf(PI * f / rate));
+    float r = 1;
+    for (int i = 0; i < CIC_ORDER; i++) {
+        r *= h;
+    }
+    return fabsf(r);
+}
+
+static void designCompensation(float32_t* coeffs, int taps, uint32_t rate) {
+    // 频率采样法: 通带(FIR输出奈奎斯特以内)取CIC响应的倒数, 阻带为0, 再加汉明窗,
+    // 归一化为单位直流增益; 系数按CMSIS约定逆序存放
+    const float cutoff = 0.5f / DECIM_FIR_RATE;
+    float h[DECIM_FIR_TAPS];
+    float sum = 0;
+    for (int i = 0; i < taps; i++) {
+        float m = i - (taps - 1) / 2.0f;
+        float acc = 0;
+        for (int k = 0; k < DESIGN_GRID; k++) {
+            float f = (k + 0.5f) * 0.5f / DESIGN_GRID;
+            if (f >= cutoff) {
+                break;
+            }
+            float gain = 1 / cicResponse(f, rate);
+            acc += (gain < COMP_MAX_GAIN ? gain : COMP_MAX_GAIN) * cosf(2 * PI * f * m);
+        }
+        h[i] = acc * (0.54f - 0.46f * cosf(2 * PI * i / (taps - 1)));
+        sum += h[i];
+    }
+    for (int i = 0; i < taps; i++) {
+        coeffs[taps - 1 - i] = h[i] / sum;
+    }
+}
+
+void cicInit(CicDecimator* c, uint32_t rate) {
+    memset(c, 0, sizeof(*c));
+    c->rate = rate;
+    c->phase = rate;
+    while ((1u << c->shift) < rate) {
+        c->shift++;
+    }
+    c->shift *= CIC_ORDER;
+}
+
+uint32_t cicProcess(CicDecimator* c, const uint16_t* in, uint32_t count, float32_t* out) {
+    // 积分器每个样本都运行, 梳状级只在输出时刻运行一次; 无符号运算溢出回绕, 梳状级相减后结果正确
+    if (c->rate == 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            out[i] = in[i];
+        }
+        return count;
+    }
+    uint32_t i0 = c->integ[0], i1 = c->integ[1], i2 = c->integ[2];
+    uint32_t phase = c->phase;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        i0 += in[i];
+        i1 += i0;
+        i2 += i1;
+        if (--phase == 0) {
+            phase = c->rate;
+            uint32_t d0 = i2 - c->comb[0];
+            c->comb[0] = i2;
+            uint32_t d1 = d0 - c->comb[1];
+            c->comb[1] = d0;
+            uint32_t d2 = d1 - c->comb[2];
+            c->comb[2] = d1;
+            out[n++] = (float32_t)(d2 >> c->shift);
+        }
+    }
+    c->integ[0] = i0;
+    c->integ[1] = i1;
+    c->integ[2] = i2;
+    c->phase = phase;
+    return n;
+}
+
+int decimInit(DecimChain* d, uint32_t decimation) {
+    if (decimation == 0 || decimation > DECIM_MAX || (decimation & (decimation - 1)) != 0) {
+        return -1;
+    }
+    memset(d, 0, sizeof(*d));
+    d->decimation = decimation;
+    if (decimation == 1) {
+        return 0;
+    }
+    uint32_t rate = decimation / DECIM_FIR_RATE;
+    cicInit(&d->cic, rate);
+    designCompensation(d->coeffs, DECIM_FIR_TAPS, rate);
+    return arm_fir_decimate_init_f32(&d->fir, DECIM_FIR_TAPS, DECIM_FIR_RATE, d->coeffs, d->state,
+        ADC_BUFFER_SIZE) == ARM_MATH_SUCCESS ? 0 : -1;
+}
+
+void decimReset(DecimChain* d) {
+    if (d->decimation > 1) {
+        cicInit(&d->cic, d->cic.rate);
+        memset(d->state, 0, sizeof(d->state));
+    }
+}
+
+uint32_t decimCic(DecimChain* d, const uint16_t* in, uint32_t count) {
+    // 第一级: 结果留在work中, 返回CIC输出样本数
+    return cicProcess(&d->cic, in, count, work);
+}
+
+uint32_t decimFir(DecimChain* d, uint32_t count, uint16_t* result) {
+    // 第二级: 对work中的count个CIC输出做补偿滤波并抽取, count须为DECIM_FIR_RATE的倍数
+    uint32_t n = count / DECIM_FIR_RATE;
+    arm_fir_decimate_f32(&d->fir, work, out, count);
+    for (uint32_t i = 0; i < n; i++) {
+        float32_t v = out[i];
+        result[i] = v < 0 ? 0 : v > ADC_FULL_SCALE ? ADC_FULL_SCALE : (uint16_t)(v + 0.5f);
+    }
+    return n;
+}
@@ -0,0 +1,43 @@
+#ifndef SCOPE_DECIM_H
+#define SCOPE_DECIM_H
+
+#include <stdint.h>
+#include "scope.h"
+
+// 多速率抽取链: CIC抽取R倍 -> 多相补偿FIR再抽取2倍, 总抽取倍数D = 2R
+// 慢时基下后级只处理抽取后的样本, D = 1时整条链旁路, 保留全部带宽
+// CIC用32位整数做积分/梳状运算, 溢出回绕不影响结果(位宽 >= 12 + CIC_ORDER * log2(R))
+// 两级之间的中间结果放在各通道共用的工作区中, 一个通道的decimCic之后要先调用decimFir, 再处理下一个通道
+
+#define CIC_ORDER 3            // CIC级数(cicProcess按3级展开)
+#define CIC_MAX_RATE 64        // CIC最大抽取倍数, 12 + 3 * 6 = 30位
+#define DECIM_FIR_RATE 2       // 补偿FIR的抽取倍数
+#define DECIM_FIR_TAPS 32      // 补偿FIR抽头数
+#define DECIM_MAX (CIC_MAX_RATE * DECIM_FIR_RATE)  // 最大总抽取倍数
+#define DECIM_STATIC_BYTES ((ADC_BUFFER_SIZE + ADC_BUFFER_SIZE / DECIM_FIR_RATE) * sizeof(float32_t))  // 共用工作区
+
+typedef struct {
+    uint32_t rate;               // 抽取倍数R, 2的幂
+    uint32_t shift;              // 直流增益R^N对应的右移位数
+    uint32_t phase;              // 距下一个输出还差的输入样本数
+    uint32_t integ[CIC_ORDER];   // 积分器
+    uint32_t comb[CIC_ORDER];    // 梳状级的上一个输入
+} CicDecimator;
+
+typedef struct {
+    uint32_t decimation;         // 总抽取倍数, 1表示旁路
+    CicDecimator cic;
+    arm_fir_decimate_instance_f32 fir;
+    float32_t coeffs[DECIM_FIR_TAPS];   // 按CMSIS约定逆序存放的补偿FIR系数
+    float32_t state[DECIM_FIR_TAPS + ADC_BUFFER_SIZE - 1];
+} DecimChain;
+
+void cicInit(CicDecimator* c, uint32_t rate);
+uint32_t cicProcess(CicDecimator* c, const uint16_t* in, uint32_t count, float32_t* out);
+
+int decimInit(DecimChain* d, uint32_t decimation);
+void decimReset(DecimChain* d);
+uint32_t decimCic(DecimChain* d, const uint16_t* in, uint32_t count);
+uint32_t decimFir(DecimChain* d, uint32_t count, uint16_t* result);
+
+#endif
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scope_fir.h"
+
+static float fftCostPerBlock(uint16_t fftLen, uint16_t taps, uint32_t blockSize) {
+    // 一对实数FFT约5NlogN + 10N次浮点运算, 频谱相乘约3N次
+    uint32_t hop = fftLen - taps + 1;
+    uint32_t segments = (blockSize + hop - 1) / hop;
+    float perSegment = 5.0f * fftLen * log2f(fftLen) + 13.0f * fftLen;
+    return segments * perSegment * FIR_FFT_OVERHEAD;
+}
+
+static uint16_t chooseFftLen(uint16_t taps, uint32_t blockSize, float* cost) {
+    // 从不小于2倍抽头数的2的幂开始, 取每块代价最小的FFT长度
+    uint16_t best = 0;
+    uint32_t len = 64;
+    while (len < 2u * taps) {
+        len <<= 1;
+    }
+    for (; len <= FIR_MAX_FFT; len <<= 1) {
+        float c = fftCostPerBlock((uint16_t)len, taps, blockSize);
+        if (best == 0 || c < *cost) {
+            best = (uint16_t)len;
+            *cost = c;
+        }
+    }
+    return best;
+}
+
+int firInit(FirFilter* f, const float32_t* coeffs, uint16_t taps, uint32_t blockSize, FirMethod method) {
+    memset(f, 0, sizeof(*f));
+    f->taps = taps;
+    f->blockSize = blockSize;
+
+    float fftCost = 0;
+    uint16_t fftLen = chooseFftLen(taps, blockSize, &fftCost);
+    if (method == FIR_AUTO) {
+        float directCost = 2.0f * taps * blockSize;
+        method = (fftLen != 0 && fftCost < directCost) ? FIR_FFT : FIR_DIRECT;
+    }
+    if (method == FIR_FFT && fftLen == 0) {
+        return -1;
+    }
+    f->method = method;
+
+    if (method == FIR_DIRECT) {
+        f->coeffs = malloc(taps * sizeof(float32_t));
+        f->state = malloc((taps + blockSize - 1) * sizeof(float32_t));
+        if (f->coeffs == NULL || f->state == NULL) {
+            firFree(f);
+            return -1;
+        }
+        for (int i = 0; i < taps; i++) {
+            f->coeffs[i] = coeffs[taps - 1 - i];
+        }
+        arm_fir_init_f32(&f->fir, taps, f->coeffs, f->state, blockSize);
+        return 0;
+    }
+
+    f->fftLen = fftLen;
+    f->hop = fftLen - taps + 1;
+    f->response = malloc(fftLen * sizeof(float32_t));
+    f->history = calloc(taps, sizeof(float32_t));
+    f->work = malloc(fftLen * sizeof(float32_t));
+    f->spectrum = malloc(fftLen * sizeof(float32_t));
+    if (f->response == NULL || f->history == NULL || f->work == NULL || f->spectrum == NULL
+        || arm_rfft_fast_init_f32(&f->rfft, fftLen) != ARM_MATH_SUCCESS) {
+        firFree(f);
+        return -1;
+    }
+
+    // 预先计算补零系数的频谱
+    memset(f->work, 0, fftLen * sizeof(float32_t));
+    memcpy(f->work, coeffs, taps * sizeof(float32_t));
+    arm_rfft_fast_f32(&f->rfft, f->work, f->response, 0);
+    return 0;
+}
+
+void firProcess(FirFilter* f, const float32_t* src, float32_t* dst, uint32_t count) {
+    if (f->method == FIR_DIRECT) {
+        arm_fir_f32(&f->fir, src, dst, count);
+        return;
+    }
+
+    // 每段: [taps-1个历史样本 | 最多hop个新样本 | 补零], 末段不足hop时补零即可,
+    // 有效输出从第taps-1点开始, 不会受到循环卷积回绕的影响
+    uint16_t keep = f->taps - 1;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t len = count - done < f->hop ? count - done : f->hop;
+        memcpy(f->work, f->history, keep * sizeof(float32_t));
+        memcpy(f->work + keep, src + done, len * sizeof(float32_t));
+        memset(f->work + keep + len, 0, (f->fftLen - keep - len) * sizeof(float32_t));
+        memcpy(f->history, f->work + len, keep * sizeof(float32_t));
+
+        arm_rfft_fast_f32(&f->rfft, f->work, f->spectrum, 0);
+
+        // 频谱逐点相乘, 第0、1项分别是实数的直流和奈奎斯特分量
+        float32_t* x = f->spectrum;
+        const float32_t* h = f->response;
+        x[0] *= h[0];
+        x[1] *= h[1];
+        for (int k = 2; k < f->fftLen; k += 2) {
+            float32_t re = x[k] * h[k] - x[k + 1] * h[k + 1];
+            float32_t im = x[k] * h[k + 1] + x[k + 1] * h[k];
+            x[k] = re;
+            x[k + 1] = im;
+        }
+
+        arm_rfft_fast_f32(&f->rfft, f->spectrum, f->work, 1);
+        memcpy(dst + done, f->work + keep, len * sizeof(float32_t));
+        done += len;
+    }
+}
+
+void firReset(FirFilter* f) {
+    if (f->method == FIR_DIRECT) {
+        memset(f->state, 0, (f->taps + f->blockSize - 1) * sizeof(float32_t));
+    } else {
+        memset(f->history, 0, f->taps * sizeof(float32_t));
+    }
+}
+
+void firFree(FirFilter* f) {
+    free(f->coeffs);
+    free(f->state);
+    free(f->response);
+    free(f->history);
+    free(f->work);
+    free(f->spectrum);
+    memset(f, 0, sizeof(*f));
+}
+
+int firInitQ15(FirFilterQ15* f, const float32_t* coeffs, uint16_t taps, uint32_t blockSize) {
+    memset(f, 0, sizeof(*f));
+    f->taps = taps;
+    f->blockSize = blockSize;
+    f->coeffs = malloc(taps * sizeof(q15_t));
+    f->state = malloc((taps + blockSize) * sizeof(q15_t));
+    float32_t* reversed = malloc(taps * sizeof(float32_t));
+    if (f->coeffs == NULL || f->state == NULL || reversed == NULL) {
+        free(reversed);
+        firFreeQ15(f);
+        return -1;
+    }
+    for (int i = 0; i < taps; i++) {
+        reversed[i] = coeffs[taps - 1 - i];
+    }
+    arm_float_to_q15(reversed, f->coeffs, taps);
+    free(reversed);
+    if (arm_fir_init_q15(&f->fir, taps, f->coeffs, f->state, blockSize) != ARM_MATH_SUCCESS) {
+        firFreeQ15(f);
+        return -1;
+    }
+    return 0;
+}
+
+void firProcessQ15(FirFilterQ15* f, const q15_t* src, q15_t* dst, uint32_t count) {
+    arm_fir_q15(&f->fir, src, dst, count);
+}
+
+void firResetQ15(FirFilterQ15* f) {
+    memset(f->state, 0, (f->taps + f->blockSize) * sizeof(q15_t));
+}
+
+void firFreeQ15(FirFilterQ15* f) {
+    free(f->coeffs);
+    free(f->state);
+    memset(f, 0, sizeof(*f));
+}
+
+void adcToQ15(const uint16_t* src, q15_t* dst, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = (q15_t)(((int32_t)src[i] - (ADC_FULL_SCALE + 1) / 2) << ADC_Q15_SHIFT);
+    }
+}
+
+void q15ToAdc(const q15_t* src, uint16_t* dst, uint32_t count) {
+    // 四舍五入后限幅到ADC量程
+    const int32_t round = 1 << (ADC_Q15_SHIFT - 1);
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t v = ((src[i] + round) >> ADC_Q15_SHIFT) + (ADC_FULL_SCALE + 1) / 2;
+        dst[i] = (uint16_t)(v < 0 ? 0 : v > ADC_FULL_SCALE ? ADC_FULL_SCALE : v);
+    }
+}
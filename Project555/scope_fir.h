@@ -0,0 +1,61 @@
+#ifndef SCOPE_FIR_H
+#define SCOPE_FIR_H
+
+#include <stdint.h>
+#include "scope.h"
+
+// 流式FIR滤波器: 滤波器对象长期存在, 延迟线状态跨数据块保留
+// 抽头较多时自动改用重叠保留(overlap-save)FFT快速卷积
+
+#define FIR_MAX_FFT 4096       // 快速卷积允许的最大FFT长度
+#define FIR_FFT_OVERHEAD 1.5f  // FFT路径相对直接型的额外开销系数(访存、无SIMD)
+
+typedef enum {
+    FIR_AUTO,    // 按代价模型自动选择
+    FIR_DIRECT,  // 直接型卷积(arm_fir_f32)
+    FIR_FFT      // 重叠保留FFT卷积
+} FirMethod;
+
+typedef struct {
+    FirMethod method;     // 实际使用的算法
+    uint16_t taps;        // 抽头数
+    uint32_t blockSize;   // 每次处理的最大样本数
+
+    // 直接型
+    arm_fir_instance_f32 fir;
+    float32_t* coeffs;    // 按CMSIS约定逆序存放的系数
+    float32_t* state;     // 延迟线, taps + blockSize - 1
+
+    // 重叠保留
+    arm_rfft_fast_instance_f32 rfft;
+    uint16_t fftLen;      // FFT长度
+    uint16_t hop;         // 每段新样本数, fftLen - taps + 1
+    float32_t* response;  // 系数的频谱(CMSIS打包格式)
+    float32_t* history;   // 上一段末尾的taps - 1个样本
+    float32_t* work;      // 时域工作缓冲区
+    float32_t* spectrum;  // 频域工作缓冲区
+} FirFilter;
+
+// Q15定点路径: ADC码值减去中点后左移4位, 满量程对应[-1, 1); 系数转换为Q15时饱和,
+// 滤波结果由arm_fir_q15饱和到Q15, 转回码值时再限幅到ADC量程
+typedef struct {
+    uint16_t taps;
+    uint32_t blockSize;
+    arm_fir_instance_q15 fir;
+    q15_t* coeffs;        // 按CMSIS约定逆序存放的Q15系数
+    q15_t* state;         // 延迟线, taps + blockSize
+} FirFilterQ15;
+
+int firInit(FirFilter* f, const float32_t* coeffs, uint16_t taps, uint32_t blockSize, FirMethod method);
+void firProcess(FirFilter* f, const float32_t* src, float32_t* dst, uint32_t count);
+void firReset(FirFilter* f);
+void firFree(FirFilter* f);
+
+int firInitQ15(FirFilterQ15* f, const float32_t* coeffs, uint16_t taps, uint32_t blockSize);
+void firProcessQ15(FirFilterQ15* f, const q15_t* src, q15_t* dst, uint32_t count);
+void firResetQ15(FirFilterQ15* f);
+void firFreeQ15(FirFilterQ15* f);
+void adcToQ15(const uint16_t* src, q15_t* dst, uint32_t count);
+void q15ToAdc(const q15_t* src, uint16_t* dst, uint32_t count);
+
+#endif
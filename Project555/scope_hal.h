@@ -0,0 +1,83 @@
+#ifndef SCOPE_HAL_H
+#define SCOPE_HAL_H
+
+#include <stdint.h>
+#include "scope.h"
+#include "scope_ring.h"
+
+// 硬件抽象层: 把采集、显示、存储和通信与具体平台隔离
+// 目标板(STM32)实现见hal_stm32.c, Linux主机实现见hal_linux.c
+
+// 系统
+void halInit(int argc, char* argv[]);
+int halRunning(void);
+uint32_t halMicros(void);  // 微秒时钟, 满2^32us才回绕, 调用者只用无符号差值和(int32_t)比较
+void halIdle(void);
+
+// 采集
+void halAdcInit(uint32_t sampleRate);
+uint32_t halAdcSampleRate(void);
+void halAdcRead(uint16_t buffer[][ADC_BUFFER_SIZE], int channels, int count);
+// 连续采集: 目标板由DMA双缓冲中断、主机由采集线程把数据块放入环形队列
+void halAcqStart(AcqRing* ring);
+void halAcqStop(void);
+
+// 显示
+void halLcdInit(void);
+void halLcdClear(void);
+void halLcdDrawLine(int x0, int y0, int x1, int y1);
+void halLcdDrawImage(int x, int y, int width, int height, const uint8_t* pixels);  // 灰度图像, 按行存放
+void halLcdSetCursor(int x, int y);
+void halLcdPrint(const char* format, ...);
+
+// 用户输入
+enum {
+    HAL_KEY_CHANNEL,
+    HAL_KEY_TIMEBASE,
+    HAL_KEY_TRIGGER,
+    HAL_KEY_CURSOR,
+    HAL_KEY_MENU,
+    HAL_KEY_SETTING,
+    HAL_KEY_COUNT
+};
+void halKeyInit(void);
+int halKeyRead(int key);
+
+// 存储
+typedef struct HalFile HalFile;
+void halStorageInit(void);
+HalFile* halFileOpen(const char* path, int write);
+uint32_t halFileWrite(HalFile* file, const void* data, uint32_t size);
+uint32_t halFileRead(HalFile* file, void* data, uint32_t size);
+int halFileSeek(HalFile* file, uint32_t offset);
+void halFileClose(HalFile* file);
+
+// 通信
+// USB发送是异步的: halUsbTransmit只启动传输, 完成后在中断(主机为USB线程)中调用txDone,
+// 传输期间data必须保持有效; halUsbTxReady在未连接或传输未完成时返回0
+void halUsbInit(void (*txDone)(void));
+int halUsbTxReady(void);
+void halUsbTransmit(const uint8_t* data, uint32_t size);
+uint32_t halUsbReceive(uint8_t* data, uint32_t size);
+
+// 网络: 非阻塞TCP服务, 事件通过回调通知, 目标板用lwIP raw API, 主机用epoll
+#define HAL_NET_PORT 5000
+#ifdef SCOPE_HOST
+#define HAL_NET_MAX_CLIENTS 4
+#else
+#define HAL_NET_MAX_CLIENTS 2   // 每个客户端占一个NET_QUEUE_BYTES的发送队列
+#endif
+
+// 目标板HAL的静态数据: ADC的DMA双缓冲, 再加FatFS、USB和lwIP的句柄, 计入test.c的内存预算
+#define HAL_STATIC_BYTES (2 * MAX_CHANNELS * ADC_BUFFER_SIZE * sizeof(uint16_t) + 4 * 1024)
+typedef struct {
+    void (*accepted)(int client);
+    void (*received)(int client, const uint8_t* data, uint32_t size);
+    void (*closed)(int client);
+} HalNetHandler;
+int halNetInit(const HalNetHandler* handler);
+void halNetService(void);  // 处理已就绪的事件后立即返回
+uint32_t halNetSend(int client, const void* data, uint32_t size);  // 返回实际接受的字节数, 不阻塞
+void halNetClose(int client);
+
+#endif
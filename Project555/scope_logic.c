@@ -0,0 +1,282 @@
+#include <string.h>
+#include "scope_logic.h"
+#include "scope_trigger.h"  // thresholdBits
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int lowestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static int bitAt(const uint64_t* bits, uint32_t i) {
+    return (int)(bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static uint32_t findLevel(const uint64_t* bits, uint32_t from, uint32_t n, int level) {
+    // 从from开始第一个值为level的样本, 整字跳过, 找不到时返回n
+    if (from >= n) {
+        return n;
+    }
+    uint32_t w = from >> 6;
+    uint32_t words = (n + 63) >> 6;
+    uint64_t word = (level ? bits[w] : ~bits[w]) & (~0ull << (from & 63));
+    while (word == 0) {
+        if (++w >= words) {
+            return n;
+        }
+        word = level ? bits[w] : ~bits[w];
+    }
+    uint32_t i = (w << 6) + lowestBit(word);
+    return i < n ? i : n;
+}
+
+static uint64_t tailMask(uint32_t w, uint32_t n) {
+    // 第w个字中位于[0, n)范围内的位
+    return n >= (w + 1) * 64 ? ~0ull : (1ull << (n - w * 64)) - 1;
+}
+
+static void addEvent(LogicAnalyzer* la, uint32_t start, uint32_t end, int type, int flags, int data, int data2) {
+    if (la->count >= LOGIC_MAX_EVENTS) {
+        la->overflow++;
+        return;
+    }
+    LogicEvent* e = &la->events[la->count++];
+    e->start = la->start + start;
+    e->length = end - start;
+    e->type = (uint8_t)type;
+    e->flags = (uint8_t)flags;
+    e->data = (uint16_t)data;
+    e->data2 = (uint16_t)data2;
+}
+
+void logicInit(LogicAnalyzer* la, const LogicConfig* cfg) {
+    memset(la, 0, sizeof(*la));
+    la->cfg = *cfg;
+}
+
+uint32_t logicLoad(LogicAnalyzer* la, const DeepCapture* caps, uint64_t start, uint32_t count) {
+    // 把深存储中[start, start + count)转换为位流, 起点向后对齐到64的倍数,
+    // 使循环缓冲区的回绕点落在字边界上; 只转换协议用到的通道
+    uint64_t aligned = (start + 63) & ~63ull;
+    count = count > aligned - start ? count - (uint32_t)(aligned - start) : 0;
+    la->start = aligned;
+    la->samples = count;
+    la->count = 0;
+    la->overflow = 0;
+
+    const LogicConfig* c = &la->cfg;
+    int used[MAX_CHANNELS] = { 0 };
+    switch (c->protocol) {
+    case LOGIC_UART:
+        used[c->rx] = 1;
+        break;
+    case LOGIC_SPI:
+        used[c->clk] = used[c->mosi] = 1;
+        if (c->miso >= 0) {
+            used[c->miso] = 1;
+        }
+        if (c->cs >= 0) {
+            used[c->cs] = 1;
+        }
+        break;
+    case LOGIC_I2C:
+        used[c->scl] = used[c->sda] = 1;
+        break;
+    default:
+        return 0;
+    }
+
+    uint32_t pos = (uint32_t)(aligned & (CAPTURE_DEPTH - 1));
+    uint32_t first = CAPTURE_DEPTH - pos < count ? CAPTURE_DEPTH - pos : count;
+    for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+        if (used[ch]) {
+            const uint16_t* x = caps[ch].samples;
+            thresholdBits(x + pos, (int)first, c->threshold, la->bits[ch]);
+            if (count > first) {
+                thresholdBits(x, (int)(count - first), c->threshold, la->bits[ch] + first / 64);
+            }
+        }
+    }
+    return count;
+}
+
+static void decodeUart(LogicAnalyzer* la) {
+    // 空闲为高: 先找高电平, 再找其后的下降沿作为起始位, 各位在位中心直接取值
+    const uint64_t* rx = la->bits[la->cfg.rx];
+    const float bit = la->cfg.samplesPerBit;
+    const uint32_t n = la->samples;
+    uint32_t pos = 0;
+    for (;;) {
+        pos = findLevel(rx, pos, n, 1);
+        uint32_t start = findLevel(rx, pos, n, 0);
+        uint32_t stop = start + (uint32_t)(9.5f * bit);
+        if (stop >= n) {
+            break;
+        }
+        if (bitAt(rx, start + (uint32_t)(0.5f * bit))) {
+            pos = start + 1;  // 毛刺, 不是起始位
+            continue;
+        }
+        int value = 0;
+        for (int k = 0; k < 8; k++) {
+            value |= bitAt(rx, start + (uint32_t)((k + 1.5f) * bit)) << k;
+        }
+        int error = !bitAt(rx, stop);
+        addEvent(la, start, start + (uint32_t)(10 * bit), EVT_UART_BYTE, error ? LOGIC_FLAG_ERROR : 0, value, 0);
+        pos = stop;
+    }
+}
+
+static void decodeSpi(LogicAnalyzer* la) {
+    // CPOL与CPHA相同时在上升沿采样, 否则在下降沿; 每字用位运算求出采样边沿, 逐个取出.
+    // 没有片选时, 边沿间隔超过上一间隔的2倍视为字间空闲, 从下一个边沿重新对齐
+    const LogicConfig* c = &la->cfg;
+    const uint64_t* clk = la->bits[c->clk];
+    const uint64_t* mosi = la->bits[c->mosi];
+    const uint64_t* miso = c->miso >= 0 ? la->bits[c->miso] : NULL;
+    const uint64_t* cs = c->cs >= 0 ? la->bits[c->cs] : NULL;
+    const int rising = (c->mode >> 1) == (c->mode & 1);
+    const uint32_t n = la->samples;
+    const uint32_t mask = (1u << c->wordBits) - 1;
+    uint64_t carry = (uint64_t)(c->mode >> 1);  // 起点之前视为空闲电平
+    int count = 0;
+    uint32_t out = 0, in = 0, first = 0, last = 0, interval = 0;
+    for (uint32_t w = 0; w < (n + 63) / 64; w++) {
+        uint64_t cur = clk[w];
+        uint64_t prev = (cur << 1) | carry;
+        carry = cur >> 63;
+        uint64_t edges = (rising ? cur & ~prev : ~cur & prev) & tailMask(w, n);
+        while (edges != 0) {
+            uint32_t i = (w << 6) + lowestBit(edges);
+            edges &= edges - 1;
+            if (cs != NULL && bitAt(cs, i)) {
+                count = 0;  // 片选无效, 丢弃不完整的字
+                out = in = 0;
+                continue;
+            }
+            if (count > 0 && cs == NULL && interval > 0 && i - last > 2 * interval) {
+                count = 0;
+                out = in = 0;
+            }
+            interval = count > 0 ? i - last : interval;
+            last = i;
+            if (count == 0) {
+                first = i;
+            }
+            out = (out << 1) | bitAt(mosi, i);
+            in = miso != NULL ? (in << 1) | bitAt(miso, i) : 0;
+            if (++count == c->wordBits) {
+                addEvent(la, first, i + 1, EVT_SPI_WORD, 0, out & mask, in & mask);
+                count = 0;
+                out = in = 0;
+            }
+        }
+    }
+}
+
+static void decodeI2c(LogicAnalyzer* la) {
+    // SCL高电平期间SDA下降为起始, 上升为停止; SCL上升沿采样数据位, 每9位(8位数据+应答)为一个字节
+    const uint64_t* scl = la->bits[la->cfg.scl];
+    const uint64_t* sda = la->bits[la->cfg.sda];
+    const uint32_t n = la->samples;
+    uint64_t carryC = 1, carryD = 1;  // 起点之前视为空闲(两线均为高)
+    int inFrame = 0, count = 0, index = 0, value = 0;
+    uint32_t byteStart = 0;
+    for (uint32_t w = 0; w < (n + 63) / 64; w++) {
+        uint64_t c = scl[w], d = sda[w];
+        uint64_t prevC = (c << 1) | carryC;
+        uint64_t prevD = (d << 1) | carryD;
+        carryC = c >> 63;
+        carryD = d >> 63;
+        uint64_t high = c & prevC;
+        uint64_t starts = ~d & prevD & high;
+        uint64_t stops = d & ~prevD & high;
+        uint64_t clocks = c & ~prevC;
+        uint64_t events = (starts | stops | clocks) & tailMask(w, n);
+        while (events != 0) {
+            int b = lowestBit(events);
+            uint64_t m = 1ull << b;
+            uint32_t i = (w << 6) + b;
+            events &= events - 1;
+            if (starts & m) {
+                addEvent(la, i, i, EVT_I2C_START, inFrame ? LOGIC_FLAG_REPEATED : 0, 0, 0);
+                inFrame = 1;
+                count = index = 0;
+            } else if (stops & m) {
+                addEvent(la, i, i, EVT_I2C_STOP, 0, 0, 0);
+                inFrame = 0;
+            } else if (inFrame) {
+                int bit = (int)(d >> b) & 1;
+                if (count == 0) {
+                    byteStart = i;
+                    value = 0;
+                }
+                if (count < 8) {
+                    value = (value << 1) | bit;
+                }
+                if (++count == 9) {
+                    int flags = bit ? LOGIC_FLAG_NACK : 0;
+                    if (index++ == 0) {
+                        addEvent(la, byteStart, i, EVT_I2C_ADDRESS, flags | (value & 1 ? LOGIC_FLAG_READ : 0),
+                            value >> 1, 0);
+                    } else {
+                        addEvent(la, byteStart, i, EVT_I2C_DATA, flags, value, 0);
+                    }
+                    count = 0;
+                }
+            }
+        }
+    }
+}
+
+uint32_t logicDecode(LogicAnalyzer* la) {
+    la->count = 0;
+    la->overflow = 0;
+    switch (la->cfg.protocol) {
+    case LOGIC_UART:
+        decodeUart(la);
+        break;
+    case LOGIC_SPI:
+        decodeSpi(la);
+        break;
+    case LOGIC_I2C:
+        decodeI2c(la);
+        break;
+    default:
+        break;
+    }
+    return la->count;
+}
+
+int logicFind(const LogicAnalyzer* la, int from, int type, int value) {
+    // 从第from个事件开始查找, type或value为-1时不限
+    for (uint32_t i = from < 0 ? 0 : (uint32_t)from; i < la->count; i++) {
+        const LogicEvent* e = &la->events[i];
+        if ((type < 0 || e->type == type) && (value < 0 || e->data == value)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int logicFindSample(const LogicAnalyzer* la, uint64_t sample) {
+    // 二分查找第一个起点不早于sample的事件, 没有时返回-1
+    uint32_t low = 0, high = la->count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (la->events[mid].start < sample) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < la->count ? (int)low : -1;
+}
@@ -0,0 +1,80 @@
+#ifndef SCOPE_LOGIC_H
+#define SCOPE_LOGIC_H
+
+#include <stdint.h>
+#include "scope.h"
+#include "scope_pyramid.h"
+
+// 逻辑分析: 深存储中的模拟通道按阈值压成每样本一位的位流(每字64个样本),
+// 再在位流上解码UART/SPI/I2C. 找空闲后的起始位、时钟边沿和起止条件都按字用位运算完成,
+// 没有跳变的字整字跳过; 解码结果按时间顺序放入事件表, 可按类型/数值或样本位置查找
+
+#ifdef SCOPE_HOST
+#define LOGIC_MAX_EVENTS 65536
+#else
+#define LOGIC_MAX_EVENTS 256
+#endif
+#define LOGIC_WORDS (CAPTURE_DEPTH / 64)  // 每通道位流的字数
+
+typedef enum {
+    LOGIC_OFF,
+    LOGIC_UART,  // 空闲高电平, 8位数据低位在前, 1位停止位, 无校验
+    LOGIC_SPI,   // 高位在前
+    LOGIC_I2C
+} LogicProtocol;
+
+typedef enum {
+    EVT_UART_BYTE,
+    EVT_SPI_WORD,
+    EVT_I2C_START,
+    EVT_I2C_STOP,
+    EVT_I2C_ADDRESS,
+    EVT_I2C_DATA
+} LogicEventType;
+
+#define LOGIC_FLAG_ERROR 0x01     // UART停止位错误
+#define LOGIC_FLAG_NACK 0x02      // I2C应答位为高
+#define LOGIC_FLAG_READ 0x04      // I2C地址字节的读方向
+#define LOGIC_FLAG_REPEATED 0x08  // I2C重复起始
+
+typedef struct {
+    LogicProtocol protocol;
+    uint16_t threshold;      // 逻辑阈值(码值)
+    // UART
+    int rx;                  // 数据通道
+    float samplesPerBit;     // 采样率 / 波特率
+    // SPI
+    int clk, mosi, miso;     // miso为-1时不解码
+    int cs;                  // 片选通道(低有效), -1表示没有片选
+    int mode;                // 0~3, CPOL = mode >> 1, CPHA = mode & 1
+    int wordBits;            // 每字位数, 1~16
+    // I2C
+    int scl, sda;
+} LogicConfig;
+
+typedef struct {
+    uint64_t start;    // 起始样本(与深存储的样本序号一致)
+    uint32_t length;   // 持续样本数
+    uint8_t type;      // LogicEventType
+    uint8_t flags;
+    uint16_t data;     // UART字节、SPI MOSI字、I2C地址(7位)或数据
+    uint16_t data2;    // SPI MISO字
+} LogicEvent;
+
+typedef struct {
+    LogicConfig cfg;
+    uint64_t bits[MAX_CHANNELS][LOGIC_WORDS];  // 各通道位流
+    uint64_t start;        // 位流第0位对应的样本序号, 64的倍数
+    uint32_t samples;      // 位流长度
+    LogicEvent events[LOGIC_MAX_EVENTS];
+    uint32_t count;        // 事件数
+    uint32_t overflow;     // 事件表满后丢弃的事件数
+} LogicAnalyzer;
+
+void logicInit(LogicAnalyzer* la, const LogicConfig* cfg);
+uint32_t logicLoad(LogicAnalyzer* la, const DeepCapture* caps, uint64_t start, uint32_t count);
+uint32_t logicDecode(LogicAnalyzer* la);
+int logicFind(const LogicAnalyzer* la, int from, int type, int value);
+int logicFindSample(const LogicAnalyzer* la, uint64_t sample);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scope_math.h"
+
+#define MATH_MID ((ADC_FULL_SCALE + 1) / 2)  // 乘法前减去的中点码值
+
+void mathInit(MathChannels* m) {
+    memset(m, 0, sizeof(*m));
+    arm_rfft_fast_init_f32(&m->rfft, MATH_POINTS);
+    for (int i = 0; i < MATH_POINTS; i++) {
+        m->hann[i] = 0.5f - 0.5f * cosf(2 * PI * i / MATH_POINTS);
+    }
+}
+
+static int addNode(MathChannels* m, MathOp op, int a, int b) {
+    // 输入只能是已有节点, 因此图中不会有环
+    if (m->count >= MATH_MAX_NODES || (op != MATH_SOURCE && (a < 0 || a >= m->count))
+        || ((op == MATH_ADD || op == MATH_SUB || op == MATH_MUL) && (b < 0 || b >= m->count))) {
+        return -1;
+    }
+    MathNode* n = &m->nodes[m->count];
+    memset(n, 0, sizeof(*n));
+    n->op = op;
+    n->a = (uint8_t)a;
+    n->b = (uint8_t)b;
+    return m->count++;
+}
+
+int mathSource(MathChannels* m, int channel) {
+    return channel >= 0 && channel < MAX_CHANNELS ? addNode(m, MATH_SOURCE, channel, 0) : -1;
+}
+
+int mathBinary(MathChannels* m, MathOp op, int a, int b) {
+    return op == MATH_ADD || op == MATH_SUB || op == MATH_MUL ? addNode(m, op, a, b) : -1;
+}
+
+int mathFft(MathChannels* m, int a) {
+    return addNode(m, MATH_FFT, a, 0);
+}
+
+void mathShow(MathChannels* m, int node, int visible) {
+    if (node >= 0 && node < m->count) {
+        m->nodes[node].visible = (uint8_t)(visible != 0);
+    }
+}
+
+void mathSetWindow(MathChannels* m, const MathWindow* window) {
+    // 窗口超过MATH_POINTS个样本时等间隔取点
+    m->window = *window;
+    m->stride = (window->span + MATH_POINTS - 1) / MATH_POINTS;
+    if (m->stride == 0) {
+        m->stride = 1;
+    }
+    m->points = window->span / m->stride;
+}
+
+void mathInvalidate(MathChannels* m) {
+    // 源数据整体重新开始(如切换时基)时调用, 所有缓存作废
+    for (int i = 0; i < m->count; i++) {
+        m->nodes[i].stamp = 0;
+    }
+}
+
+static int sameWindow(const MathWindow* x, const MathWindow* y) {
+    if (x->capture != y->capture || x->start != y->start || x->span != y->span || x->version != y->version) {
+        return 0;
+    }
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        if (x->capture == NULL && x->buffer[i] != y->buffer[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void loadSource(MathChannels* m, MathNode* n) {
+    const MathWindow* w = &m->window;
+    uint32_t stride = m->stride;
+    if (w->capture != NULL) {
+        const uint16_t* samples = w->capture[n->a].samples;
+        uint64_t pos = w->start;
+        for (uint32_t i = 0; i < m->points; i++, pos += stride) {
+            n->data[i] = samples[pos & (CAPTURE_DEPTH - 1)];
+        }
+    } else {
+        const uint16_t* samples = w->buffer[n->a] + w->start;
+        for (uint32_t i = 0; i < m->points; i++) {
+            n->data[i] = samples[i * stride];
+        }
+    }
+    n->count = m->points;
+}
+
+static void computeFft(MathChannels* m, MathNode* n, const MathNode* in) {
+    // 输入不足MATH_POINTS点时把窗函数拉伸到输入长度, 其余补零
+    uint32_t count = in->count;
+    float32_t sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        float32_t w = m->hann[(uint64_t)i * MATH_POINTS / count];
+        m->work[i] = in->data[i] * w;
+        sum += w;
+    }
+    memset(m->work + count, 0, (MATH_POINTS - count) * sizeof(float32_t));
+    arm_rfft_fast_f32(&m->rfft, m->work, n->data, 0);
+
+    // 原地求幅度: 第k点只用到第2k、2k+1项; 第0、1项分别是直流和奈奎斯特分量, 奈奎斯特舍去
+    float32_t scale = 2 / (sum > 0 ? sum : 1);
+    float32_t dc = fabsf(n->data[0]) * scale / 2;
+    arm_cmplx_mag_f32(n->data, n->data, MATH_POINTS / 2);
+    arm_scale_f32(n->data, scale, n->data, MATH_POINTS / 2);
+    n->data[0] = dc;
+    n->count = count / 2;
+}
+
+const MathNode* mathEvaluate(MathChannels* m, int node) {
+    // 先求输入, 源窗口和输入版本都没变时直接返回缓存, 否则重新计算并更新版本
+    if (node < 0 || node >= m->count) {
+        return NULL;
+    }
+    MathNode* n = &m->nodes[node];
+    const MathNode* a = NULL;
+    const MathNode* b = NULL;
+    if (n->op == MATH_SOURCE) {
+        if (n->stamp != 0 && sameWindow(&n->window, &m->window)) {
+            m->cached++;
+            return n;
+        }
+    } else {
+        a = mathEvaluate(m, n->a);
+        b = n->op == MATH_FFT ? a : mathEvaluate(m, n->b);
+        if (a == NULL || b == NULL) {
+            return NULL;
+        }
+        if (n->stamp != 0 && n->inputStamp[0] == a->stamp && n->inputStamp[1] == b->stamp) {
+            m->cached++;
+            return n;
+        }
+    }
+    if (n->data == NULL) {
+        n->data = malloc(MATH_POINTS * sizeof(float32_t));
+        if (n->data == NULL) {
+            return NULL;
+        }
+    }
+
+    switch (n->op) {
+    case MATH_SOURCE:
+        loadSource(m, n);
+        n->window = m->window;
+        break;
+    case MATH_ADD:
+    case MATH_SUB:
+    case MATH_MUL:
+        n->count = a->count < b->count ? a->count : b->count;
+        if (n->op == MATH_ADD) {
+            arm_add_f32(a->data, b->data, n->data, n->count);
+        } else if (n->op == MATH_SUB) {
+            arm_sub_f32(a->data, b->data, n->data, n->count);
+        } else {
+            for (uint32_t i = 0; i < n->count; i++) {
+                n->data[i] = (a->data[i] - MATH_MID) * (b->data[i] - MATH_MID) * (1.0f / MATH_MID);
+            }
+        }
+        break;
+    case MATH_FFT:
+        computeFft(m, n, a);
+        break;
+    }
+    if (a != NULL) {
+        n->inputStamp[0] = a->stamp;
+        n->inputStamp[1] = b->stamp;
+    }
+
+    n->min = n->max = 0;
+    if (n->count > 0) {
+        uint32_t index;
+        arm_min_f32(n->data, n->count, &n->min, &index);
+        arm_max_f32(n->data, n->count, &n->max, &index);
+    }
+    n->stamp++;
+    if (n->stamp == 0) {
+        n->stamp = 1;
+    }
+    m->computed++;
+    return n;
+}
+
+const char* mathName(const MathChannels* m, int node, char* text, int size) {
+    // 按表达式写出节点名称, 如 FFT(Ch1*Ch2)
+    static const char ops[] = { 0, '+', '-', '*' };
+    const MathNode* n = &m->nodes[node];
+    char left[48], right[48];
+    switch (n->op) {
+    case MATH_SOURCE:
+        snprintf(text, size, "Ch%d", n->a + 1);
+        break;
+    case MATH_FFT:
+        snprintf(text, size, "FFT(%s)", mathName(m, n->a, left, sizeof(left)));
+        break;
+    default:
+        mathName(m, n->a, left, sizeof(left));
+        mathName(m, n->b, right, sizeof(right));
+        snprintf(text, size, m->nodes[n->a].op == MATH_SOURCE && m->nodes[n->b].op == MATH_SOURCE
+            ? "%s%c%s" : "(%s%c%s)", left, ops[n->op], right);
+        break;
+    }
+    return text;
+}
+
+void mathFree(MathChannels* m) {
+    for (int i = 0; i < m->count; i++) {
+        free(m->nodes[i].data);
+        m->nodes[i].data = NULL;
+        m->nodes[i].stamp = 0;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef SCOPE_MATH_H
+#define SCOPE_MATH_H
+
+#include <stdint.h>
+#include "scope.h"
+#include "scope_pyramid.h"
+
+// 数学通道: 节点按添加顺序组成有向无环图(输入只能是之前添加的节点), 惰性求值
+// 只有显示的节点及其输入才会计算, 且只在显示窗口内计算; 显示窗口超过MATH_POINTS个样本时
+// 按等间隔取点, 每个节点最多MATH_POINTS点
+// 每个节点缓存上次的结果和版本号, 源窗口和输入版本都没变时直接返回缓存
+// 节点的结果缓冲区在第一次求值时才分配, 隐藏的节点不占用计算时间和内存
+
+#define MATH_MAX_NODES 8
+#define MATH_POINTS FFT_SIZE  // 每个节点的最大点数, 也是FFT长度
+
+typedef enum {
+    MATH_SOURCE,  // 源通道, 单位为码值
+    MATH_ADD,     // A + B
+    MATH_SUB,     // A - B
+    MATH_MUL,     // A × B, 两者先减去中点码值, 结果除以中点码值, 仍在码值量级
+    MATH_FFT      // A的幅度谱(汉宁窗, 码值峰值), 点数为A的一半
+} MathOp;
+
+typedef struct {
+    const DeepCapture* capture;  // 非NULL时取深存储中的[start, start + span)
+    const uint16_t* buffer[MAX_CHANNELS];  // capture为NULL时取各缓冲区的[start, start + span)
+    uint64_t start;
+    uint32_t span;
+    uint64_t version;  // 缓冲区内容的版本, 内容改变时调用者更换
+} MathWindow;
+
+typedef struct {
+    MathOp op;
+    uint8_t a, b;              // 输入节点, 源节点的a为通道号
+    uint8_t visible;
+    float32_t* data;           // 结果, 第一次求值时分配
+    uint32_t count;            // 结果点数
+    float32_t min, max;        // 结果范围, 用于自动缩放显示
+    uint32_t stamp;            // 结果版本, 每次重新计算后递增, 0表示没有结果
+    uint32_t inputStamp[2];    // 计算时输入节点的版本
+    MathWindow window;         // 源节点计算时的窗口
+} MathNode;
+
+typedef struct {
+    MathNode nodes[MATH_MAX_NODES];
+    int count;
+    MathWindow window;                  // 当前显示窗口
+    uint32_t stride, points;            // 窗口内的取点间隔和点数
+    arm_rfft_fast_instance_f32 rfft;
+    float32_t hann[MATH_POINTS];
+    float32_t work[MATH_POINTS];
+    uint32_t computed;                  // 重新计算的节点次数
+    uint32_t cached;                    // 直接使用缓存的次数
+} MathChannels;
+
+void mathInit(MathChannels* m);
+int mathSource(MathChannels* m, int channel);
+int mathBinary(MathChannels* m, MathOp op, int a, int b);
+int mathFft(MathChannels* m, int a);
+void mathShow(MathChannels* m, int node, int visible);
+void mathSetWindow(MathChannels* m, const MathWindow* window);
+void mathInvalidate(MathChannels* m);
+const MathNode* mathEvaluate(MathChannels* m, int node);
+const char* mathName(const MathChannels* m, int node, char* text, int size);
+void mathFree(MathChannels* m);
+
+#endif
@@ -0,0 +1,378 @@
+#include <string.h>
+#include <math.h>
+#include "scope_measure.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MEASURE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MEASURE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MEASURE_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 输入为12位码值, SIMD路径按有符号16位比较, 参考电平不超过0x7FFF
+#define LEVEL_NEVER_HIGH 0x7FFF
+#define LEVEL_MIN_SWING 16  // 峰峰值小于该值时不判断边沿, 避免噪声误触发
+#define SUMSQ_CHUNK 256     // 32位平方和累加器的最大样本数, 之后并入64位
+
+enum {
+    EDGE_UNKNOWN,
+    EDGE_LOW,
+    EDGE_HIGH
+};
+
+typedef struct {
+    int state;
+    int lastLow;        // 最近一个低于10%电平的样本
+    int lastHigh;       // 最近一个高于90%电平的样本
+    uint32_t rising, falling;
+    double riseSum, fallSum;
+    double firstMid, lastMid;
+} EdgeState;
+
+typedef struct {
+    uint32_t min, max;
+    uint64_t sum, sumSq, sumHigh;
+    uint32_t countHigh;
+    EdgeState edge;
+} MeasureAcc;
+
+static int highestBit(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, v);
+    return (int)index;
+#else
+    return 31 - __builtin_clz(v);
+#endif
+}
+
+static int popCount(uint32_t v) {
+#ifdef _MSC_VER
+    return (int)__popcnt(v);
+#else
+    return __builtin_popcount(v);
+#endif
+}
+
+static float crossing(const uint16_t* x, int i, uint16_t level) {
+    // x[i]与x[i+1]之间穿越level的插值位置
+    int d = x[i + 1] - x[i];
+    return d == 0 ? (float)i : i + (float)(level - x[i]) / d;
+}
+
+static void edgeScan(EdgeState* e, const uint16_t* x, int from, int to, const MeasureLevels* l) {
+    // 带迟滞的边沿状态机: 低于10%为低, 高于90%为高, 中间保持原状态
+    for (int i = from; i < to; i++) {
+        uint16_t v = x[i];
+        if (v < l->low) {
+            if (e->state == EDGE_HIGH) {
+                float tHigh = crossing(x, e->lastHigh, l->high);
+                float tLow = crossing(x, i - 1, l->low);
+                e->fallSum += tLow - tHigh;
+                e->falling++;
+            }
+            e->state = EDGE_LOW;
+            e->lastLow = i;
+        } else if (v > l->high) {
+            if (e->state == EDGE_LOW) {
+                float tLow = crossing(x, e->lastLow, l->low);
+                float tHigh = crossing(x, i - 1, l->high);
+                float tMid = (tLow + tHigh) / 2;
+                if (e->rising == 0) {
+                    e->firstMid = tMid;
+                }
+                e->lastMid = tMid;
+                e->riseSum += tHigh - tLow;
+                e->rising++;
+            }
+            e->state = EDGE_HIGH;
+            e->lastHigh = i;
+        }
+    }
+}
+
+static void edgeVector(EdgeState* e, const uint16_t* x, int base, int width,
+    uint32_t below, uint32_t above, const MeasureLevels* l) {
+    // 向量内状态不变时只需记下最后一个低/高样本的位置, 否则逐点处理
+    if ((e->state != EDGE_HIGH && above) || (e->state != EDGE_LOW && below)) {
+        edgeScan(e, x, base, base + width, l);
+    } else if (below) {
+        e->lastLow = base + highestBit(below);
+    } else if (above) {
+        e->lastHigh = base + highestBit(above);
+    }
+}
+
+static void accumulateScalar(MeasureAcc* a, const uint16_t* x, int from, int to, const MeasureLevels* l) {
+    for (int i = from; i < to; i++) {
+        uint32_t v = x[i];
+        if (v < a->min) {
+            a->min = v;
+        }
+        if (v > a->max) {
+            a->max = v;
+        }
+        a->sum += v;
+        a->sumSq += v * v;
+        if (v > l->mid) {
+            a->sumHigh += v;
+            a->countHigh++;
+        }
+    }
+    edgeScan(&a->edge, x, from, to, l);
+}
+
+static void measureStart(MeasureAcc* a) {
+    memset(a, 0, sizeof(*a));
+    a->min = 0xFFFF;
+    a->edge.state = EDGE_UNKNOWN;
+}
+
+static void measureFinish(const MeasureAcc* a, int n, uint32_t sampleRate, Measurement* m) {
+    const EdgeState* e = &a->edge;
+    uint32_t countLow = n - a->countHigh;
+
+    m->min = (uint16_t)a->min;
+    m->max = (uint16_t)a->max;
+    m->mean = (float)((double)a->sum / n);
+    m->rms = (float)sqrt((double)a->sumSq / n);
+    // 顶部/底部电平取50%电平两侧样本的均值, 对方波脉冲准确
+    m->top = a->countHigh ? (float)((double)a->sumHigh / a->countHigh) : m->max;
+    m->base = countLow ? (float)((double)(a->sum - a->sumHigh) / countLow) : m->min;
+    m->risingEdges = e->rising;
+    m->fallingEdges = e->falling;
+    m->riseTime = e->rising ? (float)(e->riseSum / e->rising) : 0;
+    m->fallTime = e->falling ? (float)(e->fallSum / e->falling) : 0;
+    m->frequency = e->rising >= 2 && e->lastMid > e->firstMid
+        ? (float)((e->rising - 1) * (double)sampleRate / (e->lastMid - e->firstMid)) : 0;
+    m->duty = (float)a->countHigh / n;
+    m->overshoot = m->top > m->base ? (m->max - m->top) / (m->top - m->base) * 100 : 0;
+    measureLevelsFromRange(m->min, m->max, &m->next);
+}
+
+void measureLevelsFromRange(uint16_t min, uint16_t max, MeasureLevels* levels) {
+    uint32_t swing = max > min ? max - min : 0;
+    levels->mid = (uint16_t)(min + swing / 2);
+    if (swing < LEVEL_MIN_SWING) {
+        levels->low = 0;
+        levels->high = LEVEL_NEVER_HIGH;
+        return;
+    }
+    levels->low = (uint16_t)(min + swing / 10);
+    levels->high = (uint16_t)(max - swing / 10);
+}
+
+void measureBlockScalar(const uint16_t* x, int n, const MeasureLevels* levels, uint32_t sampleRate, Measurement* m) {
+    MeasureAcc a;
+    measureStart(&a);
+    accumulateScalar(&a, x, 0, n, levels);
+    measureFinish(&a, n, sampleRate, m);
+}
+
+#if defined(MEASURE_AVX2)
+
+static uint32_t laneMask(__m256i cmp) {
+    // 把16个16位比较结果压成16位掩码, 每个样本一位
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(cmp, cmp), 0xD8);
+    return (uint32_t)_mm256_movemask_epi8(packed) & 0xFFFF;
+}
+
+static uint64_t sum32(__m256i v) {
+    uint32_t lanes[8];
+    uint64_t sum = 0;
+    _mm256_storeu_si256((__m256i*)lanes, v);
+    for (int i = 0; i < 8; i++) {
+        sum += lanes[i];
+    }
+    return sum;
+}
+
+static int accumulateSimd(MeasureAcc* a, const uint16_t* x, int n, const MeasureLevels* l) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i low = _mm256_set1_epi16((short)l->low);
+    const __m256i mid = _mm256_set1_epi16((short)l->mid);
+    const __m256i high = _mm256_set1_epi16((short)l->high);
+    __m256i vmin = _mm256_set1_epi16(0x7FFF);
+    __m256i vmax = _mm256_setzero_si256();
+    int i = 0;
+
+    while (i + 16 <= n) {
+        __m256i sum = _mm256_setzero_si256();
+        __m256i sq = _mm256_setzero_si256();
+        __m256i sumHigh = _mm256_setzero_si256();
+        int end = n - i > SUMSQ_CHUNK ? i + SUMSQ_CHUNK : n;
+        for (; i + 16 <= end; i += 16) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(x + i));
+            vmin = _mm256_min_epi16(vmin, v);
+            vmax = _mm256_max_epi16(vmax, v);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, ones));
+            sq = _mm256_add_epi32(sq, _mm256_madd_epi16(v, v));
+            __m256i aboveMid = _mm256_cmpgt_epi16(v, mid);
+            sumHigh = _mm256_add_epi32(sumHigh, _mm256_madd_epi16(_mm256_and_si256(v, aboveMid), ones));
+            a->countHigh += popCount(laneMask(aboveMid));
+            uint32_t below = laneMask(_mm256_cmpgt_epi16(low, v));
+            uint32_t above = laneMask(_mm256_cmpgt_epi16(v, high));
+            edgeVector(&a->edge, x, i, 16, below, above, l);
+        }
+        a->sum += sum32(sum);
+        a->sumSq += sum32(sq);
+        a->sumHigh += sum32(sumHigh);
+    }
+
+    uint16_t mins[16], maxs[16];
+    _mm256_storeu_si256((__m256i*)mins, vmin);
+    _mm256_storeu_si256((__m256i*)maxs, vmax);
+    for (int k = 0; k < 16 && i > 0; k++) {
+        if (mins[k] < a->min) {
+            a->min = mins[k];
+        }
+        if (maxs[k] > a->max) {
+            a->max = maxs[k];
+        }
+    }
+    return i;
+}
+
+const char* measureKernelName(void) {
+    return "AVX2";
+}
+
+#elif defined(MEASURE_SSE2)
+
+static uint32_t laneMask(__m128i cmp) {
+    return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(cmp, _mm_setzero_si128()));
+}
+
+static uint64_t sum32(__m128i v) {
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, v);
+    return (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+static int accumulateSimd(MeasureAcc* a, const uint16_t* x, int n, const MeasureLevels* l) {
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i low = _mm_set1_epi16((short)l->low);
+    const __m128i mid = _mm_set1_epi16((short)l->mid);
+    const __m128i high = _mm_set1_epi16((short)l->high);
+    __m128i vmin = _mm_set1_epi16(0x7FFF);
+    __m128i vmax = _mm_setzero_si128();
+    int i = 0;
+
+    while (i + 8 <= n) {
+        __m128i sum = _mm_setzero_si128();
+        __m128i sq = _mm_setzero_si128();
+        __m128i sumHigh = _mm_setzero_si128();
+        int end = n - i > SUMSQ_CHUNK ? i + SUMSQ_CHUNK : n;
+        for (; i + 8 <= end; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(v, ones));
+            sq = _mm_add_epi32(sq, _mm_madd_epi16(v, v));
+            __m128i aboveMid = _mm_cmpgt_epi16(v, mid);
+            sumHigh = _mm_add_epi32(sumHigh, _mm_madd_epi16(_mm_and_si128(v, aboveMid), ones));
+            a->countHigh += popCount(laneMask(aboveMid));
+            uint32_t below = laneMask(_mm_cmplt_epi16(v, low));
+            uint32_t above = laneMask(_mm_cmpgt_epi16(v, high));
+            edgeVector(&a->edge, x, i, 8, below, above, l);
+        }
+        a->sum += sum32(sum);
+        a->sumSq += sum32(sq);
+        a->sumHigh += sum32(sumHigh);
+    }
+
+    uint16_t mins[8], maxs[8];
+    _mm_storeu_si128((__m128i*)mins, vmin);
+    _mm_storeu_si128((__m128i*)maxs, vmax);
+    for (int k = 0; k < 8 && i > 0; k++) {
+        if (mins[k] < a->min) {
+            a->min = mins[k];
+        }
+        if (maxs[k] > a->max) {
+            a->max = maxs[k];
+        }
+    }
+    return i;
+}
+
+const char* measureKernelName(void) {
+    return "SSE2";
+}
+
+#elif defined(MEASURE_NEON)
+
+static uint32_t laneMask(uint16x8_t cmp) {
+    static const uint8_t weights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    return vaddv_u8(vand_u8(vmovn_u16(cmp), vld1_u8(weights)));
+}
+
+static int accumulateSimd(MeasureAcc* a, const uint16_t* x, int n, const MeasureLevels* l) {
+    const uint16x8_t low = vdupq_n_u16(l->low);
+    const uint16x8_t mid = vdupq_n_u16(l->mid);
+    const uint16x8_t high = vdupq_n_u16(l->high);
+    uint16x8_t vmin = vdupq_n_u16(0xFFFF);
+    uint16x8_t vmax = vdupq_n_u16(0);
+    uint64x2_t sum = vdupq_n_u64(0), sq = vdupq_n_u64(0), sumHigh = vdupq_n_u64(0);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vld1q_u16(x + i);
+        vmin = vminq_u16(vmin, v);
+        vmax = vmaxq_u16(vmax, v);
+        sum = vpadalq_u32(sum, vpaddlq_u16(v));
+        uint32x4_t sqLow = vmull_u16(vget_low_u16(v), vget_low_u16(v));
+        uint32x4_t sqHigh = vmull_u16(vget_high_u16(v), vget_high_u16(v));
+        sq = vpadalq_u32(vpadalq_u32(sq, sqLow), sqHigh);
+        uint16x8_t aboveMid = vcgtq_u16(v, mid);
+        sumHigh = vpadalq_u32(sumHigh, vpaddlq_u16(vandq_u16(v, aboveMid)));
+        a->countHigh += popCount(laneMask(aboveMid));
+        uint32_t below = laneMask(vcltq_u16(v, low));
+        uint32_t above = laneMask(vcgtq_u16(v, high));
+        edgeVector(&a->edge, x, i, 8, below, above, l);
+    }
+
+    if (i > 0) {
+        a->min = vminvq_u16(vmin);
+        a->max = vmaxvq_u16(vmax);
+        a->sum = vaddvq_u64(sum);
+        a->sumSq = vaddvq_u64(sq);
+        a->sumHigh = vaddvq_u64(sumHigh);
+    }
+    return i;
+}
+
+const char* measureKernelName(void) {
+    return "NEON";
+}
+
+#else
+
+static int accumulateSimd(MeasureAcc* a, const uint16_t* x, int n, const MeasureLevels* l) {
+    (void)a;
+    (void)x;
+    (void)n;
+    (void)l;
+    return 0;
+}
+
+const char* measureKernelName(void) {
+    return "scalar";
+}
+
+#endif
+
+void measureBlock(const uint16_t* x, int n, const MeasureLevels* levels, uint32_t sampleRate, Measurement* m) {
+    MeasureAcc a;
+    measureStart(&a);
+    int done = accumulateSimd(&a, x, n, levels);
+    accumulateScalar(&a, x, done, n, levels);
+    measureFinish(&a, n, sampleRate, m);
+}
@@ -0,0 +1,36 @@
+#ifndef SCOPE_MEASURE_H
+#define SCOPE_MEASURE_H
+
+#include <stdint.h>
+
+// 单遍融合测量: 一次扫描同时得到最小/最大值、均值、平方和、
+// 电平穿越、上升/下降时间、占空比和过冲
+// 边沿判断使用上一块得到的10%/50%/90%参考电平, 因此不需要第二遍扫描
+
+typedef struct {
+    uint16_t low;   // 10%电平(码值)
+    uint16_t mid;   // 50%电平
+    uint16_t high;  // 90%电平
+} MeasureLevels;
+
+typedef struct {
+    uint16_t min, max;      // 最小/最大值(码值)
+    float mean;             // 均值
+    float rms;              // 均方根(含直流)
+    float top, base;        // 50%电平以上/以下样本的均值, 作为顶部/底部电平
+    uint32_t risingEdges;   // 上升沿数(10%->90%)
+    uint32_t fallingEdges;  // 下降沿数(90%->10%)
+    float riseTime;         // 平均上升时间(样本)
+    float fallTime;         // 平均下降时间(样本)
+    float frequency;        // 频率(Hz), 由首末上升沿的50%点估算
+    float duty;             // 占空比(高于50%电平的样本比例)
+    float overshoot;        // 过冲(相对顶部与底部之差的百分比)
+    MeasureLevels next;     // 按本块最小/最大值算出的下一块参考电平
+} Measurement;
+
+void measureLevelsFromRange(uint16_t min, uint16_t max, MeasureLevels* levels);
+void measureBlock(const uint16_t* x, int n, const MeasureLevels* levels, uint32_t sampleRate, Measurement* m);
+void measureBlockScalar(const uint16_t* x, int n, const MeasureLevels* levels, uint32_t sampleRate, Measurement* m);
+const char* measureKernelName(void);
+
+#endif
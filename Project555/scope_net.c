@@ -0,0 +1,193 @@
+#include <string.h>
+#include "scope_net.h"
+#include "scope_hal.h"
+
+static NetClient clients[HAL_NET_MAX_CLIENTS];
+static uint32_t blockSeq, blockTime;
+static uint16_t decimated[ADC_BUFFER_SIZE];
+
+_Static_assert(sizeof(clients) + sizeof(blockSeq) + sizeof(blockTime) + sizeof(decimated) <= NET_STATIC_BYTES,
+    "NET_STATIC_BYTES does not cover the statics of scope_net.c");
+
+static uint32_t queueUsed(const NetClient* c) {
+    return c->tail - c->head;
+}
+
+static void queuePush(NetClient* c, const void* data, uint32_t size) {
+    // 调用前已确认空间足够, 回绕时分两段复制
+    uint32_t pos = c->tail & (NET_QUEUE_BYTES - 1);
+    uint32_t first = NET_QUEUE_BYTES - pos < size ? NET_QUEUE_BYTES - pos : size;
+    memcpy(c->queue + pos, data, first);
+    memcpy(c->queue, (const uint8_t*)data + first, size - first);
+    c->tail += size;
+}
+
+static int wants(const NetClient* c, int type, int channel) {
+    return c->connected && c->sending && (c->types & (1u << type)) && (c->channels & (1u << channel));
+}
+
+static void sendFrame(NetClient* c, int type, int channel, uint32_t param, const void* payload, uint32_t length) {
+    // 整帧放不下就丢弃, 并加大跳帧间隔; 不会部分入队, 客户端看到的总是完整帧
+    if (NET_QUEUE_BYTES - queueUsed(c) < sizeof(NetFrame) + length) {
+        c->framesDropped++;
+        if (c->skip < NET_MAX_SKIP) {
+            c->skip *= 2;
+        }
+        c->sending = 0;
+        return;
+    }
+    NetFrame frame;
+    frame.magic = NET_MAGIC;
+    frame.type = (uint8_t)type;
+    frame.channel = (uint8_t)channel;
+    frame.seq = blockSeq;
+    frame.timestamp = blockTime;
+    frame.param = param;
+    frame.length = length;
+    queuePush(c, &frame, sizeof(frame));
+    queuePush(c, payload, length);
+    c->framesSent++;
+}
+
+static void onAccepted(int client) {
+    // 新客户端默认订阅全部通道的测量结果和波形, 不抽取
+    NetClient* c = &clients[client];
+    c->connected = 1;
+    c->types = (1u << NET_FRAME_WAVEFORM) | (1u << NET_FRAME_MEASURE);
+    c->channels = (1u << MAX_CHANNELS) - 1;
+    c->decimation = 1;
+    c->skip = 1;
+    c->blocks = 0;
+    c->head = c->tail = 0;
+    c->rxLen = 0;
+    c->bytesSent = 0;
+    c->framesSent = 0;
+    c->framesDropped = 0;
+}
+
+static void onCommand(NetClient* c, const NetFrame* cmd) {
+    switch (cmd->type) {
+    case NET_CMD_SUBSCRIBE:
+        c->types = cmd->param & 0xFF;
+        c->channels = (cmd->param >> 8) & 0xFF;
+        break;
+    case NET_CMD_DECIMATE:
+        c->decimation = cmd->param == 0 ? 1 : cmd->param > ADC_BUFFER_SIZE ? ADC_BUFFER_SIZE : cmd->param;
+        break;
+    default:
+        break;
+    }
+}
+
+static void onReceived(int client, const uint8_t* data, uint32_t size) {
+    // 命令是不带负载的帧头, 可能被拆开或粘连, 攒够一帧再处理
+    NetClient* c = &clients[client];
+    while (size > 0) {
+        uint32_t len = NET_RX_BYTES - c->rxLen < size ? NET_RX_BYTES - c->rxLen : size;
+        memcpy(c->rx + c->rxLen, data, len);
+        c->rxLen += len;
+        data += len;
+        size -= len;
+
+        uint32_t used = 0;
+        while (c->rxLen - used >= sizeof(NetFrame)) {
+            NetFrame cmd;
+            memcpy(&cmd, c->rx + used, sizeof(cmd));
+            if (cmd.magic != NET_MAGIC || cmd.length != 0) {
+                halNetClose(client);  // 协议错误
+                return;
+            }
+            onCommand(c, &cmd);
+            used += sizeof(NetFrame);
+        }
+        memmove(c->rx, c->rx + used, c->rxLen - used);
+        c->rxLen -= used;
+    }
+}
+
+static void onClosed(int client) {
+    clients[client].connected = 0;
+}
+
+static const HalNetHandler handler = { onAccepted, onReceived, onClosed };
+
+int netServerInit(void) {
+    memset(clients, 0, sizeof(clients));
+    return halNetInit(&handler);
+}
+
+int netBeginBlock(uint32_t seq, uint32_t timestamp) {
+    // 决定本块发给哪些客户端, 队列排空的客户端逐步缩小跳帧间隔
+    int any = 0;
+    blockSeq = seq;
+    blockTime = timestamp;
+    for (int i = 0; i < HAL_NET_MAX_CLIENTS; i++) {
+        NetClient* c = &clients[i];
+        if (!c->connected) {
+            continue;
+        }
+        if (c->skip > 1 && queueUsed(c) == 0) {
+            c->skip /= 2;
+        }
+        c->sending = c->blocks++ % c->skip == 0;
+        any |= c->sending;
+    }
+    return any;
+}
+
+void netPublishWaveform(int channel, const uint16_t* samples, uint32_t count) {
+    for (int i = 0; i < HAL_NET_MAX_CLIENTS; i++) {
+        NetClient* c = &clients[i];
+        if (!wants(c, NET_FRAME_WAVEFORM, channel)) {
+            continue;
+        }
+        if (c->decimation == 1) {
+            sendFrame(c, NET_FRAME_WAVEFORM, channel, 1, samples, count * sizeof(uint16_t));
+            continue;
+        }
+        uint32_t n = 0;
+        for (uint32_t j = 0; j < count; j += c->decimation) {
+            decimated[n++] = samples[j];
+        }
+        sendFrame(c, NET_FRAME_WAVEFORM, channel, c->decimation, decimated, n * sizeof(uint16_t));
+    }
+}
+
+void netPublishSpectrum(int channel, const float32_t* magnitude, uint32_t bins) {
+    for (int i = 0; i < HAL_NET_MAX_CLIENTS; i++) {
+        if (wants(&clients[i], NET_FRAME_SPECTRUM, channel)) {
+            sendFrame(&clients[i], NET_FRAME_SPECTRUM, channel, bins, magnitude, bins * sizeof(float32_t));
+        }
+    }
+}
+
+void netPublishMeasure(int channel, const Measurement* m) {
+    NetMeasure out = { m->min, m->max, m->mean, m->rms, m->frequency, m->duty, m->riseTime, m->fallTime, m->overshoot };
+    for (int i = 0; i < HAL_NET_MAX_CLIENTS; i++) {
+        if (wants(&clients[i], NET_FRAME_MEASURE, channel)) {
+            sendFrame(&clients[i], NET_FRAME_MEASURE, channel, 0, &out, sizeof(out));
+        }
+    }
+}
+
+void netService(void) {
+    // 先处理连接和命令, 再把各队列尽量发出, 协议栈不收就留到下次
+    halNetService();
+    for (int i = 0; i < HAL_NET_MAX_CLIENTS; i++) {
+        NetClient* c = &clients[i];
+        while (c->connected && queueUsed(c) > 0) {
+            uint32_t pos = c->head & (NET_QUEUE_BYTES - 1);
+            uint32_t len = NET_QUEUE_BYTES - pos < queueUsed(c) ? NET_QUEUE_BYTES - pos : queueUsed(c);
+            uint32_t sent = halNetSend(i, c->queue + pos, len);
+            c->head += sent;
+            c->bytesSent += sent;
+            if (sent < len) {
+                break;
+            }
+        }
+    }
+}
+
+const NetClient* netClient(int client) {
+    return &clients[client];
+}
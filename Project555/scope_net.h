@@ -0,0 +1,78 @@
+#ifndef SCOPE_NET_H
+#define SCOPE_NET_H
+
+#include <stdint.h>
+#include "scope.h"
+#include "scope_measure.h"
+
+// 网络流式服务: 多客户端, 二进制分帧协议
+// 每个客户端有独立的发送队列, 队列放不下时丢弃该客户端的帧并加大跳帧间隔,
+// 队列排空后再逐步恢复, 慢客户端不会阻塞采集和其他客户端
+// 帧格式: [NetFrame][length字节负载], 多字节字段为小端
+
+#define NET_MAGIC 0x4353  // "SC"
+
+#ifndef NET_QUEUE_BYTES
+#ifdef SCOPE_HOST
+#define NET_QUEUE_BYTES (256 * 1024)  // 每客户端发送队列, 必须是2的幂
+#else
+#define NET_QUEUE_BYTES (8 * 1024)   // 目标板一块的全部帧约8.5KB, 放不下的帧跳过
+#endif
+#endif
+#define NET_MAX_SKIP 64   // 背压时最大跳帧间隔
+#define NET_RX_BYTES 64   // 命令接收缓冲区
+
+enum {
+    // 服务端 -> 客户端
+    NET_FRAME_WAVEFORM = 1,  // 负载: uint16样本, param为抽取倍数
+    NET_FRAME_SPECTRUM = 2,  // 负载: float32幅度谱
+    NET_FRAME_MEASURE = 3,   // 负载: NetMeasure
+    // 客户端 -> 服务端
+    NET_CMD_SUBSCRIBE = 16,  // param低8位: 帧类型掩码(1 << 类型), 8-15位: 通道掩码
+    NET_CMD_DECIMATE = 17    // param: 波形抽取倍数
+};
+
+typedef struct {
+    uint16_t magic;
+    uint8_t type;
+    uint8_t channel;
+    uint32_t seq;        // 采集块序号
+    uint32_t timestamp;  // 采集时刻(us)
+    uint32_t param;
+    uint32_t length;     // 负载字节数
+} NetFrame;
+
+typedef struct {
+    float min, max, mean, rms;
+    float frequency, duty, riseTime, fallTime, overshoot;
+} NetMeasure;
+
+typedef struct {
+    int connected;
+    uint32_t types;        // 订阅的帧类型掩码
+    uint32_t channels;     // 订阅的通道掩码
+    uint32_t decimation;   // 波形抽取倍数
+    uint32_t skip;         // 背压跳帧间隔, 1为不跳
+    uint32_t blocks;       // 已发布的块数, 与skip一起决定是否发送
+    int sending;           // 当前块是否发给该客户端
+    uint8_t queue[NET_QUEUE_BYTES];
+    uint32_t head, tail;   // 队列读写位置(累计字节)
+    uint8_t rx[NET_RX_BYTES];
+    uint32_t rxLen;
+    uint64_t bytesSent;
+    uint32_t framesSent;
+    uint32_t framesDropped;
+} NetClient;
+
+// 模块内部的静态数据(各客户端状态和队列、抽取后的波形), 计入test.c的内存预算
+#define NET_STATIC_BYTES (HAL_NET_MAX_CLIENTS * sizeof(NetClient) + ADC_BUFFER_SIZE * sizeof(uint16_t) + 64)
+
+int netServerInit(void);
+int netBeginBlock(uint32_t seq, uint32_t timestamp);
+void netPublishWaveform(int channel, const uint16_t* samples, uint32_t count);
+void netPublishSpectrum(int channel, const float32_t* magnitude, uint32_t bins);
+void netPublishMeasure(int channel, const Measurement* m);
+void netService(void);
+const NetClient* netClient(int client);
+
+#endif
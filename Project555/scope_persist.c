@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scope_persist.h"
+#include "scope_hal.h"
+
+static inline void hit(uint16_t* h) {
+    // 饱和累加, 编译器可向量化为无符号饱和加法
+    uint32_t v = *h + PERSIST_WEIGHT;
+    *h = (uint16_t)(v > 0xFFFF ? 0xFFFF : v);
+}
+
+static inline int toRow(uint16_t sample) {
+    return PERSIST_HEIGHT - 1 - sample * (PERSIST_HEIGHT - 1) / ADC_FULL_SCALE;
+}
+
+static void addSpan(Persistence* p, int x, int top, int bottom) {
+    uint16_t* column = p->hits[x];
+    for (int y = top; y <= bottom; y++) {
+        hit(&column[y]);
+    }
+}
+
+void persistInit(Persistence* p, uint8_t decayShift) {
+    memset(p, 0, sizeof(*p));
+    p->decayShift = decayShift;
+    // 1次命中最暗但仍可见, 饱和(256次)最亮
+    for (int i = 1; i <= 256; i++) {
+        p->levels[i] = (uint8_t)(48 + 207 * logf((float)i) / logf(256.0f) + 0.5f);
+    }
+}
+
+void persistClear(Persistence* p) {
+    memset(p->hits, 0, sizeof(p->hits));
+    p->waveforms = 0;
+}
+
+static void addLine(Persistence* p, int x0, int y0, int x1, int y1) {
+    // 整数Bresenham, 不含终点: 相邻线段共用端点时不会重复计数
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while (x0 != x1 || y0 != y1) {
+        hit(&p->hits[x0][y0]);
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void persistAddWaveform(Persistence* p, const uint16_t* data, uint32_t count) {
+    // 波形铺满屏幕宽度: 每列不少于一个样本时取该列的最小/最大值, 与前一列衔接后累加一条竖线;
+    // 样本少于列数时在相邻样本之间画线
+    if (count < 2) {
+        return;
+    }
+    if (count >= PERSIST_WIDTH) {
+        int prevTop = -1, prevBottom = -1;
+        uint32_t first = 0;
+        for (int x = 0; x < PERSIST_WIDTH; x++) {
+            uint32_t last = (uint32_t)((uint64_t)(x + 1) * count / PERSIST_WIDTH);
+            uint16_t low = data[first], high = data[first];
+            for (uint32_t i = first + 1; i < last; i++) {
+                low = data[i] < low ? data[i] : low;
+                high = data[i] > high ? data[i] : high;
+            }
+            int top = toRow(high), bottom = toRow(low);
+            if (prevTop >= 0) {
+                top = top < prevBottom ? top : prevBottom;
+                bottom = bottom > prevTop ? bottom : prevTop;
+            }
+            addSpan(p, x, top, bottom);
+            prevTop = toRow(high);
+            prevBottom = toRow(low);
+            first = last;
+        }
+    } else {
+        int x0 = 0, y0 = toRow(data[0]);
+        for (uint32_t i = 1; i < count; i++) {
+            int x1 = (int)((uint64_t)i * (PERSIST_WIDTH - 1) / (count - 1));
+            int y1 = toRow(data[i]);
+            addLine(p, x0, y0, x1, y1);
+            x0 = x1;
+            y0 = y1;
+        }
+        hit(&p->hits[x0][y0]);
+    }
+    p->waveforms++;
+}
+
+void persistRender(Persistence* p) {
+    // 先衰减(每格至少减1, 单次命中也会在有限次刷新后消失), 再按行输出灰度图像
+    if (p->decayShift != PERSIST_INFINITE) {
+        uint16_t* h = &p->hits[0][0];
+        for (int i = 0; i < PERSIST_WIDTH * PERSIST_HEIGHT; i++) {
+            h[i] -= (h[i] >> p->decayShift) + (h[i] != 0);
+        }
+    }
+    uint8_t row[LCD_WIDTH];
+    for (int y = 0; y < LCD_HEIGHT; y++) {
+        int cell = y >> PERSIST_SHIFT;
+        for (int x = 0; x < LCD_WIDTH; x++) {
+            row[x] = p->levels[(p->hits[x >> PERSIST_SHIFT][cell] + 255) >> 8];
+        }
+        halLcdDrawImage(0, y, LCD_WIDTH, 1, row);
+    }
+}
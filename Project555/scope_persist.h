@@ -0,0 +1,37 @@
+#ifndef SCOPE_PERSIST_H
+#define SCOPE_PERSIST_H
+
+#include <stdint.h>
+#include "scope.h"
+
+// 余辉显示: 每条采集到的波形都栅格化进一张(时间 × 幅度)命中计数直方图, 显示时按计数对数分级亮度
+// 计数按列存放, 竖直线段的累加是连续内存; 每次刷新先按decayShift指数衰减再输出图像,
+// 因此波形累加速度只取决于采集, 刷新率由显示任务决定
+// 目标板RAM有限, 直方图每格覆盖4×4个像素
+
+#ifndef PERSIST_SHIFT
+#ifdef SCOPE_HOST
+#define PERSIST_SHIFT 0
+#else
+#define PERSIST_SHIFT 2
+#endif
+#endif
+
+#define PERSIST_WIDTH (LCD_WIDTH >> PERSIST_SHIFT)
+#define PERSIST_HEIGHT (LCD_HEIGHT >> PERSIST_SHIFT)
+#define PERSIST_WEIGHT 256     // 每次命中累加的计数, 饱和前可区分256次命中
+#define PERSIST_INFINITE 0     // decayShift为0时不衰减(无限余辉)
+
+typedef struct {
+    uint16_t hits[PERSIST_WIDTH][PERSIST_HEIGHT];  // 按列存放的命中计数
+    uint8_t levels[257];        // (计数 + 255) / 256 到亮度的对数映射
+    uint8_t decayShift;         // 每次刷新衰减 1/2^decayShift
+    uint32_t waveforms;         // 累计折叠的波形数
+} Persistence;
+
+void persistInit(Persistence* p, uint8_t decayShift);
+void persistClear(Persistence* p);
+void persistAddWaveform(Persistence* p, const uint16_t* data, uint32_t count);
+void persistRender(Persistence* p);
+
+#endif
@@ -0,0 +1,130 @@
+#include <string.h>
+#include "scope_pyramid.h"
+
+static uint32_t groupShift(int level) {
+    return PYR_BASE_SHIFT + level * PYR_LEVEL_SHIFT;
+}
+
+static MinMax* entryAt(DeepCapture* cap, int level, uint64_t group) {
+    uint32_t mask = (CAPTURE_DEPTH >> groupShift(level)) - 1;
+    return &cap->pyramid[cap->levelOffset[level] + (group & mask)];
+}
+
+static const MinMax* entryAtConst(const DeepCapture* cap, int level, uint64_t group) {
+    return entryAt((DeepCapture*)cap, level, group);
+}
+
+static void merge(MinMax* acc, uint16_t min, uint16_t max) {
+    if (min < acc->min) {
+        acc->min = min;
+    }
+    if (max > acc->max) {
+        acc->max = max;
+    }
+}
+
+void captureInit(DeepCapture* cap) {
+    uint32_t offset = 0;
+    for (int level = 0; level < PYR_LEVELS; level++) {
+        cap->levelOffset[level] = offset;
+        offset += CAPTURE_DEPTH >> groupShift(level);
+    }
+    cap->written = 0;
+}
+
+uint64_t captureOldest(const DeepCapture* cap) {
+    return cap->written > CAPTURE_DEPTH ? cap->written - CAPTURE_DEPTH : 0;
+}
+
+void captureAppend(DeepCapture* cap, const uint16_t* data, uint32_t count) {
+    // 写入循环存储, 回绕时分两段复制
+    uint64_t first = cap->written;
+    uint32_t pos = (uint32_t)(first & (CAPTURE_DEPTH - 1));
+    uint32_t part = count < CAPTURE_DEPTH - pos ? count : CAPTURE_DEPTH - pos;
+    memcpy(&cap->samples[pos], data, part * sizeof(uint16_t));
+    memcpy(cap->samples, data + part, (count - part) * sizeof(uint16_t));
+    cap->written += count;
+    uint64_t end = cap->written;
+
+    // 第0层: 重新统计被写到的每一组, 末尾未写满的组只统计已写入部分
+    for (uint64_t g = first >> PYR_BASE_SHIFT; g <= (end - 1) >> PYR_BASE_SHIFT; g++) {
+        uint64_t s = g << PYR_BASE_SHIFT;
+        uint64_t e = s + (1u << PYR_BASE_SHIFT) < end ? s + (1u << PYR_BASE_SHIFT) : end;
+        MinMax acc = { 0xFFFF, 0 };
+        for (uint64_t i = s; i < e; i++) {
+            uint16_t v = cap->samples[i & (CAPTURE_DEPTH - 1)];
+            merge(&acc, v, v);
+        }
+        *entryAt(cap, 0, g) = acc;
+    }
+
+    // 上层: 由下一层的4个子项合并, 跳过尚未写入的子项
+    for (int level = 1; level < PYR_LEVELS; level++) {
+        uint32_t shift = groupShift(level);
+        uint32_t childShift = groupShift(level - 1);
+        for (uint64_t g = first >> shift; g <= (end - 1) >> shift; g++) {
+            MinMax acc = { 0xFFFF, 0 };
+            uint64_t child = g << PYR_LEVEL_SHIFT;
+            for (int k = 0; k < (1 << PYR_LEVEL_SHIFT) && ((child + k) << childShift) < end; k++) {
+                const MinMax* c = entryAt(cap, level - 1, child + k);
+                merge(&acc, c->min, c->max);
+            }
+            *entryAt(cap, level, g) = acc;
+        }
+    }
+}
+
+void captureRender(const DeepCapture* cap, uint64_t start, uint32_t span, int width, MinMax* columns) {
+    // 选每项覆盖样本数不超过每列样本数的最粗一层, 每列只需合并少量条目;
+    // 列边界对齐到条目边界, 每个样本恰好属于一列, 峰值不会漏掉
+    uint64_t oldest = captureOldest(cap);
+    int level = -1;
+    while (level + 1 < PYR_LEVELS && ((uint64_t)width << groupShift(level + 1)) <= span) {
+        level++;
+    }
+    uint32_t shift = level < 0 ? 0 : groupShift(level);
+
+    // 最旧的不完整组与最新的组共用同一条目, 从下一个组边界开始才有效
+    uint64_t validStart = ((oldest + (1u << shift) - 1) >> shift) << shift;
+
+    for (int c = 0; c < width; c++) {
+        uint64_t s = ((start + (uint64_t)span * c / width) >> shift) << shift;
+        uint64_t e = ((start + (uint64_t)span * (c + 1) / width) >> shift) << shift;
+        if (e <= s) {
+            e = s + (1u << shift);
+        }
+        if (s < validStart) {
+            s = validStart;
+        }
+        if (e > cap->written) {
+            e = cap->written;
+        }
+
+        MinMax acc = { 0xFFFF, 0 };
+        if (level < 0) {
+            for (uint64_t i = s; i < e; i++) {
+                uint16_t v = cap->samples[i & (CAPTURE_DEPTH - 1)];
+                merge(&acc, v, v);
+            }
+        } else {
+            for (uint64_t g = s >> shift; (g << shift) < e; g++) {
+                const MinMax* m = entryAtConst(cap, level, g);
+                merge(&acc, m->min, m->max);
+            }
+        }
+        columns[c] = acc;
+    }
+}
+
+void bufferRender(const uint16_t* data, uint32_t count, int width, MinMax* columns) {
+    // 短记录直接按列求最小/最大值, 列划分与captureRender一致
+    for (int c = 0; c < width; c++) {
+        uint32_t s = (uint32_t)((uint64_t)count * c / width);
+        uint32_t e = (uint32_t)((uint64_t)count * (c + 1) / width);
+        MinMax acc = { 0xFFFF, 0 };
+        for (uint32_t i = s; i < e; i++) {
+            merge(&acc, data[i], data[i]);
+        }
+        columns[c] = acc;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef SCOPE_PYRAMID_H
+#define SCOPE_PYRAMID_H
+
+#include <stdint.h>
+#include "scope.h"
+
+// 深存储波形与最小/最大值抽取金字塔
+// 任意缩放级别绘制时只访问与屏幕宽度成正比的条目, 峰值不会因抽取而丢失
+
+#ifndef CAPTURE_DEPTH_SHIFT
+#ifdef SCOPE_HOST
+#define CAPTURE_DEPTH_SHIFT 22  // 每通道4M样本
+#else
+#define CAPTURE_DEPTH_SHIFT 11  // 目标板片内RAM有限, 每通道2K样本(4块)
+#endif
+#endif
+
+#define CAPTURE_DEPTH (1u << CAPTURE_DEPTH_SHIFT)  // 每通道存储深度(样本)
+#define PYR_BASE_SHIFT 4   // 第0层每项覆盖16个样本
+#define PYR_LEVEL_SHIFT 2  // 每层比下一层粗4倍
+#define PYR_LEVELS ((CAPTURE_DEPTH_SHIFT - PYR_BASE_SHIFT) / PYR_LEVEL_SHIFT + 1)
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+} MinMax;
+
+typedef struct {
+    uint16_t samples[CAPTURE_DEPTH];     // 循环存储的原始样本
+    MinMax pyramid[CAPTURE_DEPTH / 8];   // 各层依次存放, 总量小于深度的1/8
+    uint32_t levelOffset[PYR_LEVELS];    // 每层在pyramid中的起始位置
+    uint64_t written;                    // 累计写入的样本数
+} DeepCapture;
+
+void captureInit(DeepCapture* cap);
+void captureAppend(DeepCapture* cap, const uint16_t* data, uint32_t count);
+uint64_t captureOldest(const DeepCapture* cap);
+void captureRender(const DeepCapture* cap, uint64_t start, uint32_t span, int width, MinMax* columns);
+void bufferRender(const uint16_t* data, uint32_t count, int width, MinMax* columns);
+
+#endif
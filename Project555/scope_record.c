@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <string.h>
+#include "scope_record.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int bitWidth(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    return _BitScanReverse(&index, v) ? (int)index + 1 : 0;
+#else
+    return v ? 32 - __builtin_clz(v) : 0;
+#endif
+}
+
+static uint8_t* encodeChannel(const uint16_t* x, uint32_t n, uint8_t* out) {
+    // 第一个样本原样存放, 之后是zigzag编码的差分, 每组前一个字节给出位宽
+    uint32_t z[RECORD_GROUP];
+    *out++ = (uint8_t)x[0];
+    *out++ = (uint8_t)(x[0] >> 8);
+    int prev = x[0];
+    for (uint32_t g = 1; g < n; g += RECORD_GROUP) {
+        uint32_t len = n - g < RECORD_GROUP ? n - g : RECORD_GROUP;
+        uint32_t all = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            int d = x[g + i] - prev;
+            prev = x[g + i];
+            z[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+            all |= z[i];
+        }
+        int width = bitWidth(all);
+        *out++ = (uint8_t)width;
+
+        // 低位在前连续打包, 攒满8位就输出一个字节
+        uint64_t acc = 0;
+        int bits = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            acc |= (uint64_t)z[i] << bits;
+            bits += width;
+            while (bits >= 8) {
+                *out++ = (uint8_t)acc;
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0) {
+            *out++ = (uint8_t)acc;
+        }
+    }
+    return out;
+}
+
+static const uint8_t* decodeChannel(const uint8_t* in, const uint8_t* end, uint16_t* x, uint32_t n) {
+    if (end - in < 2) {
+        return NULL;
+    }
+    int prev = in[0] | (in[1] << 8);
+    in += 2;
+    x[0] = (uint16_t)prev;
+    for (uint32_t g = 1; g < n; g += RECORD_GROUP) {
+        uint32_t len = n - g < RECORD_GROUP ? n - g : RECORD_GROUP;
+        if (in >= end) {
+            return NULL;
+        }
+        int width = *in++;
+        uint32_t bytes = (len * width + 7) / 8;
+        if (width > RECORD_MAX_WIDTH || (uint32_t)(end - in) < bytes) {
+            return NULL;
+        }
+        uint32_t mask = (1u << width) - 1;
+        uint64_t acc = 0;
+        int bits = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            while (bits < width) {
+                acc |= (uint64_t)*in++ << bits;
+                bits += 8;
+            }
+            uint32_t z = (uint32_t)acc & mask;
+            acc >>= width;
+            bits -= width;
+            prev += (int)(z >> 1) ^ -(int)(z & 1);
+            x[g + i] = (uint16_t)prev;
+        }
+    }
+    return in;
+}
+
+static int addIndex(Recorder* r, const RecordChunk* chunk, uint32_t offset) {
+    if (r->header.chunkCount == r->capacity) {
+        uint32_t capacity = r->capacity ? r->capacity * 2 : 64;
+        RecordIndexEntry* index = realloc(r->index, capacity * sizeof(RecordIndexEntry));
+        if (index == NULL) {
+            return -1;
+        }
+        r->index = index;
+        r->capacity = capacity;
+    }
+    RecordIndexEntry* e = &r->index[r->header.chunkCount++];
+    e->firstSample = chunk->firstSample;
+    e->timestamp = chunk->timestamp;
+    e->offset = offset;
+    return 0;
+}
+
+int recordCreate(Recorder* r, const char* path, uint32_t sampleRate) {
+    memset(r, 0, sizeof(*r));
+    r->cachedChunk = -1;
+    r->file = halFileOpen(path, 1);
+    if (r->file == NULL) {
+        return -1;
+    }
+    r->writing = 1;
+    r->header.magic = RECORD_MAGIC;
+    r->header.version = RECORD_VERSION;
+    r->header.channels = MAX_CHANNELS;
+    r->header.chunkSamples = ADC_BUFFER_SIZE;
+    r->header.sampleRate = sampleRate;
+    r->offset = halFileWrite(r->file, &r->header, sizeof(r->header));
+    return r->offset == sizeof(r->header) ? 0 : -1;
+}
+
+int recordAppend(Recorder* r, uint16_t data[][ADC_BUFFER_SIZE], uint32_t count, uint32_t timestamp) {
+    // 压缩后连同块头一次写出, 索引留在内存中, 关闭时写到文件末尾
+    RecordChunk* chunk = (RecordChunk*)r->buffer;
+    uint8_t* out = (uint8_t*)r->buffer + sizeof(RecordChunk);
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        out = encodeChannel(data[i], count, out);
+    }
+    chunk->magic = CHUNK_MAGIC;
+    chunk->size = (uint32_t)(out - (uint8_t*)r->buffer - sizeof(RecordChunk));
+    chunk->firstSample = r->samples;
+    chunk->timestamp = timestamp;
+    chunk->samples = count;
+
+    uint32_t size = (uint32_t)(out - (uint8_t*)r->buffer);
+    if (addIndex(r, chunk, r->offset) != 0 || halFileWrite(r->file, r->buffer, size) != size) {
+        return -1;
+    }
+    r->offset += size;
+    r->samples += count;
+    return 0;
+}
+
+static int rebuildIndex(Recorder* r) {
+    // 录制未正常结束时没有索引, 顺着块头逐块跳过重建
+    uint32_t offset = sizeof(RecordHeader);
+    RecordChunk chunk;
+    r->header.chunkCount = 0;
+    while (halFileSeek(r->file, offset) == 0
+        && halFileRead(r->file, &chunk, sizeof(chunk)) == sizeof(chunk)
+        && chunk.magic == CHUNK_MAGIC && chunk.samples <= ADC_BUFFER_SIZE
+        && chunk.size <= RECORD_CHUNK_BYTES - sizeof(RecordChunk)
+        && chunk.samples > 0 && chunk.firstSample == r->samples) {
+        if (addIndex(r, &chunk, offset) != 0) {
+            return -1;
+        }
+        offset += sizeof(chunk) + chunk.size;
+        r->samples = chunk.firstSample + chunk.samples;
+    }
+    return 0;
+}
+
+static int checkIndex(const Recorder* r) {
+    // 文件中的索引不可信: 起始样本必须从0开始且连续递增(相邻两块相差不超过一块的长度),
+    // 块头必须按顺序位于文件头和索引之间, 否则recordRead会越界或返回错位的数据
+    uint32_t end = r->header.indexOffset;
+    for (uint32_t i = 0; i < r->header.chunkCount; i++) {
+        const RecordIndexEntry* e = &r->index[i];
+        uint64_t first = i > 0 ? r->index[i - 1].firstSample : 0;
+        uint32_t offset = i > 0 ? r->index[i - 1].offset + (uint32_t)sizeof(RecordChunk) : (uint32_t)sizeof(RecordHeader);
+        if (i > 0 ? e->firstSample <= first || e->firstSample - first > r->header.chunkSamples : e->firstSample != 0) {
+            return -1;
+        }
+        if (e->offset < offset || e->offset > end - sizeof(RecordChunk)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int recordOpen(Recorder* r, const char* path) {
+    memset(r, 0, sizeof(*r));
+    r->cachedChunk = -1;
+    r->file = halFileOpen(path, 0);
+    if (r->file == NULL) {
+        return -1;
+    }
+    RecordHeader header;
+    if (halFileRead(r->file, &header, sizeof(header)) != sizeof(header)
+        || header.magic != RECORD_MAGIC || header.version != RECORD_VERSION
+        || header.channels != MAX_CHANNELS || header.chunkSamples > ADC_BUFFER_SIZE) {
+        recordClose(r);
+        return -1;
+    }
+    r->header = header;
+    if (header.indexOffset == 0) {
+        return rebuildIndex(r);
+    }
+
+    // 每块至少有一个块头, 块数不可能超过索引之前能放下的块头数, 这也保证了下面的乘法不溢出
+    if (header.indexOffset < sizeof(RecordHeader) + sizeof(RecordChunk) * (uint64_t)header.chunkCount) {
+        recordClose(r);
+        return -1;
+    }
+    uint32_t size = header.chunkCount * sizeof(RecordIndexEntry);
+    r->index = malloc(size ? size : 1);
+    r->capacity = header.chunkCount;
+    if (r->index == NULL || halFileSeek(r->file, header.indexOffset) != 0
+        || halFileRead(r->file, r->index, size) != size || checkIndex(r) != 0) {
+        recordClose(r);
+        return -1;
+    }
+    if (header.chunkCount > 0) {
+        // 最后一块的长度在块头里
+        RecordChunk chunk;
+        const RecordIndexEntry* last = &r->index[header.chunkCount - 1];
+        if (halFileSeek(r->file, last->offset) != 0 || halFileRead(r->file, &chunk, sizeof(chunk)) != sizeof(chunk)
+            || chunk.magic != CHUNK_MAGIC || chunk.firstSample != last->firstSample
+            || chunk.samples == 0 || chunk.samples > header.chunkSamples) {
+            recordClose(r);
+            return -1;
+        }
+        r->samples = last->firstSample + chunk.samples;
+    }
+    return 0;
+}
+
+static int32_t findChunk(const Recorder* r, uint64_t sample) {
+    // 二分查找起始样本不大于sample的最后一块
+    int32_t lo = 0, hi = (int32_t)r->header.chunkCount - 1;
+    if (hi < 0 || sample < r->index[0].firstSample) {
+        return -1;
+    }
+    while (lo < hi) {
+        int32_t mid = (lo + hi + 1) / 2;
+        if (r->index[mid].firstSample <= sample) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+static uint32_t loadChunk(Recorder* r, int32_t c) {
+    // 定位并解码一块, 返回每通道样本数
+    RecordChunk* chunk = (RecordChunk*)r->buffer;
+    if (r->cachedChunk == c) {
+        return chunk->samples;
+    }
+    r->cachedChunk = -1;
+    if (halFileSeek(r->file, r->index[c].offset) != 0
+        || halFileRead(r->file, chunk, sizeof(RecordChunk)) != sizeof(RecordChunk)
+        || chunk->magic != CHUNK_MAGIC || chunk->samples > ADC_BUFFER_SIZE
+        || chunk->size > RECORD_CHUNK_BYTES - sizeof(RecordChunk)
+        || chunk->firstSample != r->index[c].firstSample) {
+        return 0;
+    }
+    // 块的长度必须正好接上下一块的起始样本, 否则索引与块内容不一致
+    uint64_t next = c + 1 < (int32_t)r->header.chunkCount ? r->index[c + 1].firstSample : r->samples;
+    if (chunk->firstSample + chunk->samples != next) {
+        return 0;
+    }
+    const uint8_t* in = (const uint8_t*)r->buffer + sizeof(RecordChunk);
+    const uint8_t* end = in + chunk->size;
+    if (halFileRead(r->file, (uint8_t*)r->buffer + sizeof(RecordChunk), chunk->size) != chunk->size) {
+        return 0;
+    }
+    for (int i = 0; i < MAX_CHANNELS && in != NULL; i++) {
+        in = decodeChannel(in, end, r->decoded[i], chunk->samples);
+    }
+    if (in == NULL) {
+        return 0;
+    }
+    r->cachedChunk = c;
+    return chunk->samples;
+}
+
+uint32_t recordRead(Recorder* r, uint64_t start, uint32_t count, uint16_t data[][ADC_BUFFER_SIZE]) {
+    // 读取[start, start + count)的样本, 只解码覆盖该区间的块
+    uint32_t done = 0;
+    int32_t c = findChunk(r, start);
+    while (c >= 0 && c < (int32_t)r->header.chunkCount && done < count) {
+        uint32_t samples = loadChunk(r, c);
+        uint64_t first = r->index[c].firstSample;
+        uint64_t from = start + done;
+        if (samples == 0 || from < first || from >= first + samples) {
+            break;
+        }
+        uint32_t skip = (uint32_t)(from - first);
+        uint32_t len = samples - skip < count - done ? samples - skip : count - done;
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            memcpy(data[i] + done, r->decoded[i] + skip, len * sizeof(uint16_t));
+        }
+        done += len;
+        c++;
+    }
+    return done;
+}
+
+uint64_t recordFindTime(const Recorder* r, uint32_t timestamp) {
+    // 按块时间戳二分查找, 返回采集时刻不早于timestamp的第一块的起始样本
+    uint32_t lo = 0, hi = r->header.chunkCount;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if ((int32_t)(r->index[mid].timestamp - timestamp) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < r->header.chunkCount ? r->index[lo].firstSample : r->samples;
+}
+
+void recordClose(Recorder* r) {
+    if (r->file != NULL && r->writing) {
+        // 写出索引, 再回到文件头记下索引位置
+        uint32_t size = r->header.chunkCount * sizeof(RecordIndexEntry);
+        if (halFileWrite(r->file, r->index, size) == size) {
+            r->header.indexOffset = r->offset;
+        }
+        if (halFileSeek(r->file, 0) == 0) {
+            halFileWrite(r->file, &r->header, sizeof(r->header));
+        }
+    }
+    if (r->file != NULL) {
+        halFileClose(r->file);
+        r->file = NULL;
+    }
+    free(r->index);
+    r->index = NULL;
+    r->capacity = 0;
+}
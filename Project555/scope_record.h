@@ -0,0 +1,66 @@
+#ifndef SCOPE_RECORD_H
+#define SCOPE_RECORD_H
+
+#include <stdint.h>
+#include "scope.h"
+#include "scope_hal.h"
+
+// 分块压缩的波形录制文件
+// 每次追加一块(每通道ADC_BUFFER_SIZE个样本), 各通道做一阶差分后按64个样本一组
+// 取该组所需的位宽打包; 每块前有块头, 文件末尾写块索引(起始样本、时间戳、偏移),
+// 读取任意区间时二分查找索引后直接定位到对应块, 不需要从头读取
+// 文件格式: [RecordHeader][RecordChunk + 数据]...[RecordIndexEntry...]
+
+#define RECORD_MAGIC 0x43455253u   // "SREC"
+#define CHUNK_MAGIC 0x4B4E4843u    // "CHNK"
+#define RECORD_VERSION 1
+#define RECORD_GROUP 64            // 每组样本数, 组内共用一个位宽
+#define RECORD_MAX_WIDTH 17        // 16位样本差分后的最大位宽, 12位ADC数据不超过13位
+#define RECORD_CHUNK_BYTES (sizeof(RecordChunk) + MAX_CHANNELS * \
+    (2 + (ADC_BUFFER_SIZE + RECORD_GROUP - 1) / RECORD_GROUP * (1 + RECORD_GROUP * RECORD_MAX_WIDTH / 8)))
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t channels;
+    uint32_t chunkSamples;   // 每块每通道的样本数
+    uint32_t sampleRate;
+    uint32_t indexOffset;    // 索引在文件中的位置, 为0表示录制未正常结束
+    uint32_t chunkCount;
+} RecordHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;           // 块头之后的压缩数据字节数
+    uint64_t firstSample;    // 本块第一个样本的序号
+    uint32_t timestamp;      // 采集时刻(us)
+    uint32_t samples;        // 本块每通道的样本数
+} RecordChunk;
+
+typedef struct {
+    uint64_t firstSample;
+    uint32_t timestamp;
+    uint32_t offset;         // 块头在文件中的位置
+} RecordIndexEntry;
+
+typedef struct {
+    HalFile* file;
+    int writing;
+    RecordHeader header;
+    RecordIndexEntry* index;
+    uint32_t capacity;
+    uint32_t offset;         // 当前写入位置
+    uint64_t samples;        // 每通道样本总数
+    int32_t cachedChunk;     // decoded中缓存的块号, -1表示无
+    uint64_t buffer[(RECORD_CHUNK_BYTES + 7) / 8];  // 块头+压缩数据, 按8字节对齐
+    uint16_t decoded[MAX_CHANNELS][ADC_BUFFER_SIZE];
+} Recorder;
+
+int recordCreate(Recorder* r, const char* path, uint32_t sampleRate);
+int recordAppend(Recorder* r, uint16_t data[][ADC_BUFFER_SIZE], uint32_t count, uint32_t timestamp);
+int recordOpen(Recorder* r, const char* path);
+uint32_t recordRead(Recorder* r, uint64_t start, uint32_t count, uint16_t data[][ADC_BUFFER_SIZE]);
+uint64_t recordFindTime(const Recorder* r, uint32_t timestamp);
+void recordClose(Recorder* r);
+
+#endif
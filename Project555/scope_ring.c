@@ -0,0 +1,69 @@
+#include <string.h>
+#include "scope_ring.h"
+
+void ringInit(AcqRing* ring) {
+    memset(ring, 0, sizeof(*ring));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->overruns, 0);
+    for (int i = 0; i < ACQ_RING_BLOCKS; i++) {
+        ring->slots[i] = &ring->blocks[i];
+    }
+}
+
+int ringFull(AcqRing* ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail >= ACQ_RING_BLOCKS;
+}
+
+AcqBlock* ringProducerSlot(AcqRing* ring) {
+    // 队列满时消费者可能正在读下一个槽位, 只能写入备用块
+    if (ringFull(ring)) {
+        ring->filling = &ring->spare;
+    } else {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        ring->filling = ring->slots[head & (ACQ_RING_BLOCKS - 1)];
+    }
+    return ring->filling;
+}
+
+void ringProducerCommit(AcqRing* ring) {
+    ring->filling->seq = ring->produced++;
+    if (ring->filling == &ring->spare) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        return;
+    }
+    // release保证消费者看到head更新时块数据已经写完
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+const AcqBlock* ringConsumerPeek(AcqRing* ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    return ring->slots[tail & (ACQ_RING_BLOCKS - 1)];
+}
+
+void ringConsumerRelease(AcqRing* ring) {
+    // release保证生产者复用槽位前消费者已经读完
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+AcqBlock* ringConsumerExchange(AcqRing* ring, AcqBlock* empty) {
+    // 调用前ringConsumerPeek已返回非空; 槽位指针在释放tail之前写入,
+    // 生产者看到新的tail时一定也看到新的指针
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    AcqBlock* full = ring->slots[tail & (ACQ_RING_BLOCKS - 1)];
+    ring->slots[tail & (ACQ_RING_BLOCKS - 1)] = empty;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return full;
+}
+
+uint32_t ringOverruns(AcqRing* ring) {
+    return atomic_load_explicit(&ring->overruns, memory_order_relaxed);
+}
@@ -0,0 +1,46 @@
+#ifndef SCOPE_RING_H
+#define SCOPE_RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "scope.h"
+
+// 采集块环形队列: 单生产者(DMA中断/主机采集线程)、单消费者(主循环), 无锁
+// 生产者只写head, 消费者只写tail, 队列满时新块写入备用块并计为溢出
+// 槽位保存块指针, 消费者可以用自己的空块换出已填满的块, 之后该块归消费者所有, 不用复制
+
+#ifndef ACQ_RING_BLOCKS
+#ifdef SCOPE_HOST
+#define ACQ_RING_BLOCKS 4  // 队列块数, 必须是2的幂
+#else
+#define ACQ_RING_BLOCKS 2  // 目标板即DMA双缓冲
+#endif
+#endif
+
+typedef struct {
+    uint32_t seq;        // 块序号, 含被丢弃的块, 不连续说明中间有溢出
+    uint32_t timestamp;  // 采集完成时刻(us)
+    uint16_t data[MAX_CHANNELS][ADC_BUFFER_SIZE];
+} AcqBlock;
+
+typedef struct {
+    AcqBlock blocks[ACQ_RING_BLOCKS];
+    AcqBlock* slots[ACQ_RING_BLOCKS];  // 各槽位当前使用的块
+    AcqBlock spare;       // 队列满时生产者写入的备用块
+    atomic_uint head;     // 已发布的块数(生产者写)
+    atomic_uint tail;     // 已释放的块数(消费者写)
+    atomic_uint overruns; // 因队列满而丢弃的块数
+    uint32_t produced;    // 生产者产生的块数(仅生产者访问)
+    AcqBlock* filling;    // 生产者正在填充的块(仅生产者访问)
+} AcqRing;
+
+void ringInit(AcqRing* ring);
+int ringFull(AcqRing* ring);
+AcqBlock* ringProducerSlot(AcqRing* ring);
+void ringProducerCommit(AcqRing* ring);
+const AcqBlock* ringConsumerPeek(AcqRing* ring);
+void ringConsumerRelease(AcqRing* ring);
+AcqBlock* ringConsumerExchange(AcqRing* ring, AcqBlock* empty);
+uint32_t ringOverruns(AcqRing* ring);
+
+#endif
@@ -0,0 +1,156 @@
+#include <string.h>
+#include "scope_sched.h"
+#include "scope_hal.h"
+
+#define BACKGROUND_PRIORITY 255
+
+static int addTask(Scheduler* s, const char* name, TaskKind kind, void (*run)(void), uint8_t priority) {
+    if (s->count >= SCHED_MAX_TASKS) {
+        return -1;
+    }
+    Task* t = &s->tasks[s->count];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->kind = kind;
+    t->run = run;
+    t->priority = priority;
+    return s->count++;
+}
+
+static int before(uint32_t a, uint32_t b) {
+    // 时刻比较, 允许halMicros回绕
+    return (int32_t)(a - b) < 0;
+}
+
+void schedInit(Scheduler* s) {
+    memset(s, 0, sizeof(*s));
+    s->startTime = halMicros();
+}
+
+int schedAddPeriodic(Scheduler* s, const char* name, void (*run)(void), uint8_t priority,
+    uint32_t period, uint32_t deadline) {
+    int id = addTask(s, name, TASK_PERIODIC, run, priority);
+    if (id >= 0) {
+        s->tasks[id].period = period;
+        s->tasks[id].deadline = deadline;
+        s->tasks[id].nextRelease = halMicros();
+    }
+    return id;
+}
+
+int schedAddEvent(Scheduler* s, const char* name, void (*run)(void), int (*ready)(void), uint8_t priority,
+    uint32_t deadline) {
+    int id = addTask(s, name, TASK_EVENT, run, priority);
+    if (id >= 0) {
+        s->tasks[id].ready = ready;
+        s->tasks[id].deadline = deadline;
+    }
+    return id;
+}
+
+int schedAddBackground(Scheduler* s, const char* name, void (*run)(void)) {
+    return addTask(s, name, TASK_BACKGROUND, run, BACKGROUND_PRIORITY);
+}
+
+void schedSignal(Scheduler* s, int task) {
+    // 可在中断中调用; 上一次释放的作业还没运行时计为一次错过
+    Task* t = &s->tasks[task];
+    if (t->pending) {
+        t->misses++;
+        return;
+    }
+    t->released = halMicros();
+    t->pending = 1;
+}
+
+int schedPending(const Scheduler* s, int task) {
+    return s->tasks[task].pending;
+}
+
+static void release(Scheduler* s, uint32_t now) {
+    for (int i = 0; i < s->count; i++) {
+        Task* t = &s->tasks[i];
+        if (t->kind == TASK_PERIODIC && !before(now, t->nextRelease)) {
+            if (t->pending) {
+                t->misses++;
+            } else {
+                t->pending = 1;
+                t->released = t->nextRelease;
+            }
+            // 落后超过一个周期时不补发, 从现在重新计时
+            t->nextRelease += t->period;
+            if (before(t->nextRelease, now)) {
+                t->nextRelease = now + t->period;
+            }
+        } else if (t->kind == TASK_EVENT && !t->pending && t->ready != NULL && t->ready()) {
+            t->pending = 1;
+            t->released = now;
+        }
+    }
+}
+
+static int slackFor(const Scheduler* s, const Task* bg, uint32_t now) {
+    // 后台任务的最长执行时间不能超过其他任务还能容忍的阻塞时间
+    for (int i = 0; i < s->count; i++) {
+        const Task* t = &s->tasks[i];
+        if (t->kind == TASK_BACKGROUND) {
+            continue;
+        }
+        int32_t budget = (int32_t)(t->deadline - t->maxTime);
+        if (t->kind == TASK_PERIODIC) {
+            budget += (int32_t)(t->nextRelease - now);
+        }
+        if ((int32_t)bg->maxTime > budget) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int schedRunOnce(Scheduler* s) {
+    // 运行一个就绪任务, 没有可运行的任务时返回0
+    uint32_t now = halMicros();
+    release(s, now);
+
+    Task* best = NULL;
+    for (int i = 0; i < s->count; i++) {
+        Task* t = &s->tasks[i];
+        if (t->kind == TASK_BACKGROUND || !t->pending) {
+            continue;
+        }
+        if (best == NULL || t->priority < best->priority
+            || (t->priority == best->priority && before(t->released + t->deadline, best->released + best->deadline))) {
+            best = t;
+        }
+    }
+    if (best == NULL) {
+        // 没有就绪任务: 依次轮转后台任务, 只运行空闲时间足够的一个
+        for (int k = 0; k < s->count && best == NULL; k++) {
+            Task* t = &s->tasks[(s->nextBackground + k) % s->count];
+            if (t->kind == TASK_BACKGROUND && slackFor(s, t, now)) {
+                best = t;
+                s->nextBackground = (int)(t - s->tasks) + 1;
+            }
+        }
+        if (best == NULL) {
+            return 0;
+        }
+        best->released = now;
+    }
+
+    best->pending = 0;
+    uint32_t start = halMicros();
+    best->run();
+    uint32_t end = halMicros();
+    uint32_t elapsed = end - start;
+    best->runs++;
+    best->totalTime += elapsed;
+    s->busyTime += elapsed;
+    if (elapsed > best->maxTime) {
+        best->maxTime = elapsed;
+    }
+    if (best->kind != TASK_BACKGROUND && end - best->released > best->deadline) {
+        best->misses++;
+    }
+    return 1;
+}
@@ -0,0 +1,56 @@
+#ifndef SCOPE_SCHED_H
+#define SCOPE_SCHED_H
+
+#include <stdint.h>
+
+// 协作式优先级调度器: 周期任务按节拍释放, 事件任务由ready回调或schedSignal释放,
+// 每次从就绪任务中选优先级最高(数值最小)者运行, 同优先级取截止时间最早者
+// 任务不可抢占, 因此后台任务只在空闲时间足够时运行: 其最长执行时间不能超过
+// 任何更高优先级任务的剩余容许阻塞时间(截止时间 - 最长执行时间)和到下个周期释放的时间
+// 每个任务统计运行次数、累计/最长执行时间和截止时间错过次数
+
+#define SCHED_MAX_TASKS 12
+
+typedef enum {
+    TASK_PERIODIC,    // 按周期释放
+    TASK_EVENT,       // ready返回非0或被schedSignal时释放
+    TASK_BACKGROUND   // 没有截止时间, 只在空闲时间运行
+} TaskKind;
+
+typedef struct {
+    const char* name;
+    TaskKind kind;
+    void (*run)(void);
+    int (*ready)(void);       // 事件任务的就绪判断, 可为NULL
+    uint8_t priority;         // 0最高
+    uint32_t period;          // 周期(us)
+    uint32_t deadline;        // 相对释放时刻的截止时间(us)
+    uint32_t nextRelease;     // 周期任务下次释放时刻
+    uint32_t released;        // 当前作业的释放时刻
+    volatile int pending;     // 已释放, 等待运行
+    // 统计
+    uint32_t runs;
+    uint32_t misses;          // 完成晚于截止时间, 或上一作业未运行又被释放
+    uint32_t maxTime;         // 最长执行时间(us)
+    uint64_t totalTime;       // 累计执行时间(us)
+} Task;
+
+typedef struct {
+    Task tasks[SCHED_MAX_TASKS];
+    int count;
+    int nextBackground;       // 下次优先考虑的后台任务
+    uint64_t busyTime;        // 任务累计执行时间(us)
+    uint32_t startTime;       // 调度开始时刻
+} Scheduler;
+
+void schedInit(Scheduler* s);
+int schedAddPeriodic(Scheduler* s, const char* name, void (*run)(void), uint8_t priority,
+    uint32_t period, uint32_t deadline);
+int schedAddEvent(Scheduler* s, const char* name, void (*run)(void), int (*ready)(void), uint8_t priority,
+    uint32_t deadline);
+int schedAddBackground(Scheduler* s, const char* name, void (*run)(void));
+void schedSignal(Scheduler* s, int task);
+int schedPending(const Scheduler* s, int task);
+int schedRunOnce(Scheduler* s);
+
+#endif
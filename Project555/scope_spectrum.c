@@ -0,0 +1,242 @@
+#include <string.h>
+#include <math.h>
+#include "scope_spectrum.h"
+
+static const char* const windowNames[] = { "rect", "Hann", "Hamming", "Blackman-Harris", "flat-top" };
+
+static float peakInterpolate(const float32_t* mag, int k, float* offset) {
+    // 对数幅度上三点抛物线插值, 返回峰值幅度, offset为相对第k点的偏移(-0.5..0.5)
+    float a = logf(mag[k - 1] + 1e-12f);
+    float b = logf(mag[k] + 1e-12f);
+    float c = logf(mag[k + 1] + 1e-12f);
+    float d = a - 2 * b + c;
+    float p = d < 0 ? 0.5f * (a - c) / d : 0;
+    *offset = p;
+    return expf(b - 0.25f * (a - c) * p);
+}
+
+static int findPeak(const float32_t* mag, int from, int to) {
+    int best = from;
+    for (int k = from + 1; k <= to; k++) {
+        if (mag[k] > mag[best]) {
+            best = k;
+        }
+    }
+    return best;
+}
+
+static float noiseFloor(const float32_t* mag, int from, int to) {
+    // 频点幅度的中位数: 在最小值和最大值之间二分, 不需要排序用的缓冲区
+    float low = mag[from], high = mag[from];
+    for (int k = from + 1; k <= to; k++) {
+        low = mag[k] < low ? mag[k] : low;
+        high = mag[k] > high ? mag[k] : high;
+    }
+    int half = (to - from + 1) / 2;
+    for (int i = 0; i < 24; i++) {
+        float mid = 0.5f * (low + high);
+        int below = 0;
+        for (int k = from; k <= to; k++) {
+            below += mag[k] <= mid;
+        }
+        if (below > half) {
+            high = mid;
+        } else {
+            low = mid;
+        }
+    }
+    return high;
+}
+
+int spectrumInit(SpectrumAnalyzer* s, SpectrumWindow window) {
+    memset(s, 0, sizeof(*s));
+#ifdef SCOPE_Q15
+    if (arm_rfft_init_q15(&s->rfft, SPECTRUM_FFT, 0, 1) != ARM_MATH_SUCCESS) {
+#else
+    if (arm_rfft_fast_init_f32(&s->rfft, SPECTRUM_FFT) != ARM_MATH_SUCCESS) {
+#endif
+        return -1;
+    }
+    spectrumSetWindow(s, window);
+    return 0;
+}
+
+void spectrumSetWindow(SpectrumAnalyzer* s, SpectrumWindow window) {
+    // 周期型(DFT-even)余弦和窗, 系数取自Harris 1978; 更换窗后重新开始平均
+    static const float terms[][5] = {
+        { 1, 0, 0, 0, 0 },
+        { 0.5f, 0.5f, 0, 0, 0 },
+        { 0.54f, 0.46f, 0, 0, 0 },
+        { 0.35875f, 0.48829f, 0.14128f, 0.01168f, 0 },
+        { 0.21557895f, 0.41663158f, 0.277263158f, 0.083578947f, 0.006947368f },
+    };
+    static const int lobes[] = { 1, 2, 2, 4, 5 };
+    const float* a = terms[window];
+    float sum = 0;
+    for (int i = 0; i < SPECTRUM_FFT; i++) {
+        float x = 2 * PI * i / SPECTRUM_FFT;
+        float w = a[0] - a[1] * cosf(x) + a[2] * cosf(2 * x) - a[3] * cosf(3 * x) + a[4] * cosf(4 * x);
+#ifdef SCOPE_Q15
+        arm_float_to_q15(&w, &s->table[i], 1);
+#else
+        s->table[i] = w;
+#endif
+        sum += w;
+    }
+    s->windowSum = sum;
+    s->window = window;
+    s->lobe = lobes[window];
+    s->scale = (2 / sum) * (2 / sum);
+    spectrumReset(s);
+}
+
+void spectrumReset(SpectrumAnalyzer* s) {
+    s->fill = 0;
+    s->segments = 0;
+    memset(s->accum, 0, sizeof(s->accum));
+    memset(s->magnitude, 0, sizeof(s->magnitude));
+    spectrumResetPeak(s);
+}
+
+void spectrumResetPeak(SpectrumAnalyzer* s) {
+    memset(s->peak, 0, sizeof(s->peak));
+}
+
+#ifdef SCOPE_Q15
+static void segmentPower(SpectrumAnalyzer* s, const uint16_t* x) {
+    // 码值转为Q15后乘窗(四舍五入), arm_rfft_q15的输出为DFT / N, 换算回码值单位:
+    // X = Y * N / 2^ADC_Q15_SHIFT; 功率用32位整数计算, 只在累加时转为浮点
+    const int32_t mid = (ADC_FULL_SCALE + 1) / 2;
+    for (int i = 0; i < SPECTRUM_FFT; i++) {
+        int32_t v = (x[i] - mid) << ADC_Q15_SHIFT;
+        s->work[i] = (q15_t)((v * s->table[i] + (1 << 14)) >> 15);
+    }
+    arm_rfft_q15(&s->rfft, s->work, s->fft);
+    const float32_t unit = (float32_t)SPECTRUM_FFT / (1 << ADC_Q15_SHIFT);
+    for (int k = 1; k < SPECTRUM_BINS; k++) {
+        int32_t re = s->fft[2 * k], im = s->fft[2 * k + 1];
+        uint32_t p = (uint32_t)(re * re) + (uint32_t)(im * im);
+        s->power[k] = p * unit * unit;
+    }
+    // 直流分量补回转换时减去的中点, 且不需要单边谱的2倍
+    float32_t dc = s->fft[0] * unit + mid * s->windowSum;
+    s->power[0] = dc * dc / 4;
+}
+#else
+static void segmentPower(SpectrumAnalyzer* s, const uint16_t* x) {
+    for (int i = 0; i < SPECTRUM_FFT; i++) {
+        s->work[i] = s->table[i] * x[i];
+    }
+    arm_rfft_fast_f32(&s->rfft, s->work, s->fft, 0);
+    // 第0项的实部、虚部分别是直流和奈奎斯特分量, 直流单独计算, 奈奎斯特丢弃
+    float32_t dc = s->fft[0];
+    s->fft[1] = 0;
+    arm_cmplx_mag_squared_f32(s->fft, s->power, SPECTRUM_BINS);
+    s->power[0] = dc * dc / 4;  // 直流分量不需要单边谱的2倍
+}
+#endif
+
+static void processSegment(SpectrumAnalyzer* s) {
+    // 同一段位置上依次处理全部通道, 共用窗函数表和FFT实例
+    for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+        segmentPower(s, s->segment[ch]);
+        float32_t* acc = s->accum[ch];
+        for (int k = 0; k < SPECTRUM_BINS; k++) {
+            acc[k] += s->power[k];
+        }
+    }
+    // 与下一段重叠的部分移到开头
+    for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+        memmove(s->segment[ch], s->segment[ch] + SPECTRUM_HOP, (SPECTRUM_FFT - SPECTRUM_HOP) * sizeof(uint16_t));
+    }
+    s->fill = SPECTRUM_FFT - SPECTRUM_HOP;
+}
+
+static void publishAverage(SpectrumAnalyzer* s) {
+    // 功率谱取平均后开方得到幅度谱, 同时更新峰值保持
+    float32_t k = s->scale / s->segments;
+    for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+        float32_t* acc = s->accum[ch];
+        float32_t* mag = s->magnitude[ch];
+        float32_t* peak = s->peak[ch];
+        for (int i = 0; i < SPECTRUM_BINS; i++) {
+            mag[i] = sqrtf(acc[i] * k);
+            if (mag[i] > peak[i]) {
+                peak[i] = mag[i];
+            }
+            acc[i] = 0;
+        }
+    }
+    s->segments = 0;
+    s->updates++;
+}
+
+int spectrumProcess(SpectrumAnalyzer* s, uint16_t data[][ADC_BUFFER_SIZE], uint32_t count) {
+    // 追加各通道的count个样本, 凑满一段处理一段; 完成一次平均时返回1
+    int updated = 0;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t n = SPECTRUM_FFT - s->fill;
+        if (n > count - done) {
+            n = count - done;
+        }
+        for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+            memcpy(s->segment[ch] + s->fill, data[ch] + done, n * sizeof(uint16_t));
+        }
+        s->fill += n;
+        done += n;
+        if (s->fill == SPECTRUM_FFT) {
+            processSegment(s);
+            if (++s->segments == SPECTRUM_AVERAGES) {
+                publishAverage(s);
+                updated = 1;
+            }
+        }
+    }
+    return updated;
+}
+
+void spectrumHarmonics(const SpectrumAnalyzer* s, int channel, uint32_t sampleRate, Harmonics* h) {
+    // 基波取直流主瓣以外的最大峰, 第n次谐波在n倍基波附近一个主瓣宽度内搜索,
+    // 峰值位置和幅度都用抛物线插值修正扇贝损失
+    // 基波必须是真正的局部极大(不是直流主瓣的下降沿)且高出噪声基底SPECTRUM_PEAK_SNR倍,
+    // 否则(比如基波落在直流主瓣内, 或只有噪声)报告没有基波, fundamental为0
+    const float32_t* mag = s->magnitude[channel];
+    memset(h, 0, sizeof(*h));
+    if (s->updates == 0) {
+        return;
+    }
+    int lobe = s->lobe;
+    int k = findPeak(mag, lobe + 1, SPECTRUM_BINS - 2);
+    if (mag[k] <= mag[k - 1] || mag[k] < mag[k + 1]
+        || mag[k] < SPECTRUM_PEAK_SNR * noiseFloor(mag, lobe + 1, SPECTRUM_BINS - 2)) {
+        return;
+    }
+    float offset;
+    float amp = peakInterpolate(mag, k, &offset);
+    if (amp <= 0) {
+        return;
+    }
+    float bin = k + offset;
+    const float binWidth = (float)sampleRate / SPECTRUM_FFT;
+    h->fundamental = bin * binWidth;
+    h->amplitude[0] = amp;
+    h->count = 1;
+    float distortion = 0;
+    for (int n = 2; n <= SPECTRUM_HARMONICS; n++) {
+        int center = (int)(bin * n + 0.5f);
+        if (center + lobe > SPECTRUM_BINS - 2) {
+            break;
+        }
+        int peak = findPeak(mag, center - lobe, center + lobe);
+        float a = peakInterpolate(mag, peak, &offset);
+        h->amplitude[n - 1] = a;
+        h->count = n;
+        distortion += a * a;
+    }
+    h->thd = 100 * sqrtf(distortion) / amp;
+}
+
+const char* spectrumWindowName(SpectrumWindow window) {
+    return windowNames[window];
+}
@@ -0,0 +1,69 @@
+#ifndef SCOPE_SPECTRUM_H
+#define SCOPE_SPECTRUM_H
+
+#include <stdint.h>
+#include "scope.h"
+
+// 频谱分析: 加窗、50%重叠的Welch平均、峰值保持和谐波测量
+// 窗函数表只在选择窗时计算一次, 所有通道共用一个实数FFT实例;
+// 每凑满一段就依次对全部通道做FFT(批处理), 旋转因子表留在缓存中
+// 幅度已按窗的相干增益校正, 单位为码值峰值
+// 定义SCOPE_Q15时加窗和FFT用Q15定点(arm_rfft_q15), 各频点功率以32位整数求出后再累加
+
+#define SPECTRUM_FFT FFT_SIZE            // 每段长度
+#define SPECTRUM_BINS (SPECTRUM_FFT / 2) // 输出频点数(不含奈奎斯特)
+#define SPECTRUM_HOP (SPECTRUM_FFT / 2)  // 段间步长, 50%重叠
+#define SPECTRUM_AVERAGES 8              // 每次Welch平均的段数
+#define SPECTRUM_HARMONICS 10            // 测量的谐波次数(含基波)
+#define SPECTRUM_PEAK_SNR 10.0f          // 基波幅度至少是各频点幅度中位数(噪声基底)的10倍, 即20dB
+
+typedef enum {
+    WIN_RECT,
+    WIN_HANN,
+    WIN_HAMMING,
+    WIN_BLACKMAN_HARRIS,  // 4项Blackman-Harris, 旁瓣-92dB
+    WIN_FLATTOP           // 平顶窗, 幅度误差最小
+} SpectrumWindow;
+
+typedef struct {
+    SpectrumWindow window;
+    int lobe;                   // 主瓣半宽(频点), 找峰时以此为搜索范围
+    float32_t scale;            // 功率谱归一化系数, (2 / sum(w))^2
+    float32_t windowSum;        // sum(w)
+#ifdef SCOPE_Q15
+    q15_t table[SPECTRUM_FFT];                // 窗函数表
+    arm_rfft_instance_q15 rfft;
+    q15_t work[SPECTRUM_FFT];                 // 加窗后的时域数据
+    q15_t fft[2 * SPECTRUM_FFT];              // FFT输出, 全部复数频点
+#else
+    float32_t table[SPECTRUM_FFT];            // 窗函数表
+    arm_rfft_fast_instance_f32 rfft;
+    float32_t work[SPECTRUM_FFT];             // 加窗后的时域数据
+    float32_t fft[SPECTRUM_FFT];              // FFT输出
+#endif
+    float32_t power[SPECTRUM_BINS];           // 一段的功率谱
+    uint16_t segment[MAX_CHANNELS][SPECTRUM_FFT];  // 正在凑的一段
+    uint32_t fill;              // segment中已有的样本数
+    float32_t accum[MAX_CHANNELS][SPECTRUM_BINS];   // 本轮各段功率谱之和
+    uint32_t segments;          // 本轮已累加的段数
+    float32_t magnitude[MAX_CHANNELS][SPECTRUM_BINS];  // 最近一次Welch平均的幅度谱
+    float32_t peak[MAX_CHANNELS][SPECTRUM_BINS];       // 峰值保持
+    uint32_t updates;           // 已完成的平均次数
+} SpectrumAnalyzer;
+
+typedef struct {
+    float fundamental;                      // 基波频率(Hz), 未找到时为0
+    float amplitude[SPECTRUM_HARMONICS];    // 各次谐波幅度(码值峰值), [0]为基波
+    int count;                              // 奈奎斯特以内的谐波数
+    float thd;                              // 总谐波失真(%)
+} Harmonics;
+
+int spectrumInit(SpectrumAnalyzer* s, SpectrumWindow window);
+void spectrumSetWindow(SpectrumAnalyzer* s, SpectrumWindow window);
+void spectrumReset(SpectrumAnalyzer* s);
+void spectrumResetPeak(SpectrumAnalyzer* s);
+int spectrumProcess(SpectrumAnalyzer* s, uint16_t data[][ADC_BUFFER_SIZE], uint32_t count);
+void spectrumHarmonics(const SpectrumAnalyzer* s, int channel, uint32_t sampleRate, Harmonics* h);
+const char* spectrumWindowName(SpectrumWindow window);
+
+#endif
@@ -0,0 +1,358 @@
+#include <string.h>
+#include "scope_trigger.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRIGGER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRIGGER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TRIGGER_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define BITMAP_WORDS ((ADC_BUFFER_SIZE + 63) / 64)
+
+static uint64_t fireBits[BITMAP_WORDS];  // 位图A: 触发/脉冲有效电平
+static uint64_t armBits[BITMAP_WORDS];   // 位图B: 预备电平/欠幅高阈值
+
+_Static_assert(sizeof(fireBits) + sizeof(armBits) <= TRIG_STATIC_BYTES, "TRIG_STATIC_BYTES does not cover the statics of scope_trigger.c");
+
+static int lowestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+void thresholdBits(const uint16_t* x, int n, int32_t threshold, uint64_t* bits) {
+    // bits第i位 = x[i] > threshold, 输入为12位码值, 按有符号16位比较
+    int words = (n + 63) / 64;
+    if (threshold < 0 || threshold >= 0x7FFF) {
+        memset(bits, threshold < 0 ? 0xFF : 0, words * sizeof(uint64_t));
+        if (threshold < 0 && (n & 63)) {
+            bits[words - 1] = (1ull << (n & 63)) - 1;
+        }
+        return;
+    }
+
+    int i = 0;
+#if defined(TRIGGER_AVX2)
+    const __m256i t = _mm256_set1_epi16((short)threshold);
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 64; k += 32) {
+            __m256i a = _mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i*)(x + i + k)), t);
+            __m256i b = _mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i*)(x + i + k + 16)), t);
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+            word |= (uint64_t)(uint32_t)_mm256_movemask_epi8(packed) << k;
+        }
+        bits[i >> 6] = word;
+    }
+#elif defined(TRIGGER_SSE2)
+    const __m128i t = _mm_set1_epi16((short)threshold);
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 64; k += 16) {
+            __m128i a = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(x + i + k)), t);
+            __m128i b = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(x + i + k + 8)), t);
+            word |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_packs_epi16(a, b)) << k;
+        }
+        bits[i >> 6] = word;
+    }
+#elif defined(TRIGGER_NEON)
+    const uint16x8_t t = vdupq_n_u16((uint16_t)threshold);
+    const uint16x8_t weights = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (int k = 0; k < 64; k += 8) {
+            uint16x8_t cmp = vcgtq_u16(vld1q_u16(x + i + k), t);
+            word |= (uint64_t)vaddvq_u16(vandq_u16(cmp, weights)) << k;
+        }
+        bits[i >> 6] = word;
+    }
+#endif
+    // 剩余样本(或无SIMD的目标板)逐个置位, 不用分支
+    for (; i < n; i += 64) {
+        uint64_t word = 0;
+        int end = n - i < 64 ? n - i : 64;
+        for (int k = 0; k < end; k++) {
+            word |= (uint64_t)(x[i + k] > threshold) << k;
+        }
+        bits[i >> 6] = word;
+    }
+}
+
+static uint64_t validMask(int w, int from, int n) {
+    // 第w个字中位于[from, n)范围内的位
+    uint64_t mask = ~0ull;
+    if (from > w * 64) {
+        mask <<= from - w * 64;
+    }
+    if (n < (w + 1) * 64) {
+        mask &= (1ull << (n - w * 64)) - 1;
+    }
+    return mask;
+}
+
+static void invertBits(uint64_t* bits, int n) {
+    for (int w = 0; w < (n + 63) / 64; w++) {
+        bits[w] = ~bits[w] & validMask(w, 0, n);
+    }
+}
+
+static int scanLevel(TriggerEngine* t, int from, int n) {
+    // armBits为预备区, fireBits为触发区, 两者不相交: 先找预备位, 再找其后的第一个触发位
+    for (int w = from >> 6; w < (n + 63) / 64; w++) {
+        uint64_t mask = validMask(w, from, n);
+        uint64_t arm = armBits[w] & mask;
+        uint64_t fire = fireBits[w] & mask;
+        if (!t->armed) {
+            if (arm == 0) {
+                continue;
+            }
+            fire &= ~0ull << lowestBit(arm);
+            t->armed = 1;
+        }
+        if (fire != 0) {
+            t->armed = 0;
+            return w * 64 + lowestBit(fire);
+        }
+    }
+    return -1;
+}
+
+static int scanPulse(TriggerEngine* t, uint64_t base, int from, int n) {
+    // fireBits为脉冲有效电平, 由相邻位求出起止跳变, 脉冲结束时检查宽度
+    uint64_t carry = t->carry & 1;
+    for (int w = 0; w < (n + 63) / 64; w++) {
+        uint64_t active = fireBits[w];
+        uint64_t prev = (active << 1) | carry;
+        carry = active >> 63;
+        if (w < (from >> 6)) {
+            continue;
+        }
+        uint64_t mask = validMask(w, from, n);
+        uint64_t start = active & ~prev & mask;
+        uint64_t end = ~active & prev & mask;
+        uint64_t events = start | end;
+        while (events != 0) {
+            int p = lowestBit(events);
+            uint64_t at = base + w * 64 + p;
+            events &= events - 1;
+            if ((start >> p) & 1) {
+                t->inPulse = 1;
+                t->eventStart = at;
+            } else if (t->inPulse) {
+                uint64_t width = at - t->eventStart;
+                t->inPulse = 0;
+                if (width >= t->cfg.widthMin && width <= t->cfg.widthMax) {
+                    return w * 64 + p;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+static int scanRunt(TriggerEngine* t, int from, int n) {
+    // fireBits为越过低阈值, armBits为越过高阈值; 越过低阈值后未到高阈值就返回即为欠幅
+    uint64_t carryLow = t->carry & 1;
+    uint64_t carryHigh = (t->carry >> 1) & 1;
+    for (int w = 0; w < (n + 63) / 64; w++) {
+        uint64_t low = fireBits[w];
+        uint64_t high = armBits[w];
+        uint64_t prevLow = (low << 1) | carryLow;
+        uint64_t prevHigh = (high << 1) | carryHigh;
+        carryLow = low >> 63;
+        carryHigh = high >> 63;
+        if (w < (from >> 6)) {
+            continue;
+        }
+        uint64_t mask = validMask(w, from, n);
+        uint64_t enter = low & ~prevLow & mask;
+        uint64_t leave = ~low & prevLow & mask;
+        uint64_t reach = high & ~prevHigh & mask;
+        uint64_t events = enter | leave | reach;
+        while (events != 0) {
+            int p = lowestBit(events);
+            events &= events - 1;
+            if ((enter >> p) & 1) {
+                t->inPulse = 1;
+                t->reachedHigh = 0;
+            }
+            if ((reach >> p) & 1) {
+                t->reachedHigh = 1;
+            }
+            if ((leave >> p) & 1) {
+                int runt = t->inPulse && !t->reachedHigh;
+                t->inPulse = 0;
+                if (runt) {
+                    return w * 64 + p;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+static void buildBitmaps(TriggerEngine* t, const uint16_t* x, int n) {
+    const TriggerConfig* c = &t->cfg;
+    int32_t level = c->level;
+    int32_t hyst = c->type == TRIG_LEVEL ? c->hysteresis : 0;
+    switch (c->type) {
+    case TRIG_EDGE:
+    case TRIG_LEVEL:
+        if (c->rising) {
+            thresholdBits(x, n, level, fireBits);            // x > level
+            thresholdBits(x, n, level - hyst, armBits);      // x <= level - hyst
+            invertBits(armBits, n);
+        } else {
+            thresholdBits(x, n, level - 1, fireBits);        // x < level
+            invertBits(fireBits, n);
+            thresholdBits(x, n, level + hyst - 1, armBits);  // x >= level + hyst
+        }
+        break;
+    case TRIG_PULSE:
+        if (c->rising) {
+            thresholdBits(x, n, level, fireBits);
+        } else {
+            thresholdBits(x, n, level - 1, fireBits);
+            invertBits(fireBits, n);
+        }
+        break;
+    case TRIG_RUNT:
+        if (c->rising) {
+            thresholdBits(x, n, level, fireBits);            // 高于低阈值
+            thresholdBits(x, n, c->levelHigh, armBits);      // 高于高阈值
+        } else {
+            thresholdBits(x, n, c->levelHigh - 1, fireBits); // 低于高阈值
+            invertBits(fireBits, n);
+            thresholdBits(x, n, level - 1, armBits);         // 低于低阈值
+            invertBits(armBits, n);
+        }
+        break;
+    }
+}
+
+static void takeRecord(TriggerEngine* t, uint64_t trig) {
+    // 从循环历史中截取[trig - preTrigger, trig - preTrigger + TRIG_RECORD)
+    uint64_t start = trig - t->cfg.preTrigger;
+    uint32_t pos = (uint32_t)(start & (TRIG_HISTORY - 1));
+    uint32_t first = TRIG_HISTORY - pos < TRIG_RECORD ? TRIG_HISTORY - pos : TRIG_RECORD;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        memcpy(t->record[i], t->history[i] + pos, first * sizeof(uint16_t));
+        memcpy(t->record[i] + first, t->history[i], (TRIG_RECORD - first) * sizeof(uint16_t));
+    }
+    t->recordTrigger = t->cfg.preTrigger;
+    t->recordAt = t->written;
+}
+
+static void restartSearch(TriggerEngine* t, uint64_t from) {
+    t->searchFrom = from > t->cfg.preTrigger ? from : t->cfg.preTrigger;
+    t->pending = TRIG_NONE;
+    t->armed = 0;
+    t->inPulse = 0;
+    t->reachedHigh = 0;
+}
+
+void triggerInit(TriggerEngine* t) {
+    memset(t, 0, sizeof(*t));
+    t->cfg.type = TRIG_EDGE;
+    t->cfg.sweep = TRIG_AUTO;
+    t->cfg.rising = 1;
+    t->cfg.level = ADC_FULL_SCALE / 2;
+    t->cfg.levelHigh = ADC_FULL_SCALE * 3 / 4;
+    t->cfg.hysteresis = ADC_FULL_SCALE / 50;
+    t->cfg.widthMin = 1;
+    t->cfg.widthMax = TRIG_RECORD;
+    t->cfg.preTrigger = TRIG_RECORD / 2;
+    t->cfg.autoTimeout = 4 * TRIG_RECORD;
+    restartSearch(t, 0);
+}
+
+void triggerArm(TriggerEngine* t) {
+    // 重新布防, 单次模式从当前位置开始等待下一次触发
+    t->stopped = 0;
+    t->recordAt = t->written;
+    restartSearch(t, t->written);
+}
+
+int triggerFeed(TriggerEngine* t, uint16_t data[][ADC_BUFFER_SIZE], int count) {
+    if (t->cfg.sweep == TRIG_OFF) {
+        return 0;
+    }
+
+    // 各通道写入循环历史, 回绕时分两段
+    uint64_t blockStart = t->written;
+    uint32_t pos = (uint32_t)(blockStart & (TRIG_HISTORY - 1));
+    uint32_t first = TRIG_HISTORY - pos < (uint32_t)count ? TRIG_HISTORY - pos : (uint32_t)count;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        memcpy(t->history[i] + pos, data[i], first * sizeof(uint16_t));
+        memcpy(t->history[i], data[i] + first, (count - first) * sizeof(uint16_t));
+    }
+    t->written += count;
+    if (t->stopped) {
+        return 0;
+    }
+
+    int ready = 0;
+    buildBitmaps(t, data[t->cfg.source], count);
+    for (;;) {
+        if (t->pending != TRIG_NONE) {
+            uint64_t end = t->pending - t->cfg.preTrigger + TRIG_RECORD;
+            if (t->written < end) {
+                break;  // 等待后触发样本
+            }
+            takeRecord(t, t->pending);
+            ready = 1;
+            restartSearch(t, end + t->cfg.holdoff);
+            if (t->cfg.sweep == TRIG_SINGLE) {
+                t->stopped = 1;
+                break;
+            }
+        }
+        if (t->searchFrom >= t->written) {
+            break;
+        }
+        int from = t->searchFrom > blockStart ? (int)(t->searchFrom - blockStart) : 0;
+        int p;
+        switch (t->cfg.type) {
+        case TRIG_PULSE:
+            p = scanPulse(t, blockStart, from, count);
+            break;
+        case TRIG_RUNT:
+            p = scanRunt(t, from, count);
+            break;
+        default:
+            p = scanLevel(t, from, count);
+            break;
+        }
+        if (p < 0) {
+            break;
+        }
+        t->pending = blockStart + p;
+        t->triggers++;
+    }
+
+    // 保存最后一个样本的位图值, 下一块求跳变时用
+    int last = count - 1;
+    t->carry = ((fireBits[last >> 6] >> (last & 63)) & 1) | (((armBits[last >> 6] >> (last & 63)) & 1) << 1);
+
+    // 自动模式: 超时仍无触发就取最新的一段数据显示
+    if (!ready && t->cfg.sweep == TRIG_AUTO && t->pending == TRIG_NONE
+        && t->written >= TRIG_RECORD && t->written - t->recordAt >= t->cfg.autoTimeout) {
+        takeRecord(t, t->written - TRIG_RECORD + t->cfg.preTrigger);
+        t->forced++;
+        ready = 1;
+    }
+    return ready;
+}
@@ -0,0 +1,74 @@
+#ifndef SCOPE_TRIGGER_H
+#define SCOPE_TRIGGER_H
+
+#include <stdint.h>
+#include "scope.h"
+
+// 触发引擎: 边沿、带迟滞电平、脉宽和欠幅触发
+// 先用SIMD把触发源样本与阈值比较, 压成每样本一位的位图(每字64个样本),
+// 再按字用位运算查找跳变, 没有跳变的字直接跳过, 不做逐样本分支判断
+// 各通道样本写入循环历史缓冲区, 触发后截取触发点前后的数据形成一条记录
+
+#define TRIG_RECORD ADC_BUFFER_SIZE         // 每条记录的样本数
+#ifdef SCOPE_HOST
+#define TRIG_HISTORY (4 * ADC_BUFFER_SIZE)  // 循环历史缓冲区长度, 必须是2的幂
+#else
+#define TRIG_HISTORY (2 * ADC_BUFFER_SIZE)  // 目标板只保留最少的一条记录加一块
+#endif
+#define TRIG_NONE UINT64_MAX
+#define TRIG_STATIC_BYTES (2 * ((ADC_BUFFER_SIZE + 63) / 64) * sizeof(uint64_t))  // 两张电平位图
+
+typedef enum {
+    TRIG_OFF,     // 不触发, 连续显示
+    TRIG_AUTO,    // 超时无触发时强制采集
+    TRIG_NORMAL,  // 只在触发时采集
+    TRIG_SINGLE   // 触发一次后停止
+} TriggerSweep;
+
+typedef enum {
+    TRIG_EDGE,   // 边沿
+    TRIG_LEVEL,  // 带迟滞的电平穿越
+    TRIG_PULSE,  // 脉宽在范围内的脉冲结束时触发
+    TRIG_RUNT    // 越过低阈值但未达到高阈值就返回的欠幅脉冲
+} TriggerType;
+
+typedef struct {
+    TriggerType type;
+    TriggerSweep sweep;
+    int source;              // 触发源通道
+    int rising;              // 1: 上升沿/正脉冲, 0: 下降沿/负脉冲
+    uint16_t level;          // 触发电平(码值), 欠幅触发时为低阈值
+    uint16_t levelHigh;      // 欠幅触发的高阈值
+    uint16_t hysteresis;     // 迟滞(码值), 仅TRIG_LEVEL使用
+    uint32_t widthMin;       // 脉宽下限(样本), 仅TRIG_PULSE使用
+    uint32_t widthMax;       // 脉宽上限(样本)
+    uint32_t preTrigger;     // 记录中触发点之前的样本数
+    uint32_t holdoff;        // 一条记录结束后到下次触发的最小间隔(样本)
+    uint32_t autoTimeout;    // 自动模式下无触发时强制采集的等待样本数
+} TriggerConfig;
+
+typedef struct {
+    TriggerConfig cfg;
+    uint16_t history[MAX_CHANNELS][TRIG_HISTORY];
+    uint16_t record[MAX_CHANNELS][TRIG_RECORD];
+    uint64_t written;       // 已写入历史缓冲区的样本数
+    uint64_t searchFrom;    // 下次搜索触发的起点
+    uint64_t pending;       // 已触发、等待后触发样本的触发点
+    uint64_t recordAt;      // 最近一条记录完成时的written
+    uint64_t eventStart;    // 当前脉冲的起点
+    int armed;              // 迟滞状态: 已越过预备电平
+    int inPulse;            // 脉宽/欠幅状态: 正处于脉冲中
+    int reachedHigh;        // 欠幅状态: 脉冲已达到高阈值
+    uint64_t carry;         // 上一块最后一个样本的位图值(位0: A, 位1: B)
+    int stopped;            // 单次模式已完成
+    uint32_t triggers;      // 触发次数
+    uint32_t forced;        // 自动模式强制采集次数
+    uint32_t recordTrigger; // 触发点在记录中的位置
+} TriggerEngine;
+
+void triggerInit(TriggerEngine* t);
+void triggerArm(TriggerEngine* t);
+int triggerFeed(TriggerEngine* t, uint16_t data[][ADC_BUFFER_SIZE], int count);
+void thresholdBits(const uint16_t* x, int n, int32_t threshold, uint64_t* bits);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stddef.h>
+#include <string.h>
+#include "scope_usb.h"
+#include "scope_hal.h"
+
+static uint32_t crcTable[256];
+
+_Static_assert(sizeof(crcTable) <= USB_STATIC_BYTES, "USB_STATIC_BYTES does not cover the statics of scope_usb.c");
+
+static void crcInit(void) {
+    // 反射多项式0xEDB88320, 与zlib的crc32一致
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crcTable[i] = c;
+    }
+}
+
+uint32_t usbCrc32(uint32_t crc, const void* data, uint32_t size) {
+    const uint8_t* p = data;
+    crc = ~crc;
+    while (size--) {
+        crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void usbStreamInit(UsbStream* s) {
+    memset(s, 0, sizeof(*s));
+    atomic_init(&s->busy, 0);
+    crcInit();
+}
+
+static uint32_t packetLength(uint32_t index) {
+    // 块中第index包的负载长度, 只有最后一包不满
+    uint32_t offset = index * USB_PACKET_PAYLOAD;
+    return USB_BLOCK_BYTES - offset < USB_PACKET_PAYLOAD ? USB_BLOCK_BYTES - offset : USB_PACKET_PAYLOAD;
+}
+
+static void sendNext(UsbStream* s) {
+    // 状态在调用halUsbTransmit之前更新, 发送完成中断可能在返回前就到来
+    const uint8_t* data = (const uint8_t*)s->block->data;
+    uint32_t offset = s->index * USB_PACKET_PAYLOAD;
+    uint32_t length = packetLength(s->index);
+    uint32_t first = length < USB_HEAD_PAYLOAD ? length : USB_HEAD_PAYLOAD;
+
+    if (s->tail) {
+        s->tail = 0;
+        s->index++;
+        halUsbTransmit(data + offset + first, length - first);
+        return;
+    }
+
+    UsbPacket packet;
+    packet.magic = USB_MAGIC;
+    packet.length = (uint16_t)length;
+    packet.seq = s->seq++;
+    packet.block = s->block->seq;
+    packet.index = (uint16_t)s->index;
+    packet.count = USB_BLOCK_PACKETS;
+    packet.crc = usbCrc32(usbCrc32(0, &packet, offsetof(UsbPacket, crc)), data + offset, length);
+    memcpy(s->head, &packet, sizeof(packet));
+    memcpy(s->head + sizeof(packet), data + offset, first);
+    s->tail = length > first;
+    if (!s->tail) {
+        s->index++;
+    }
+    halUsbTransmit(s->head, sizeof(packet) + first);
+}
+
+int usbStreamOffer(UsbStream* s, AcqBlock* block) {
+    // 上一块还没发完就不接收, 由接收端根据块序号发现跳过的块
+    if (atomic_load(&s->busy)) {
+        return 0;
+    }
+    s->block = block;
+    s->index = 0;
+    s->tail = 0;
+    atomic_store(&s->busy, 1);
+    sendNext(s);
+    return 1;
+}
+
+int usbStreamHolds(UsbStream* s, const AcqBlock* block) {
+    return atomic_load(&s->busy) && s->block == block;
+}
+
+void usbStreamTxDone(UsbStream* s) {
+    // 在USB发送完成中断中调用, 接着发下一段, 整块发完后交还
+    if (!atomic_load(&s->busy)) {
+        return;
+    }
+    if (s->index >= USB_BLOCK_PACKETS) {
+        s->blocksSent++;
+        atomic_store(&s->busy, 0);
+        return;
+    }
+    sendNext(s);
+}
+
+void usbReceiverInit(UsbReceiver* r) {
+    memset(r, 0, sizeof(*r));
+    crcInit();
+}
+
+static void resync(UsbReceiver* r) {
+    // 丢掉第一个字节, 从下一个可能的魔数处重新开始
+    uint32_t i = 1;
+    while (i < r->filled && !(r->packet[i] == (USB_MAGIC & 0xFF)
+        && (i + 1 == r->filled || r->packet[i + 1] == (USB_MAGIC >> 8)))) {
+        i++;
+    }
+    memmove(r->packet, r->packet + i, r->filled - i);
+    r->filled -= i;
+    r->discarded += i;
+}
+
+static int acceptPacket(UsbReceiver* r, const UsbPacket* h) {
+    // 包序号不连续说明中间丢了包(含CRC错误的包), 换块时未收齐的块丢弃
+    if (r->synced && h->seq != r->nextSeq) {
+        r->lostPackets += h->seq - r->nextSeq;
+    }
+    r->nextSeq = h->seq + 1;
+    r->synced = 1;
+    r->packets++;
+    if (h->block != r->block) {
+        if (r->received != 0) {
+            r->incomplete++;
+        }
+        r->block = h->block;
+        r->received = 0;
+    }
+    memcpy(r->data + h->index * USB_PACKET_PAYLOAD, r->packet + sizeof(UsbPacket), h->length);
+    r->received |= 1u << h->index;
+    if (r->received == (1u << h->count) - 1) {
+        r->blocks++;
+        r->received = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int usbReceive(UsbReceiver* r, const uint8_t* data, uint32_t size) {
+    // 返回本次收齐的块数, 最新的完整块在r->data中
+    int completed = 0;
+    for (;;) {
+        uint32_t need = sizeof(UsbPacket);
+        if (r->filled >= sizeof(UsbPacket)) {
+            UsbPacket h;
+            memcpy(&h, r->packet, sizeof(h));
+            // CRC只能发现传输错误, 格式正确但长度与位置不符的包同样要拒绝, 否则负载会写出r->data
+            if (h.magic != USB_MAGIC || h.count != USB_BLOCK_PACKETS || h.index >= h.count
+                || h.length != packetLength(h.index)) {
+                resync(r);
+                continue;
+            }
+            need += h.length;
+            if (r->filled >= need) {
+                uint32_t crc = usbCrc32(usbCrc32(0, &h, offsetof(UsbPacket, crc)), r->packet + sizeof(h), h.length);
+                if (crc != h.crc) {
+                    r->crcErrors++;
+                    resync(r);
+                    continue;
+                }
+                completed += acceptPacket(r, &h);
+                r->filled = 0;
+                continue;
+            }
+        }
+        if (size == 0) {
+            break;
+        }
+        uint32_t len = need - r->filled < size ? need - r->filled : size;
+        memcpy(r->packet + r->filled, data, len);
+        r->filled += len;
+        data += len;
+        size -= len;
+    }
+    return completed;
+}
@@ -0,0 +1,68 @@
+#ifndef SCOPE_USB_H
+#define SCOPE_USB_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "scope.h"
+#include "scope_ring.h"
+
+// USB CDC流式传输: 采集块按包发送, 每包带序号和CRC32
+// 每包正好占满整数个端点包: 包头和负载开头凑成第一个端点包(只复制这一小段),
+// 其余负载直接从采集块中原地发送; 发送期间块归USB所有, 发送完成后交还
+// 接收端按魔数和CRC重新同步, 根据包序号发现丢包, 不完整的块丢弃
+
+#define USB_MAGIC 0xA55A
+#define USB_EP_SIZE 64           // 全速批量端点最大包长
+#define USB_PACKET_BYTES 1024    // 每包16个端点包
+#define USB_BLOCK_BYTES (MAX_CHANNELS * ADC_BUFFER_SIZE * sizeof(uint16_t))
+
+typedef struct {
+    uint16_t magic;
+    uint16_t length;   // 负载字节数
+    uint32_t seq;      // 包序号, 连续递增
+    uint32_t block;    // 采集块序号
+    uint16_t index;    // 包在块中的序号
+    uint16_t count;    // 本块的包数
+    uint32_t crc;      // 包头前16字节和负载的CRC32
+} UsbPacket;
+
+#define USB_HEAD_PAYLOAD (USB_EP_SIZE - sizeof(UsbPacket))
+#define USB_PACKET_PAYLOAD (USB_PACKET_BYTES - sizeof(UsbPacket))
+#define USB_BLOCK_PACKETS ((USB_BLOCK_BYTES + USB_PACKET_PAYLOAD - 1) / USB_PACKET_PAYLOAD)
+#define USB_STATIC_BYTES (256 * sizeof(uint32_t))  // CRC表
+
+typedef struct {
+    atomic_int busy;        // 正在发送block, 由发送完成中断清除
+    AcqBlock* block;
+    uint32_t index;         // 当前包在块中的序号
+    int tail;               // 当前包的第一个端点包已发出, 下一步发其余负载
+    uint32_t seq;
+    uint8_t head[USB_EP_SIZE];
+    uint32_t blocksSent;
+} UsbStream;
+
+typedef struct {
+    uint8_t packet[USB_PACKET_BYTES];
+    uint32_t filled;
+    uint32_t nextSeq;
+    int synced;
+    uint32_t block;         // 正在拼接的块序号
+    uint32_t received;      // 已收到的包位图
+    uint8_t data[USB_BLOCK_BYTES];
+    uint32_t packets;
+    uint32_t blocks;        // 完整收到的块数
+    uint32_t lostPackets;
+    uint32_t crcErrors;
+    uint32_t incomplete;    // 因丢包而丢弃的块数
+    uint64_t discarded;     // 重新同步时丢弃的字节数
+} UsbReceiver;
+
+uint32_t usbCrc32(uint32_t crc, const void* data, uint32_t size);
+void usbStreamInit(UsbStream* s);
+int usbStreamOffer(UsbStream* s, AcqBlock* block);
+int usbStreamHolds(UsbStream* s, const AcqBlock* block);
+void usbStreamTxDone(UsbStream* s);
+void usbReceiverInit(UsbReceiver* r);
+int usbReceive(UsbReceiver* r, const uint8_t* data, uint32_t size);
+
+#endif
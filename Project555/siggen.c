@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scope.h"
+#include "siggen.h"
+
+static float sigRandom(SigChannel* ch) {
+    // xorshift32, 返回[-1, 1)的均匀分布
+    uint32_t x = ch->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ch->seed = x;
+    return (float)(int32_t)x * (1.0f / 2147483648.0f);
+}
+
+static float sigGaussian(SigChannel* ch) {
+    // 四个均匀分布之和近似高斯分布, 方差归一到1
+    float sum = sigRandom(ch) + sigRandom(ch) + sigRandom(ch) + sigRandom(ch);
+    return sum * 0.8660254f;
+}
+
+static int protocolLevel(const SigChannel* ch) {
+    // 协议信号当前样本的逻辑电平, 由位序号和位内相位决定
+    uint32_t s, frame;
+    int bit;
+    switch (ch->type) {
+    case SIG_UART:
+        s = ch->slot % 12;
+        frame = ch->slot / 12;
+        return s == 0 ? 0 : s <= 8 ? (int)(frame >> (s - 1)) & 1 : 1;
+    case SIG_SPI_CLK:
+        return ch->slot % 10 < 8 && ch->phase >= 0.5;
+    case SIG_SPI_DATA:
+        s = ch->slot % 10;
+        frame = ch->slot / 10;
+        return s < 8 ? (int)(frame >> (7 - s)) & 1 : 0;
+    default:
+        break;
+    }
+    // I2C: 空闲2位, 起始, 8位地址, 应答, 8位数据, 应答, 停止, 共22位
+    s = ch->slot % 22;
+    frame = ch->slot / 22;
+    if (s < 2) {
+        return 1;
+    }
+    if (s == 2) {
+        return ch->type == SIG_I2C_SCL || ch->phase < 0.5;
+    }
+    if (s == 21) {
+        return ch->type == SIG_I2C_SCL ? ch->phase >= 0.25 : ch->phase >= 0.5;
+    }
+    if (ch->type == SIG_I2C_SCL) {
+        return ch->phase >= 0.5;
+    }
+    bit = s - 3;
+    if (bit < 8) {
+        return (0xA0 >> (7 - bit)) & 1;
+    }
+    if (bit > 8 && bit < 17) {
+        return (int)(frame >> (16 - bit)) & 1;
+    }
+    return 0;  // 应答
+}
+
+void sigInit(SigChannel* ch, SigType type, float freq, float amplitude) {
+    memset(ch, 0, sizeof(*ch));
+    ch->type = type;
+    ch->freq = freq;
+    ch->freqEnd = freq * 10.0f;
+    ch->sweepTime = 1.0f;
+    ch->amplitude = amplitude;
+    ch->offset = ADC_VREF / 2;
+    ch->duty = 0.5f;
+    ch->seed = 0x9E3779B9u ^ (uint32_t)(freq * 1000.0f + 1.0f);
+}
+
+int sigParse(SigChannel* ch, const char* spec) {
+    // 格式: 类型[:频率[:幅度[:噪声]]], 如 "sine:50:1.0:0.01"
+    static const char* names[] = { "sine", "square", "noise", "chirp", "uart", "spiclk", "spidata", "i2cscl", "i2csda" };
+    char buffer[64];
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = 0;
+
+    char* field = strtok(buffer, ":");
+    int type = -1;
+    for (int i = 0; field != NULL && i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(field, names[i]) == 0) {
+            type = i;
+        }
+    }
+    if (type < 0) {
+        return -1;
+    }
+
+    float values[3] = { 50.0f, 1.0f, 0.0f };
+    for (int i = 0; i < 3 && (field = strtok(NULL, ":")) != NULL; i++) {
+        values[i] = strtof(field, NULL);
+    }
+    sigInit(ch, (SigType)type, values[0], values[1]);
+    ch->noise = values[2];
+    return 0;
+}
+
+void sigGenerate(SigChannel* ch, uint32_t sampleRate, uint16_t* out, int count) {
+    const double dt = 1.0 / sampleRate;
+    const float scale = ADC_FULL_SCALE / ADC_VREF;
+
+    for (int i = 0; i < count; i++) {
+        float v;
+        switch (ch->type) {
+        case SIG_SINE:
+            v = ch->amplitude * sinf((float)(2 * M_PI * ch->phase));
+            break;
+        case SIG_SQUARE:
+            v = ch->phase < ch->duty ? ch->amplitude : -ch->amplitude;
+            break;
+        case SIG_NOISE:
+            v = ch->amplitude * sigGaussian(ch);
+            break;
+        case SIG_UART:
+        case SIG_SPI_CLK:
+        case SIG_SPI_DATA:
+        case SIG_I2C_SCL:
+        case SIG_I2C_SDA:
+            v = protocolLevel(ch) ? ch->amplitude : -ch->amplitude;
+            break;
+        default:
+            v = ch->amplitude * sinf((float)(2 * M_PI * ch->phase));
+            break;
+        }
+        if (ch->noise > 0) {
+            v += ch->noise * sigGaussian(ch);
+        }
+
+        float code = (v + ch->offset) * scale + 0.5f;
+        if (code < 0) {
+            code = 0;
+        }
+        if (code > ADC_FULL_SCALE) {
+            code = ADC_FULL_SCALE;
+        }
+        out[i] = (uint16_t)code;
+
+        // 推进相位, 扫频时瞬时频率随时间线性变化
+        double freq = ch->freq;
+        if (ch->type == SIG_CHIRP) {
+            freq += (ch->freqEnd - ch->freq) * ch->elapsed / ch->sweepTime;
+            ch->elapsed += dt;
+            if (ch->elapsed >= ch->sweepTime) {
+                ch->elapsed = 0;
+            }
+        }
+        ch->phase += freq * dt;
+        ch->slot += (uint32_t)ch->phase;
+        ch->phase -= floor(ch->phase);
+    }
+}
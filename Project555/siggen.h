@@ -0,0 +1,40 @@
+#ifndef SIGGEN_H
+#define SIGGEN_H
+
+#include <stdint.h>
+
+// 合成信号发生器: 主机构建时代替ADC产生多通道测试信号
+
+typedef enum {
+    SIG_SINE,    // 正弦波
+    SIG_SQUARE,  // 方波
+    SIG_NOISE,   // 白噪声
+    SIG_CHIRP,   // 线性扫频
+    // 数字协议测试信号, 频率为位速率, 数据字节依次递增; 同一协议的各路信号用相同位速率即可对齐
+    SIG_UART,      // UART 8N1, 每帧后空闲2位
+    SIG_SPI_CLK,   // SPI模式0时钟, 每字8位后空闲2位
+    SIG_SPI_DATA,  // SPI数据, 高位在前
+    SIG_I2C_SCL,   // I2C写事务: 起始, 地址0x50, 一个数据字节, 停止
+    SIG_I2C_SDA
+} SigType;
+
+typedef struct {
+    SigType type;
+    float freq;       // 频率(Hz), 扫频时为起始频率
+    float freqEnd;    // 扫频终止频率(Hz)
+    float sweepTime;  // 扫频周期(s)
+    float amplitude;  // 峰值幅度(V)
+    float offset;     // 直流偏置(V)
+    float noise;      // 叠加噪声的均方根(V)
+    float duty;       // 方波占空比
+    double phase;     // 当前相位(周期, 0~1)
+    double elapsed;   // 扫频已运行时间(s)
+    uint32_t seed;    // 噪声随机数状态
+    uint32_t slot;    // 协议信号已经过的位数
+} SigChannel;
+
+void sigInit(SigChannel* ch, SigType type, float freq, float amplitude);
+int sigParse(SigChannel* ch, const char* spec);
+void sigGenerate(SigChannel* ch, uint32_t sampleRate, uint16_t* out, int count);
+
+#endif
@@ -1,235 +1,960 @@
 #include <stdio.h>
 #include <stdint.h>
-#include <stm32f4xx.h>
-#include <arm_math.h>  // źŴ㷨
-#include <ff.h>        // FatFSļϵͳ
-#include <lwip/api.h>  // LwIPЭջ
-#include <usbd_cdc_if.h>  // USB CDC
+#include <string.h>
+#include <math.h>
+#include "scope.h"
+#include "scope_hal.h"  // 硬件抽象层(采集、显示、存储、通信)
+#include "scope_fir.h"  // 流式FIR滤波器
+#include "scope_ring.h"  // 采集块无锁队列
+#include "scope_pyramid.h"  // 深存储与最小/最大值金字塔
+#include "scope_measure.h"  // 单遍融合测量
+#include "scope_trigger.h"  // 触发引擎
+#include "scope_record.h"  // 压缩波形录制
+#include "scope_net.h"  // 网络流式服务
+#include "scope_usb.h"  // USB分包流式传输
+#include "scope_decim.h"  // CIC + 多相FIR抽取链
+#include "scope_spectrum.h"  // Welch平均频谱与谐波测量
+#include "scope_logic.h"  // 位流协议解码
+#include "scope_sched.h"  // 协作式优先级调度器
+#include "scope_math.h"  // 惰性求值的数学通道
+#include "scope_persist.h"  // 余辉(亮度分级)显示
 
-#define ADC_SAMPLE_RATE 1000  // 1kHz
-#define ADC_BUFFER_SIZE 2048  // С
-#define FFT_SIZE 2048         // FFT
-#define MAX_CHANNELS 4        // ͨ
+#ifndef FIR_TAPS
+#define FIR_TAPS 32           // FIR滤波器阶数
+#endif
+#define FIR_CUTOFF 0.1f       // 归一化截止频率(相对采样率)
+#define SPECTRUM_HEIGHT 60    // 频谱图高度(像素)
+#define DISPLAY_PERIOD_US 20000   // 屏幕刷新周期, 与采集速率无关
+#define INPUT_DEADLINE_US 50000   // 按键响应的截止时间
+#define RECORD_DEADLINE_US 100000 // SD卡写入一块的截止时间
+#ifndef LOGIC_PROTOCOL
+#define LOGIC_PROTOCOL LOGIC_UART  // 逻辑分析解码的协议
+#endif
+#ifndef LOGIC_BITRATE
+#define LOGIC_BITRATE 9600         // UART波特率
+#endif
+#define MATH_TRACES 4              // 预先定义的数学通道数
+#ifndef MATH_VISIBLE
+#define MATH_VISIBLE 0             // 显示的数学通道(位掩码): 1 Ch1+Ch2, 2 Ch1-Ch2, 4 Ch1*Ch2, 8 FFT(Ch1*Ch2)
+#endif
+#ifndef PERSIST_DECAY
+#define PERSIST_DECAY -1           // 余辉显示: -1关闭, 0无限余辉, n为每次刷新衰减1/2^n
+#endif
+#ifndef SPECTRUM_WINDOW
+#define SPECTRUM_WINDOW WIN_BLACKMAN_HARRIS  // 频谱分析窗函数
+#endif
 
-uint16_t adcBuffer[MAX_CHANNELS][ADC_BUFFER_SIZE];  // ADCݻ
-uint16_t displayBuffer[MAX_CHANNELS][ADC_BUFFER_SIZE];  // ʾ
-float32_t fftBuffer[MAX_CHANNELS][FFT_SIZE];  // FFT㻺
+AcqRing acqRing;  // 采集与处理之间的块队列
+AcqBlock blockPool[2];  // 与队列交换的块: 一块正在处理, 另一块空闲或正由USB发送
+AcqBlock* currentBlock = &blockPool[0];  // 正在处理的块
+AcqBlock* otherBlock = &blockPool[1];
+uint16_t (*adcBuffer)[ADC_BUFFER_SIZE] = blockPool[0].data;  // ADC采样数据, 指向currentBlock
+UsbStream usbStream;  // USB发送状态
+uint32_t blockSeq = 0;  // 当前adcBuffer对应的块序号
+uint32_t blockTime = 0;  // 当前adcBuffer的采集时刻(us)
+uint32_t decimation = 1;  // 时基对应的总抽取倍数
+DecimChain decimators[MAX_CHANNELS];  // 各通道的抽取链, 状态跨数据块保留
+uint16_t decimBuffer[2][MAX_CHANNELS][ADC_BUFFER_SIZE];  // 抽取后的样本: 一份正在攒, 另一份是交给后级的上一帧
+int decimSide = 0;  // 正在攒的一份
+uint32_t decimFill = 0;  // 正在攒的一份中已有的样本数
+SCOPE_CCM DeepCapture deepCapture[MAX_CHANNELS];  // 各通道的深存储
+SCOPE_CCM MinMax screenColumns[LCD_WIDTH];  // 每列的最小/最大值
+Measurement measurements[MAX_CHANNELS];  // 各通道最新的测量结果
+TriggerEngine triggerEngine;  // 触发引擎及触发前后记录
+uint32_t viewSpan = ADC_BUFFER_SIZE;  // 屏幕显示的样本数(缩放)
+uint64_t viewOffset = 0;  // 显示窗口末端距最新样本的距离(平移)
+SCOPE_CCM uint16_t displayBuffer[MAX_CHANNELS][ADC_BUFFER_SIZE];  // 显示缓冲区
+SCOPE_CCM SpectrumAnalyzer spectrum;  // 各通道的平均频谱和峰值保持
+Harmonics harmonics;  // 所选通道的谐波测量结果
+int selectedChannel = 0;  // 谐波测量的通道
+SCOPE_CCM LogicAnalyzer logic;  // 显示范围内的协议解码结果
+SCOPE_CCM MathChannels mathChannels;  // 数学通道表达式图
+SCOPE_CCM Persistence persistence;  // 余辉直方图, PERSIST_DECAY >= 0时使用
+int mathTraces[MATH_TRACES];  // 可显示的数学通道节点, 与MATH_VISIBLE的各位对应
+float32_t FIR_COEFFS[FIR_TAPS];  // FIR滤波器系数
+#ifdef SCOPE_Q15
+q15_t sampleBuffer[ADC_BUFFER_SIZE];  // Q15采样工作缓冲区
+q15_t filterBuffer[ADC_BUFFER_SIZE];  // 滤波输出工作缓冲区
+FirFilterQ15 channelFilters[MAX_CHANNELS];  // 各通道的Q15 FIR滤波器, 状态跨数据块保留
+#ifdef SCOPE_HOST
+FirFilter referenceFilters[MAX_CHANNELS];  // 主机上同时运行的浮点滤波器, 用于校验定点结果
+float32_t referenceIn[ADC_BUFFER_SIZE], referenceOut[ADC_BUFFER_SIZE];
+double q15MaxError = 0, q15ErrorPower = 0, q15SignalPower = 0;  // 定点与浮点输出之差(码值)
+#endif
+#else
+float32_t sampleBuffer[ADC_BUFFER_SIZE];  // 浮点采样工作缓冲区
+float32_t filterBuffer[ADC_BUFFER_SIZE];  // 滤波输出工作缓冲区
+FirFilter channelFilters[MAX_CHANNELS];  // 各通道的FIR滤波器, 状态跨数据块保留
+#endif
+
+int saveWaveformFlag = 0;  // 请求保存波形, 置位期间连续录制
+int loadWaveformFlag = 0;  // 请求加载波形
+Recorder recorder;  // 波形录制或回放的文件, 两者不同时进行, 共用一份缓冲区
+int recording = 0;  // recorder正在写入
+int playerOpen = 0;  // recorder已打开用于回放
+uint64_t recordedSamples = 0;  // 最近一次录制的每通道样本数
+uint32_t recordedBytes = 0;  // 最近一次录制的文件大小
+uint64_t loadPosition = 0;  // 下一次加载的起始样本
+uint16_t playBuffer[MAX_CHANNELS][ADC_BUFFER_SIZE];  // 回放数据, 不能解码到可能仍由USB发送的采集块中
+
+Scheduler scheduler;  // 任务调度器
+int usbTask, inputTask, netTask, recordTask;  // 每帧由采集任务释放的事件任务
+
+uint64_t processTime = 0;  // processSignal累计耗时(us)
+uint64_t displayTime = 0;  // 屏幕刷新累计耗时(us)
+uint32_t frameCount = 0;   // 已处理帧数
+uint32_t displayCount = 0; // 屏幕刷新次数
+uint64_t inputBlocks = 0;  // 已消耗的采集块数
+uint64_t cicTime = 0, cicSamples = 0;  // CIC级累计耗时(us)和输入样本数
+uint64_t decimFirTime = 0, decimFirSamples = 0;  // 补偿FIR级累计耗时(us)和输入样本数
+uint64_t logicTime = 0, logicSamples = 0;  // 协议解码累计耗时(us)和样本数
+uint64_t mathTime = 0;  // 数学通道求值和绘制累计耗时(us)
+uint64_t persistTime = 0;  // 波形折叠进余辉直方图的累计耗时(us)
+
+#ifndef SCOPE_HOST
+// 目标板的全部静态数据按区域检查(预算见scope.h): CCM中是只由CPU访问的对象,
+// 其余在SRAM中, 包括其他模块和HAL内部的静态数据; 上面的标量合计不到512字节
+_Static_assert(sizeof(deepCapture) + sizeof(screenColumns) + sizeof(displayBuffer) + sizeof(spectrum)
+    + sizeof(logic) + sizeof(mathChannels) + sizeof(persistence) <= SCOPE_CCM_BUDGET,
+    "target CCM data exceeds SCOPE_CCM_BUDGET");
+_Static_assert(sizeof(acqRing) + sizeof(blockPool) + sizeof(usbStream) + sizeof(decimators) + sizeof(decimBuffer)
+    + sizeof(measurements) + sizeof(triggerEngine) + sizeof(harmonics) + sizeof(mathTraces) + sizeof(FIR_COEFFS)
+    + sizeof(sampleBuffer) + sizeof(filterBuffer) + sizeof(channelFilters) + sizeof(recorder) + sizeof(playBuffer)
+    + sizeof(scheduler) + 512 + NET_STATIC_BYTES + DECIM_STATIC_BYTES + USB_STATIC_BYTES + TRIG_STATIC_BYTES
+    + HAL_STATIC_BYTES <= SCOPE_SRAM_BUDGET, "target SRAM data exceeds SCOPE_SRAM_BUDGET");
+#endif
+
+uint32_t sampleRate() {
+    // 抽取后交给处理、显示和测量的采样率
+    return halAdcSampleRate() / decimation;
+}
+
+void designLowPass(float32_t* coeffs, int taps, float cutoff) {
+    // 汉明窗加窗sinc低通, 归一化为单位直流增益
+    float sum = 0;
+    for (int i = 0; i < taps; i++) {
+        float m = i - (taps - 1) / 2.0f;
+        float h = m == 0 ? 2 * cutoff : sinf(2 * PI * cutoff * m) / (PI * m);
+        h *= 0.54f - 0.46f * cosf(2 * PI * i / (taps - 1));
+        coeffs[i] = h;
+        sum += h;
+    }
+    for (int i = 0; i < taps; i++) {
+        coeffs[i] /= sum;
+    }
+}
+
+int toScreenY(uint16_t sample) {
+    return LCD_HEIGHT - 1 - sample * (LCD_HEIGHT - 1) / ADC_FULL_SCALE;
+}
+
+void drawSpectrum(const float32_t* magnitude, const float32_t* held, int bins, int channel) {
+    // 每个通道占屏幕底部的四分之一宽度, 每列取其覆盖频点的最大值(跳过直流),
+    // 峰值保持画成该列顶端的一个点, 两者按峰值保持的最大值归一化
+    int width = LCD_WIDTH / MAX_CHANNELS;
+    int x0 = channel * width;
+    float32_t peak = 1e-6f;
+    for (int i = 1; i < bins; i++) {
+        if (held[i] > peak) {
+            peak = held[i];
+        }
+    }
+    for (int x = 0; x < width; x++) {
+        float32_t value = 0, top = 0;
+        for (int i = x == 0 ? 1 : x * bins / width; i < (x + 1) * bins / width; i++) {
+            if (magnitude[i] > value) {
+                value = magnitude[i];
+            }
+            if (held[i] > top) {
+                top = held[i];
+            }
+        }
+        int height = (int)(value / peak * SPECTRUM_HEIGHT);
+        int y = LCD_HEIGHT - 1 - (int)(top / peak * SPECTRUM_HEIGHT);
+        halLcdDrawLine(x0 + x, LCD_HEIGHT - 1, x0 + x, LCD_HEIGHT - 1 - height);
+        halLcdDrawLine(x0 + x, y, x0 + x, y);
+    }
+}
+
+void usbTxDone() {
+    // USB发送完成中断
+    usbStreamTxDone(&usbStream);
+}
 
 void initSystem() {
-    // ʼADC
-    ADC_Init(ADC1, &ADC_InitStructure);
-    ADC_Cmd(ADC1, ENABLE);
-    ADC_RegularChannelConfig(ADC1, ADC_Channel_0, 1, ADC_SampleTime_84Cycles);
-    ADC_RegularChannelConfig(ADC1, ADC_Channel_1, 2, ADC_SampleTime_84Cycles);
-    ADC_RegularChannelConfig(ADC1, ADC_Channel_2, 3, ADC_SampleTime_84Cycles);
-    ADC_RegularChannelConfig(ADC1, ADC_Channel_3, 4, ADC_SampleTime_84Cycles);
-
-    // ʼLCDʾ
-    LCD_Init();
-    LCD_SetBackColor(LCD_COLOR_BLACK);
-    LCD_SetTextColor(LCD_COLOR_WHITE);
-
-    // ʼûӿ
-    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0 | GPIO_Pin_1 | GPIO_Pin_2 | GPIO_Pin_3 | GPIO_Pin_4 | GPIO_Pin_5;
-    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN;
-    GPIO_Init(GPIOA, &GPIO_InitStructure);
-
-    // ʼ洢豸
-    f_mount(&FatFS, "/", 1);
-
-    // ʼͨŽӿ
-    USBD_Init(&USBD_Device, &VCP_CDC_desc, 0);
-    USBD_RegisterClass(&USBD_Device, &USBD_CDC);
-    USBD_CDC_RegisterInterface(&USBD_Device, &USBD_CDC_fops);
-    USBD_Start(&USBD_Device);
-
-    // ʼЭջ
-    lwip_init();
-    netif_add(&netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, tcpip_input);
-    netif_set_default(&netif);
-    netif_set_up(&netif);
-}
-
-void sampleData() {
-    // ADC
-    ADC_SoftwareStartConv(ADC1);
-
-    // ȡADCת뻺
+    // 初始化ADC外设
+    halAdcInit(ADC_SAMPLE_RATE);
+    ringInit(&acqRing);
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        for (int j = 0; j < ADC_BUFFER_SIZE; j++) {
-            adcBuffer[i][j] = ADC_GetInjectedConversionValue(ADC1, i + 1);
+        captureInit(&deepCapture[i]);
+    }
+    triggerInit(&triggerEngine);
+
+    // 初始化LCD显示屏
+    halLcdInit();
+
+    // 初始化用户输入接口
+    halKeyInit();
+
+    // 初始化存储设备
+    halStorageInit();
+
+    // 初始化通信接口
+    usbStreamInit(&usbStream);
+    halUsbInit(usbTxDone);
+
+    // 初始化网络协议栈并开始监听
+    netServerInit();
+
+    // 初始化滤波器和FFT, 只在启动时执行一次
+    designLowPass(FIR_COEFFS, FIR_TAPS, FIR_CUTOFF);
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+#ifdef SCOPE_Q15
+        firInitQ15(&channelFilters[i], FIR_COEFFS, FIR_TAPS, ADC_BUFFER_SIZE);
+#ifdef SCOPE_HOST
+        firInit(&referenceFilters[i], FIR_COEFFS, FIR_TAPS, ADC_BUFFER_SIZE, FIR_DIRECT);
+#endif
+#else
+        firInit(&channelFilters[i], FIR_COEFFS, FIR_TAPS, ADC_BUFFER_SIZE, FIR_AUTO);
+#endif
+    }
+    spectrumInit(&spectrum, SPECTRUM_WINDOW);
+
+    // 逻辑分析: UART接通道1, SPI时钟/数据和I2C的SCL/SDA接通道1/2
+    LogicConfig logicConfig = { 0 };
+    logicConfig.protocol = LOGIC_PROTOCOL;
+    logicConfig.threshold = ADC_FULL_SCALE / 2;
+    logicConfig.clk = logicConfig.scl = 0;
+    logicConfig.mosi = logicConfig.sda = 1;
+    logicConfig.miso = logicConfig.cs = -1;
+    logicConfig.wordBits = 8;
+    logicInit(&logic, &logicConfig);
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        decimInit(&decimators[i], decimation);
+    }
+
+    // 余辉直方图: PERSIST_DECAY为0时无限余辉
+    persistInit(&persistence, PERSIST_DECAY > 0 ? PERSIST_DECAY : PERSIST_INFINITE);
+
+    // 数学通道: Ch1、Ch2的和、差、积以及积的频谱, 积和频谱共用同一个乘法节点
+    mathInit(&mathChannels);
+    int a = mathSource(&mathChannels, 0);
+    int b = mathSource(&mathChannels, 1);
+    mathTraces[0] = mathBinary(&mathChannels, MATH_ADD, a, b);
+    mathTraces[1] = mathBinary(&mathChannels, MATH_SUB, a, b);
+    mathTraces[2] = mathBinary(&mathChannels, MATH_MUL, a, b);
+    mathTraces[3] = mathFft(&mathChannels, mathTraces[2]);
+    for (int i = 0; i < MATH_TRACES; i++) {
+        mathShow(&mathChannels, mathTraces[i], (MATH_VISIBLE >> i) & 1);
+    }
+
+    // 启动连续采集
+    halAcqStart(&acqRing);
+}
+
+void nextBlock() {
+    // 用空块换出队列中的下一块, 不复制数据, 采集在后台持续进行;
+    // USB仍在发送的块不能交还给队列
+    AcqBlock* empty = usbStreamHolds(&usbStream, currentBlock) ? otherBlock : currentBlock;
+    AcqBlock* keep = empty == currentBlock ? otherBlock : currentBlock;
+    currentBlock = ringConsumerExchange(&acqRing, empty);
+    otherBlock = keep;
+    blockSeq = currentBlock->seq;
+    blockTime = currentBlock->timestamp;
+    inputBlocks++;
+}
+
+int sampleData() {
+    // 取一个采集块: 不抽取时整块就是一帧; 否则经抽取链攒入decimBuffer, 攒满一帧时返回1,
+    // 两份缓冲区交替使用, 后级任务读取上一帧时不会被下一帧覆盖
+    uint32_t previous = blockSeq;
+    nextBlock();
+    if (decimation == 1) {
+        adcBuffer = currentBlock->data;
+        return 1;
+    }
+    // 队列溢出丢块后输入不再连续, 抽取链的历史作废, 未攒满的一帧也丢弃重新开始
+    if (blockSeq != previous + 1) {
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            decimReset(&decimators[i]);
+        }
+        decimFill = 0;
+    }
+    // 两级共用一个工作区, 每个通道先后经过CIC和补偿FIR
+    uint16_t (*fill)[ADC_BUFFER_SIZE] = decimBuffer[decimSide];
+    uint32_t count = 0;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        uint32_t start = halMicros();
+        count = decimCic(&decimators[i], currentBlock->data[i], ADC_BUFFER_SIZE);
+        uint32_t middle = halMicros();
+        decimFir(&decimators[i], count, fill[i] + decimFill);
+        cicTime += middle - start;
+        decimFirTime += halMicros() - middle;
+    }
+    cicSamples += MAX_CHANNELS * ADC_BUFFER_SIZE;
+    decimFirSamples += MAX_CHANNELS * count;
+    decimFill += count / DECIM_FIR_RATE;
+    if (decimFill < ADC_BUFFER_SIZE) {
+        return 0;
+    }
+    decimFill = 0;
+    decimSide ^= 1;
+    adcBuffer = fill;
+    return 1;
+}
+
+void setTimebase(uint32_t newDecimation) {
+    // 切换抽取倍数: 与采样率相关的状态全部重新开始, 录制也随之结束
+    decimation = newDecimation;
+    decimFill = 0;
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        decimInit(&decimators[i], decimation);
+#ifdef SCOPE_Q15
+        firResetQ15(&channelFilters[i]);
+#ifdef SCOPE_HOST
+        firReset(&referenceFilters[i]);
+#endif
+#else
+        firReset(&channelFilters[i]);
+#endif
+        captureInit(&deepCapture[i]);
+    }
+    mathInvalidate(&mathChannels);
+    persistClear(&persistence);
+    triggerArm(&triggerEngine);
+    spectrumReset(&spectrum);
+    viewOffset = 0;
+    saveWaveformFlag = 0;
+}
+
+#if defined(SCOPE_Q15) && defined(SCOPE_HOST)
+void checkQ15Filter(int channel) {
+    // 同一块数据再用浮点滤波器处理一遍, 统计定点输出相对浮点输出的误差;
+    // 浮点输入同样减去中点, 两者的初始状态一致
+    const float32_t mid = (ADC_FULL_SCALE + 1) / 2;
+    for (int j = 0; j < ADC_BUFFER_SIZE; j++) {
+        referenceIn[j] = adcBuffer[channel][j] - mid;
+    }
+    firProcess(&referenceFilters[channel], referenceIn, referenceOut, ADC_BUFFER_SIZE);
+    for (int j = 0; j < ADC_BUFFER_SIZE; j++) {
+        double e = filterBuffer[j] / (float32_t)(1 << ADC_Q15_SHIFT) - referenceOut[j];
+        double v = referenceOut[j];
+        q15ErrorPower += e * e;
+        q15SignalPower += v * v;
+        if (fabs(e) > q15MaxError) {
+            q15MaxError = fabs(e);
         }
     }
 }
+#endif
 
 void processSignal() {
-    // Բݽ˲
+    // 对采样数据进行滤波处理
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        arm_fir_instance_f32 firFilter;
-        arm_fir_init_f32(&firFilter, FIR_COEFFS, FIR_TAPS, ADC_BUFFER_SIZE);
-        arm_fir_f32(&firFilter, adcBuffer[i], displayBuffer[i], ADC_BUFFER_SIZE);
+#ifdef SCOPE_Q15
+        adcToQ15(adcBuffer[i], sampleBuffer, ADC_BUFFER_SIZE);
+        firProcessQ15(&channelFilters[i], sampleBuffer, filterBuffer, ADC_BUFFER_SIZE);
+        q15ToAdc(filterBuffer, displayBuffer[i], ADC_BUFFER_SIZE);
+#ifdef SCOPE_HOST
+        checkQ15Filter(i);
+#endif
+#else
+        for (int j = 0; j < ADC_BUFFER_SIZE; j++) {
+            sampleBuffer[j] = adcBuffer[i][j];
+        }
+        firProcess(&channelFilters[i], sampleBuffer, filterBuffer, ADC_BUFFER_SIZE);
+        for (int j = 0; j < ADC_BUFFER_SIZE; j++) {
+            float32_t v = filterBuffer[j];
+            displayBuffer[i][j] = v < 0 ? 0 : v > ADC_FULL_SCALE ? ADC_FULL_SCALE : (uint16_t)v;
+        }
+#endif
+        captureAppend(&deepCapture[i], displayBuffer[i], ADC_BUFFER_SIZE);
     }
 
-    // FFTƵͼ
-    for (int i = 0; i < MAX_CHANNELS; i++) {
-        arm_rfft_instance_f32 rfftInstance;
-        arm_rfft_init_f32(&rfftInstance, FFT_SIZE, 0, 1);
-        arm_rfft_f32(&rfftInstance, adcBuffer[i], fftBuffer[i]);
-        arm_cmplx_mag_f32(fftBuffer[i], fftBuffer[i], FFT_SIZE / 2);
-        drawSpectrum(fftBuffer[i], FFT_SIZE / 2, i);
+    // 在滤波后的数据上查找触发, 触发点前后的数据截取为一条记录
+    int recorded = triggerFeed(&triggerEngine, displayBuffer, ADC_BUFFER_SIZE);
+
+    // 余辉: 触发开启时折叠每条新的触发记录, 否则折叠每帧数据
+    if (PERSIST_DECAY >= 0 && (recorded || triggerEngine.cfg.sweep == TRIG_OFF)) {
+        uint32_t start = halMicros();
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            persistAddWaveform(&persistence, recorded ? triggerEngine.record[i] : displayBuffer[i], ADC_BUFFER_SIZE);
+        }
+        persistTime += halMicros() - start;
+    }
+
+    // 原始数据加窗后按50%重叠分段做FFT, 累计SPECTRUM_AVERAGES段后更新平均频谱
+    spectrumProcess(&spectrum, adcBuffer, ADC_BUFFER_SIZE);
+}
+
+int triggeredView() {
+    // 触发开启且显示范围未缩放平移时显示触发记录, 否则显示深存储中的连续波形
+    return triggerEngine.cfg.sweep != TRIG_OFF && viewSpan == TRIG_RECORD && viewOffset == 0;
+}
+
+void drawColumns(const MinMax* columns) {
+    MinMax prev = columns[0];
+    for (int x = 0; x < LCD_WIDTH; x++) {
+        MinMax col = columns[x];
+        if (col.min > col.max) {
+            continue;  // 该列没有数据
+        }
+        // 与前一列的范围衔接, 避免陡峭边沿断开
+        uint16_t low = col.min < prev.max ? col.min : prev.max;
+        uint16_t high = col.max > prev.min ? col.max : prev.min;
+        if (prev.min > prev.max) {
+            low = col.min;
+            high = col.max;
+        }
+        halLcdDrawLine(x, toScreenY(low), x, toScreenY(high));
+        prev = col;
     }
 }
 
 void displayWaveform() {
-    // LCDϻƲ
-    LCD_Clear(LCD_COLOR_BLACK);
+    // 在LCD上绘制波形: 每列取最小/最大值画一条竖线; 余辉模式下改为画出累积的直方图
+    halLcdClear();
+    int triggered = triggeredView();
+    if (PERSIST_DECAY >= 0) {
+        persistRender(&persistence);
+    }
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        for (int j = 0; j < ADC_BUFFER_SIZE - 1; j++) {
-            LCD_DrawLine(j, 239 - displayBuffer[i][j], j + 1, 239 - displayBuffer[i][j + 1]);
+        if (PERSIST_DECAY < 0) {
+            if (triggered) {
+                bufferRender(triggerEngine.record[i], TRIG_RECORD, LCD_WIDTH, screenColumns);
+            } else {
+                const DeepCapture* cap = &deepCapture[i];
+                uint64_t end = cap->written > viewOffset ? cap->written - viewOffset : 0;
+                uint64_t start = end > viewSpan ? end - viewSpan : 0;
+                captureRender(cap, start, viewSpan, LCD_WIDTH, screenColumns);
+            }
+            drawColumns(screenColumns);
         }
+        drawSpectrum(spectrum.magnitude[i], spectrum.peak[i], SPECTRUM_BINS, i);
+    }
+    if (triggered) {
+        // 顶部标出触发位置, 左侧标出触发电平
+        int x = triggerEngine.recordTrigger * LCD_WIDTH / TRIG_RECORD;
+        int y = toScreenY(triggerEngine.cfg.level);
+        halLcdDrawLine(x, 0, x, 6);
+        halLcdDrawLine(0, y, 6, y);
     }
 
-    // ʾ
-    LCD_SetCursor(0, 0);
+    // 显示测量结果: 每个通道一遍扫描得到全部测量值, 参考电平沿用上一块的结果
+    halLcdSetCursor(0, 0);
+    const float volts = ADC_VREF / ADC_FULL_SCALE;
+    const float usPerSample = 1e6f / sampleRate();
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        LCD_Print("Ch%d: Peak-to-Peak: %.2fV, RMS: %.2fV, Freq: %.2fHz", i + 1,
-            getPeakToPeak(displayBuffer[i], ADC_BUFFER_SIZE),
-            getRMS(displayBuffer[i], ADC_BUFFER_SIZE),
-            getFrequency(displayBuffer[i], ADC_BUFFER_SIZE, ADC_SAMPLE_RATE));
-        LCD_SetCursor(0, 20 * (i + 1));
+        Measurement* m = &measurements[i];
+        MeasureLevels levels = m->next;
+        measureBlock(triggered ? triggerEngine.record[i] : displayBuffer[i], ADC_BUFFER_SIZE, &levels, sampleRate(), m);
+        halLcdPrint("Ch%d: Peak-to-Peak: %.2fV, RMS: %.2fV, Freq: %.2fHz", i + 1,
+            (m->max - m->min) * volts, m->rms * volts, m->frequency);
+        halLcdSetCursor(0, 20 * (i + 1) - 10);
+        halLcdPrint("     Duty: %.1f%%, Rise: %.1fus, Fall: %.1fus, Overshoot: %.1f%%",
+            m->duty * 100, m->riseTime * usPerSample, m->fallTime * usPerSample, m->overshoot);
+        halLcdSetCursor(0, 20 * (i + 1));
+    }
+    static const char* sweepNames[] = { "OFF", "AUTO", "NORMAL", "SINGLE" };
+    halLcdPrint("Trigger: %s%s, %u triggered, %u forced, Rate: %u Hz", sweepNames[triggerEngine.cfg.sweep],
+        triggerEngine.stopped ? " (stopped)" : "", triggerEngine.triggers, triggerEngine.forced, sampleRate());
+    halLcdSetCursor(0, 20 * MAX_CHANNELS + 10);
+    uint32_t overruns = ringOverruns(&acqRing);
+    if (overruns > 0) {
+        halLcdPrint("Dropped blocks: %u", overruns);
     }
 }
 
 void userInput() {
-    // ȡû벢²β
-    int channel = GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_0);
-    int timebase = GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_1);
-    int trigger = GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_2);
-    int cursor = GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_3);
-    int menu = GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_4);
-    int setting = GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_5);
+    // 读取用户输入并更新波形参数
+    int channel = halKeyRead(HAL_KEY_CHANNEL);
+    int timebase = halKeyRead(HAL_KEY_TIMEBASE);
+    int trigger = halKeyRead(HAL_KEY_TRIGGER);
+    int cursor = halKeyRead(HAL_KEY_CURSOR);
+    int menu = halKeyRead(HAL_KEY_MENU);
+    int setting = halKeyRead(HAL_KEY_SETTING);
+    static int lastCursor = 0, lastSetting = 0, lastTrigger = 0, lastMenu = 0, lastTimebase = 0;
+    static int lastChannel = 0;
+
+    // 通道键切换谐波测量的通道, 并清除峰值保持
+    if (channel && !lastChannel) {
+        selectedChannel = (selectedChannel + 1) % MAX_CHANNELS;
+        spectrumResetPeak(&spectrum);
+    }
+
+    // 时基键依次加倍抽取倍数, 到最大值后回到不抽取
+    if (timebase && !lastTimebase) {
+        setTimebase(decimation < DECIM_MAX ? decimation * 2 : 1);
+    }
+
+    // 菜单键开始/停止录制
+    if (menu && !lastMenu) {
+        saveWaveformFlag = !saveWaveformFlag;
+    }
+
+    // 触发键依次切换 关闭 -> 自动 -> 正常 -> 单次, 单次模式每次进入都重新布防
+    if (trigger && !lastTrigger) {
+        triggerEngine.cfg.sweep = (TriggerSweep)((triggerEngine.cfg.sweep + 1) % (TRIG_SINGLE + 1));
+        triggerArm(&triggerEngine);
+        persistClear(&persistence);
+    }
+
+    // 光标键向历史方向平移四分之一屏, 设置键放大显示范围, 到存储深度后回到一屏一样本
+    uint64_t depth = deepCapture[0].written - captureOldest(&deepCapture[0]);
+    if (cursor && !lastCursor) {
+        viewOffset += viewSpan / 4;
+        if (viewOffset + viewSpan > depth) {
+            viewOffset = 0;
+        }
+    }
+    if (setting && !lastSetting) {
+        viewSpan = viewSpan * 2 <= CAPTURE_DEPTH ? viewSpan * 2 : LCD_WIDTH;
+        viewOffset = 0;
+    }
+    lastCursor = cursor;
+    lastSetting = setting;
+    lastTrigger = trigger;
+    lastMenu = menu;
+    lastTimebase = timebase;
+    lastChannel = channel;
     // ...
 }
 
 void saveWaveform() {
-    // ݱ浽SD
-    FIL file;
-    f_open(&file, "waveform.dat", FA_WRITE | FA_CREATE_ALWAYS);
-    f_write(&file, adcBuffer, sizeof(adcBuffer), NULL);
-    f_close(&file);
+    // 将采样数据连续录制到SD卡: 第一次调用时新建文件, 之后每帧追加一块
+    if (!recording) {
+        if (playerOpen) {
+            recordClose(&recorder);
+            playerOpen = 0;
+        }
+        if (recordCreate(&recorder, "waveform.rec", sampleRate()) != 0) {
+            recordClose(&recorder);
+            saveWaveformFlag = 0;
+            return;
+        }
+        recording = 1;
+    }
+    if (recordAppend(&recorder, adcBuffer, ADC_BUFFER_SIZE, blockTime) != 0) {
+        saveWaveformFlag = 0;
+    }
+}
+
+void stopRecording() {
+    // 写出块索引并关闭录制文件
+    if (recording) {
+        recordedSamples = recorder.samples;
+        recordedBytes = recorder.offset;
+        recordClose(&recorder);
+        recording = 0;
+    }
 }
 
 void loadWaveform() {
-    // SDȡݲʾ
-    FIL file;
-    f_open(&file, "waveform.dat", FA_READ);
-    f_read(&file, adcBuffer, sizeof(adcBuffer), NULL);
-    f_close(&file);
+    // 从SD卡读取一段录制数据并显示, 按索引直接定位, 不读取其余部分
+    if (!playerOpen) {
+        if (recordOpen(&recorder, "waveform.rec") != 0) {
+            recordClose(&recorder);
+            loadWaveformFlag = 0;
+            return;
+        }
+        playerOpen = 1;
+    }
+    if (loadPosition >= recorder.samples) {
+        loadPosition = 0;
+    }
+    uint32_t count = recordRead(&recorder, loadPosition, ADC_BUFFER_SIZE, playBuffer);
+    if (count < ADC_BUFFER_SIZE) {
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            memset(playBuffer[i] + count, 0, (ADC_BUFFER_SIZE - count) * sizeof(uint16_t));
+        }
+    }
+    loadPosition += ADC_BUFFER_SIZE;
+    adcBuffer = playBuffer;
     processSignal();
     displayWaveform();
 }
 
 void netInterface() {
-    // ʵͨŽӿ
-    struct netconn* conn = netconn_new(NETCONN_TCP);
-    netconn_bind(conn, IP_ADDR_ANY, 5000);
-    netconn_listen(conn);
-    struct netbuf* buf;
-    while (1) {
-        if (netconn_accept(conn, &buf) == ERR_OK) {
-            // ͻ
-            char* data;
-            u16_t len;
-            netbuf_data(buf, (void**)&data, &len);
-            // ...
-            netbuf_delete(buf);
+    // 把本块的波形、频谱和测量结果放入各客户端的发送队列, 不等待发送完成
+    if (netBeginBlock(blockSeq, blockTime)) {
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            netPublishWaveform(i, adcBuffer[i], ADC_BUFFER_SIZE);
+            netPublishSpectrum(i, spectrum.magnitude[i], SPECTRUM_BINS);
+            netPublishMeasure(i, &measurements[i]);
         }
     }
+    netService();
 }
 
 void usbInterface() {
-    // ʵUSBͨŽӿ
-    USBD_CDC_HandleTypeDef* hcdc = (USBD_CDC_HandleTypeDef*)USBD_Device.pClassData;
-    if (hcdc->TxState == 0) {
-        // 
-        uint8_t* txBuf = (uint8_t*)adcBuffer;
-        USBD_CDC_SetTxBuffer(&USBD_Device, txBuf, sizeof(adcBuffer));
-        USBD_CDC_TransmitPacket(&USBD_Device);
-    }
-    if (USBD_CDC_GetRxState(&USBD_Device) == 1) {
-        // 
-        uint8_t* rxBuf = hcdc->RxBuffer;
-        uint32_t rxLen = hcdc->RxLength;
+    // 把当前块交给USB分包发送, 上一块还没发完就跳过本块, 不影响采集
+    if (halUsbTxReady()) {
+        usbStreamOffer(&usbStream, currentBlock);
+    }
+    uint8_t rxBuf[64];
+    uint32_t rxLen = halUsbReceive(rxBuf, sizeof(rxBuf));
+    if (rxLen > 0) {
+        // 接收数据
         // ...
-        USBD_CDC_ReceivePacket(&USBD_Device);
     }
 }
 
 void systemManagement() {
-    // ʵϵͳ״̬غ͹
+#ifndef SCOPE_HOST
+    // 实现系统状态监控和故障诊断
     checkSystemStatus();
     if (systemFaultDetected()) {
         handleSystemFault();
     }
 
-    // ʵֹ̼
+    // 实现固件升级功能
     if (firmwareUpgradeRequested()) {
         performFirmwareUpgrade();
     }
 
-    // ʵֵԴ
+    // 实现电源管理功能
     if (systemIdleTimeout()) {
         enterPowerSaveMode();
     }
 
-    // ʵϵͳñͻָ
+    // 实现系统设置保存和恢复
     if (settingsSaveRequested()) {
         saveSystemSettings();
     }
     if (settingsRestoreRequested()) {
         restoreSystemSettings();
     }
+#endif
+}
+
+void performFFTAnalysis() {
+    // 在最近一次平均频谱上测量所选通道的基波和谐波
+    spectrumHarmonics(&spectrum, selectedChannel, sampleRate(), &harmonics);
+}
+
+void displayHarmonicMeasurement() {
+    // 在测量结果下方显示基波频率、THD和2~5次谐波相对基波的电平
+    halLcdSetCursor(0, 20 * MAX_CHANNELS + 20);
+    if (harmonics.fundamental == 0) {
+        halLcdPrint("Ch%d Spectrum (%s): no fundamental", selectedChannel + 1, spectrumWindowName(spectrum.window));
+        return;
+    }
+    float db[4] = { 0 };
+    for (int n = 2; n <= 5 && n <= harmonics.count; n++) {
+        db[n - 2] = 20 * log10f(harmonics.amplitude[n - 1] / harmonics.amplitude[0] + 1e-12f);
+    }
+    halLcdPrint("Ch%d F0: %.2fHz, %.3fV, THD: %.3f%%, H2..H5: %.0f %.0f %.0f %.0f dBc", selectedChannel + 1,
+        harmonics.fundamental, harmonics.amplitude[0] * ADC_VREF / ADC_FULL_SCALE, harmonics.thd,
+        db[0], db[1], db[2], db[3]);
+}
+
+void viewWindow(uint64_t* start, uint64_t* end) {
+    // 深存储中屏幕显示的样本范围, 不早于仍保留的最早样本
+    const DeepCapture* cap = &deepCapture[0];
+    *end = cap->written > viewOffset ? cap->written - viewOffset : 0;
+    *start = *end > viewSpan ? *end - viewSpan : 0;
+    if (*start < captureOldest(cap)) {
+        *start = captureOldest(cap);
+    }
+}
+
+void drawMathTrace(const MathNode* n) {
+    // 时域结果按自身范围缩放到整个屏幕高度, 频谱画在底部频谱区; 每列取覆盖点的最小/最大值画竖线
+    int frequency = n->op == MATH_FFT;
+    float32_t low = frequency ? 0 : n->min;
+    float32_t range = n->max - low > 1e-6f ? n->max - low : 1e-6f;
+    int height = frequency ? SPECTRUM_HEIGHT : LCD_HEIGHT - 1;
+    for (int x = 0; x < LCD_WIDTH; x++) {
+        uint32_t first = (uint32_t)((uint64_t)x * n->count / LCD_WIDTH);
+        uint32_t last = (uint32_t)((uint64_t)(x + 1) * n->count / LCD_WIDTH);
+        if (first >= n->count) {
+            break;
+        }
+        float32_t top = n->data[first], bottom = top;
+        for (uint32_t i = first + 1; i < last; i++) {
+            top = n->data[i] > top ? n->data[i] : top;
+            bottom = n->data[i] < bottom ? n->data[i] : bottom;
+        }
+        if (frequency) {
+            bottom = 0;
+        }
+        halLcdDrawLine(x, LCD_HEIGHT - 1 - (int)((bottom - low) / range * height),
+            x, LCD_HEIGHT - 1 - (int)((top - low) / range * height));
+    }
+}
+
+void performMathOperation() {
+    // 只求显示的数学通道: 输入与显示的波形相同(触发记录或深存储的显示范围), 未变化的节点直接用缓存
+    int shown = 0;
+    for (int i = 0; i < MATH_TRACES; i++) {
+        shown |= mathChannels.nodes[mathTraces[i]].visible;
+    }
+    if (!shown) {
+        return;
+    }
+    uint32_t t0 = halMicros();
+    MathWindow window;
+    memset(&window, 0, sizeof(window));
+    if (triggeredView()) {
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            window.buffer[i] = triggerEngine.record[i];
+        }
+        window.span = TRIG_RECORD;
+        window.version = triggerEngine.recordAt;
+    } else {
+        uint64_t end;
+        window.capture = deepCapture;
+        viewWindow(&window.start, &end);
+        window.span = (uint32_t)(end - window.start);
+    }
+    mathSetWindow(&mathChannels, &window);
+
+    char name[64];
+    int y = 20 * MAX_CHANNELS + 40;
+    for (int i = 0; i < MATH_TRACES; i++) {
+        if (!mathChannels.nodes[mathTraces[i]].visible) {
+            continue;
+        }
+        const MathNode* n = mathEvaluate(&mathChannels, mathTraces[i]);
+        if (n == NULL) {
+            continue;
+        }
+        drawMathTrace(n);
+        halLcdSetCursor(0, y);
+        halLcdPrint("%s: %.1f .. %.1f", mathName(&mathChannels, mathTraces[i], name, sizeof(name)), n->min, n->max);
+        y += 10;
+    }
+    mathTime += halMicros() - t0;
+}
+
+void displayLogicAnalysis() {
+    // 解码屏幕显示范围内的波形, 在屏幕顶部标出每个事件的起点, 并显示屏幕中间起的几个解码结果
+    if (logic.cfg.protocol == LOGIC_OFF) {
+        return;
+    }
+    uint64_t start, end;
+    viewWindow(&start, &end);
+    uint32_t t0 = halMicros();
+    logic.cfg.samplesPerBit = (float)sampleRate() / LOGIC_BITRATE;
+    uint32_t n = logicLoad(&logic, deepCapture, start, (uint32_t)(end - start));
+    logicDecode(&logic);
+    logicTime += halMicros() - t0;
+    logicSamples += n;
+
+    for (uint32_t i = 0; i < logic.count; i++) {
+        int x = (int)((logic.events[i].start - start) * LCD_WIDTH / viewSpan);
+        halLcdDrawLine(x, 8, x, 10);
+    }
+
+    static const char* protocolNames[] = { "", "UART", "SPI", "I2C" };
+    int errors = 0;
+    for (int i = logicFind(&logic, 0, -1, -1); i >= 0; i = logicFind(&logic, i + 1, -1, -1)) {
+        errors += (logic.events[i].flags & (LOGIC_FLAG_ERROR | LOGIC_FLAG_NACK)) != 0;
+    }
+    // 解码结果从屏幕中间的事件开始列出, 平移视图时跟着移动
+    char text[64];
+    int len = 0;
+    int shown = 0;
+    int first = logicFindSample(&logic, start + (end - start) / 2);
+    for (uint32_t i = first >= 0 ? (uint32_t)first : logic.count; i < logic.count && shown < 8; i++) {
+        const LogicEvent* e = &logic.events[i];
+        if (e->type != EVT_I2C_START && e->type != EVT_I2C_STOP) {
+            len += snprintf(text + len, sizeof(text) - len, " %02X", e->data);
+            shown++;
+        }
+    }
+    text[len] = 0;
+    halLcdSetCursor(0, 20 * MAX_CHANNELS + 30);
+    halLcdPrint("%s: %u events, %d errors:%s", protocolNames[logic.cfg.protocol], logic.count, errors, text);
 }
 
 void extendedFunctions() {
-    // ʵⲿ빦
+#ifndef SCOPE_HOST
+    // 实现外部传感器接入功能
     readSensorData();
     displaySensorData();
 
-    // ʵѧ߼
-    performMathOperation();
-    displayLogicAnalysis();
-
-    // ʵֲɺģ⹦
+    // 实现波形生成和模拟功能
     generateWaveform();
     displayWaveformSimulation();
 
-    // ʵƵ׷г
+    // 实现数据导出和报告生成功能
+    exportDataToFile();
+    generateMeasurementReport();
+#endif
+}
+
+void printStatistics() {
+    // 输出处理吞吐量(主机构建用于性能评估)
+    double samples = (double)frameCount * MAX_CHANNELS * ADC_BUFFER_SIZE;
+#ifdef SCOPE_Q15
+    const char* firMethod = "Q15 direct";
+#else
+    const char* firMethod = channelFilters[0].method == FIR_FFT ? "overlap-save FFT" : "direct";
+#endif
+    printf("frames: %u, sample rate: %u Hz (decimation %u), FIR: %d taps (%s), measure: %s\n", frameCount,
+        halAdcSampleRate(), decimation, FIR_TAPS, firMethod, measureKernelName());
+    printf("processSignal:   %8.1f us/frame, %8.2f MS/s\n",
+        (double)processTime / frameCount, samples / processTime);
+    printf("display:         %8.1f us/refresh, %u refreshes\n",
+        displayCount ? (double)displayTime / displayCount : 0.0, displayCount);
+    if (cicSamples > 0) {
+        printf("decim CIC:       %8.1f us/frame, %8.2f MS/s\n",
+            (double)cicTime / frameCount, (double)cicSamples / cicTime);
+        printf("decim FIR:       %8.1f us/frame, %8.2f MS/s\n",
+            (double)decimFirTime / frameCount, (double)decimFirSamples / decimFirTime);
+    }
+    if (harmonics.fundamental > 0) {
+        printf("spectrum ch%d:    F0 %.2f Hz, THD %.3f %% (%s window, %u averages)\n", selectedChannel + 1,
+            harmonics.fundamental, harmonics.thd, spectrumWindowName(spectrum.window), spectrum.updates);
+    } else if (spectrum.updates > 0) {
+        printf("spectrum ch%d:    no fundamental (%s window, %u averages)\n", selectedChannel + 1,
+            spectrumWindowName(spectrum.window), spectrum.updates);
+    }
+#if defined(SCOPE_Q15) && defined(SCOPE_HOST)
+    printf("Q15 vs float FIR: max error %.2f codes, SNR %.1f dB\n", q15MaxError,
+        10 * log10(q15SignalPower / (q15ErrorPower + 1e-30)));
+#endif
+    if (logicSamples > 0) {
+        printf("logic decode:    %8.1f us/refresh, %8.2f MS/s, %u events in view\n",
+            (double)logicTime / displayCount, (double)logicSamples / logicTime, logic.count);
+    }
+    if (persistence.waveforms > 0) {
+        printf("persistence:     %8.2f us/waveform, %u waveforms (%.0f/s of signal)\n",
+            (double)persistTime / persistence.waveforms, persistence.waveforms,
+            persistence.waveforms / ((double)inputBlocks * ADC_BUFFER_SIZE / halAdcSampleRate()));
+    }
+    if (mathChannels.computed > 0) {
+        printf("math channels:   %8.1f us/refresh, %u nodes computed, %u from cache\n",
+            (double)mathTime / displayCount, mathChannels.computed, mathChannels.cached);
+    }
+    printf("dropped blocks:  %8u\n", ringOverruns(&acqRing));
+    printf("triggers:        %8u (%u forced)\n", triggerEngine.triggers, triggerEngine.forced);
+    for (int i = 0; i < HAL_NET_MAX_CLIENTS; i++) {
+        const NetClient* c = netClient(i);
+        if (c->framesSent + c->framesDropped > 0) {
+            printf("net client %d:    %8u frames, %.1f MB sent, %u dropped, skip %u\n",
+                i, c->framesSent, c->bytesSent / 1e6, c->framesDropped, c->skip);
+        }
+    }
+    if (usbStream.blocksSent > 0) {
+        printf("usb blocks sent: %8u\n", usbStream.blocksSent);
+    }
+    if (recordedSamples > 0) {
+        double raw = (double)recordedSamples * MAX_CHANNELS * sizeof(uint16_t);
+        printf("recorded:        %8llu samples/ch, %u bytes (%.1f %% of raw)\n",
+            (unsigned long long)recordedSamples, recordedBytes, 100.0 * recordedBytes / raw);
+    }
+    printf("task         runs   avg us   max us  misses\n");
+    for (int i = 0; i < scheduler.count; i++) {
+        const Task* t = &scheduler.tasks[i];
+        printf("%-10s %6u %8.1f %8u %7u\n", t->name, t->runs,
+            t->runs ? (double)t->totalTime / t->runs : 0.0, t->maxTime, t->misses);
+    }
+    // 负载为非后台任务执行时间按消耗的采集块折算, 抽取时一帧对应多个采集块; CPU占用含后台任务
+    uint64_t taskTime = 0;
+    for (int i = 0; i < scheduler.count; i++) {
+        if (scheduler.tasks[i].kind != TASK_BACKGROUND) {
+            taskTime += scheduler.tasks[i].totalTime;
+        }
+    }
+    printf("real-time load:  %8.1f %%\n", 100.0 * taskTime
+        / ((double)inputBlocks * ADC_BUFFER_SIZE / halAdcSampleRate() * 1e6));
+    printf("cpu busy:        %8.1f %%\n", 100.0 * scheduler.busyTime / (double)(halMicros() - scheduler.startTime));
+}
+
+uint32_t blockPeriod() {
+    // 一个采集块的时长(us)
+    return (uint32_t)((uint64_t)ADC_BUFFER_SIZE * 1000000u / halAdcSampleRate());
+}
+
+int framePending() {
+    return schedPending(&scheduler, usbTask) || schedPending(&scheduler, inputTask)
+        || schedPending(&scheduler, netTask) || schedPending(&scheduler, recordTask);
+}
+
+int acquireReady() {
+    // 有块待处理且上一帧的后续任务都已运行时就绪: 这些任务读取的是上一帧的缓冲区,
+    // 下一帧会覆盖它们; 其间到达的采集块由采集队列缓存
+    return ringConsumerPeek(&acqRing) != NULL && !framePending();
+}
+
+void acquire() {
+    // 采集任务: 处理一个采集块, 凑满一帧后滤波、触发和频谱, 再释放本帧的后续任务
+    if (!sampleData()) {
+        return;
+    }
+    uint32_t start = halMicros();
+    processSignal();
+    processTime += halMicros() - start;
+    frameCount++;
+    schedSignal(&scheduler, usbTask);
+    schedSignal(&scheduler, inputTask);
+    schedSignal(&scheduler, netTask);
+    schedSignal(&scheduler, recordTask);
+}
+
+void refreshDisplay() {
+    // 显示任务: 按固定周期刷新波形、测量、谐波和逻辑分析结果
+    uint32_t start = halMicros();
+    displayWaveform();
+    performMathOperation();
     performFFTAnalysis();
     displayHarmonicMeasurement();
+    displayLogicAnalysis();
+    displayTime += halMicros() - start;
+    displayCount++;
+}
 
-    // ʵݵͱɹ
-    exportDataToFile();
-    generateMeasurementReport();
+void recordTaskRun() {
+    // 录制/回放任务: SD卡读写较慢, 优先级低于采集和显示
+    if (saveWaveformFlag) {
+        saveWaveform();
+    } else {
+        stopRecording();
+    }
+    if (loadWaveformFlag && !recording) {
+        // 录制和回放共用recorder, 录制结束后才回放
+        loadWaveform();
+    }
 }
 
-int main() {
+void backgroundTask() {
+    // 后台任务: 只在空闲时间运行
+    systemManagement();
+    extendedFunctions();
+}
+
+void initTasks() {
+    // 优先级: 采集 > USB > 按键 > 网络 > 显示 > 录制 > 后台
+    uint32_t period = blockPeriod();
+    schedInit(&scheduler);
+    schedAddEvent(&scheduler, "acquire", acquire, acquireReady, 0, period);
+    usbTask = schedAddEvent(&scheduler, "usb", usbInterface, NULL, 1, period);
+    inputTask = schedAddEvent(&scheduler, "input", userInput, NULL, 2, INPUT_DEADLINE_US);
+    netTask = schedAddEvent(&scheduler, "net", netInterface, NULL, 3, period * ACQ_RING_BLOCKS);
+    schedAddPeriodic(&scheduler, "display", refreshDisplay, 4, DISPLAY_PERIOD_US, DISPLAY_PERIOD_US);
+    recordTask = schedAddEvent(&scheduler, "record", recordTaskRun, NULL, 5, RECORD_DEADLINE_US);
+    schedAddBackground(&scheduler, "background", backgroundTask);
+}
+
+int main(int argc, char* argv[]) {
+    halInit(argc, argv);
     initSystem();
+    initTasks();
 
-    while (1) {
-        sampleData();
-        processSignal();
-        displayWaveform();
-        userInput();
-        if (saveWaveformFlag) {
-            saveWaveform();
+    // 每次halRunning对应一帧, 直到这一帧的后续任务(含按键)都运行完, 其间没有就绪任务时休眠
+    while (halRunning()) {
+        uint32_t frames = frameCount;
+        while (frameCount == frames || framePending()) {
+            if (!schedRunOnce(&scheduler)) {
+                halIdle();
+            }
         }
-        if (loadWaveformFlag) {
-            loadWaveform();
-        }
-        netInterface();
-        usbInterface();
-        systemManagement();
-        extendedFunctions();
     }
+
+    halAcqStop();
+    stopRecording();
+    printStatistics();
+    return 0;
 }
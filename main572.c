@@ -1,98 +1,499 @@
+#define _CRT_SECURE_NO_WARNINGS
 #include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
 
-int main()
+#ifdef _WIN32
+#include<io.h>
+#define read _read
+#define write _write
+#else
+#include<unistd.h>
+#include<sys/uio.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include<emmintrin.h>
+#define SCAN_SSE2
+#endif
+
+// 读入任意多个 "类型 名字[N] = {a, b, ...};" 形式的声明, 每个声明输出一行: 各元素, 不足N个时补0;
+// 没有初始化的输出N个N, 写成 名字[] 时元素有几个就是几个. 输入按块读, 长度不限, 声明可以跨行
+// 元素可以是字符串、字符常量或带括号的表达式, 其中的逗号不分隔元素; 多维数组和嵌套的大括号报错
+// 找分隔符时SSE2每次比较16字节(没有SSE2时按8字节整字), 输出先攒在缓冲区里, 读下一块输入前写出
+// 补的0和N用memcpy加倍复制成整块, 很多时同一块用writev一次写出多份; 加-r时写成 "0 x次数" 的紧凑形式
+
+#define INPUT_SIZE (1 << 20)      // 每次最多读入1MB, 一个元素比缓冲区还长时缓冲区加倍
+#define OUTPUT_SIZE (1 << 20)     // 输出缓冲区1MB
+#define OUTPUT_IOV 64             // writev一次最多交64块, 即64MB
+
+typedef struct
 {
-	char arr[100], ch;
-	int flag = 0, i = 0, q = 0, pcount = 0;
-	char num[3] = { 0 };
-	int j = 0, pnum = 0, number = 0;
-	while ((ch = getchar()) != '\n')
+	char* data;
+	size_t size;
+	size_t begin;    // 还要用到的数据从这里开始, 读入新数据时前面的可以丢掉
+	size_t end;      // 已读入数据的末尾
+	int eof;
+} Input;
+
+typedef struct
+{
+	char data[OUTPUT_SIZE];
+	size_t used;
+	int runs;        // 连续补的元素写成 "0 x次数"
+	int failed;      // 写出错(比如管道被关掉)后不再写
+} Output;
+
+static Output output;
+
+static void writeAll(const char* p, size_t n)
+{
+	while (n > 0 && !output.failed)
 	{
-		arr[i] = ch;
-		i++;
+		long w = (long)write(1, p, (unsigned int)(n < (1u << 30) ? n : (1u << 30)));
+		if (w <= 0)
+			output.failed = 1;
+		else
+		{
+			p += w;
+			n -= (size_t)w;
+		}
 	}
-	for (i = 0; arr[i] != ';'; i++)
+}
+
+static void flush(void)
+{
+	writeAll(output.data, output.used);
+	output.used = 0;
+}
+
+static void put(const char* p, size_t n)
+{
+	if (n > OUTPUT_SIZE - output.used)
 	{
-		if (arr[i] == '[')
+		flush();
+		if (n >= OUTPUT_SIZE)
 		{
-			num[0] = arr[i + 1];
-			if (arr[i + 2] != ']' && arr[i + 2] != ' ')
-			{
-				num[1] = arr[i + 2];
-				if (arr[i + 3] != ']' && arr[i + 2] != ' ')
-					num[2] = arr[i + 3];
-			}
-
+			writeAll(p, n);
+			return;
 		}
-		if (arr[i] == '{')
-		{
-			flag = 1;
-			if (arr[i + 2] != '}')
-			{
-				q = i;
-			}
-			else
-				q = -1;
+	}
+	memcpy(output.data + output.used, p, n);
+	output.used += n;
+}
+
+static void fill(char* dst, const char* p, size_t n, size_t count)
+{
+	// 先放一份, 以后每次把已经放好的整段复制到后面, 长度翻倍, count份只要log2(count)次memcpy
+	size_t done = n, total = n * count;
+	memcpy(dst, p, n);
+	while (done < total)
+	{
+		size_t m = done < total - done ? done : total - done;
+		memcpy(dst + done, dst, m);
+		done += m;
+	}
+}
 
+static void writeBlocks(size_t block, unsigned long long count)
+{
+	// 缓冲区开头的block字节写count遍
+#ifdef _WIN32
+	while (count-- > 0 && !output.failed)
+		writeAll(output.data, block);
+#else
+	struct iovec v[OUTPUT_IOV];
+	int i;
+	for (i = 0; i < OUTPUT_IOV; i++)
+	{
+		v[i].iov_base = output.data;
+		v[i].iov_len = block;
+	}
+	while (count > 0 && !output.failed)
+	{
+		int k = count < OUTPUT_IOV ? (int)count : OUTPUT_IOV;
+		size_t total = block * (size_t)k, done;
+		long w = (long)writev(1, v, k);
+		if (w <= 0)
+		{
+			output.failed = 1;
+			return;
 		}
+		// 只写了一部分时, 剩下的从中断处接着写
+		for (done = (size_t)w; done < total && !output.failed; done += block - done % block)
+			writeAll(output.data + done % block, block - done % block);
+		count -= (unsigned long long)k;
+	}
+#endif
+}
 
+static void putRepeat(const char* p, size_t n, unsigned long long count)
+{
+	// 把p重复count遍. 先填满缓冲区剩下的部分, 还不够时整个缓冲区填成整份的p, 按块反复写出, 零头留在缓冲区里
+	size_t room, per;
+	if (count == 0)
+		return;
+	if (output.runs && count > 1)
+	{
+		char text[32];
+		put(p, n);
+		put(text, (size_t)sprintf(text, "x%llu ", count));
+		return;
+	}
+	if (n > OUTPUT_SIZE - output.used)
+		flush();
+	room = (OUTPUT_SIZE - output.used) / n;
+	if (count <= room)
+	{
+		fill(output.data + output.used, p, n, (size_t)count);
+		output.used += n * (size_t)count;
+		return;
 	}
+	if (room > 0)
+	{
+		fill(output.data + output.used, p, n, room);
+		output.used += n * room;
+		count -= room;
+	}
+	flush();
+	per = OUTPUT_SIZE / n;
+	fill(output.data, p, n, count < per ? (size_t)count : per);
+	writeBlocks(n * per, count / per);
+	output.used = n * (size_t)(count % per);
+}
 
-	for (j = 0; j < 3; j++)
+static int refill(Input* in, size_t* pos)
+{
+	// 丢掉begin之前的数据, 缓冲区满时加倍, 再读入一块; 读不到新数据时返回-1
+	// 交互输入时read读到一行就返回, 所以读之前先把已有的输出写出去
+	long n;
+	if (in->eof)
+		return -1;
+	if (in->begin > 0)
+	{
+		memmove(in->data, in->data + in->begin, in->end - in->begin);
+		in->end -= in->begin;
+		*pos -= in->begin;
+		in->begin = 0;
+	}
+	if (in->end == in->size)
 	{
-		if (num[j] == ' ')
-			num[j] = 0;
-		if (num[j] == 0)
+		char* data = realloc(in->data, in->size * 2);
+		if (data == NULL)
 		{
-			number++;
+			in->eof = 1;
+			return -1;
 		}
+		in->data = data;
+		in->size *= 2;
+	}
+	flush();
+	n = (long)read(0, in->data + in->end, (unsigned int)(in->size - in->end < INPUT_SIZE ? in->size - in->end : INPUT_SIZE));
+	if (n <= 0)
+	{
+		in->eof = 1;
+		return -1;
+	}
+	in->end += (size_t)n;
+	return 0;
+}
 
+static size_t findAny(const char* p, size_t n, const char* set)
+{
+	// 找第一个属于set(最多8个字符)的字节, 没有时返回n
+	size_t i = 0, k, count = strlen(set);
+#ifdef SCAN_SSE2
+	__m128i v[8];
+	for (k = 0; k < count; k++)
+		v[k] = _mm_set1_epi8(set[k]);
+	while (i + 16 <= n)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i)), hit = _mm_cmpeq_epi8(x, v[0]);
+		int mask;
+		for (k = 1; k < count; k++)
+			hit = _mm_or_si128(hit, _mm_cmpeq_epi8(x, v[k]));
+		mask = _mm_movemask_epi8(hit);
+		if (mask != 0)
+		{
+			while ((mask & 1) == 0)
+			{
+				mask >>= 1;
+				i++;
+			}
+			return i;
+		}
+		i += 16;
+	}
+#else
+	const unsigned long long ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+	unsigned long long m[8];
+	for (k = 0; k < count; k++)
+		m[k] = ones * (unsigned char)set[k];
+	while (i + 8 <= n)
+	{
+		unsigned long long v, x, found = 0;
+		memcpy(&v, p + i, 8);
+		for (k = 0; k < count; k++)
+		{
+			x = v ^ m[k];
+			found |= (x - ones) & ~x;
+		}
+		if (found & highs)
+			break;
+		i += 8;
+	}
+#endif
+	for (; i < n; i++)
+	{
+		if (memchr(set, p[i], count) != NULL)
+			return i;
 	}
+	return n;
+}
 
-	if (number == 0)
-		pnum = (num[0] - 48) * 100 + (num[1] - 48) * 10 + num[2] - 48;
-	if (number == 1)
-		pnum = (num[0] - 48) * 10 + num[1] - 48;
-	if (number == 2)
-		pnum = num[0] - 48;
-	if (flag == 0)
+static int scan(Input* in, size_t* pos, const char* set, int keep)
+{
+	// 从*pos起找set中的字符, 找到时*pos指向它; 输入结束时返回-1
+	// keep为0时调用者不需要begin到分隔符之间的内容, 读入下一块前就可以丢掉
+	for (;;)
 	{
-		for (i = 0; i < pnum; i++)
-			printf("N ");
+		size_t i = findAny(in->data + *pos, in->end - *pos, set);
+		if (i < in->end - *pos)
+		{
+			*pos += i;
+			return 0;
+		}
+		*pos = in->end;
+		if (!keep)
+			in->begin = in->end;
+		if (refill(in, pos) != 0)
+			return -1;
 	}
+}
 
-	if (flag == 1 && q != -1)
+static int skipLiteral(Input* in, size_t* pos)
+{
+	// *pos指向字符串或字符常量开头的引号, 跳到结尾引号之后; 反斜杠转义下一个字符, 常量不能跨行
+	const char* set = in->data[*pos] == '"' ? "\"\\\n" : "'\\\n";
+	for (;;)
 	{
-		for (i = q + 2; arr[i] != '}'; i++)
+		++*pos;
+		if (scan(in, pos, set, 1) != 0 || in->data[*pos] == '\n')
+			return -1;
+		if (in->data[*pos] != '\\')
 		{
-			if (arr[i] != ',' && arr[i] != ' ')
-			{
-				printf("%c", arr[i]);
-				if (arr[i + 1] != ' ' && arr[i + 1] != ',') {
-					i++;
-					while (arr[i] != ' ' && arr[i] != ',' && arr[i] != '}') {
+			++*pos;
+			return 0;
+		}
+		++*pos;
+		if (*pos == in->end && refill(in, pos) != 0)
+			return -1;
+	}
+}
 
-						printf("%c", arr[i]);
-						i++;
-					}
+static int isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
 
+static int parseSize(const char* p, size_t n, unsigned long long* size, int* sized)
+{
+	// [ ]之间只能有空白和一个十进制数, 没有数表示大小由元素个数决定
+	size_t i = 0, digits = 0;
+	*size = 0;
+	while (i < n && isBlank(p[i]))
+		i++;
+	for (; i < n && p[i] >= '0' && p[i] <= '9'; i++, digits++)
+	{
+		if (*size > (~0ULL - 9) / 10)
+			return -1;
+		*size = *size * 10 + (unsigned long long)(p[i] - '0');
+	}
+	while (i < n && isBlank(p[i]))
+		i++;
+	*sized = digits > 0;
+	return i == n ? 0 : -1;
+}
 
-				}
-				printf(" ");
-				pcount++;
+static int element(Input* in, size_t* pos, const char** error)
+{
+	// 从*pos起找一个元素的结尾(顶层的','或'}'), 字符串、字符常量和括号里的','不算;
+	// 嵌套的大括号(多维数组或结构)不支持
+	int depth = 0;
+	for (;;)
+	{
+		if (scan(in, pos, depth > 0 ? "()'\";" : ",}{()'\";", 1) != 0)
+			return -1;
+		switch (in->data[*pos])
+		{
+		case '\'':
+		case '"':
+			if (skipLiteral(in, pos) != 0)
+			{
+				*error = "的字符串或字符常量没有结束";
+				return -1;
 			}
+			continue;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (--depth < 0)
+			{
+				*error = "的括号不配对";
+				return -1;
+			}
+			break;
+		case '{':
+			*error = "有嵌套的大括号, 只支持一维数组";
+			return -1;
+		case ';':
+			return -1;
+		default:
+			return 0;
+		}
+		++*pos;
+	}
+}
 
+static void skipStatement(Input* in, size_t pos)
+{
+	// 跳过本声明剩下的部分, 到字符串和字符常量以外的下一个分号之后
+	for (;;)
+	{
+		in->begin = pos;
+		if (scan(in, &pos, ";'\"", 0) != 0)
+		{
+			in->begin = in->end;
+			return;
 		}
-		for (i = 0; i < pnum - pcount; i++)
+		if (in->data[pos] == ';')
 		{
-			printf("0 ");
+			in->begin = pos + 1;
+			return;
 		}
+		if (skipLiteral(in, &pos) != 0)
+		{
+			// 常量不能跨行, 没有结束的常量说明这一行坏了, 从下一行接着读
+			in->begin = pos < in->end ? pos + 1 : in->end;
+			return;
+		}
+	}
+}
+
+static int declaration(Input* in, unsigned long long number)
+{
+	// 处理一个声明, 返回1; 输入里没有声明了返回0; 格式不对或不支持时报告后跳到分号, 返回-1
+	size_t pos = in->begin;
+	unsigned long long size, count = 0;
+	int sized;
+	const char* error = "格式不对";
+	if (scan(in, &pos, "[;", 0) != 0)
+		return 0;
+	if (in->data[pos] == ';')
+	{
+		in->begin = pos + 1;
+		return 1;
+	}
+	in->begin = pos + 1;
+	if (scan(in, &pos, "];", 1) != 0 || in->data[pos] != ']'
+		|| parseSize(in->data + in->begin, pos - in->begin, &size, &sized) != 0)
+		goto fail;
+	pos++;
+	if (scan(in, &pos, "=;[", 0) != 0)
+		goto fail;
+	if (in->data[pos] == '[')
+	{
+		error = "是多维数组, 只支持一维数组";
+		goto fail;
+	}
+	if (in->data[pos] == ';')
+	{
+		if (!sized)
+			goto fail;
+		putRepeat("N ", 2, size);
+		put("\n", 1);
+		in->begin = pos + 1;
+		return 1;
 	}
-	if (q == -1 && flag == 1)
-		for (i = 0; i < pnum; i++)
+	if (scan(in, &pos, "{;'\"", 0) != 0 || in->data[pos] != '{')
+	{
+		if (pos < in->end && in->data[pos] != ';')
+			error = "的初始化不是大括号列表";
+		goto fail;
+	}
+	for (;;)
+	{
+		size_t from, to;
+		in->begin = ++pos;
+		if (element(in, &pos, &error) != 0)
+			goto fail;
+		from = in->begin;
+		to = pos;
+		while (from < to && isBlank(in->data[from]))
+			from++;
+		while (to > from && isBlank(in->data[to - 1]))
+			to--;
+		if (to > from)
 		{
-			printf("0 ");
+			if (!sized || count < size)
+			{
+				put(in->data + from, to - from);
+				put(" ", 1);
+			}
+			count++;
 		}
-	return 0; 
+		if (in->data[pos] == '}')
+			break;
+	}
+	in->begin = pos;
+	if (scan(in, &pos, ";;", 0) != 0)
+		goto fail;
+	if (sized && count < size)
+		putRepeat("0 ", 2, size - count);
+	put("\n", 1);
+	in->begin = pos + 1;
+	if (sized && count > size)
+	{
+		flush();
+		fprintf(stderr, "第%llu个声明: %llu个元素多于数组大小%llu, 多出的忽略\n", number, count, size);
+		return -1;
+	}
+	return 1;
+fail:
+	put("\n", 1);
+	flush();
+	fprintf(stderr, "第%llu个声明%s, 跳过这个声明\n", number, error);
+	if (pos < in->end && (in->data[pos] == ';' || in->data[pos] == '\n'))
+		in->begin = pos + 1;    // 停在分号, 或者停在没有结束的常量所在行的行尾
+	else
+		skipStatement(in, pos < in->end ? pos : in->end);
+	return -1;
+}
+
+int main(int argc, char** argv)
+{
+	Input in;
+	unsigned long long number = 0;
+	int result, errors = 0;
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "-r") != 0))
+	{
+		fprintf(stderr, "用法: %s [-r]\n  -r  补的元素写成 \"0 x次数\"\n", argv[0]);
+		return 2;
+	}
+	output.runs = argc == 2;
+	in.size = INPUT_SIZE;
+	in.data = malloc(in.size);
+	in.begin = in.end = 0;
+	in.eof = 0;
+	if (in.data == NULL)
+		return 1;
+	while ((result = declaration(&in, ++number)) != 0)
+	{
+		if (result < 0)
+			errors++;
+	}
+	flush();
+	free(in.data);
+	return errors != 0 || output.failed;
 }
@@ -0,0 +1,936 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "archive.h"
+#include "copy.h"
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+#define HASH_BITS 15               // 找匹配的哈希表32K项
+#define DMER_BITS 20               // 训练时计频的哈希表1M项
+#define LITERAL_RAW 0
+#define LITERAL_HUFFMAN 1
+#define PACKED_MAX(block) ((size_t)(block) * 4 + 1024)
+
+typedef struct
+{
+	unsigned char* window;    // 字典 + 一块原文
+	int32_t* head;            // 哈希 -> 最近的位置
+	int32_t* prev;            // 位置 -> 同一哈希的前一个位置
+	unsigned char* literals;
+	unsigned char* sequences;
+	unsigned char* out;
+	unsigned char* plain;     // 不用字典压缩的结果
+} Packer;
+
+typedef struct
+{
+	uint32_t start;           // 在样本中的位置
+	uint64_t score;
+} Segment;
+
+static uint64_t hashBytes(uint64_t hash, const unsigned char* p, size_t length)
+{
+	// FNV-1a
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ p[i]) * 0x100000001B3ULL;
+	return hash;
+}
+
+static size_t putVarint(unsigned char* out, uint64_t value)
+{
+	size_t n = 0;
+	while (value >= 0x80)
+	{
+		out[n++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	out[n++] = (unsigned char)value;
+	return n;
+}
+
+static int getVarint(const unsigned char** p, const unsigned char* end, uint64_t* value)
+{
+	uint64_t v = 0;
+	for (int shift = 0; shift < 64 && *p < end; shift += 7)
+	{
+		unsigned char b = *(*p)++;
+		v |= (uint64_t)(b & 0x7F) << shift;
+		if (b < 0x80)
+		{
+			*value = v;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static size_t putRun(unsigned char* out, size_t value)
+{
+	// 长度超出4位字段的部分: 若干个255再加一个小于255的字节
+	size_t n = 0;
+	while (value >= 255)
+	{
+		out[n++] = 255;
+		value -= 255;
+	}
+	out[n++] = (unsigned char)value;
+	return n;
+}
+
+static int getRun(const unsigned char** p, const unsigned char* end, size_t* value)
+{
+	unsigned char b;
+	do
+	{
+		if (*p >= end)
+			return -1;
+		b = *(*p)++;
+		*value += b;
+	} while (b == 255);
+	return 0;
+}
+
+// ---------------------------------------------------------------- 字典训练
+
+static uint32_t hashDmer(const unsigned char* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> (64 - DMER_BITS));
+}
+
+static unsigned char* loadSample(const char* const* files, int count, size_t* length)
+{
+	// 每个文件按大小分到一份额度, 在文件里等距地取ARCHIVE_SAMPLE_PIECE字节的片段
+	uint64_t total = 0;
+	uint64_t* sizes = calloc(count > 0 ? count : 1, sizeof(uint64_t));
+	if (sizes == NULL)
+		return NULL;
+	for (int i = 0; i < count; i++)
+	{
+		FILE* fp = fopen(files[i], "rb");
+		if (fp != NULL && fseeko(fp, 0, SEEK_END) == 0)
+		{
+			long long end = ftello(fp);
+			sizes[i] = end > 0 ? (uint64_t)end : 0;
+		}
+		if (fp != NULL)
+			fclose(fp);
+		total += sizes[i];
+	}
+	size_t budget = total < ARCHIVE_SAMPLE ? (size_t)total : ARCHIVE_SAMPLE;
+	unsigned char* sample = malloc(budget ? budget : 1);
+	size_t used = 0;
+	for (int i = 0; sample != NULL && i < count; i++)
+	{
+		if (sizes[i] == 0)
+			continue;
+		size_t share = (size_t)((double)budget * sizes[i] / total);
+		uint64_t pieces = share / ARCHIVE_SAMPLE_PIECE ? share / ARCHIVE_SAMPLE_PIECE : 1;
+		uint64_t stride = sizes[i] / pieces;
+		FILE* fp = fopen(files[i], "rb");
+		if (fp == NULL)
+			continue;
+		for (uint64_t k = 0; k < pieces && used < budget; k++)
+		{
+			uint64_t at = k * stride;
+			size_t want = sizes[i] - at < ARCHIVE_SAMPLE_PIECE ? (size_t)(sizes[i] - at) : ARCHIVE_SAMPLE_PIECE;
+			if (want > budget - used)
+				want = budget - used;
+			if (fseeko(fp, (long long)at, SEEK_SET) != 0)
+				break;
+			used += fread(sample + used, 1, want, fp);
+		}
+		fclose(fp);
+	}
+	free(sizes);
+	*length = used;
+	return sample;
+}
+
+static int compareSegments(const void* a, const void* b)
+{
+	const Segment* x = a;
+	const Segment* y = b;
+	if (x->score != y->score)
+		return x->score < y->score ? -1 : 1;
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+int archiveTrain(const char* const* files, int count, unsigned char* dict, size_t* dictSize)
+{
+	// dict至少要有ARCHIVE_DICT字节; 样本不比字典大时整个样本就是字典
+	// 样本分成ARCHIVE_DICT / ARCHIVE_SEGMENT段, 每段挑一个片段; 挑中的片段里的8字节串计数清零, 后面不再重复挑
+	size_t length;
+	unsigned char* sample = loadSample(files, count, &length);
+	if (sample == NULL)
+		return -1;
+	if (length <= ARCHIVE_DICT)
+	{
+		memcpy(dict, sample, length);
+		*dictSize = length;
+		free(sample);
+		return 0;
+	}
+	uint32_t* freq = calloc((size_t)1 << DMER_BITS, sizeof(uint32_t));
+	uint32_t epochs = ARCHIVE_DICT / ARCHIVE_SEGMENT;
+	Segment* segments = malloc(epochs * sizeof(Segment));
+	if (freq == NULL || segments == NULL)
+	{
+		free(sample);
+		free(freq);
+		free(segments);
+		return -1;
+	}
+	for (size_t i = 0; i + ARCHIVE_DMER <= length; i++)
+	{
+		uint32_t h = hashDmer(sample + i);
+		if (freq[h] != UINT32_MAX)
+			freq[h]++;
+	}
+	size_t epochLength = length / epochs, chosen = 0;
+	const size_t dmers = ARCHIVE_SEGMENT - ARCHIVE_DMER + 1;
+	for (uint32_t e = 0; e < epochs; e++)
+	{
+		size_t from = e * epochLength, to = e + 1 == epochs ? length : from + epochLength;
+		if (to - from < ARCHIVE_SEGMENT)
+			continue;
+		// 窗口内各个8字节串的计数之和, 窗口每右移一个字节加一项减一项
+		uint64_t sum = 0, best = 0;
+		size_t bestStart = from;
+		for (size_t j = 0; j < dmers; j++)
+			sum += freq[hashDmer(sample + from + j)];
+		best = sum;
+		for (size_t s = from + 1; s + ARCHIVE_SEGMENT <= to; s++)
+		{
+			sum += freq[hashDmer(sample + s + dmers - 1)];
+			sum -= freq[hashDmer(sample + s - 1)];
+			if (sum > best)
+			{
+				best = sum;
+				bestStart = s;
+			}
+		}
+		if (best == 0)
+			continue;
+		segments[chosen].start = (uint32_t)bestStart;
+		segments[chosen++].score = best;
+		for (size_t j = 0; j < dmers; j++)
+			freq[hashDmer(sample + bestStart + j)] = 0;
+	}
+	// 分高的放在最后, 离块最近, 匹配的偏移最短
+	qsort(segments, chosen, sizeof(Segment), compareSegments);
+	for (size_t i = 0; i < chosen; i++)
+		memcpy(dict + i * ARCHIVE_SEGMENT, sample + segments[i].start, ARCHIVE_SEGMENT);
+	*dictSize = chosen * ARCHIVE_SEGMENT;
+	free(sample);
+	free(freq);
+	free(segments);
+	return 0;
+}
+
+// ---------------------------------------------------------------- 哈夫曼编码
+
+static void buildLengths(const uint32_t* counts, uint8_t* lengths)
+{
+	// 两个队列合并出哈夫曼树; 最长超过ARCHIVE_CODE_MAX时把计数减半(不为0的至少留1)重来
+	uint32_t weight[512];
+	uint16_t parent[512];
+	uint16_t symbols[256];
+	uint32_t scaled[256];
+	memcpy(scaled, counts, sizeof(scaled));
+	for (;;)
+	{
+		int n = 0;
+		memset(lengths, 0, 256);
+		for (int s = 0; s < 256; s++)
+		{
+			if (scaled[s] > 0)
+				symbols[n++] = (uint16_t)s;
+		}
+		if (n == 0)
+			return;
+		if (n == 1)
+		{
+			lengths[symbols[0]] = 1;
+			return;
+		}
+		// 叶子按计数从小到大插入排序, 只有256个
+		for (int i = 1; i < n; i++)
+		{
+			uint16_t s = symbols[i];
+			int j = i;
+			while (j > 0 && scaled[symbols[j - 1]] > scaled[s])
+			{
+				symbols[j] = symbols[j - 1];
+				j--;
+			}
+			symbols[j] = s;
+		}
+		for (int i = 0; i < n; i++)
+			weight[i] = scaled[symbols[i]];
+		int leaf = 0, node = n, next = n;
+		while (next < 2 * n - 1)
+		{
+			int pick[2];
+			for (int k = 0; k < 2; k++)
+			{
+				if (leaf < n && (node >= next || weight[leaf] <= weight[node]))
+					pick[k] = leaf++;
+				else
+					pick[k] = node++;
+			}
+			weight[next] = weight[pick[0]] + weight[pick[1]];
+			parent[pick[0]] = parent[pick[1]] = (uint16_t)next;
+			next++;
+		}
+		// 根是最后一个节点, 深度从根往下推
+		uint8_t depth[512];
+		int longest = 0;
+		depth[next - 1] = 0;
+		for (int i = next - 2; i >= 0; i--)
+		{
+			depth[i] = (uint8_t)(depth[parent[i]] + 1);
+			if (i < n && depth[i] > longest)
+				longest = depth[i];
+		}
+		if (longest <= ARCHIVE_CODE_MAX)
+		{
+			for (int i = 0; i < n; i++)
+				lengths[symbols[i]] = depth[i];
+			return;
+		}
+		for (int s = 0; s < 256; s++)
+			scaled[s] = scaled[s] ? (scaled[s] + 1) / 2 : 0;
+	}
+}
+
+static int assignCodes(const uint8_t* lengths, uint16_t* codes)
+{
+	// 范式哈夫曼码, 按码长再按字节值分配; 码按位反转存放, 输出和查表都从低位开始; 长度不构成前缀码时返回-1
+	uint32_t count[ARCHIVE_CODE_MAX + 1] = { 0 };
+	uint32_t next[ARCHIVE_CODE_MAX + 2];
+	uint32_t space = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		if (lengths[s] > ARCHIVE_CODE_MAX)
+			return -1;
+		count[lengths[s]]++;
+		if (lengths[s] > 0)
+			space += 1u << (ARCHIVE_CODE_MAX - lengths[s]);
+	}
+	if (space > (1u << ARCHIVE_CODE_MAX))
+		return -1;
+	uint32_t code = 0;
+	count[0] = 0;
+	for (int len = 1; len <= ARCHIVE_CODE_MAX; len++)
+	{
+		code = (code + count[len - 1]) << 1;
+		next[len] = code;
+	}
+	for (int s = 0; s < 256; s++)
+	{
+		int len = lengths[s];
+		if (len == 0)
+			continue;
+		uint32_t c = next[len]++, r = 0;
+		for (int k = 0; k < len; k++)
+			r |= ((c >> k) & 1) << (len - 1 - k);
+		codes[s] = (uint16_t)r;
+	}
+	return 0;
+}
+
+static size_t encodeLiterals(const unsigned char* literals, size_t count, unsigned char* out)
+{
+	// 输出: 方式字节, 哈夫曼时接着128字节的码长(每个4位)和码流的字节数; 编码不更短时原样存放
+	uint32_t counts[256] = { 0 };
+	uint8_t lengths[256];
+	uint16_t codes[256];
+	for (size_t i = 0; i < count; i++)
+		counts[literals[i]]++;
+	buildLengths(counts, lengths);
+	uint64_t bits = 0;
+	for (int s = 0; s < 256; s++)
+		bits += (uint64_t)counts[s] * lengths[s];
+	size_t n = 0;
+	if (count < 256 || 1 + 128 + 10 + (bits + 7) / 8 >= 1 + count || assignCodes(lengths, codes) != 0)
+	{
+		out[n++] = LITERAL_RAW;
+		memcpy(out + n, literals, count);
+		return n + count;
+	}
+	out[n++] = LITERAL_HUFFMAN;
+	for (int s = 0; s < 256; s += 2)
+		out[n++] = (unsigned char)(lengths[s] | lengths[s + 1] << 4);
+	n += putVarint(out + n, (bits + 7) / 8);
+	uint64_t buffer = 0;
+	int filled = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		buffer |= (uint64_t)codes[literals[i]] << filled;
+		filled += lengths[literals[i]];
+		while (filled >= 8)
+		{
+			out[n++] = (unsigned char)buffer;
+			buffer >>= 8;
+			filled -= 8;
+		}
+	}
+	if (filled > 0)
+		out[n++] = (unsigned char)buffer;
+	return n;
+}
+
+static int decodeLiterals(const unsigned char** p, const unsigned char* end, unsigned char* literals, size_t count)
+{
+	if (*p >= end)
+		return -1;
+	int mode = *(*p)++;
+	if (mode == LITERAL_RAW)
+	{
+		if ((size_t)(end - *p) < count)
+			return -1;
+		memcpy(literals, *p, count);
+		*p += count;
+		return 0;
+	}
+	if (mode != LITERAL_HUFFMAN || end - *p < 128)
+		return -1;
+	uint8_t lengths[256];
+	uint16_t codes[256];
+	uint16_t table[1 << ARCHIVE_CODE_MAX];   // 低8位是字节, 高8位是码长, 0表示非法
+	for (int s = 0; s < 256; s += 2)
+	{
+		lengths[s] = (*p)[s / 2] & 15;
+		lengths[s + 1] = (*p)[s / 2] >> 4;
+	}
+	*p += 128;
+	uint64_t bytes;
+	if (assignCodes(lengths, codes) != 0 || getVarint(p, end, &bytes) != 0 || bytes > (uint64_t)(end - *p))
+		return -1;
+	memset(table, 0, sizeof(table));
+	for (int s = 0; s < 256; s++)
+	{
+		int len = lengths[s];
+		for (uint32_t k = codes[s]; len > 0 && k < (1u << ARCHIVE_CODE_MAX); k += 1u << len)
+			table[k] = (uint16_t)(s | len << 8);
+	}
+	const unsigned char* in = *p;
+	const unsigned char* stop = in + bytes;
+	uint64_t buffer = 0;
+	int filled = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		while (filled <= 56 && in < stop)
+		{
+			buffer |= (uint64_t)*in++ << filled;
+			filled += 8;
+		}
+		uint16_t entry = table[buffer & ((1u << ARCHIVE_CODE_MAX) - 1)];
+		int len = entry >> 8;
+		if (len == 0 || len > filled)
+			return -1;
+		literals[i] = (unsigned char)entry;
+		buffer >>= len;
+		filled -= len;
+	}
+	*p = stop;
+	return 0;
+}
+
+// ---------------------------------------------------------------- 块的压缩和解压
+
+static uint32_t hash4(const unsigned char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static size_t matchLength(const unsigned char* a, const unsigned char* b, size_t limit)
+{
+	size_t n = 0;
+	while (n + 8 <= limit)
+	{
+		uint64_t x, y;
+		memcpy(&x, a + n, 8);
+		memcpy(&y, b + n, 8);
+		if (x != y)
+			break;
+		n += 8;
+	}
+	while (n < limit && a[n] == b[n])
+		n++;
+	return n;
+}
+
+static size_t findMatch(const Packer* pk, size_t pos, size_t end, size_t* offset)
+{
+	// pos之前的位置都已经进了哈希链
+	const unsigned char* w = pk->window;
+	int32_t candidate = pk->head[hash4(w + pos)];
+	size_t best = 0;
+	for (int depth = 0; candidate >= 0 && depth < ARCHIVE_CHAIN; depth++)
+	{
+		size_t n = matchLength(w + candidate, w + pos, end - pos);
+		if (n > best)
+		{
+			best = n;
+			*offset = pos - (size_t)candidate;
+			if (pos + n == end)
+				break;
+		}
+		candidate = pk->prev[candidate];
+	}
+	return best;
+}
+
+static size_t putSequence(unsigned char* out, size_t literals, size_t match, size_t offset)
+{
+	// 标记字节: 高4位字面字节数, 低4位匹配长度 - ARCHIVE_MATCH_MIN, 15表示后面还有; match为0时是最后一组
+	size_t n = 1;
+	size_t extra = match ? match - ARCHIVE_MATCH_MIN : 0;
+	out[0] = (unsigned char)((literals < 15 ? literals : 15) << 4 | (extra < 15 ? extra : 15));
+	if (literals >= 15)
+		n += putRun(out + n, literals - 15);
+	if (match == 0)
+		return n;
+	n += putVarint(out + n, offset);
+	if (extra >= 15)
+		n += putRun(out + n, extra - 15);
+	return n;
+}
+
+static size_t compressBlock(Packer* pk, size_t dictSize, size_t length)
+{
+	// window[dictSize, dictSize + length)压缩到pk->out, 返回字节数
+	unsigned char* w = pk->window;
+	size_t end = dictSize + length, inserted = 0, pos = dictSize, anchor = dictSize;
+	size_t literalCount = 0, sequenceLength = 0;
+	for (size_t i = 0; i < ((size_t)1 << HASH_BITS); i++)
+		pk->head[i] = -1;
+	while (pos + ARCHIVE_MATCH_MIN <= end)
+	{
+		for (; inserted < pos; inserted++)
+		{
+			uint32_t h = hash4(w + inserted);
+			pk->prev[inserted] = pk->head[h];
+			pk->head[h] = (int32_t)inserted;
+		}
+		size_t offset = 0, match = findMatch(pk, pos, end, &offset);
+		if (match < ARCHIVE_MATCH_MIN)
+		{
+			pos++;
+			continue;
+		}
+		// 懒惰匹配: 下一个位置的匹配更长时, 这个字节作为字面字节
+		if (pos + 1 + ARCHIVE_MATCH_MIN <= end)
+		{
+			uint32_t h = hash4(w + pos);
+			pk->prev[pos] = pk->head[h];
+			pk->head[h] = (int32_t)pos;
+			inserted = pos + 1;
+			size_t offset2 = 0, match2 = findMatch(pk, pos + 1, end, &offset2);
+			if (match2 > match)
+			{
+				pos++;
+				match = match2;
+				offset = offset2;
+			}
+		}
+		size_t n = pos - anchor;
+		memcpy(pk->literals + literalCount, w + anchor, n);
+		literalCount += n;
+		sequenceLength += putSequence(pk->sequences + sequenceLength, n, match, offset);
+		pos += match;
+		anchor = pos;
+	}
+	size_t n = end - anchor;
+	memcpy(pk->literals + literalCount, w + anchor, n);
+	literalCount += n;
+	sequenceLength += putSequence(pk->sequences + sequenceLength, n, 0, 0);
+	size_t size = 0;
+	pk->out[size++] = ARCHIVE_LZ;
+	size += putVarint(pk->out + size, literalCount);
+	size += encodeLiterals(pk->literals, literalCount, pk->out + size);
+	memcpy(pk->out + size, pk->sequences, sequenceLength);
+	size += sequenceLength;
+	if (size >= 1 + length)
+	{
+		pk->out[0] = ARCHIVE_STORED;
+		memcpy(pk->out + 1, w + dictSize, length);
+		size = 1 + length;
+	}
+	return size;
+}
+
+static int decompressBlock(const unsigned char* in, size_t size, unsigned char* window, size_t dictSize,
+	size_t length, unsigned char* literals)
+{
+	// 解到window[dictSize, dictSize + length), 匹配可以引用字典; 任何越界都当作损坏
+	const unsigned char* p = in;
+	const unsigned char* end = in + size;
+	if (size == 0)
+		return -1;
+	int type = *p++;
+	unsigned char* out = window + dictSize;
+	if (type == ARCHIVE_STORED)
+	{
+		if ((size_t)(end - p) != length)
+			return -1;
+		memcpy(out, p, length);
+		return 0;
+	}
+	uint64_t literalCount;
+	if (type != ARCHIVE_LZ || getVarint(&p, end, &literalCount) != 0 || literalCount > length
+		|| decodeLiterals(&p, end, literals, (size_t)literalCount) != 0)
+		return -1;
+	size_t produced = 0, used = 0;
+	for (;;)
+	{
+		if (p >= end)
+			return -1;
+		unsigned char token = *p++;
+		size_t n = token >> 4, match = token & 15;
+		if (n == 15 && getRun(&p, end, &n) != 0)
+			return -1;
+		if (n > literalCount - used || n > length - produced)
+			return -1;
+		memcpy(out + produced, literals + used, n);
+		used += n;
+		produced += n;
+		if (produced == length)
+			break;
+		uint64_t offset;
+		if (getVarint(&p, end, &offset) != 0 || (match == 15 && getRun(&p, end, &match) != 0))
+			return -1;
+		match += ARCHIVE_MATCH_MIN;
+		if (offset == 0 || offset > dictSize + produced || match > length - produced)
+			return -1;
+		// 重叠的复制要逐字节进行
+		unsigned char* to = out + produced;
+		const unsigned char* from = to - offset;
+		if (offset >= match)
+			memcpy(to, from, match);
+		else
+		{
+			for (size_t i = 0; i < match; i++)
+				to[i] = from[i];
+		}
+		produced += match;
+	}
+	return p == end && used == literalCount ? 0 : -1;
+}
+
+// ---------------------------------------------------------------- 压缩包
+
+int archiveIsPacked(const char* path)
+{
+	size_t n = strlen(path), suffix = strlen(ARCHIVE_SUFFIX);
+	return n > suffix && strcmp(path + n - suffix, ARCHIVE_SUFFIX) == 0;
+}
+
+void archiveDictPath(const char* path, uint64_t hash, char* dictPath, size_t size)
+{
+	// 字典文件与压缩包在同一目录, 文件名是16位十六进制的哈希
+	const char* name = path;
+	for (const char* p = path; *p; p++)
+	{
+		if (*p == '/' || *p == '\\')
+			name = p + 1;
+	}
+	snprintf(dictPath, size, "%.*s%016llx%s", (int)(name - path), path, (unsigned long long)hash, ARCHIVE_DICT_SUFFIX);
+}
+
+int archiveSaveDict(const char* path, const unsigned char* dict, size_t dictSize)
+{
+	// 把压缩包path用到的字典存成共享的字典文件; 文件名由内容的哈希决定, 已有同名且长度相同的文件就不再写
+	char dictPath[1024], temp[1040];
+	archiveDictPath(path, hashBytes(0xCBF29CE484222325ULL, dict, dictSize), dictPath, sizeof(dictPath));
+	FILE* fp = fopen(dictPath, "rb");
+	if (fp != NULL)
+	{
+		long long size = fseeko(fp, 0, SEEK_END) == 0 ? ftello(fp) : -1;
+		fclose(fp);
+		if (size == (long long)dictSize)
+			return 0;
+	}
+	snprintf(temp, sizeof(temp), "%s.tmp", dictPath);
+	fp = fopen(temp, "wb");
+	if (fp == NULL)
+		return -1;
+	int failed = fwrite(dict, 1, dictSize, fp) != dictSize;
+	if (fclose(fp) != 0 || failed)
+	{
+		remove(temp);
+		return -1;
+	}
+#ifdef _WIN32
+	remove(dictPath);
+#endif
+	return rename(temp, dictPath);
+}
+
+int archivePack(const char* path, const char* text, const unsigned char* dict, size_t dictSize,
+	const ChapterIndex* index, ArchiveStats* stats)
+{
+	// 依次是文件头、各块、块偏移表、章回表; 先写临时文件再改名. 用到字典时(stats->shared不为0)
+	// 文件头记下字典的长度和哈希, 字典本身由调用者用archiveSaveDict存成共享的字典文件
+	char temp[1024];
+	double start = copyNow();
+	ArchiveHeader header;
+	Packer pk;
+	memset(&header, 0, sizeof(header));
+	memset(stats, 0, sizeof(*stats));
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+	FILE* in = fopen(text, "rb");
+	if (in == NULL)
+		return -1;
+	long long size = fseeko(in, 0, SEEK_END) == 0 ? ftello(in) : -1;
+	rewind(in);
+	uint64_t blocks = size > 0 ? ((uint64_t)size + ARCHIVE_BLOCK - 1) / ARCHIVE_BLOCK : 0;
+	uint64_t* table = malloc((size_t)(blocks + 1) * sizeof(uint64_t));
+	pk.window = malloc(dictSize + ARCHIVE_BLOCK);
+	pk.head = malloc(((size_t)1 << HASH_BITS) * sizeof(int32_t));
+	pk.prev = malloc((dictSize + ARCHIVE_BLOCK) * sizeof(int32_t));
+	pk.literals = malloc(ARCHIVE_BLOCK);
+	pk.sequences = malloc(PACKED_MAX(ARCHIVE_BLOCK));
+	pk.out = malloc(PACKED_MAX(ARCHIVE_BLOCK));
+	pk.plain = malloc(PACKED_MAX(ARCHIVE_BLOCK));
+	FILE* out = NULL;
+	int result = -1;
+	if (size < 0 || table == NULL || pk.window == NULL || pk.head == NULL || pk.prev == NULL || pk.literals == NULL
+		|| pk.sequences == NULL || pk.out == NULL || pk.plain == NULL || (out = fopen(temp, "wb")) == NULL)
+		goto done;
+	memcpy(header.magic, ARCHIVE_MAGIC, 4);
+	header.version = ARCHIVE_VERSION;
+	header.blockSize = ARCHIVE_BLOCK;
+	header.chapterCount = index->count;
+	header.size = (uint64_t)size;
+	header.blockCount = blocks;
+	header.check = 0xCBF29CE484222325ULL;
+	memcpy(pk.window, dict, dictSize);
+	uint64_t at = sizeof(header), plain = sizeof(header);
+	if (fwrite(&header, sizeof(header), 1, out) != 1)
+		goto done;
+	for (uint64_t k = 0; k < blocks; k++)
+	{
+		size_t want = (uint64_t)size - k * ARCHIVE_BLOCK < ARCHIVE_BLOCK ? (size_t)((uint64_t)size - k * ARCHIVE_BLOCK) : ARCHIVE_BLOCK;
+		if (fread(pk.window + dictSize, 1, want, in) != want)
+			goto done;
+		header.check = hashBytes(header.check, pk.window + dictSize, want);
+		size_t n = compressBlock(&pk, dictSize, want), m = n;
+		const unsigned char* packed = pk.out;
+		if (dictSize > 0)
+		{
+			// 不用字典时把块当作从窗口开头起, 匹配引用不到字典, 解压时窗口前面有没有字典都一样
+			Packer alone = pk;
+			alone.window = pk.window + dictSize;
+			alone.out = pk.plain;
+			m = compressBlock(&alone, 0, want);
+			if (m <= n)
+			{
+				packed = pk.plain;
+				n = m;
+			}
+			else
+				stats->shared++;
+		}
+		stats->stored += packed[0] == ARCHIVE_STORED;
+		table[k] = at;
+		at += n;
+		plain += m;
+		if (fwrite(packed, 1, n, out) != n)
+			goto done;
+	}
+	if (stats->shared > 0)
+	{
+		header.dictSize = (uint32_t)dictSize;
+		header.dictHash = hashBytes(0xCBF29CE484222325ULL, dict, dictSize);
+	}
+	table[blocks] = at;
+	header.tableOffset = at;
+	header.chapterOffset = at + (blocks + 1) * sizeof(uint64_t);
+	if (fwrite(table, sizeof(uint64_t), (size_t)(blocks + 1), out) != blocks + 1
+		|| fwrite(index->entries, sizeof(ChapterEntry), index->count, out) != index->count
+		|| fseeko(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1)
+		goto done;
+	stats->bytes = (unsigned long long)size;
+	stats->packed = header.chapterOffset + (uint64_t)index->count * sizeof(ChapterEntry);
+	stats->plain = plain + (blocks + 1) * sizeof(uint64_t) + (uint64_t)index->count * sizeof(ChapterEntry);
+	result = 0;
+done:
+	if (out != NULL && fclose(out) != 0)
+		result = -1;
+	if (out != NULL && result != 0)
+		remove(temp);
+	if (result == 0)
+	{
+#ifdef _WIN32
+		remove(path);
+#endif
+		result = rename(temp, path);
+	}
+	fclose(in);
+	free(table);
+	free(pk.window);
+	free(pk.head);
+	free(pk.prev);
+	free(pk.literals);
+	free(pk.sequences);
+	free(pk.out);
+	free(pk.plain);
+	stats->seconds = copyNow() - start;
+	return result;
+}
+
+void archiveClose(Archive* a)
+{
+	if (a->fp != NULL)
+		fclose(a->fp);
+	free(a->table);
+	free(a->window);
+	free(a->packed);
+	free(a->literals);
+	memset(a, 0, sizeof(*a));
+}
+
+int archiveOpen(Archive* a, const char* path)
+{
+	// 读入文件头、块偏移表和共享的字典文件, 检查各部分都在文件范围内、字典的长度和哈希与文件头相符
+	memset(a, 0, sizeof(*a));
+	a->cached = UINT64_MAX;
+	a->fp = fopen(path, "rb");
+	if (a->fp == NULL)
+		return -1;
+	ArchiveHeader* h = &a->header;
+	long long fileSize = fseeko(a->fp, 0, SEEK_END) == 0 ? ftello(a->fp) : -1;
+	if (fileSize < (long long)sizeof(*h) || fseeko(a->fp, 0, SEEK_SET) != 0 || fread(h, sizeof(*h), 1, a->fp) != 1
+		|| memcmp(h->magic, ARCHIVE_MAGIC, 4) != 0 || h->version != ARCHIVE_VERSION
+		|| h->blockSize == 0 || h->blockSize > (16 << 20) || h->dictSize > (16 << 20)
+		|| h->blockCount != (h->size + h->blockSize - 1) / h->blockSize
+		|| h->tableOffset < sizeof(*h) || h->tableOffset > (uint64_t)fileSize
+		|| h->blockCount >= ((uint64_t)fileSize - h->tableOffset) / sizeof(uint64_t)
+		|| h->chapterOffset != h->tableOffset + (h->blockCount + 1) * sizeof(uint64_t)
+		|| h->chapterCount > ((uint64_t)fileSize - h->chapterOffset) / sizeof(ChapterEntry))
+		goto fail;
+	a->table = malloc((size_t)(h->blockCount + 1) * sizeof(uint64_t));
+	a->window = malloc((size_t)h->dictSize + h->blockSize);
+	a->packed = malloc(PACKED_MAX(h->blockSize));
+	a->literals = malloc(h->blockSize);
+	if (a->table == NULL || a->window == NULL || a->packed == NULL || a->literals == NULL
+		|| fseeko(a->fp, (long long)h->tableOffset, SEEK_SET) != 0
+		|| fread(a->table, sizeof(uint64_t), (size_t)(h->blockCount + 1), a->fp) != h->blockCount + 1)
+		goto fail;
+	if (h->dictSize > 0)
+	{
+		char dictPath[1024];
+		unsigned char extra;
+		archiveDictPath(path, h->dictHash, dictPath, sizeof(dictPath));
+		FILE* fp = fopen(dictPath, "rb");
+		int valid = fp != NULL && fread(a->window, 1, h->dictSize, fp) == h->dictSize && fread(&extra, 1, 1, fp) == 0
+			&& hashBytes(0xCBF29CE484222325ULL, a->window, h->dictSize) == h->dictHash;
+		if (fp != NULL)
+			fclose(fp);
+		if (!valid)
+			goto fail;
+	}
+	for (uint64_t k = 0; k < h->blockCount; k++)
+	{
+		if (a->table[k] < sizeof(*h) || a->table[k + 1] <= a->table[k]
+			|| a->table[k + 1] - a->table[k] > PACKED_MAX(h->blockSize) || a->table[k + 1] > h->tableOffset)
+			goto fail;
+	}
+	return 0;
+fail:
+	archiveClose(a);
+	return -1;
+}
+
+static int loadBlock(Archive* a, uint64_t k)
+{
+	// 最近解压的一块留在window里, 顺序读同一块时不重复解压
+	const ArchiveHeader* h = &a->header;
+	if (a->cached == k)
+		return 0;
+	a->cached = UINT64_MAX;
+	size_t size = (size_t)(a->table[k + 1] - a->table[k]);
+	size_t length = h->size - k * h->blockSize < h->blockSize ? (size_t)(h->size - k * h->blockSize) : h->blockSize;
+	if (fseeko(a->fp, (long long)a->table[k], SEEK_SET) != 0 || fread(a->packed, 1, size, a->fp) != size
+		|| decompressBlock(a->packed, size, a->window, h->dictSize, length, a->literals) != 0)
+		return -1;
+	a->cached = k;
+	return 0;
+}
+
+int archiveRead(Archive* a, uint64_t offset, void* buffer, size_t size, size_t* length)
+{
+	// 与chapterRead相同: 读到原文末尾时length小于size
+	const ArchiveHeader* h = &a->header;
+	unsigned char* out = buffer;
+	*length = 0;
+	while (size > 0 && offset < h->size)
+	{
+		uint64_t k = offset / h->blockSize;
+		if (loadBlock(a, k) != 0)
+			return -1;
+		size_t in = (size_t)(offset - k * h->blockSize);
+		size_t available = (h->size - k * h->blockSize < h->blockSize ? (size_t)(h->size - k * h->blockSize) : h->blockSize) - in;
+		size_t n = available < size ? available : size;
+		memcpy(out, a->window + h->dictSize + in, n);
+		out += n;
+		*length += n;
+		offset += n;
+		size -= n;
+	}
+	return 0;
+}
+
+int archiveChapters(const Archive* a, ChapterIndex* index)
+{
+	// 章回表在打包时由原文建好, 整个原文都算已扫描
+	const ArchiveHeader* h = &a->header;
+	chapterIndexInit(index);
+	index->entries = malloc((h->chapterCount ? h->chapterCount : 1) * sizeof(ChapterEntry));
+	if (index->entries == NULL || fseeko(a->fp, (long long)h->chapterOffset, SEEK_SET) != 0
+		|| fread(index->entries, sizeof(ChapterEntry), h->chapterCount, a->fp) != h->chapterCount)
+	{
+		chapterIndexFree(index);
+		return -1;
+	}
+	index->count = index->capacity = h->chapterCount;
+	index->scanned = index->resume = h->size;
+	for (uint32_t i = 0; i < index->count; i++)
+	{
+		if (index->entries[i].offset >= h->size || (i > 0 && index->entries[i].offset <= index->entries[i - 1].offset))
+		{
+			chapterIndexFree(index);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int archiveUnpack(Archive* a, FILE* out)
+{
+	// 解出全文并校验哈希
+	const ArchiveHeader* h = &a->header;
+	uint64_t check = 0xCBF29CE484222325ULL;
+	for (uint64_t k = 0; k < h->blockCount; k++)
+	{
+		size_t length = h->size - k * h->blockSize < h->blockSize ? (size_t)(h->size - k * h->blockSize) : h->blockSize;
+		if (loadBlock(a, k) != 0 || fwrite(a->window + h->dictSize, 1, length, out) != length)
+			return -1;
+		check = hashBytes(check, a->window + h->dictSize, length);
+	}
+	return check == h->check ? 0 : -1;
+}
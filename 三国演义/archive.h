@@ -0,0 +1,85 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "chapter.h"
+
+// 压缩包: 原文按ARCHIVE_BLOCK切块, 每块单独压缩, 块偏移表记下每块在包里的位置, 读任意一段只解压用到的块
+// 每块的压缩: LZ77(哈希链, 一步懒惰匹配)把块接在字典后面找重复, 字面字节再用限长的范式哈夫曼编码
+// 字典从整个语料取样训练: 对8字节片段计频, 每段样本里挑出片段频率之和最大的256字节, 高分的放在字典末尾
+// 字典不放进包里: 同一次打包的各个包共用一个字典文件, 与包在同一目录, 文件名是字典的哈希;
+// 每块用字典和不用字典各压一次取小的, 没有一块用到字典的包不依赖字典文件
+// 包里同时存着章回索引, 读第N回时不需要原文
+
+#define ARCHIVE_MAGIC "SGAR"
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_SUFFIX ".sga"
+#define ARCHIVE_DICT_SUFFIX ".sgd"
+#define ARCHIVE_BLOCK (64 << 10)       // 原文每块64KB
+#define ARCHIVE_DICT (32 << 10)        // 字典32KB
+#define ARCHIVE_SAMPLE (16 << 20)      // 训练字典最多取样16MB
+#define ARCHIVE_SAMPLE_PIECE 4096      // 样本在各文件里均匀地取, 每段4KB
+#define ARCHIVE_SEGMENT 256            // 字典由256字节的片段组成
+#define ARCHIVE_DMER 8                 // 训练时计频的片段长度
+#define ARCHIVE_MATCH_MIN 4
+#define ARCHIVE_CHAIN 32               // 找匹配时沿哈希链最多看32个位置
+#define ARCHIVE_CODE_MAX 11            // 哈夫曼码最长11位, 解码查一张2048项的表
+
+typedef enum
+{
+	ARCHIVE_STORED,           // 压缩后不更小, 原样存放
+	ARCHIVE_LZ                // LZ77 + 字面字节的哈夫曼编码
+} ArchiveBlockType;
+
+typedef struct
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t blockSize;
+	uint32_t dictSize;        // 0表示不用字典
+	uint32_t chapterCount;
+	uint32_t reserved;
+	uint64_t size;            // 原文长度
+	uint64_t blockCount;
+	uint64_t dictHash;        // 字典的FNV-1a哈希, 由它得出字典文件名
+	uint64_t tableOffset;     // 相对文件开头; blockCount + 1个块偏移, 第一块紧接文件头, 最后一个是压缩数据的末尾
+	uint64_t chapterOffset;   // chapterCount个ChapterEntry
+	uint64_t check;           // 原文的FNV-1a哈希, 解出全文时校验
+} ArchiveHeader;
+
+typedef struct
+{
+	FILE* fp;
+	ArchiveHeader header;
+	uint64_t* table;
+	unsigned char* window;    // 字典, 后面接着解压好的一块
+	unsigned char* packed;    // 读入的压缩块
+	unsigned char* literals;  // 解出的字面字节
+	uint64_t cached;          // window里是哪一块, 没有时为UINT64_MAX
+} Archive;
+
+typedef struct
+{
+	unsigned long long bytes;     // 原文字节数
+	unsigned long long packed;    // 压缩包字节数, 不含字典文件
+	unsigned long long plain;     // 全部块都不用字典时的压缩包字节数
+	unsigned long long stored;    // 原样存放的块数
+	unsigned long long shared;    // 用到字典的块数
+	double seconds;
+} ArchiveStats;
+
+int archiveTrain(const char* const* files, int count, unsigned char* dict, size_t* dictSize);
+int archivePack(const char* path, const char* text, const unsigned char* dict, size_t dictSize,
+	const ChapterIndex* index, ArchiveStats* stats);
+void archiveDictPath(const char* path, uint64_t hash, char* dictPath, size_t size);
+int archiveSaveDict(const char* path, const unsigned char* dict, size_t dictSize);
+int archiveOpen(Archive* a, const char* path);
+void archiveClose(Archive* a);
+int archiveRead(Archive* a, uint64_t offset, void* buffer, size_t size, size_t* length);
+int archiveChapters(const Archive* a, ChapterIndex* index);
+int archiveUnpack(Archive* a, FILE* out);
+int archiveIsPacked(const char* path);
+
+#endif
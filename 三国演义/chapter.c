@@ -0,0 +1,416 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chapter.h"
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+// GBK的中文数字, 十和百是单位, 其余是数位
+static const struct
+{
+	unsigned char code[2];
+	unsigned char value;
+} numerals[] = {
+	{ { 0xC1, 0xE3 }, 0 }, { { 0xA9, 0x96 }, 0 }, { { 0xD2, 0xBB }, 1 }, { { 0xB6, 0xFE }, 2 },
+	{ { 0xC8, 0xFD }, 3 }, { { 0xCB, 0xC4 }, 4 }, { { 0xCE, 0xE5 }, 5 }, { { 0xC1, 0xF9 }, 6 },
+	{ { 0xC6, 0xDF }, 7 }, { { 0xB0, 0xCB }, 8 }, { { 0xBE, 0xC5 }, 9 }, { { 0xCA, 0xAE }, 10 },
+	{ { 0xB0, 0xD9 }, 100 }
+};
+
+void chapterIndexInit(ChapterIndex* index)
+{
+	memset(index, 0, sizeof(*index));
+}
+
+void chapterIndexFree(ChapterIndex* index)
+{
+	free(index->entries);
+	chapterIndexInit(index);
+}
+
+static int numeral(const unsigned char* p, size_t length)
+{
+	// 返回p处一个数字字符的值, 阿拉伯数字(半角或全角)或中文数字; 不是数字返回-1
+	if (length >= 1 && p[0] >= '0' && p[0] <= '9')
+		return p[0] - '0';
+	if (length < 2)
+		return -1;
+	if (p[0] == 0xA3 && p[1] >= 0xB0 && p[1] <= 0xB9)
+		return p[1] - 0xB0;
+	for (size_t i = 0; i < sizeof(numerals) / sizeof(numerals[0]); i++)
+	{
+		if (p[0] == numerals[i].code[0] && p[1] == numerals[i].code[1])
+			return numerals[i].value;
+	}
+	return -1;
+}
+
+static int parseHeading(const unsigned char* p, size_t length, uint32_t* number)
+{
+	// 行首(可缩进)是"第" + 数字 + "回"时返回1; "第一百二十回"和"第120回"都得到120
+	size_t i = 0;
+	while (i < length && (p[i] == ' ' || p[i] == '\t' || (p[i] == 0xA1 && i + 1 < length && p[i + 1] == 0xA1)))
+		i += p[i] == 0xA1 ? 2 : 1;
+	if (i + 2 > length || p[i] != 0xB5 || p[i + 1] != 0xDA)
+		return 0;
+	i += 2;
+	uint32_t total = 0, digit = 0;
+	int digits = 0;
+	for (;;)
+	{
+		int value = numeral(p + i, length - i);
+		if (value < 0 || digits == 8)
+			break;
+		if (value >= 10)
+		{
+			total += (digit ? digit : 1) * value;
+			digit = 0;
+		}
+		else
+			digit = digit * 10 + value;
+		i += p[i] < 0x80 ? 1 : 2;
+		digits++;
+	}
+	if (digits == 0 || i + 2 > length || p[i] != 0xBB || p[i + 1] != 0xD8)
+		return 0;
+	*number = total + digit;
+	return 1;
+}
+
+static int addEntry(ChapterIndex* index, uint64_t offset, uint32_t number, uint32_t titleLength)
+{
+	if (index->count == index->capacity)
+	{
+		uint32_t capacity = index->capacity ? index->capacity * 2 : 128;
+		ChapterEntry* entries = realloc(index->entries, capacity * sizeof(ChapterEntry));
+		if (entries == NULL)
+			return -1;
+		index->entries = entries;
+		index->capacity = capacity;
+	}
+	ChapterEntry* e = &index->entries[index->count++];
+	e->offset = offset;
+	e->number = number;
+	e->titleLength = titleLength;
+	return 0;
+}
+
+int chapterRead(FILE* fp, uint64_t offset, void* buffer, size_t size, size_t* length)
+{
+	if (fseeko(fp, (long long)offset, SEEK_SET) != 0)
+		return -1;
+	*length = fread(buffer, 1, size, fp);
+	return ferror(fp) ? -1 : 0;
+}
+
+static uint64_t hashBytes(uint64_t hash, const unsigned char* p, size_t length)
+{
+	// FNV-1a
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ p[i]) * 0x100000001B3ULL;
+	return hash;
+}
+
+static int checksum(FILE* text, uint64_t size, uint64_t* check)
+{
+	// 只读首尾各CHAPTER_CHECK_BYTES, 代价与文件大小无关; 改动中间内容而长度不变时发现不了
+	unsigned char buffer[CHAPTER_CHECK_BYTES];
+	size_t head = size < CHAPTER_CHECK_BYTES ? (size_t)size : CHAPTER_CHECK_BYTES;
+	size_t length;
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	if (chapterRead(text, 0, buffer, head, &length) != 0 || length != head)
+		return -1;
+	hash = hashBytes(hash, buffer, length);
+	if (chapterRead(text, size - head, buffer, head, &length) != 0 || length != head)
+		return -1;
+	*check = hashBytes(hash, buffer, length) ^ size;
+	return 0;
+}
+
+static size_t boundary(const unsigned char* p, size_t from, size_t limit)
+{
+	// from是字符边界, 向后逐字符走, 返回不超过limit的最后一个字符边界
+	size_t i = from;
+	while (i < limit)
+	{
+		size_t step = p[i] >= 0x81 && p[i] <= 0xFE ? 2 : 1;
+		if (i + step > limit)
+			break;
+		i += step;
+	}
+	return i;
+}
+
+static int scan(ChapterIndex* index, FILE* text, uint64_t from, uint64_t size)
+{
+	// from必须是行首; 行首离读入块末尾不足CHAPTER_HEADING_MAX时留给下一块从这一行读起
+	unsigned char* buffer = malloc(CHAPTER_SCAN_CHUNK);
+	uint64_t pos = from;
+	int lineStart = 1;
+	if (buffer == NULL)
+		return -1;
+	while (pos < size)
+	{
+		size_t n;
+		if (chapterRead(text, pos, buffer, CHAPTER_SCAN_CHUNK, &n) != 0 || n == 0)
+		{
+			free(buffer);
+			return -1;
+		}
+		if (pos + n > size)
+			n = (size_t)(size - pos);
+		int final = pos + n == size;
+		uint64_t next = pos + n;
+		size_t i = 0;
+		while (i < n)
+		{
+			if (lineStart)
+			{
+				size_t rest = n - i;
+				if (!final && rest < CHAPTER_HEADING_MAX && i > 0)
+				{
+					next = pos + i;
+					break;
+				}
+				index->resume = pos + i;
+				uint32_t number;
+				if (parseHeading(buffer + i, rest, &number))
+				{
+					const unsigned char* end = memchr(buffer + i, '\n', rest < CHAPTER_HEADING_MAX ? rest : CHAPTER_HEADING_MAX);
+					size_t title = end ? (size_t)(end - buffer - i) : (rest < CHAPTER_HEADING_MAX ? rest : CHAPTER_HEADING_MAX);
+					if (title > 0 && buffer[i + title - 1] == '\r')
+						title--;
+					title = boundary(buffer + i, 0, title);
+					if (addEntry(index, pos + i, number, (uint32_t)title) != 0)
+					{
+						free(buffer);
+						return -1;
+					}
+				}
+			}
+			const unsigned char* nl = memchr(buffer + i, '\n', n - i);
+			if (nl == NULL)
+			{
+				// 这一行比读入块还长, 下一块开头不是行首
+				lineStart = 0;
+				break;
+			}
+			i = nl - buffer + 1;
+			lineStart = 1;
+		}
+		if (lineStart && i == n)
+			index->resume = pos + n;
+		index->rescanned += next - pos;
+		pos = next;
+	}
+	free(buffer);
+	return 0;
+}
+
+int chapterIndexUpdate(ChapterIndex* index, FILE* text)
+{
+	// 返回0表示索引与文件一致, index->changed表示需要重新保存
+	uint64_t check;
+	index->rescanned = 0;
+	index->changed = 0;
+	if (fseeko(text, 0, SEEK_END) != 0)
+		return -1;
+	long long end = ftello(text);
+	if (end < 0)
+		return -1;
+	uint64_t size = (uint64_t)end;
+	if (size < index->scanned || (index->scanned > 0 && (checksum(text, index->scanned, &check) != 0 || check != index->check)))
+	{
+		// 文件变短或已扫描部分被改过, 从头重建
+		index->count = 0;
+		index->scanned = 0;
+		index->resume = 0;
+		index->changed = 1;
+	}
+	if (size == index->scanned)
+		return 0;
+	// 最后一行在上次扫描时可能还不完整, 去掉它上面的标题后从它的行首重新扫描
+	while (index->count > 0 && index->entries[index->count - 1].offset >= index->resume)
+		index->count--;
+	if (scan(index, text, index->resume, size) != 0 || checksum(text, size, &index->check) != 0)
+		return -1;
+	index->scanned = size;
+	index->changed = 1;
+	return 0;
+}
+
+int chapterIndexLoad(ChapterIndex* index, const char* path)
+{
+	// 索引文件不存在或格式不对时返回-1, index保持为空, 由chapterIndexUpdate从头建立
+	ChapterIndexHeader header;
+	FILE* fp = fopen(path, "rb");
+	chapterIndexInit(index);
+	if (fp == NULL)
+		return -1;
+	int result = -1;
+	if (fread(&header, sizeof(header), 1, fp) == 1 && memcmp(header.magic, CHAPTER_MAGIC, 4) == 0
+		&& header.version == CHAPTER_VERSION && header.resume <= header.scanned)
+	{
+		index->entries = header.count ? malloc(header.count * sizeof(ChapterEntry)) : NULL;
+		index->capacity = header.count;
+		if ((header.count == 0 || index->entries != NULL)
+			&& fread(index->entries, sizeof(ChapterEntry), header.count, fp) == header.count)
+		{
+			index->count = header.count;
+			index->scanned = header.scanned;
+			index->resume = header.resume;
+			index->check = header.check;
+			result = 0;
+			for (uint32_t i = 0; i < index->count; i++)
+			{
+				if (index->entries[i].offset >= index->scanned || (i > 0 && index->entries[i].offset <= index->entries[i - 1].offset))
+					result = -1;
+			}
+		}
+	}
+	fclose(fp);
+	if (result != 0)
+		chapterIndexFree(index);
+	return result;
+}
+
+int chapterIndexSave(const ChapterIndex* index, const char* path)
+{
+	// 先写临时文件再改名, 中途失败不会留下半个索引
+	char temp[1024];
+	ChapterIndexHeader header;
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHAPTER_MAGIC, 4);
+	header.version = CHAPTER_VERSION;
+	header.scanned = index->scanned;
+	header.resume = index->resume;
+	header.check = index->check;
+	header.count = index->count;
+	FILE* fp = fopen(temp, "wb");
+	if (fp == NULL)
+		return -1;
+	int failed = fwrite(&header, sizeof(header), 1, fp) != 1
+		|| fwrite(index->entries, sizeof(ChapterEntry), index->count, fp) != index->count;
+	if (fclose(fp) != 0 || failed)
+	{
+		remove(temp);
+		return -1;
+	}
+#ifdef _WIN32
+	remove(path);
+#endif
+	return rename(temp, path);
+}
+
+int chapterFind(const ChapterIndex* index, uint32_t number)
+{
+	// 回数一般递增, 但有的版本会重复或跳号, 按顺序找第一个
+	for (uint32_t i = 0; i < index->count; i++)
+	{
+		if (index->entries[i].number == number)
+			return (int)i;
+	}
+	return -1;
+}
+
+int chapterAt(const ChapterIndex* index, uint64_t offset)
+{
+	// 二分查找offset所在的回, 在第一回之前返回-1
+	int low = 0, high = (int)index->count - 1, found = -1;
+	while (low <= high)
+	{
+		int middle = (low + high) / 2;
+		if (index->entries[middle].offset <= offset)
+		{
+			found = middle;
+			low = middle + 1;
+		}
+		else
+			high = middle - 1;
+	}
+	return found;
+}
+
+void chapterRange(const ChapterIndex* index, int i, uint64_t* start, uint64_t* end)
+{
+	// 一回从标题行开始, 到下一回标题行(最后一回到已扫描的文件末尾)为止
+	*start = index->entries[i].offset;
+	*end = (uint32_t)i + 1 < index->count ? index->entries[i + 1].offset : index->scanned;
+}
+
+int chapterPage(ChapterReader read, void* source, const ChapterIndex* index, uint64_t offset, size_t pageSize,
+	uint64_t* start, uint64_t* end)
+{
+	// 取包含offset、不超过pageSize字节的一页, 尽量从行首开始、到行尾结束;
+	// 行太长时在字符边界上截断, 字符边界从offset所在行的行首数起, 不会切开双字节字符
+	if (offset >= index->scanned || pageSize == 0)
+		return -1;
+	uint64_t base = offset > CHAPTER_PAGE_REACH ? offset - CHAPTER_PAGE_REACH : 0;
+	int chapter = chapterAt(index, offset);
+	if (chapter >= 0 && index->entries[chapter].offset > base)
+		base = index->entries[chapter].offset;
+	uint64_t limit = offset + pageSize < index->scanned ? offset + pageSize : index->scanned;
+	size_t size = (size_t)(limit - base), length;
+	unsigned char* buffer = malloc(size);
+	if (buffer == NULL || read(source, base, buffer, size, &length) != 0 || length != size)
+	{
+		free(buffer);
+		return -1;
+	}
+	// base是文件开头或回首时一定是行首, 否则找到它之后的第一个行首;
+	// 一行超过CHAPTER_PAGE_REACH时找不到行首, 只好把base当作字符边界
+	size_t at = (size_t)(offset - base), line = 0;
+	if (base != 0 && (chapter < 0 || base != index->entries[chapter].offset))
+	{
+		const unsigned char* nl = memchr(buffer, '\n', at);
+		line = nl ? (size_t)(nl - buffer + 1) : 0;
+	}
+	for (size_t i = at; i > line; i--)
+	{
+		if (buffer[i - 1] == '\n')
+		{
+			line = i;
+			break;
+		}
+	}
+	// 页首: 离offset不超过半页的最早的行首, 没有时从offset所在行内截取
+	size_t first = at > pageSize / 2 ? at - pageSize / 2 : 0;
+	size_t s;
+	if (line >= first)
+	{
+		s = line;
+		for (size_t i = first; i < line; i++)
+		{
+			if (buffer[i] == '\n')
+			{
+				s = i + 1;
+				break;
+			}
+		}
+	}
+	else
+		s = boundary(buffer, line, first);
+	// 页尾: 页内最后一个换行之后, offset之后没有换行时在字符边界截断
+	size_t e = s + pageSize < size ? s + pageSize : size;
+	size_t stop = e;
+	while (stop > at + 1 && buffer[stop - 1] != '\n')
+		stop--;
+	if (buffer[stop - 1] == '\n')
+		e = stop;
+	else if (base + e < index->scanned)
+		e = boundary(buffer, s, e);
+	if (e <= at)
+		e = boundary(buffer, s, at + 2 < size ? at + 2 : size);
+	*start = base + s;
+	*end = base + e;
+	free(buffer);
+	return 0;
+}
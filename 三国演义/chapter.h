@@ -0,0 +1,64 @@
+#ifndef CHAPTER_H
+#define CHAPTER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// 章回索引: 扫描一遍GBK文本, 记下每个"第NNN回"标题行的偏移, 保存为索引文件
+// 之后打开第N回或某个偏移附近的一页, 只需一次定位加一次有限长度的读取
+// 文件追加内容后, 只从上次最后一行的行首接着扫描; 已扫描部分首尾被改动时整个重建
+
+#define CHAPTER_MAGIC "SGCI"
+#define CHAPTER_VERSION 1
+#define CHAPTER_SCAN_CHUNK (1 << 20)   // 扫描时每次读1MB
+#define CHAPTER_HEADING_MAX 128        // 标题行最多记录的字节数, 也是识别标题需要的最大长度
+#define CHAPTER_CHECK_BYTES 4096       // 校验已扫描部分首尾各4KB
+#define CHAPTER_PAGE_SIZE 2048         // 默认每页字节数
+#define CHAPTER_PAGE_REACH (64 << 10)  // 找页首所在行的行首时最多往回读64KB
+
+typedef struct
+{
+	uint64_t offset;        // 标题行行首在文件中的偏移
+	uint32_t number;        // 标题中的回数
+	uint32_t titleLength;   // 标题行的字节数(不含换行)
+} ChapterEntry;
+
+// 从文本的offset处读最多size字节, 到末尾时length小于size; chapterRead是普通文件的实现
+typedef int (*ChapterReader)(void* source, uint64_t offset, void* buffer, size_t size, size_t* length);
+
+typedef struct
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t scanned;       // 已扫描的文件长度
+	uint64_t resume;        // 最后一行的行首, 追加内容后从这里接着扫描
+	uint64_t check;         // 已扫描部分首尾的哈希, 用来发现追加以外的改动
+	uint32_t count;
+	uint32_t reserved;
+} ChapterIndexHeader;
+
+typedef struct
+{
+	ChapterEntry* entries;  // 按偏移递增
+	uint32_t count;
+	uint32_t capacity;
+	uint64_t scanned;
+	uint64_t resume;
+	uint64_t check;
+	uint64_t rescanned;     // 最近一次更新实际扫描的字节数
+	int changed;            // 更新后需要重新保存
+} ChapterIndex;
+
+void chapterIndexInit(ChapterIndex* index);
+int chapterIndexLoad(ChapterIndex* index, const char* path);
+int chapterIndexUpdate(ChapterIndex* index, FILE* text);
+int chapterIndexSave(const ChapterIndex* index, const char* path);
+void chapterIndexFree(ChapterIndex* index);
+int chapterFind(const ChapterIndex* index, uint32_t number);
+int chapterAt(const ChapterIndex* index, uint64_t offset);
+void chapterRange(const ChapterIndex* index, int i, uint64_t* start, uint64_t* end);
+int chapterRead(FILE* text, uint64_t offset, void* buffer, size_t size, size_t* length);
+int chapterPage(ChapterReader read, void* source, const ChapterIndex* index, uint64_t offset, size_t pageSize,
+	uint64_t* start, uint64_t* end);
+
+#endif
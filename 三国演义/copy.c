@@ -0,0 +1,250 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "copy.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <malloc.h>
+#define read _read
+#define write _write
+#define close _close
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#endif
+
+double copyNow(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+const char* copyMethodName(CopyMethod method)
+{
+	static const char* names[] = { "copy_file_range", "sendfile", "mmap", "buffered" };
+	return names[method];
+}
+
+const char* copyReport(const CopyStats* stats, char* text, size_t size)
+{
+	// 与transcodeError一样写入调用者的缓冲区, 由调用者按控制台的编码输出
+	double mb = stats->bytes / 1048576.0;
+	snprintf(text, size, "%llu 字节, %.3f 秒, %.1f MB/s (%s)", stats->bytes, stats->seconds,
+		stats->seconds > 0 ? mb / stats->seconds : 0.0, copyMethodName(stats->method));
+	return text;
+}
+
+static int writeAll(int out, const char* data, size_t size)
+{
+	// write可能只写入一部分, 或被信号打断
+	while (size > 0)
+	{
+		int n = write(out, data, (unsigned)(size < COPY_BUFFER_SIZE ? size : COPY_BUFFER_SIZE));
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += n;
+		size -= n;
+	}
+	return 0;
+}
+
+static int copyBuffered(int in, int out, unsigned long long* bytes)
+{
+#ifdef _WIN32
+	char* buffer = _aligned_malloc(COPY_BUFFER_SIZE, COPY_BUFFER_ALIGN);
+#else
+	char* buffer = NULL;
+	if (posix_memalign((void**)&buffer, COPY_BUFFER_ALIGN, COPY_BUFFER_SIZE) != 0)
+		buffer = NULL;
+#endif
+	if (buffer == NULL)
+		return -1;
+	int result = 0;
+	for (;;)
+	{
+		int n = read(in, buffer, COPY_BUFFER_SIZE);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			result = n;
+			break;
+		}
+		if (writeAll(out, buffer, n) != 0)
+		{
+			result = -1;
+			break;
+		}
+		*bytes += n;
+	}
+#ifdef _WIN32
+	_aligned_free(buffer);
+#else
+	free(buffer);
+#endif
+	return result;
+}
+
+#ifndef _WIN32
+static int unsupported(int err)
+{
+	// 这些错误表示该方法不适用于这对描述符, 换下一种方法即可
+	return err == ENOSYS || err == EXDEV || err == EINVAL || err == EBADF || err == EOPNOTSUPP
+		|| err == ESPIPE || err == ENOTSUP;
+}
+
+static int copyRange(int in, int out, unsigned long long* bytes)
+{
+	// 返回1表示不支持, 且还没有复制任何数据
+	for (;;)
+	{
+		ssize_t n = copy_file_range(in, NULL, out, NULL, COPY_MAP_WINDOW, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return *bytes == 0 && unsupported(errno) ? 1 : -1;
+		if (n == 0)
+			return 0;
+		*bytes += n;
+	}
+}
+
+static int copySendfile(int in, int out, unsigned long long* bytes)
+{
+	for (;;)
+	{
+		ssize_t n = sendfile(out, in, NULL, COPY_MAP_WINDOW);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return *bytes == 0 && unsupported(errno) ? 1 : -1;
+		if (n == 0)
+			return 0;
+		*bytes += n;
+	}
+}
+
+static int copyMapped(int in, int out, off_t size, unsigned long long* bytes)
+{
+	// 按窗口依次映射, 提示内核顺序预读, 用完立即解除映射
+	off_t offset = lseek(in, 0, SEEK_CUR);
+	if (offset < 0)
+		return 1;
+	while (offset < size)
+	{
+		off_t base = offset & ~(off_t)(COPY_BUFFER_ALIGN - 1);
+		size_t length = size - base < COPY_MAP_WINDOW ? (size_t)(size - base) : COPY_MAP_WINDOW;
+		char* map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, in, base);
+		if (map == MAP_FAILED)
+			return *bytes == 0 ? 1 : -1;
+		madvise(map, length, MADV_SEQUENTIAL);
+		size_t skip = (size_t)(offset - base);
+		int failed = writeAll(out, map + skip, length - skip);
+		munmap(map, length);
+		if (failed)
+			return -1;
+		*bytes += length - skip;
+		offset = base + length;
+	}
+	lseek(in, offset, SEEK_SET);
+	return 0;
+}
+#endif
+
+int copyStream(int in, int out, CopyStats* stats)
+{
+	// 只有在还没有复制任何数据时才换下一种方法, 已经开始复制后出错直接返回失败
+	double start = copyNow();
+	int result;
+	stats->bytes = 0;
+#ifndef _WIN32
+	struct stat st;
+	int regular = fstat(in, &st) == 0 && S_ISREG(st.st_mode);
+	if (regular)
+		posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+	stats->method = COPY_RANGE;
+	result = copyRange(in, out, &stats->bytes);
+	if (result == 1)
+	{
+		stats->method = COPY_SENDFILE;
+		result = copySendfile(in, out, &stats->bytes);
+	}
+	if (result == 1 && regular)
+	{
+		stats->method = COPY_MMAP;
+		result = copyMapped(in, out, st.st_size, &stats->bytes);
+	}
+	if (result == 1)
+#endif
+	{
+		stats->method = COPY_BUFFERED;
+		result = copyBuffered(in, out, &stats->bytes);
+	}
+	stats->seconds = copyNow() - start;
+	return result;
+}
+
+static int sameFile(int in, const char* to)
+{
+	// 目标已存在且与源是同一个文件(同一路径、硬链接或符号链接)时返回1
+#ifdef _WIN32
+	BY_HANDLE_FILE_INFORMATION a, b;
+	int out = _open(to, _O_RDONLY | _O_BINARY);
+	int same = 0;
+	if (out < 0)
+		return 0;
+	if (GetFileInformationByHandle((HANDLE)_get_osfhandle(in), &a)
+		&& GetFileInformationByHandle((HANDLE)_get_osfhandle(out), &b))
+		same = a.dwVolumeSerialNumber == b.dwVolumeSerialNumber && a.nFileIndexHigh == b.nFileIndexHigh
+			&& a.nFileIndexLow == b.nFileIndexLow;
+	close(out);
+	return same;
+#else
+	struct stat a, b;
+	return fstat(in, &a) == 0 && stat(to, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+#endif
+}
+
+int copyFile(const char* from, const char* to, CopyStats* stats)
+{
+	// 目标用O_TRUNC打开, 必须先确认它不是源文件, 否则源文件会被清空
+#ifdef _WIN32
+	int in = _open(from, _O_RDONLY | _O_BINARY | _O_SEQUENTIAL);
+#else
+	int in = open(from, O_RDONLY);
+#endif
+	if (in >= 0 && sameFile(in, to))
+	{
+		close(in);
+		return COPY_SAME_FILE;
+	}
+#ifdef _WIN32
+	int out = in < 0 ? -1 : _open(to, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	int out = in < 0 ? -1 : open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+	int result = -1;
+	if (in >= 0 && out >= 0)
+		result = copyStream(in, out, stats);
+	if (in >= 0)
+		close(in);
+	if (out >= 0 && close(out) != 0)
+		result = -1;
+	return result;
+}
@@ -0,0 +1,35 @@
+#ifndef COPY_H
+#define COPY_H
+
+#include <stdio.h>
+
+// 流式复制: 依次尝试 copy_file_range、sendfile、mmap、对齐大缓冲区 read/write, 用第一个可用的方法
+// 文件大小不受限制, 只复制实际读到的字节; Windows上只有缓冲区方式
+
+#define COPY_BUFFER_SIZE (1 << 20)    // 缓冲区方式每次读写1MB
+#define COPY_BUFFER_ALIGN 4096        // 缓冲区按页对齐
+#define COPY_MAP_WINDOW (64 << 20)    // mmap每次映射64MB, 32位系统也能复制大文件
+#define COPY_SAME_FILE (-2)           // copyFile: 目标就是源文件, 没有打开也没有截断目标
+
+typedef enum
+{
+	COPY_RANGE,       // copy_file_range, 内核内复制, 文件系统支持时可共享数据块
+	COPY_SENDFILE,    // sendfile, 内核内复制
+	COPY_MMAP,        // 映射输入文件后直接write
+	COPY_BUFFERED     // 对齐缓冲区read/write, 适用于管道等任何描述符
+} CopyMethod;
+
+typedef struct
+{
+	CopyMethod method;         // 实际使用的方法
+	unsigned long long bytes;  // 复制的字节数
+	double seconds;            // 耗时
+} CopyStats;
+
+int copyStream(int in, int out, CopyStats* stats);
+int copyFile(const char* from, const char* to, CopyStats* stats);
+const char* copyMethodName(CopyMethod method);
+const char* copyReport(const CopyStats* stats, char* text, size_t size);
+double copyNow(void);
+
+#endif
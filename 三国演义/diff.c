@@ -0,0 +1,583 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "diff.h"
+#include "copy.h"
+
+typedef struct
+{
+	const uint32_t* a;
+	const uint32_t* b;
+	uint8_t* changedA;
+	uint8_t* changedB;
+	ptrdiff_t* forward;       // 下标是对角线x - y: 从左上角出发在这条对角线上走得最远的x
+	ptrdiff_t* backward;      // 从右下角出发走得最远(最小)的x
+	ptrdiff_t cost;           // 搜索超过这么多步就不再找最短的
+} Sequences;
+
+typedef struct
+{
+	DiffWriter write;
+	void* context;
+	size_t used;
+	int lineStart;            // 按字符比较时, 下一个字节是不是行首, 行首要加~
+	unsigned char buffer[DIFF_OUTPUT];
+} Output;
+
+static void middleSnake(Sequences* s, ptrdiff_t xoff, ptrdiff_t xlim, ptrdiff_t yoff, ptrdiff_t ylim,
+	ptrdiff_t* xmid, ptrdiff_t* ymid)
+{
+	// 两头同时搜索, 第c步时每条对角线上记下走了c步能到的最远点, 两边在同一条对角线上相遇就是中间蛇
+	// 两边的首尾都已经不同, 所以至少各走一步
+	const uint32_t* a = s->a;
+	const uint32_t* b = s->b;
+	ptrdiff_t* fd = s->forward;
+	ptrdiff_t* bd = s->backward;
+	ptrdiff_t dmin = xoff - ylim, dmax = xlim - yoff;
+	ptrdiff_t fmid = xoff - yoff, bmid = xlim - ylim;
+	ptrdiff_t fmin = fmid, fmax = fmid, bmin = bmid, bmax = bmid;
+	int odd = (fmid - bmid) & 1;
+	fd[fmid] = xoff;
+	bd[bmid] = xlim;
+	for (ptrdiff_t c = 1;; c++)
+	{
+		if (fmin > dmin)
+			fd[--fmin - 1] = -1;
+		else
+			fmin++;
+		if (fmax < dmax)
+			fd[++fmax + 1] = -1;
+		else
+			fmax--;
+		for (ptrdiff_t d = fmax; d >= fmin; d -= 2)
+		{
+			ptrdiff_t lo = fd[d - 1], hi = fd[d + 1];
+			ptrdiff_t x = lo >= hi ? lo + 1 : hi, y = x - d;
+			while (x < xlim && y < ylim && a[x] == b[y])
+				x++, y++;
+			fd[d] = x;
+			if (odd && bmin <= d && d <= bmax && bd[d] <= x)
+			{
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+		if (bmin > dmin)
+			bd[--bmin - 1] = PTRDIFF_MAX;
+		else
+			bmin++;
+		if (bmax < dmax)
+			bd[++bmax + 1] = PTRDIFF_MAX;
+		else
+			bmax--;
+		for (ptrdiff_t d = bmax; d >= bmin; d -= 2)
+		{
+			ptrdiff_t lo = bd[d - 1], hi = bd[d + 1];
+			ptrdiff_t x = lo < hi ? lo : hi - 1, y = x - d;
+			while (x > xoff && y > yoff && a[x - 1] == b[y - 1])
+				x--, y--;
+			bd[d] = x;
+			if (!odd && fmin <= d && d <= fmax && x <= fd[d])
+			{
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+		if (c >= s->cost)
+		{
+			// 改动太多: 取两个方向中走得最远的点作分界, 两半分别再比较; 结果是正确的改动, 只是不一定最少
+			ptrdiff_t fbest = -1, fx = xoff, bbest = PTRDIFF_MAX, bx = xlim;
+			for (ptrdiff_t d = fmax; d >= fmin; d -= 2)
+			{
+				ptrdiff_t x = fd[d] < xlim ? fd[d] : xlim, y = x - d;
+				if (y > ylim)
+				{
+					x = ylim + d;
+					y = ylim;
+				}
+				if (x + y > fbest)
+				{
+					fbest = x + y;
+					fx = x;
+				}
+			}
+			for (ptrdiff_t d = bmax; d >= bmin; d -= 2)
+			{
+				ptrdiff_t x = bd[d] > xoff ? bd[d] : xoff, y = x - d;
+				if (y < yoff)
+				{
+					x = yoff + d;
+					y = yoff;
+				}
+				if (x + y < bbest)
+				{
+					bbest = x + y;
+					bx = x;
+				}
+			}
+			if (xlim + ylim - bbest < fbest - (xoff + yoff))
+			{
+				*xmid = fx;
+				*ymid = fbest - fx;
+			}
+			else
+			{
+				*xmid = bx;
+				*ymid = bbest - bx;
+			}
+			return;
+		}
+	}
+}
+
+static void compareRange(Sequences* s, ptrdiff_t xoff, ptrdiff_t xlim, ptrdiff_t yoff, ptrdiff_t ylim)
+{
+	// 去掉相同的首尾, 一边空了另一边剩下的都是改动, 否则在中间蛇处分成两半
+	const uint32_t* a = s->a;
+	const uint32_t* b = s->b;
+	while (xoff < xlim && yoff < ylim && a[xoff] == b[yoff])
+		xoff++, yoff++;
+	while (xlim > xoff && ylim > yoff && a[xlim - 1] == b[ylim - 1])
+		xlim--, ylim--;
+	if (xoff == xlim)
+		memset(s->changedB + yoff, 1, (size_t)(ylim - yoff));
+	else if (yoff == ylim)
+		memset(s->changedA + xoff, 1, (size_t)(xlim - xoff));
+	else
+	{
+		ptrdiff_t xmid, ymid;
+		middleSnake(s, xoff, xlim, yoff, ylim, &xmid, &ymid);
+		compareRange(s, xoff, xmid, yoff, ymid);
+		compareRange(s, xmid, xlim, ymid, ylim);
+	}
+}
+
+static int compareSequences(const uint32_t* a, size_t n, const uint32_t* b, size_t m, uint8_t* changedA, uint8_t* changedB)
+{
+	// changedA/changedB由调用者清零; 对角线从-(m + 1)到n + 1
+	Sequences s;
+	size_t diagonals = n + m + 3;
+	ptrdiff_t* v = malloc(diagonals * 2 * sizeof(ptrdiff_t));
+	if (v == NULL)
+		return -1;
+	s.a = a;
+	s.b = b;
+	s.changedA = changedA;
+	s.changedB = changedB;
+	s.forward = v + m + 1;
+	s.backward = v + diagonals + m + 1;
+	s.cost = 1;
+	for (size_t k = diagonals; k != 0; k >>= 2)
+		s.cost <<= 1;
+	if (s.cost < DIFF_COST_MIN)
+		s.cost = DIFF_COST_MIN;
+	compareRange(&s, 0, (ptrdiff_t)n, 0, (ptrdiff_t)m);
+	free(v);
+	return 0;
+}
+
+static size_t commonPrefix(const unsigned char* a, const unsigned char* b, size_t n)
+{
+	// 按4KB一块用memcmp比较, 遇到不同的块再逐字节找
+	size_t i = 0;
+	while (n - i >= 4096 && memcmp(a + i, b + i, 4096) == 0)
+		i += 4096;
+	while (i < n && a[i] == b[i])
+		i++;
+	return i;
+}
+
+static size_t commonSuffix(const unsigned char* aEnd, const unsigned char* bEnd, size_t n)
+{
+	size_t i = 0;
+	while (n - i >= 4096 && memcmp(aEnd - i - 4096, bEnd - i - 4096, 4096) == 0)
+		i += 4096;
+	while (i < n && aEnd[-1 - (ptrdiff_t)i] == bEnd[-1 - (ptrdiff_t)i])
+		i++;
+	return i;
+}
+
+static size_t nextLine(const unsigned char* text, size_t at, size_t length)
+{
+	const unsigned char* p = memchr(text + at, '\n', length - at);
+	return p == NULL ? length : (size_t)(p - text) + 1;
+}
+
+static int splitLines(DiffFile* f)
+{
+	size_t count = 0;
+	for (size_t at = f->start; at < f->end; at = nextLine(f->text, at, f->end))
+		count++;
+	f->count = count;
+	f->lines = malloc((count + 1) * sizeof(size_t));
+	f->ids = malloc((count ? count : 1) * sizeof(uint32_t));
+	f->changed = calloc(count ? count : 1, 1);
+	if (f->lines == NULL || f->ids == NULL || f->changed == NULL)
+		return -1;
+	count = 0;
+	for (size_t at = f->start; at < f->end; at = nextLine(f->text, at, f->end))
+		f->lines[count++] = at;
+	f->lines[count] = f->end;
+	return 0;
+}
+
+static uint64_t hashLine(const unsigned char* p, size_t n)
+{
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+
+static int numberLines(Diff* d)
+{
+	// 开放定址的哈希表, 槽里存编号 + 1; 哈希相同时再比较内容, 编号相同的行内容一定相同
+	size_t total = d->a.count + d->b.count, size = 16;
+	while (size < total * 2)
+		size <<= 1;
+	uint32_t* table = calloc(size, sizeof(uint32_t));
+	uint64_t* hashes = malloc((total ? total : 1) * sizeof(uint64_t));
+	const unsigned char** texts = malloc((total ? total : 1) * sizeof(unsigned char*));
+	size_t* lengths = malloc((total ? total : 1) * sizeof(size_t));
+	int result = -1;
+	if (table == NULL || hashes == NULL || texts == NULL || lengths == NULL || total >= UINT32_MAX)
+		goto done;
+	uint32_t ids = 0;
+	DiffFile* files[2] = { &d->a, &d->b };
+	for (int k = 0; k < 2; k++)
+	{
+		DiffFile* f = files[k];
+		for (size_t i = 0; i < f->count; i++)
+		{
+			const unsigned char* p = f->text + f->lines[i];
+			size_t n = f->lines[i + 1] - f->lines[i];
+			uint64_t h = hashLine(p, n);
+			size_t slot = (size_t)h & (size - 1);
+			for (;; slot = (slot + 1) & (size - 1))
+			{
+				uint32_t id = table[slot];
+				if (id == 0)
+				{
+					hashes[ids] = h;
+					texts[ids] = p;
+					lengths[ids] = n;
+					table[slot] = ++ids;
+					f->ids[i] = ids - 1;
+					break;
+				}
+				if (hashes[id - 1] == h && lengths[id - 1] == n && memcmp(texts[id - 1], p, n) == 0)
+				{
+					f->ids[i] = id - 1;
+					break;
+				}
+			}
+		}
+	}
+	result = 0;
+done:
+	free(table);
+	free(hashes);
+	free(texts);
+	free(lengths);
+	return result;
+}
+
+int diffCompare(Diff* d, const unsigned char* a, size_t aLength, const unsigned char* b, size_t bLength, int context)
+{
+	// 中间一段: 从相同开头的最后一个完整行之后, 到两边都在行首的相同结尾, 再向外各留context行
+	double started = copyNow();
+	memset(d, 0, sizeof(*d));
+	d->context = context;
+	d->a.text = a;
+	d->a.length = aLength;
+	d->b.text = b;
+	d->b.length = bLength;
+	size_t shorter = aLength < bLength ? aLength : bLength;
+	size_t start = commonPrefix(a, b, shorter);
+	while (start > 0 && a[start - 1] != '\n')
+		start--;
+	// 相同的结尾不能伸进相同的开头, 否则改动可能被挤到中间一段的边上, 后面没有上下文
+	size_t same = commonSuffix(a + aLength, b + bLength, shorter - start);
+	size_t end = aLength - same, bEnd = bLength - same;
+	int aLineStart = end == start || a[end - 1] == '\n';
+	int bLineStart = bEnd == start || b[bEnd - 1] == '\n';
+	if (!aLineStart || !bLineStart)
+		end = nextLine(a, end, aLength);
+	for (int k = 0; k < context && end < aLength; k++)
+		end = nextLine(a, end, aLength);
+	for (int k = 0; k < context && start > 0; k++)
+	{
+		start--;
+		while (start > 0 && a[start - 1] != '\n')
+			start--;
+	}
+	for (const unsigned char* p = a; (p = memchr(p, '\n', a + start - p)) != NULL; p++)
+		d->prefixLines++;
+	d->a.start = start;
+	d->a.end = end;
+	d->b.start = start;
+	d->b.end = end - aLength + bLength;
+	if (splitLines(&d->a) != 0 || splitLines(&d->b) != 0 || numberLines(d) != 0
+		|| compareSequences(d->a.ids, d->a.count, d->b.ids, d->b.count, d->a.changed, d->b.changed) != 0)
+	{
+		diffFree(d);
+		return -1;
+	}
+	for (size_t i = 0; i < d->a.count; i++)
+		d->deleted += d->a.changed[i];
+	for (size_t i = 0; i < d->b.count; i++)
+		d->inserted += d->b.changed[i];
+	d->seconds = copyNow() - started;
+	return 0;
+}
+
+void diffFree(Diff* d)
+{
+	free(d->a.lines);
+	free(d->a.ids);
+	free(d->a.changed);
+	free(d->b.lines);
+	free(d->b.ids);
+	free(d->b.changed);
+	d->a.lines = d->b.lines = NULL;
+	d->a.ids = d->b.ids = NULL;
+	d->a.changed = d->b.changed = NULL;
+}
+
+static void flush(Output* o)
+{
+	if (o->used > 0)
+		o->write(o->context, o->buffer, o->used);
+	o->used = 0;
+}
+
+static void put(Output* o, const void* text, size_t length)
+{
+	if (length > sizeof(o->buffer) - o->used)
+	{
+		flush(o);
+		if (length >= sizeof(o->buffer))
+		{
+			o->write(o->context, text, length);
+			return;
+		}
+	}
+	memcpy(o->buffer + o->used, text, length);
+	o->used += length;
+}
+
+static void putLine(Output* o, const DiffFile* f, size_t i, char mark)
+{
+	size_t from = f->lines[i], to = f->lines[i + 1];
+	put(o, &mark, 1);
+	put(o, f->text + from, to - from);
+	if (to == from || f->text[to - 1] != '\n')
+	{
+		static const char missing[] = "\n\\ No newline at end of file\n";
+		put(o, missing, sizeof(missing) - 1);
+	}
+}
+
+static void putMerged(Output* o, const void* merged, size_t length)
+{
+	// 合并显示的每行开头加~
+	const unsigned char* text = merged;
+	while (length > 0)
+	{
+		if (o->lineStart)
+			put(o, "~", 1);
+		const unsigned char* p = memchr(text, '\n', length);
+		size_t n = p == NULL ? length : (size_t)(p - text) + 1;
+		put(o, text, n);
+		o->lineStart = p != NULL;
+		text += n;
+		length -= n;
+	}
+}
+
+static size_t splitChars(const unsigned char* text, size_t length, int utf8, uint32_t* values, size_t* offsets)
+{
+	// 一个字符的全部字节拼成一个整数; GBK首字节0x81以上占两个字节, UTF-8按首字节判断长度
+	size_t count = 0;
+	for (size_t i = 0; i < length;)
+	{
+		unsigned char c = text[i];
+		size_t n = 1;
+		if (utf8)
+			n = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+		else if (c >= 0x81)
+			n = 2;
+		if (n > length - i)
+			n = length - i;
+		uint32_t value = 0;
+		for (size_t k = 0; k < n; k++)
+			value = value << 8 | text[i + k];
+		values[count] = value;
+		offsets[count++] = i;
+		i += n;
+	}
+	offsets[count] = length;
+	return count;
+}
+
+static int putChars(Output* o, const Diff* d, size_t i, size_t i2, size_t j, size_t j2, int utf8)
+{
+	// 两边的改动块按字符比较, 合并成一段输出; 块太大时返回1, 由调用者按行输出
+	const unsigned char* x = d->a.text + d->a.lines[i];
+	const unsigned char* y = d->b.text + d->b.lines[j];
+	size_t xLength = d->a.lines[i2] - d->a.lines[i], yLength = d->b.lines[j2] - d->b.lines[j];
+	if (xLength > DIFF_CHAR_MAX * 4 || yLength > DIFF_CHAR_MAX * 4)
+		return 1;
+	uint32_t* values = malloc((xLength + yLength) * sizeof(uint32_t));
+	size_t* offsets = malloc((xLength + yLength + 2) * sizeof(size_t));
+	uint8_t* changed = calloc(xLength + yLength, 1);
+	int result = -1;
+	if (values != NULL && offsets != NULL && changed != NULL)
+	{
+		size_t* xOffsets = offsets;
+		size_t n = splitChars(x, xLength, utf8, values, xOffsets);
+		size_t* yOffsets = offsets + n + 1;
+		size_t m = splitChars(y, yLength, utf8, values + n, yOffsets);
+		uint8_t* xChanged = changed;
+		uint8_t* yChanged = changed + n;
+		result = 1;
+		if (n <= DIFF_CHAR_MAX && m <= DIFF_CHAR_MAX)
+			result = compareSequences(values, n, values + n, m, xChanged, yChanged);
+		if (result == 0)
+		{
+			size_t p = 0, q = 0;
+			o->lineStart = 1;
+			while (p < n || q < m)
+			{
+				size_t p2 = p, q2 = q;
+				while (p2 < n && q2 < m && !xChanged[p2] && !yChanged[q2])
+					p2++, q2++;
+				if (p2 > p)
+				{
+					putMerged(o, x + xOffsets[p], xOffsets[p2] - xOffsets[p]);
+					p = p2;
+					q = q2;
+					continue;
+				}
+				while (p2 < n && xChanged[p2])
+					p2++;
+				while (q2 < m && yChanged[q2])
+					q2++;
+				if (p2 == p && q2 == q)
+					break;
+				if (p2 > p)
+				{
+					putMerged(o, "[-", 2);
+					putMerged(o, x + xOffsets[p], xOffsets[p2] - xOffsets[p]);
+					putMerged(o, "-]", 2);
+				}
+				if (q2 > q)
+				{
+					putMerged(o, "{+", 2);
+					putMerged(o, y + yOffsets[q], yOffsets[q2] - yOffsets[q]);
+					putMerged(o, "+}", 2);
+				}
+				p = p2;
+				q = q2;
+			}
+			if (!o->lineStart)
+				put(o, "\n", 1);
+		}
+	}
+	free(values);
+	free(offsets);
+	free(changed);
+	return result;
+}
+
+static int nextBlock(const Diff* d, size_t* i, size_t* j, size_t* i2, size_t* j2)
+{
+	// 从(i, j)跳过两边对应的相同行, 找到下一个改动块[i, i2) / [j, j2), 没有了返回0
+	while (*i < d->a.count && *j < d->b.count && !d->a.changed[*i] && !d->b.changed[*j])
+		(*i)++, (*j)++;
+	*i2 = *i;
+	*j2 = *j;
+	while (*i2 < d->a.count && d->a.changed[*i2])
+		(*i2)++;
+	while (*j2 < d->b.count && d->b.changed[*j2])
+		(*j2)++;
+	return *i2 > *i || *j2 > *j;
+}
+
+static void putRange(Output* o, char mark, uint64_t start, uint64_t count)
+{
+	// 统一格式的行号: 只有一行时省略行数, 没有行时给出前一行的行号
+	char text[64];
+	int n = count == 1 ? snprintf(text, sizeof(text), " %c%llu", mark, (unsigned long long)start)
+		: snprintf(text, sizeof(text), " %c%llu,%llu", mark, (unsigned long long)(count ? start : start - 1),
+			(unsigned long long)count);
+	put(o, text, (size_t)n);
+}
+
+int diffWrite(const Diff* d, int chars, int utf8, DiffWriter write, void* context)
+{
+	// 间隔不超过2 * context行的改动块合成一段; 返回段数, 出错返回-1
+	Output* o = malloc(sizeof(Output));
+	if (o == NULL)
+		return -1;
+	o->write = write;
+	o->context = context;
+	o->used = 0;
+	size_t ctx = (size_t)d->context;
+	size_t i = 0, j = 0, i2, j2;
+	int hunks = 0, result = 0;
+	int more = nextBlock(d, &i, &j, &i2, &j2);
+	while (more && result == 0)
+	{
+		// 先找出这一段的范围, 再从头输出
+		size_t hi = i > ctx ? i - ctx : 0, hj = j - (i - hi);
+		size_t ei = i2, ej = j2, ni = i2, nj = j2, ni2, nj2;
+		while ((more = nextBlock(d, &ni, &nj, &ni2, &nj2)) != 0 && ni - ei <= 2 * ctx)
+		{
+			ei = ni2;
+			ej = nj2;
+			ni = ni2;
+			nj = nj2;
+		}
+		size_t ti = ei + ctx < d->a.count ? ei + ctx : d->a.count, tj = ej + (ti - ei);
+		put(o, "@@", 2);
+		putRange(o, '-', d->prefixLines + hi + 1, ti - hi);
+		putRange(o, '+', d->prefixLines + hj + 1, tj - hj);
+		put(o, " @@\n", 4);
+		size_t x = hi, y = hj;
+		while (x < ti || y < tj)
+		{
+			size_t bi = x, bj = y, bi2, bj2;
+			if (!nextBlock(d, &bi, &bj, &bi2, &bj2) || bi > ei)
+				bi = ti, bj = tj, bi2 = ti, bj2 = tj;
+			for (; x < bi; x++, y++)
+				putLine(o, &d->a, x, ' ');
+			int plain = 1;
+			if (chars && bi2 > bi && bj2 > bj)
+			{
+				plain = putChars(o, d, bi, bi2, bj, bj2, utf8);
+				result = plain < 0 ? -1 : 0;
+			}
+			if (plain > 0)
+			{
+				for (; x < bi2; x++)
+					putLine(o, &d->a, x, '-');
+				for (; y < bj2; y++)
+					putLine(o, &d->b, y, '+');
+			}
+			x = bi2;
+			y = bj2;
+		}
+		hunks++;
+		i = ni;
+		j = nj;
+		i2 = ni2;
+		j2 = nj2;
+	}
+	flush(o);
+	free(o);
+	return result < 0 ? -1 : hunks;
+}
@@ -0,0 +1,46 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 比较两个文本, 输出统一格式(unified diff)的差异
+// 先用memcmp找出两边相同的开头和结尾, 只把中间一段切成行, 每行哈希成编号(内容相同的行编号相同),
+// 再对编号序列用Myers的O(ND)算法, 以"中间蛇"二分递归, 只用线性空间; 几乎相同的大文件, 耗时主要与改动量有关
+// 按字符比较时, 两边都有的改动块(这本书里一行就是一个段落)再按字符比较一次, 用[-删去-]{+加入+}标出改了哪几个字
+
+#define DIFF_CONTEXT 3                 // 每处改动前后各显示3行
+#define DIFF_COST_MIN 4096             // 中间蛇的搜索超过这么多步(并且超过约sqrt(N))就取最远的点, 结果仍正确但不一定最短
+#define DIFF_CHAR_MAX 4096             // 改动块每边不超过4096个字符才按字符比较
+#define DIFF_OUTPUT (1 << 16)          // 输出缓冲区64KB
+
+typedef void (*DiffWriter)(void* context, const unsigned char* text, size_t length);
+
+typedef struct
+{
+	const unsigned char* text;
+	size_t length;
+	size_t start;             // 中间一段的起点和终点, 都在行首(或文件末尾)
+	size_t end;
+	size_t* lines;            // 中间各行行首的偏移, 多一项存end
+	uint32_t* ids;            // 每行的编号
+	uint8_t* changed;         // 该行是删去(或加入)的
+	size_t count;             // 中间的行数
+} DiffFile;
+
+typedef struct
+{
+	DiffFile a;
+	DiffFile b;
+	int context;
+	uint64_t prefixLines;     // 中间一段之前的行数, 两边相同
+	uint64_t deleted;         // 删去的行数
+	uint64_t inserted;        // 加入的行数
+	double seconds;
+} Diff;
+
+int diffCompare(Diff* d, const unsigned char* a, size_t aLength, const unsigned char* b, size_t bLength, int context);
+int diffWrite(const Diff* d, int chars, int utf8, DiffWriter write, void* context);
+void diffFree(Diff* d);
+
+#endif
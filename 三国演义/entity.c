@@ -0,0 +1,507 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "entity.h"
+#include "copy.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#define fseeko _fseeki64
+#define ftello _ftelli64
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+#define mutexInit(m) InitializeCriticalSection(m)
+#define mutexLock(m) EnterCriticalSection(m)
+#define mutexUnlock(m) LeaveCriticalSection(m)
+#define mutexDestroy(m) DeleteCriticalSection(m)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+#define mutexInit(m) pthread_mutex_init(m, NULL)
+#define mutexLock(m) pthread_mutex_lock(m)
+#define mutexUnlock(m) pthread_mutex_unlock(m)
+#define mutexDestroy(m) pthread_mutex_destroy(m)
+#endif
+
+typedef struct
+{
+	EntityMatch* items;
+	uint64_t count;
+	uint64_t capacity;
+} MatchList;
+
+typedef struct
+{
+	const EntityMatcher* m;
+	const char* path;
+	uint64_t size;
+	const uint64_t* chapters;
+	uint32_t chapterCount;
+	uint32_t slots;
+	uint32_t chunkCount;
+	uint64_t* splits;         // chunkCount + 1个分界, 都是字符边界
+	uint32_t nextChunk;       // 下一个待领取的块, 由mutex保护
+	Mutex mutex;
+	int positions;
+	int failed;
+	MatchList* lists;         // 每块一个, 合并时按块的顺序连起来
+} EntityJob;
+
+typedef struct
+{
+	EntityJob* job;
+	uint32_t* counts;         // 本线程的[名字 * slots + 格]
+} EntityWorker;
+
+int entityThreads(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int n = (int)info.dwNumberOfProcessors;
+#else
+	int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return n < 1 ? 1 : n > ENTITY_THREADS_MAX ? ENTITY_THREADS_MAX : n;
+}
+
+void entityFree(EntityMatcher* m)
+{
+	free(m->next);
+	free(m->output);
+	free(m->suffix);
+	free(m->same);
+	free(m->lengths);
+	memset(m, 0, sizeof(*m));
+}
+
+int entityCompile(EntityMatcher* m, const unsigned char* const* patterns, const size_t* lengths, uint32_t count,
+	EntityEncoding encoding)
+{
+	// 先建字典树(0表示还没有子节点, 根不会是别人的子节点), 再按广度优先补全转移并求失败链,
+	// 最后按广度优先的顺序给状态重新编号; 空名字或超过ENTITY_PATTERN_MAX的名字返回-1
+	size_t total = 1;
+	memset(m, 0, sizeof(*m));
+	m->encoding = encoding;
+	m->patternCount = count;
+	for (uint32_t k = 0; k < count; k++)
+	{
+		if (lengths[k] == 0 || lengths[k] > ENTITY_PATTERN_MAX)
+			return -1;
+		total += lengths[k];
+		for (size_t i = 0; i < lengths[k]; i++)
+			m->classes[patterns[k][i]] = 1;
+		if (lengths[k] > m->maxLength)
+			m->maxLength = (uint32_t)lengths[k];
+	}
+	uint32_t classes = 1;
+	for (int b = 0; b < 256; b++)
+		m->classes[b] = m->classes[b] ? (uint8_t)classes++ : 0;
+	m->classCount = classes;
+	if ((uint64_t)total * classes >= ENTITY_OUTPUT)
+		return -1;
+	uint32_t* trie = calloc(total * classes, sizeof(uint32_t));
+	uint32_t* out = calloc(total, sizeof(uint32_t));
+	uint32_t* fail = calloc(total, sizeof(uint32_t));
+	uint32_t* dict = calloc(total, sizeof(uint32_t));
+	uint32_t* order = malloc(total * sizeof(uint32_t));
+	uint32_t* rank = malloc(total * sizeof(uint32_t));
+	m->same = calloc(count ? count : 1, sizeof(uint32_t));
+	m->lengths = malloc(count ? count : 1);
+	uint32_t states = 1;
+	int result = -1;
+	if (trie == NULL || out == NULL || fail == NULL || dict == NULL || order == NULL || rank == NULL
+		|| m->same == NULL || m->lengths == NULL)
+		goto done;
+	for (uint32_t k = 0; k < count; k++)
+	{
+		uint32_t s = 0;
+		for (size_t i = 0; i < lengths[k]; i++)
+		{
+			uint32_t* t = &trie[(size_t)s * classes + m->classes[patterns[k][i]]];
+			if (*t == 0)
+				*t = states++;
+			s = *t;
+		}
+		// 重复的名字挂在同一个状态上
+		m->same[k] = out[s];
+		out[s] = k + 1;
+		m->lengths[k] = (uint8_t)lengths[k];
+	}
+	// 广度优先: 父状态的失败目标先处理完, 它的整行已经补全
+	uint32_t head = 0, tail = 0;
+	order[tail++] = 0;
+	while (head < tail)
+	{
+		uint32_t r = order[head++];
+		for (uint32_t c = 0; c < classes; c++)
+		{
+			uint32_t* t = &trie[(size_t)r * classes + c];
+			if (*t != 0)
+			{
+				uint32_t u = *t;
+				fail[u] = r == 0 ? 0 : trie[(size_t)fail[r] * classes + c];
+				dict[u] = out[fail[u]] ? fail[u] : dict[fail[u]];
+				order[tail++] = u;
+			}
+			else
+				*t = r == 0 ? 0 : trie[(size_t)fail[r] * classes + c];
+		}
+	}
+	// 按广度优先重新编号, 转移表存目标的行号, 有名字结束(自己的或失败链上的)的目标加标记位
+	for (uint32_t i = 0; i < states; i++)
+		rank[order[i]] = i;
+	m->stateCount = states;
+	m->next = malloc((size_t)states * classes * sizeof(uint32_t));
+	m->output = malloc(states * sizeof(uint32_t));
+	m->suffix = malloc(states * sizeof(uint32_t));
+	if (m->next == NULL || m->output == NULL || m->suffix == NULL)
+		goto done;
+	for (uint32_t i = 0; i < states; i++)
+	{
+		uint32_t s = order[i];
+		for (uint32_t c = 0; c < classes; c++)
+		{
+			uint32_t u = trie[(size_t)s * classes + c];
+			m->next[(size_t)i * classes + c] = rank[u] * classes | (out[u] || dict[u] ? ENTITY_OUTPUT : 0);
+		}
+		m->output[i] = out[s];
+		m->suffix[i] = dict[s] ? rank[dict[s]] * classes : 0;
+	}
+	result = 0;
+done:
+	free(trie);
+	free(out);
+	free(fail);
+	free(dict);
+	free(order);
+	free(rank);
+	if (result != 0)
+		entityFree(m);
+	return result;
+}
+
+static int findSplits(EntityJob* job)
+{
+	// 块的分界: 名义位置之后第一个小于0x80的字节的下一个字节, 它在GBK里是ASCII或尾字节, 在UTF-8里是ASCII,
+	// 后面一定是字符边界; 一直找不到时分界推到文件末尾, 前一块把剩下的都扫完
+	unsigned char window[ENTITY_ALIGN];
+	FILE* fp = fopen(job->path, "rb");
+	if (fp == NULL)
+		return -1;
+	job->splits[0] = 0;
+	job->splits[job->chunkCount] = job->size;
+	for (uint32_t k = 1; k < job->chunkCount; k++)
+	{
+		uint64_t at = (uint64_t)k * ENTITY_CHUNK;
+		if (at < job->splits[k - 1])
+			at = job->splits[k - 1];
+		uint64_t split = job->size;
+		while (at < job->size && split == job->size)
+		{
+			size_t want = job->size - at < sizeof(window) ? (size_t)(job->size - at) : sizeof(window);
+			if (fseeko(fp, (long long)at, SEEK_SET) != 0 || fread(window, 1, want, fp) != want)
+			{
+				fclose(fp);
+				return -1;
+			}
+			for (size_t i = 0; i < want; i++)
+			{
+				if (window[i] < 0x80)
+				{
+					split = at + i + 1;
+					break;
+				}
+			}
+			at += want;
+		}
+		job->splits[k] = split;
+	}
+	fclose(fp);
+	return 0;
+}
+
+static int addMatch(MatchList* list, uint32_t pattern, uint64_t offset)
+{
+	if (list->count == list->capacity)
+	{
+		uint64_t capacity = list->capacity ? list->capacity * 2 : 1024;
+		EntityMatch* items = realloc(list->items, (size_t)capacity * sizeof(EntityMatch));
+		if (items == NULL)
+			return -1;
+		list->items = items;
+		list->capacity = capacity;
+	}
+	list->items[list->count].pattern = pattern;
+	list->items[list->count].offset = offset;
+	list->count++;
+	return 0;
+}
+
+static int compareMatches(const void* a, const void* b)
+{
+	const EntityMatch* x = a;
+	const EntityMatch* y = b;
+	if (x->offset != y->offset)
+		return x->offset < y->offset ? -1 : 1;
+	return x->pattern < y->pattern ? -1 : x->pattern > y->pattern;
+}
+
+static int scanChunk(EntityWorker* w, const unsigned char* p, size_t length, size_t limit, uint64_t base, MatchList* list)
+{
+	// p[0]是字符边界; 扫描p[0, length), 只记起点小于limit的匹配
+	// GBK时用环形表记下最近256个字节各自是不是字符边界, 匹配的起点不在边界上就丢掉
+	const EntityMatcher* m = w->job->m;
+	const EntityJob* job = w->job;
+	const uint32_t* next = m->next;
+	const uint8_t* classes = m->classes;
+	uint8_t boundary[256];
+	int gbk = m->encoding == ENTITY_GBK, trail = 0;
+	uint32_t s = 0, slot = 0;
+	uint64_t slotStart = 0, slotEnd = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		unsigned char b = p[i];
+		if (gbk)
+		{
+			boundary[i & 255] = (uint8_t)!trail;
+			trail = !trail && b >= 0x81 && b <= 0xFE;
+		}
+		s = next[s + classes[b]];
+		if (!(s & ENTITY_OUTPUT))
+			continue;
+		s &= ~ENTITY_OUTPUT;
+		for (uint32_t row = m->output[s / m->classCount] ? s : m->suffix[s / m->classCount]; row != 0;
+			row = m->suffix[row / m->classCount])
+		{
+			for (uint32_t k = m->output[row / m->classCount]; k != 0; k = m->same[k - 1])
+			{
+				size_t start = i + 1 - m->lengths[k - 1];
+				if (start >= limit || (gbk && !boundary[start & 255]))
+					continue;
+				// 找匹配所在的回: 多数匹配和上一个在同一回, 不在时再二分
+				uint64_t offset = base + start;
+				if (offset < slotStart || offset >= slotEnd)
+				{
+					uint32_t low = 0, high = job->chapterCount;
+					while (low < high)
+					{
+						uint32_t middle = (low + high) / 2;
+						if (job->chapters[middle] <= offset)
+							low = middle + 1;
+						else
+							high = middle;
+					}
+					slot = low;
+					slotStart = low == 0 ? 0 : job->chapters[low - 1];
+					slotEnd = low == job->chapterCount ? UINT64_MAX : job->chapters[low];
+				}
+				w->counts[(size_t)(k - 1) * job->slots + slot]++;
+				if (list != NULL && addMatch(list, k - 1, offset) != 0)
+					return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+static int scanChunks(EntityWorker* w)
+{
+	// 反复领取下一块, 读入[分界, 下一个分界 + 最长名字 - 1)扫描
+	EntityJob* job = w->job;
+	unsigned char* buffer = NULL;
+	size_t capacity = 0;
+	FILE* fp = fopen(job->path, "rb");
+	int result = fp == NULL ? -1 : 0;
+	while (result == 0)
+	{
+		mutexLock(&job->mutex);
+		uint32_t k = job->failed ? job->chunkCount : job->nextChunk;
+		if (k < job->chunkCount)
+			job->nextChunk++;
+		mutexUnlock(&job->mutex);
+		if (k >= job->chunkCount)
+			break;
+		uint64_t start = job->splits[k], end = job->splits[k + 1];
+		if (start == end)
+			continue;
+		uint64_t stop = end + job->m->maxLength - 1 < job->size ? end + job->m->maxLength - 1 : job->size;
+		size_t want = (size_t)(stop - start);
+		if (want > capacity)
+		{
+			unsigned char* grown = realloc(buffer, want);
+			if (grown == NULL)
+			{
+				result = -1;
+				break;
+			}
+			buffer = grown;
+			capacity = want;
+		}
+		if (fseeko(fp, (long long)start, SEEK_SET) != 0 || fread(buffer, 1, want, fp) != want)
+		{
+			result = -1;
+			break;
+		}
+		MatchList* list = job->positions ? &job->lists[k] : NULL;
+		result = scanChunk(w, buffer, want, (size_t)(end - start), start, list);
+		if (result == 0 && list != NULL)
+			qsort(list->items, (size_t)list->count, sizeof(EntityMatch), compareMatches);
+	}
+	if (result != 0)
+	{
+		mutexLock(&job->mutex);
+		job->failed = 1;
+		mutexUnlock(&job->mutex);
+	}
+	if (fp != NULL)
+		fclose(fp);
+	free(buffer);
+	return result;
+}
+
+#ifdef _WIN32
+static unsigned __stdcall workerMain(void* argument)
+{
+	scanChunks(argument);
+	return 0;
+}
+#else
+static void* workerMain(void* argument)
+{
+	scanChunks(argument);
+	return NULL;
+}
+#endif
+
+int entityCount(const EntityMatcher* m, const char* path, const uint64_t* chapters, uint32_t chapterCount,
+	int threads, int positions, EntityCounts* result)
+{
+	// chapters是各回起点的偏移(递增); 每个线程有自己的计数表, 结束后相加, 不需要加锁计数
+	EntityJob job;
+	EntityWorker workers[ENTITY_THREADS_MAX];
+	Thread handles[ENTITY_THREADS_MAX];
+	double start = copyNow();
+	memset(result, 0, sizeof(*result));
+	memset(&job, 0, sizeof(job));
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return -1;
+	long long size = fseeko(fp, 0, SEEK_END) == 0 ? ftello(fp) : -1;
+	fclose(fp);
+	if (size < 0)
+		return -1;
+	job.m = m;
+	job.path = path;
+	job.size = (uint64_t)size;
+	job.chapters = chapters;
+	job.chapterCount = chapterCount;
+	job.slots = chapterCount + 1;
+	job.chunkCount = (uint32_t)((job.size + ENTITY_CHUNK - 1) / ENTITY_CHUNK);
+	job.positions = positions;
+	if (threads < 1)
+		threads = 1;
+	if (threads > ENTITY_THREADS_MAX)
+		threads = ENTITY_THREADS_MAX;
+	if ((uint32_t)threads > job.chunkCount)
+		threads = job.chunkCount ? (int)job.chunkCount : 1;
+	size_t cells = (size_t)m->patternCount * job.slots;
+	result->slots = job.slots;
+	result->counts = calloc(cells ? cells : 1, sizeof(uint32_t));
+	result->totals = calloc(m->patternCount ? m->patternCount : 1, sizeof(uint64_t));
+	job.lists = positions ? calloc(job.chunkCount ? job.chunkCount : 1, sizeof(MatchList)) : NULL;
+	job.splits = malloc((job.chunkCount + 1) * sizeof(uint64_t));
+	int started = 0, failed = result->counts == NULL || result->totals == NULL || (positions && job.lists == NULL)
+		|| job.splits == NULL || findSplits(&job) != 0;
+	mutexInit(&job.mutex);
+	for (int i = 0; i < threads && !failed; i++)
+	{
+		workers[i].job = &job;
+		workers[i].counts = i == 0 ? result->counts : calloc(cells ? cells : 1, sizeof(uint32_t));
+		if (workers[i].counts == NULL)
+		{
+			failed = 1;
+			break;
+		}
+		started++;
+	}
+	// 第0个工作线程就是当前线程
+	for (int i = 1; i < started; i++)
+	{
+#ifdef _WIN32
+		handles[i] = (HANDLE)_beginthreadex(NULL, 0, workerMain, &workers[i], 0, NULL);
+		int ok = handles[i] != 0;
+#else
+		int ok = pthread_create(&handles[i], NULL, workerMain, &workers[i]) == 0;
+#endif
+		if (!ok)
+		{
+			free(workers[i].counts);
+			started = i;
+			break;
+		}
+	}
+	if (started > 0)
+		scanChunks(&workers[0]);
+	for (int i = 1; i < started; i++)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(handles[i], INFINITE);
+		CloseHandle(handles[i]);
+#else
+		pthread_join(handles[i], NULL);
+#endif
+		for (size_t c = 0; c < cells; c++)
+			result->counts[c] += workers[i].counts[c];
+		free(workers[i].counts);
+	}
+	mutexDestroy(&job.mutex);
+	failed |= job.failed || started == 0;
+	for (uint32_t k = 0; k < m->patternCount && !failed; k++)
+	{
+		for (uint32_t s = 0; s < job.slots; s++)
+			result->totals[k] += result->counts[(size_t)k * job.slots + s];
+	}
+	if (positions && !failed)
+	{
+		// 各块的匹配已按起点排好, 块之间起点不重叠, 按块的顺序连起来就是整体有序
+		for (uint32_t k = 0; k < job.chunkCount; k++)
+			result->matchCount += job.lists[k].count;
+		result->matches = malloc((size_t)(result->matchCount ? result->matchCount : 1) * sizeof(EntityMatch));
+		failed = result->matches == NULL;
+		for (uint64_t k = 0, n = 0; k < job.chunkCount && !failed; k++)
+		{
+			if (job.lists[k].count > 0)
+				memcpy(result->matches + n, job.lists[k].items, (size_t)job.lists[k].count * sizeof(EntityMatch));
+			n += job.lists[k].count;
+		}
+	}
+	for (uint32_t k = 0; positions && job.lists != NULL && k < job.chunkCount; k++)
+		free(job.lists[k].items);
+	free(job.lists);
+	free(job.splits);
+	result->bytes = job.size;
+	result->threads = started;
+	result->seconds = copyNow() - start;
+	if (failed)
+	{
+		entityCountsFree(result);
+		return -1;
+	}
+	return 0;
+}
+
+void entityCountsFree(EntityCounts* result)
+{
+	free(result->counts);
+	free(result->totals);
+	free(result->matches);
+	memset(result, 0, sizeof(*result));
+}
@@ -0,0 +1,67 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// 多模式匹配: 把成千上万个人名、地名编译成一个Aho-Corasick自动机, 对字节流一遍扫描找出全部出现
+// 自动机做成完整的转移表(不需要沿失败链回退), 字节先映射到字符类以缩小每行, 状态按广度优先编号,
+// 常走的浅层状态连在一起; 转移目标的最高位标记"到这里有名字结束", 扫描时每字节只查一次表
+// 文件在字符边界上切成块由线程池并行扫描, 每块多扫最长名字减1个字节, 只算起点在本块内的匹配,
+// 跨块的名字不重不漏
+
+#define ENTITY_CHUNK (4 << 20)         // 每个任务扫描4MB
+#define ENTITY_ALIGN 4096              // 找块的分界时每次读4KB
+#define ENTITY_PATTERN_MAX 255         // 名字最长255字节
+#define ENTITY_THREADS_MAX 64
+#define ENTITY_OUTPUT 0x80000000u      // 转移目标的标记位
+
+typedef enum
+{
+	ENTITY_GBK,       // 需要检查匹配是否从字符边界开始, 避免把前一个字的尾字节和后一个字的首字节当成一个字
+	ENTITY_UTF8       // UTF-8自同步, 不需要检查
+} EntityEncoding;
+
+typedef struct
+{
+	uint32_t pattern;
+	uint64_t offset;          // 匹配起点在文件中的偏移
+} EntityMatch;
+
+typedef struct
+{
+	EntityEncoding encoding;
+	uint32_t patternCount;
+	uint32_t maxLength;
+	uint32_t stateCount;
+	uint32_t classCount;
+	uint8_t classes[256];     // 字节 -> 字符类, 名字里没有的字节都是0类
+	uint32_t* next;           // [行 + 字符类] -> 目标状态的行(状态号 * classCount), 可能带ENTITY_OUTPUT
+	uint32_t* output;         // 每个状态(按行): 在这里结束的第一个名字 + 1, 0表示没有
+	uint32_t* suffix;         // 每个状态: 失败链上最近的有名字结束的状态的行, 没有时为0
+	uint32_t* same;           // 每个名字: 同一状态结束的下一个名字 + 1(重复的名字)
+	uint8_t* lengths;         // 每个名字的字节数
+} EntityMatcher;
+
+typedef struct
+{
+	uint32_t slots;           // 回数 + 1, 第0格是第一回之前的部分
+	uint32_t* counts;         // [名字 * slots + 格]
+	uint64_t* totals;         // 每个名字的总次数
+	EntityMatch* matches;     // 需要位置时按起点排好的全部匹配
+	uint64_t matchCount;
+	unsigned long long bytes;
+	double seconds;
+	int threads;
+} EntityCounts;
+
+int entityCompile(EntityMatcher* m, const unsigned char* const* patterns, const size_t* lengths, uint32_t count,
+	EntityEncoding encoding);
+void entityFree(EntityMatcher* m);
+int entityCount(const EntityMatcher* m, const char* path, const uint64_t* chapters, uint32_t chapterCount,
+	int threads, int positions, EntityCounts* result);
+void entityCountsFree(EntityCounts* result);
+int entityThreads(void);
+
+#endif
@@ -1,29 +1,831 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include<stdio.h>
+#include<stdarg.h>
 #include<stdlib.h>
-int main()
+#include<string.h>
+#include "copy.h"
+#include "transcode.h"
+#include "chapter.h"
+#include "search.h"
+#include "entity.h"
+#include "diff.h"
+#include "archive.h"
+
+#ifdef _WIN32
+#include<io.h>
+#include<fcntl.h>
+#define fileno _fileno
+#endif
+
+#ifdef _WIN32
+#define NOVEL "三国演义.txt"
+#define NOVEL_COPY "新三国演义.txt"
+#else
+// 源文件按GBK保存, 其他系统的文件名是UTF-8, 只能用转义写出
+#define NOVEL "\xE4\xB8\x89\xE5\x9B\xBD\xE6\xBC\x94\xE4\xB9\x89.txt"
+#define NOVEL_COPY "\xE6\x96\xB0\xE4\xB8\x89\xE5\x9B\xBD\xE6\xBC\x94\xE4\xB9\x89.txt"
+#endif
+
+static const char* consoleText(const char* text, char* buffer, size_t size)
 {
-	FILE* pf1 = fopen(".txt", "r");
+	// 源文件里的汉字是GBK: Windows控制台原样输出, 其他系统与正文一样转成UTF-8; 放不下或转不了时原样返回
+#ifdef _WIN32
+	(void)buffer;
+	(void)size;
+	return text;
+#else
+	Transcoder t;
+	size_t length = strlen(text), produced;
+	transcodeInit(&t, GBK_TO_UTF8);
+	if (transcodeMaxOutput(GBK_TO_UTF8, length) >= size
+		|| transcodeChunk(&t, (const unsigned char*)text, length, (unsigned char*)buffer, &produced, 1) != TRANSCODE_OK)
+		return text;
+	buffer[produced] = 0;
+	return buffer;
+#endif
+}
 
-	int count = 0;
-	char num;
+static void message(FILE* fp, const char* format, ...)
+{
+	// 提示、统计和表头: 只转换格式串, 参数里的文件名等来自命令行或文件系统, 已是控制台的编码
+	char converted[4096];
+	va_list args;
+	va_start(args, format);
+	vfprintf(fp, consoleText(format, converted, sizeof(converted)), args);
+	va_end(args);
+}
 
-	while (count <= 21150)
+static void usage(const char* program)
+{
+	message(stderr,
+		"用法: %s                  输出%s全文, 并复制为%s\n"
+		"      %s copy 源文件 目标文件\n"
+		"      %s gbk2utf8 输入 输出      GBK转UTF-8, 文件名为-时使用标准输入/输出\n"
+		"      %s utf82gbk 输入 输出      UTF-8转GBK\n"
+		"      %s index [文件]            建立或补充章回索引(文件.idx), 列出各回\n"
+		"      %s chapter 回数 [文件]     输出第N回\n"
+		"      %s page 偏移 [文件]        输出偏移附近的一页; 这三个命令的文件也可以是压缩包(%s)\n"
+		"      %s ngram 索引 文件...      对文件建二元组全文索引\n"
+		"      %s search 索引 词语 [条数] 查找词语出现的位置\n"
+		"      %s names 词典 [文件]       统计词典里每个名字在各回出现的次数\n"
+		"      %s where 词典 [文件]       列出词典里的名字出现的全部位置\n"
+		"      %s diff [文件1 文件2]      按行比较, 输出统一格式的差异, 默认比较%s和%s\n"
+		"      %s chardiff [文件1 文件2]  同diff, 改动的段落再按字符比较, ~开头的行用[-删去-]{+加入+}标出改动\n"
+		"      %s pack 文件...            用这些文件训练字典, 每个文件压缩成文件%s, 字典另存为同目录的哈希%s\n"
+		"      %s unpack 压缩包 输出      解出全文并校验\n",
+		program, NOVEL, NOVEL_COPY, program, program, program, program, program, program, ARCHIVE_SUFFIX, program, program,
+		program, program, program, NOVEL, NOVEL_COPY, program, program, ARCHIVE_SUFFIX, ARCHIVE_DICT_SUFFIX, program);
+}
+
+static int copyCommand(const char* from, const char* to)
+{
+	// 复制文件并在标准错误上报告吞吐量, 标准输出不受影响
+	CopyStats stats;
+	int result = copyFile(from, to, &stats);
+	if (result == COPY_SAME_FILE)
 	{
-		num = fgetc(pf1);
-		printf("%c", num);
-		count++;
+		message(stderr, "%s -> %s: 源文件和目标文件是同一个文件\n", from, to);
+		return 1;
 	}
-	fclose(pf1);
-	pf1 = NULL;
-	pf1 = fopen(".txt", "r");
-	FILE* pf2 = fopen(".txt", "w");
-	while (num != -1)
+	if (result != 0)
 	{
-		num = fgetc(pf1);
-		fputc(num, pf2);
+		perror(from);
+		return 1;
+	}
+	char text[128], converted[256];
+	fprintf(stderr, "%s -> %s: %s\n", from, to, consoleText(copyReport(&stats, text, sizeof(text)), converted, sizeof(converted)));
+	return 0;
+}
+
+static void transcodeMessage(const char* name, const Transcoder* t, TranscodeStatus status)
+{
+	// 转码错误的说明也是GBK, 与其他提示一样输出
+	char text[128], converted[256];
+	const char* error = consoleText(transcodeError(t, status, text, sizeof(text)), converted, sizeof(converted));
+	if (name != NULL)
+		fprintf(stderr, "%s: %s\n", name, error);
+	else
+		fprintf(stderr, "%s\n", error);
+}
+
+static FILE* openStream(const char* name, const char* mode)
+{
+	// "-"表示标准输入/输出, 都按二进制方式读写
+	if (strcmp(name, "-") != 0)
+		return fopen(name, mode);
+	FILE* fp = mode[0] == 'r' ? stdin : stdout;
+#ifdef _WIN32
+	_setmode(_fileno(fp), _O_BINARY);
+#endif
+	return fp;
+}
+
+static int transcodeCommand(const char* from, const char* to, TranscodeDirection direction)
+{
+	// 出错时报告位置和字节, 已转换的部分保留在输出中
+	FILE* in = openStream(from, "rb");
+	if (in == NULL)
+	{
+		perror(from);
+		return 1;
+	}
+	FILE* out = openStream(to, "wb");
+	if (out == NULL)
+	{
+		perror(to);
+		fclose(in);
+		return 1;
+	}
+	Transcoder t;
+	transcodeInit(&t, direction);
+	TranscodeStatus status = transcodeStream(&t, in, out);
+	if (in != stdin)
+		fclose(in);
+	if (out != stdout && fclose(out) != 0 && status == TRANSCODE_OK)
+		status = TRANSCODE_IO;
+	if (status != TRANSCODE_OK)
+	{
+		transcodeMessage(from, &t, status);
+		return 1;
+	}
+	message(stderr, "%s -> %s: %llu -> %llu 字节, %.3f 秒, %.1f MB/s\n", from, to, t.consumed, t.produced,
+		t.seconds, t.seconds > 0 ? t.consumed / 1048576.0 / t.seconds : 0.0);
+	return 0;
+}
+
+typedef struct
+{
+	FILE* fp;                 // 普通文本文件
+	Archive archive;          // fp为NULL时从压缩包读
+} Text;
+
+static int readText(void* source, uint64_t offset, void* buffer, size_t size, size_t* length)
+{
+	Text* text = source;
+	if (text->fp != NULL)
+		return chapterRead(text->fp, offset, buffer, size, length);
+	return archiveRead(&text->archive, offset, buffer, size, length);
+}
+
+static int printRange(Text* text, unsigned long long start, unsigned long long end)
+{
+	// 有限长度地读出[start, end)并输出, 不从头扫描; 与printNovel一样, 只在非Windows系统转成UTF-8
+	static unsigned char input[1 << 16];
+	static unsigned char output[(1 << 16) / 2 * 3 + 8];
+	Transcoder t;
+	transcodeInit(&t, GBK_TO_UTF8);
+	while (start < end)
+	{
+		size_t want = end - start < sizeof(input) ? (size_t)(end - start) : sizeof(input);
+		size_t length;
+		if (readText(text, start, input, want, &length) != 0 || length == 0)
+			return 1;
+		start += length;
+#ifdef _WIN32
+		fwrite(input, 1, length, stdout);
+#else
+		size_t produced;
+		TranscodeStatus status = transcodeChunk(&t, input, length, output, &produced, start >= end);
+		fwrite(output, 1, produced, stdout);
+		if (status != TRANSCODE_OK)
+		{
+			transcodeMessage(NULL, &t, status);
+			return 1;
+		}
+#endif
+	}
+	return 0;
+}
+
+static FILE* openIndexed(const char* name, ChapterIndex* index)
+{
+	// 读入name.idx, 只扫描索引之后追加的内容, 有变化时写回索引
+	char path[1024];
+	snprintf(path, sizeof(path), "%s.idx", name);
+	FILE* fp = fopen(name, "rb");
+	if (fp == NULL)
+	{
+		perror(name);
+		return NULL;
+	}
+	chapterIndexLoad(index, path);
+	double start = copyNow();
+	if (chapterIndexUpdate(index, fp) != 0)
+	{
+		message(stderr, "%s: 建立索引失败\n", name);
+		chapterIndexFree(index);
+		fclose(fp);
+		return NULL;
+	}
+	if (index->rescanned > 0)
+		message(stderr, "%s: 扫描 %llu 字节, %.3f 秒, 共%u回\n", name, (unsigned long long)index->rescanned,
+			copyNow() - start, index->count);
+	if (index->changed && chapterIndexSave(index, path) != 0)
+		perror(path);
+	return fp;
+}
+
+static int openText(const char* name, ChapterIndex* index, Text* text)
+{
+	// 压缩包自带章回表, 普通文件用openIndexed
+	memset(text, 0, sizeof(*text));
+	if (!archiveIsPacked(name))
+		return (text->fp = openIndexed(name, index)) != NULL ? 0 : -1;
+	if (archiveOpen(&text->archive, name) != 0)
+	{
+		message(stderr, "%s: 无法打开压缩包\n", name);
+		return -1;
+	}
+	if (archiveChapters(&text->archive, index) != 0)
+	{
+		message(stderr, "%s: 章回表损坏\n", name);
+		archiveClose(&text->archive);
+		return -1;
+	}
+	return 0;
+}
+
+static void closeText(Text* text)
+{
+	if (text->fp != NULL)
+		fclose(text->fp);
+	else
+		archiveClose(&text->archive);
+}
+
+static int indexCommand(const char* name)
+{
+	// 每回一行: 回数, 偏移, 长度, 标题
+	ChapterIndex index;
+	Text text;
+	if (openText(name, &index, &text) != 0)
+		return 1;
+	int result = 0;
+	for (uint32_t i = 0; i < index.count && result == 0; i++)
+	{
+		uint64_t start, end;
+		chapterRange(&index, i, &start, &end);
+		printf("%4u %12llu %10llu  ", index.entries[i].number, (unsigned long long)start, (unsigned long long)(end - start));
+		fflush(stdout);
+		result = printRange(&text, start, start + index.entries[i].titleLength);
+		printf("\n");
+	}
+	closeText(&text);
+	chapterIndexFree(&index);
+	return result;
+}
+
+static int chapterCommand(const char* number, const char* name)
+{
+	ChapterIndex index;
+	Text text;
+	if (openText(name, &index, &text) != 0)
+		return 1;
+	int i = chapterFind(&index, (uint32_t)strtoul(number, NULL, 10));
+	int result = 1;
+	if (i < 0)
+		message(stderr, "%s: 没有第%s回\n", name, number);
+	else
+	{
+		uint64_t start, end;
+		chapterRange(&index, i, &start, &end);
+		fflush(stdout);
+		result = printRange(&text, start, end);
+	}
+	closeText(&text);
+	chapterIndexFree(&index);
+	return result;
+}
+
+static int pageCommand(const char* offset, const char* name)
+{
+	// 页的范围和所在的回写到标准错误
+	ChapterIndex index;
+	Text text;
+	if (openText(name, &index, &text) != 0)
+		return 1;
+	uint64_t at = strtoull(offset, NULL, 10), start, end;
+	int result = 1;
+	if (chapterPage(readText, &text, &index, at, CHAPTER_PAGE_SIZE, &start, &end) != 0)
+		message(stderr, "%s: 偏移%s超出文件长度%llu\n", name, offset, (unsigned long long)index.scanned);
+	else
+	{
+		int i = chapterAt(&index, at);
+		message(stderr, "%s: %llu-%llu 字节", name, (unsigned long long)start, (unsigned long long)end);
+		if (i >= 0)
+			message(stderr, ", 第%u回", index.entries[i].number);
+		fprintf(stderr, "\n");
+		fflush(stdout);
+		result = printRange(&text, start, end);
+	}
+	closeText(&text);
+	chapterIndexFree(&index);
+	return result;
+}
+
+static int buildCommand(const char* path, const char* const* files, int count)
+{
+	SearchBuildStats stats;
+	if (searchBuild(path, files, count, &stats) != 0)
+	{
+		message(stderr, "%s: 建立索引失败\n", path);
+		return 1;
+	}
+	message(stderr, "%s: %d 个文件, %llu 字节, %u 个二元组, %llu 个位置, 索引 %llu 字节, %.3f 秒\n", path, count,
+		stats.bytes, stats.terms, stats.postings, stats.size, stats.seconds);
+	return 0;
+}
+
+static void printText(const unsigned char* text, size_t length)
+{
+	// 输出一段完整的GBK文本, 非Windows系统转成UTF-8
+#ifdef _WIN32
+	fwrite(text, 1, length, stdout);
+#else
+	static unsigned char output[1024];
+	Transcoder t;
+	size_t produced;
+	transcodeInit(&t, GBK_TO_UTF8);
+	if (transcodeMaxOutput(GBK_TO_UTF8, length) <= sizeof(output)
+		&& transcodeChunk(&t, text, length, output, &produced, 1) == TRANSCODE_OK)
+		fwrite(output, 1, produced, stdout);
+#endif
+}
+
+static int searchCommand(const char* path, const char* word, int maxHits)
+{
+	// 结果按文件和偏移的顺序, 每行一处, 带前后文; 结果数和查询耗时写到标准错误
+	SearchIndex index;
+	unsigned char phrase[SEARCH_PHRASE_MAX * 2];
+	size_t length = strlen(word);
+#ifdef _WIN32
+	if (length > sizeof(phrase))
+		length = sizeof(phrase) + 1;
+	else
+		memcpy(phrase, word, length);
+#else
+	// 命令行参数是UTF-8, 索引按GBK建
+	Transcoder t;
+	transcodeInit(&t, UTF8_TO_GBK);
+	if (length > sizeof(phrase) || transcodeChunk(&t, (const unsigned char*)word, length, phrase, &length, 1) != TRANSCODE_OK)
+		length = sizeof(phrase) + 1;
+#endif
+	if (length > sizeof(phrase))
+	{
+		message(stderr, "%s: 无法查找的词语\n", word);
+		return 1;
+	}
+	if (searchOpen(&index, path) != 0)
+	{
+		message(stderr, "%s: 无法打开索引\n", path);
+		return 1;
+	}
+	if (index.stale > 0)
+		message(stderr, "%s: %u 个文件在建索引后改动过, 请重新建立索引\n", path, index.stale);
+	SearchHit* hits = malloc((maxHits > 0 ? maxHits : 1) * sizeof(SearchHit));
+	unsigned long long total = 0;
+	double start = copyNow();
+	int found = hits == NULL ? -1 : searchPhrase(&index, phrase, length, hits, maxHits, &total);
+	double seconds = copyNow() - start;
+	for (int i = 0; i < found; i++)
+	{
+		char name[1024];
+		unsigned char snippet[SEARCH_CONTEXT * 2 + SEARCH_PHRASE_MAX * 2 + 4];
+		size_t n = searchSnippet(&index, &hits[i], length, snippet, sizeof(snippet));
+		printf("%s:%llu: ", searchDocName(&index, hits[i].doc, name, sizeof(name)), (unsigned long long)hits[i].offset);
+		printText(snippet, n);
+		printf("\n");
+	}
+	if (found >= 0)
+		message(stderr, "%llu 处, 显示 %d 处, 查询 %.3f 毫秒\n", total, found, seconds * 1000);
+	free(hits);
+	searchClose(&index);
+	return found < 0;
+}
+
+typedef struct
+{
+	unsigned char* text;          // 整个词典文件, 每行一个名字
+	unsigned char* converted;     // 与正文编码不同的行转换后放在这里
+	const unsigned char** patterns;
+	size_t* lengths;
+	uint32_t count;
+} Dictionary;
+
+static unsigned char* loadFile(const char* path, size_t* length)
+{
+	// 整个文件读进内存, 后面多留一个字节
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL)
+		return NULL;
+	long size = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+	rewind(fp);
+	unsigned char* text = size >= 0 ? malloc(size + 1) : NULL;
+	*length = text != NULL ? fread(text, 1, size, fp) : 0;
+	fclose(fp);
+	if (text != NULL && *length != (size_t)size)
+	{
+		free(text);
+		text = NULL;
+	}
+	return text;
+}
+
+static int looksUtf8(const unsigned char* sample, size_t n)
+{
+	// 有非ASCII字节且是合法UTF-8时当作UTF-8, 否则当作GBK
+	for (size_t i = 0; i < n; i++)
+	{
+		if (sample[i] >= 0x80)
+			return transcodeIsUtf8(sample, n);
 	}
-	fclose(pf1);
-	fclose(pf2);
 	return 0;
-}
\ No newline at end of file
+}
+
+static void freeDictionary(Dictionary* d)
+{
+	free(d->text);
+	free(d->converted);
+	free(d->patterns);
+	free(d->lengths);
+	memset(d, 0, sizeof(*d));
+}
+
+static int loadDictionary(const char* path, EntityEncoding encoding, Dictionary* d)
+{
+	// 空行和#开头的行跳过; 每行按自己的编码判断, 与正文不同时转换, 词典用UTF-8写也能查GBK正文
+	memset(d, 0, sizeof(*d));
+	size_t length;
+	d->text = loadFile(path, &length);
+	if (d->text == NULL)
+		return -1;
+	d->text[length] = '\n';
+	d->converted = malloc(transcodeMaxOutput(GBK_TO_UTF8, length) + length * 2 + 1);
+	d->patterns = malloc((length / 2 + 1) * sizeof(unsigned char*));
+	d->lengths = malloc((length / 2 + 1) * sizeof(size_t));
+	if (d->converted == NULL || d->patterns == NULL || d->lengths == NULL)
+		return -1;
+	size_t used = 0;
+	for (unsigned char* line = d->text; line < d->text + length;)
+	{
+		unsigned char* end = memchr(line, '\n', d->text + length + 1 - line);
+		size_t n = end - line;
+		if (n > 0 && line[n - 1] == '\r')
+			n--;
+		if (n > 0 && line[0] != '#')
+		{
+			int ascii = 1;
+			for (size_t i = 0; i < n && ascii; i++)
+				ascii = line[i] < 0x80;
+			int utf8 = transcodeIsUtf8(line, n);
+			const unsigned char* pattern = line;
+			if (!ascii && utf8 != (encoding == ENTITY_UTF8))
+			{
+				Transcoder t;
+				size_t produced;
+				transcodeInit(&t, utf8 ? UTF8_TO_GBK : GBK_TO_UTF8);
+				if (transcodeChunk(&t, line, n, d->converted + used, &produced, 1) != TRANSCODE_OK)
+					return -1;
+				pattern = d->converted + used;
+				n = produced;
+				used += produced;
+			}
+			d->patterns[d->count] = pattern;
+			d->lengths[d->count++] = n;
+		}
+		line = end + 1;
+	}
+	return 0;
+}
+
+static EntityEncoding detectEncoding(FILE* fp)
+{
+	// 看开头64KB
+	static unsigned char sample[1 << 16];
+	size_t n;
+	if (chapterRead(fp, 0, sample, sizeof(sample), &n) != 0)
+		return ENTITY_GBK;
+	return looksUtf8(sample, n) ? ENTITY_UTF8 : ENTITY_GBK;
+}
+
+static void printName(const Dictionary* d, uint32_t k, EntityEncoding encoding)
+{
+	if (encoding == ENTITY_GBK)
+		printText(d->patterns[k], d->lengths[k]);
+	else
+		fwrite(d->patterns[k], 1, d->lengths[k], stdout);
+}
+
+static int namesCommand(const char* dictionary, const char* name, int positions)
+{
+	// 一遍扫描得到每个名字在各回的次数(制表符分隔的表), 或者全部出现位置
+	ChapterIndex index;
+	Dictionary d;
+	EntityMatcher m;
+	EntityCounts counts;
+	FILE* fp = openIndexed(name, &index);
+	if (fp == NULL)
+		return 1;
+	EntityEncoding encoding = detectEncoding(fp);
+	fclose(fp);
+	uint64_t* chapters = malloc((index.count ? index.count : 1) * sizeof(uint64_t));
+	for (uint32_t i = 0; chapters != NULL && i < index.count; i++)
+		chapters[i] = index.entries[i].offset;
+	int result = 1;
+	if (loadDictionary(dictionary, encoding, &d) != 0)
+		message(stderr, "%s: 无法读取词典\n", dictionary);
+	else if (entityCompile(&m, d.patterns, d.lengths, d.count, encoding) != 0)
+		message(stderr, "%s: 词典为空或名字太长(最多%d字节)\n", dictionary, ENTITY_PATTERN_MAX);
+	else
+	{
+		if (chapters == NULL || entityCount(&m, name, chapters, index.count, entityThreads(), positions, &counts) != 0)
+			message(stderr, "%s: 扫描失败\n", name);
+		else
+		{
+			result = 0;
+			if (positions)
+			{
+				for (uint64_t i = 0; i < counts.matchCount; i++)
+				{
+					int chapter = chapterAt(&index, counts.matches[i].offset);
+					printf("%llu\t%u\t", (unsigned long long)counts.matches[i].offset, chapter < 0 ? 0 : index.entries[chapter].number);
+					printName(&d, counts.matches[i].pattern, encoding);
+					printf("\n");
+				}
+			}
+			else
+			{
+				// 第一回之前有匹配时才输出"回前"一列
+				int before = 0;
+				for (uint32_t k = 0; k < d.count; k++)
+					before |= counts.counts[(size_t)k * counts.slots] != 0;
+				message(stdout, before ? "名字\t合计\t回前" : "名字\t合计");
+				for (uint32_t i = 0; i < index.count; i++)
+					printf("\t%u", index.entries[i].number);
+				printf("\n");
+				for (uint32_t k = 0; k < d.count; k++)
+				{
+					printName(&d, k, encoding);
+					printf("\t%llu", (unsigned long long)counts.totals[k]);
+					for (uint32_t s = before ? 0 : 1; s < counts.slots; s++)
+						printf("\t%u", counts.counts[(size_t)k * counts.slots + s]);
+					printf("\n");
+				}
+			}
+			message(stderr, "%s: %u 个名字, %u 个状态 x %u 类, %d 线程, %llu 字节, %.3f 秒, %.1f MB/s\n", name, d.count,
+				m.stateCount, m.classCount, counts.threads, counts.bytes, counts.seconds,
+				counts.seconds > 0 ? counts.bytes / 1048576.0 / counts.seconds : 0.0);
+			entityCountsFree(&counts);
+		}
+		entityFree(&m);
+	}
+	freeDictionary(&d);
+	free(chapters);
+	chapterIndexFree(&index);
+	return result;
+}
+
+typedef struct
+{
+	Transcoder t;
+	int convert;              // GBK文本在非Windows系统转成UTF-8输出
+} DiffOutput;
+
+static void writeDiff(void* context, const unsigned char* text, size_t length)
+{
+	// 差异是GBK原文的片段, 分成16KB一段转码, 不合法的字节原样输出
+	DiffOutput* out = context;
+	static unsigned char output[(16 << 10) / 2 * 3 + 8];
+	if (!out->convert)
+	{
+		fwrite(text, 1, length, stdout);
+		return;
+	}
+	while (length > 0)
+	{
+		size_t n = length < (16 << 10) ? length : (16 << 10), produced;
+		if (transcodeChunk(&out->t, text, n, output, &produced, 0) == TRANSCODE_OK)
+			fwrite(output, 1, produced, stdout);
+		else
+		{
+			fwrite(text, 1, n, stdout);
+			transcodeInit(&out->t, GBK_TO_UTF8);
+		}
+		text += n;
+		length -= n;
+	}
+}
+
+static int diffCommand(const char* from, const char* to, int chars)
+{
+	// 与diff命令一样, 相同返回0, 不同返回1, 出错返回2; 统计写到标准错误
+	size_t aLength = 0, bLength = 0;
+	unsigned char* a = loadFile(from, &aLength);
+	unsigned char* b = a != NULL ? loadFile(to, &bLength) : NULL;
+	if (a == NULL || b == NULL)
+	{
+		perror(a == NULL ? from : to);
+		free(a);
+		return 2;
+	}
+	Diff d;
+	int hunks = -1;
+	if (diffCompare(&d, a, aLength, b, bLength, DIFF_CONTEXT) == 0)
+	{
+		DiffOutput out;
+		int utf8 = looksUtf8(a, aLength < (1 << 16) ? aLength : (1 << 16));
+#ifdef _WIN32
+		out.convert = 0;
+#else
+		out.convert = !utf8;
+#endif
+		transcodeInit(&out.t, GBK_TO_UTF8);
+		if (d.deleted + d.inserted > 0)
+		{
+			printf("--- %s\n+++ %s\n", from, to);
+			fflush(stdout);
+		}
+		hunks = diffWrite(&d, chars, utf8, writeDiff, &out);
+		message(stderr, "%s -> %s: 比较了中间 %llu / %llu 行, 删去 %llu 行, 加入 %llu 行, %d 处, %.3f 秒\n", from, to,
+			(unsigned long long)d.a.count, (unsigned long long)d.b.count, (unsigned long long)d.deleted,
+			(unsigned long long)d.inserted, hunks, d.seconds);
+		diffFree(&d);
+	}
+	else
+		message(stderr, "%s -> %s: 内存不足\n", from, to);
+	free(a);
+	free(b);
+	return hunks < 0 ? 2 : hunks > 0;
+}
+
+static int packCommand(const char* const* files, int count)
+{
+	// 字典用全部文件训练一次, 每个文件各自成包, 各块用不用字典取压缩后小的; 字典存成与包同目录的共享字典文件,
+	// 字典文件的长度算进去仍不比全部不用字典时小, 就全部不用字典重新压缩
+	static unsigned char dict[ARCHIVE_DICT];
+	size_t dictSize;
+	double start = copyNow();
+	if (archiveTrain(files, count, dict, &dictSize) != 0)
+	{
+		message(stderr, "训练字典失败\n");
+		return 1;
+	}
+	message(stderr, "字典 %llu 字节, %.3f 秒\n", (unsigned long long)dictSize, copyNow() - start);
+	ChapterIndex* indexes = calloc(count, sizeof(ChapterIndex));
+	ArchiveStats* stats = calloc(count, sizeof(ArchiveStats));
+	char (*paths)[1024] = calloc(count, sizeof(*paths));
+	if (indexes == NULL || stats == NULL || paths == NULL)
+	{
+		message(stderr, "内存不足\n");
+		free(indexes);
+		free(stats);
+		free(paths);
+		return 1;
+	}
+	int result = 0;
+	for (int i = 0; i < count; i++)
+	{
+		FILE* fp = openIndexed(files[i], &indexes[i]);
+		if (fp == NULL)
+		{
+			result = 1;
+			continue;
+		}
+		fclose(fp);
+		snprintf(paths[i], sizeof(paths[i]), "%s%s", files[i], ARCHIVE_SUFFIX);
+	}
+	unsigned long long bytes, packed, plain, shared;
+	for (;;)
+	{
+		bytes = packed = plain = shared = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (paths[i][0] == 0)
+				continue;
+			if (archivePack(paths[i], files[i], dict, dictSize, &indexes[i], &stats[i]) != 0)
+			{
+				message(stderr, "%s: 压缩失败\n", paths[i]);
+				paths[i][0] = 0;
+				result = 1;
+				continue;
+			}
+			bytes += stats[i].bytes;
+			packed += stats[i].packed;
+			plain += stats[i].plain;
+			shared += stats[i].shared;
+		}
+		if (shared == 0 || packed + dictSize < plain)
+			break;
+		dictSize = 0;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		if (paths[i][0] == 0)
+			continue;
+		if (stats[i].shared > 0 && archiveSaveDict(paths[i], dict, dictSize) != 0)
+		{
+			message(stderr, "%s: 无法写入字典文件\n", paths[i]);
+			result = 1;
+		}
+		message(stderr, "%s -> %s: %llu -> %llu 字节 (%.1f%%), %u回, %llu 块原样存放, %llu 块用字典, %.3f 秒, %.1f MB/s\n",
+			files[i], paths[i], stats[i].bytes, stats[i].packed, stats[i].bytes ? stats[i].packed * 100.0 / stats[i].bytes : 0.0,
+			indexes[i].count, stats[i].stored, stats[i].shared, stats[i].seconds,
+			stats[i].seconds > 0 ? stats[i].bytes / 1048576.0 / stats[i].seconds : 0.0);
+		chapterIndexFree(&indexes[i]);
+	}
+	if (shared > 0)
+		packed += dictSize;
+	message(stderr, "共 %llu -> %llu 字节 (%.1f%%), 其中共享字典 %llu 字节\n", bytes, packed,
+		bytes ? packed * 100.0 / bytes : 0.0, shared > 0 ? (unsigned long long)dictSize : 0ULL);
+	free(indexes);
+	free(stats);
+	free(paths);
+	return result;
+}
+
+static int unpackCommand(const char* from, const char* to)
+{
+	Archive archive;
+	if (archiveOpen(&archive, from) != 0)
+	{
+		message(stderr, "%s: 无法打开压缩包\n", from);
+		return 1;
+	}
+	FILE* out = openStream(to, "wb");
+	if (out == NULL)
+	{
+		perror(to);
+		archiveClose(&archive);
+		return 1;
+	}
+	double start = copyNow();
+	int result = archiveUnpack(&archive, out);
+	if (out != stdout && fclose(out) != 0)
+		result = -1;
+	if (result != 0)
+		message(stderr, "%s: 解压失败或校验不符\n", from);
+	else
+		message(stderr, "%s -> %s: %llu 字节, %.3f 秒\n", from, to, (unsigned long long)archive.header.size, copyNow() - start);
+	archiveClose(&archive);
+	return result != 0;
+}
+
+static int printNovel(void)
+{
+	// 整个文件写到标准输出, 不限长度; Windows控制台本身是GBK, 直接输出, 其他系统转成UTF-8
+	FILE* pf1 = fopen(NOVEL, "rb");
+	if (pf1 == NULL)
+	{
+		perror(NOVEL);
+		return 1;
+	}
+	fflush(stdout);
+#ifdef _WIN32
+	CopyStats stats;
+	int result = copyStream(fileno(pf1), fileno(stdout), &stats);
+#else
+	Transcoder t;
+	transcodeInit(&t, GBK_TO_UTF8);
+	int result = transcodeStream(&t, pf1, stdout);
+	if (result != TRANSCODE_OK)
+		transcodeMessage(NOVEL, &t, (TranscodeStatus)result);
+#endif
+	fclose(pf1);
+	return result != 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc == 1)
+	{
+		if (printNovel() != 0)
+			return 1;
+		return copyCommand(NOVEL, NOVEL_COPY);
+	}
+	if (strcmp(argv[1], "copy") == 0 && argc == 4)
+		return copyCommand(argv[2], argv[3]);
+	if (strcmp(argv[1], "gbk2utf8") == 0 && argc == 4)
+		return transcodeCommand(argv[2], argv[3], GBK_TO_UTF8);
+	if (strcmp(argv[1], "utf82gbk") == 0 && argc == 4)
+		return transcodeCommand(argv[2], argv[3], UTF8_TO_GBK);
+	if (strcmp(argv[1], "index") == 0 && argc <= 3)
+		return indexCommand(argc == 3 ? argv[2] : NOVEL);
+	if (strcmp(argv[1], "chapter") == 0 && (argc == 3 || argc == 4))
+		return chapterCommand(argv[2], argc == 4 ? argv[3] : NOVEL);
+	if (strcmp(argv[1], "page") == 0 && (argc == 3 || argc == 4))
+		return pageCommand(argv[2], argc == 4 ? argv[3] : NOVEL);
+	if (strcmp(argv[1], "ngram") == 0 && argc >= 4)
+		return buildCommand(argv[2], (const char* const*)argv + 3, argc - 3);
+	if (strcmp(argv[1], "search") == 0 && (argc == 4 || argc == 5))
+		return searchCommand(argv[2], argv[3], argc == 5 ? atoi(argv[4]) : 20);
+	if ((strcmp(argv[1], "names") == 0 || strcmp(argv[1], "where") == 0) && (argc == 3 || argc == 4))
+		return namesCommand(argv[2], argc == 4 ? argv[3] : NOVEL, argv[1][0] == 'w');
+	if ((strcmp(argv[1], "diff") == 0 || strcmp(argv[1], "chardiff") == 0) && (argc == 2 || argc == 4))
+		return diffCommand(argc == 4 ? argv[2] : NOVEL, argc == 4 ? argv[3] : NOVEL_COPY, argv[1][0] == 'c');
+	if (strcmp(argv[1], "pack") == 0 && argc >= 3)
+		return packCommand((const char* const*)argv + 2, argc - 2);
+	if (strcmp(argv[1], "unpack") == 0 && argc == 4)
+		return unpackCommand(argv[2], argv[3]);
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,757 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "copy.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define fseeko _fseeki64
+#define stat _stat64
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+typedef struct
+{
+	uint32_t key;
+	uint32_t count;
+	uint64_t last;            // 上一个位置, 下一个位置存与它的差
+	unsigned char* data;      // 已压缩的位置表
+	size_t length;
+	size_t capacity;
+} TermBuilder;
+
+typedef struct
+{
+	TermBuilder* terms;
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t* table;          // 开放寻址散列表, 存terms的序号 + 1
+	uint32_t tableBits;
+	unsigned long long postings;
+} Builder;
+
+typedef struct
+{
+	const SearchTerm* term;
+	const unsigned char* data;
+	const unsigned char* next;    // 下一个要解码的字节
+	const unsigned char* end;     // 位置表结尾
+	const SearchSkip* skips;
+	uint32_t skipCount;
+	uint32_t index;               // 当前位置的序号
+	uint64_t value;               // 当前位置
+	uint64_t delta;               // 二元组在短语中的字节偏移
+} Cursor;
+
+static size_t unitAt(const unsigned char* p, size_t length, int final, uint32_t* code)
+{
+	// 一个字符: 合法的双字节GBK字符或单个字节; 双字节字符只读到一半且后面还有数据时返回0
+	if (p[0] >= 0x81 && p[0] <= 0xFE)
+	{
+		if (length < 2)
+		{
+			if (!final)
+				return 0;
+		}
+		else if (p[1] >= 0x40 && p[1] != 0x7F && p[1] != 0xFF)
+		{
+			*code = (uint32_t)p[0] << 8 | p[1];
+			return 2;
+		}
+	}
+	*code = p[0];
+	return 1;
+}
+
+static int growTable(Builder* b)
+{
+	uint32_t bits = b->tableBits ? b->tableBits + 1 : 16;
+	uint32_t* table = calloc((size_t)1 << bits, sizeof(uint32_t));
+	if (table == NULL)
+		return -1;
+	uint32_t mask = (1u << bits) - 1;
+	for (uint32_t i = 0; i < b->count; i++)
+	{
+		uint32_t slot = (b->terms[i].key * 2654435761u) >> (32 - bits);
+		while (table[slot] != 0)
+			slot = (slot + 1) & mask;
+		table[slot] = i + 1;
+	}
+	free(b->table);
+	b->table = table;
+	b->tableBits = bits;
+	return 0;
+}
+
+static TermBuilder* termFor(Builder* b, uint32_t key)
+{
+	if (b->count * 2 >= (b->tableBits ? 1u << b->tableBits : 0) && growTable(b) != 0)
+		return NULL;
+	uint32_t mask = (1u << b->tableBits) - 1;
+	uint32_t slot = (key * 2654435761u) >> (32 - b->tableBits);
+	while (b->table[slot] != 0)
+	{
+		TermBuilder* t = &b->terms[b->table[slot] - 1];
+		if (t->key == key)
+			return t;
+		slot = (slot + 1) & mask;
+	}
+	if (b->count == b->capacity)
+	{
+		uint32_t capacity = b->capacity ? b->capacity * 2 : 65536;
+		TermBuilder* terms = realloc(b->terms, capacity * sizeof(TermBuilder));
+		if (terms == NULL)
+			return NULL;
+		b->terms = terms;
+		b->capacity = capacity;
+	}
+	TermBuilder* t = &b->terms[b->count++];
+	memset(t, 0, sizeof(*t));
+	t->key = key;
+	b->table[slot] = b->count;
+	return t;
+}
+
+static int addPosting(Builder* b, uint32_t key, uint64_t position)
+{
+	TermBuilder* t = termFor(b, key);
+	if (t == NULL)
+		return -1;
+	if (t->length + 10 > t->capacity)
+	{
+		size_t capacity = t->capacity ? t->capacity * 2 : 16;
+		unsigned char* data = realloc(t->data, capacity);
+		if (data == NULL)
+			return -1;
+		t->data = data;
+		t->capacity = capacity;
+	}
+	uint64_t delta = position - t->last;
+	while (delta >= 0x80)
+	{
+		t->data[t->length++] = (unsigned char)(delta | 0x80);
+		delta >>= 7;
+	}
+	t->data[t->length++] = (unsigned char)delta;
+	t->last = position;
+	t->count++;
+	b->postings++;
+	return 0;
+}
+
+static uint64_t readVarint(const unsigned char** p, const unsigned char* end)
+{
+	// 64位值最多10个字节; 索引损坏时读到end或第10个字节为止, 不越过位置表
+	uint64_t value = 0;
+	for (int shift = 0; shift < 70 && *p < end; shift += 7)
+	{
+		unsigned char c = *(*p)++;
+		value |= (uint64_t)(c & 0x7F) << shift;
+		if (c < 0x80)
+			break;
+	}
+	return value;
+}
+
+static int indexFile(Builder* b, FILE* fp, uint64_t base, uint64_t* size, unsigned char* buffer)
+{
+	// 分块读入, 块尾不完整的双字节字符留到下一块开头; 每个字符与前一个字符组成一个二元组
+	uint64_t offset = 0, previousOffset = 0;
+	uint32_t previous = 0;
+	int started = 0;
+	size_t carry = 0;
+	for (;;)
+	{
+		size_t n = fread(buffer + carry, 1, SEARCH_CHUNK, fp);
+		if (ferror(fp))
+			return -1;
+		size_t total = carry + n, i = 0;
+		int final = n == 0;
+		while (i < total)
+		{
+			uint32_t code;
+			size_t step = unitAt(buffer + i, total - i, final, &code);
+			if (step == 0)
+				break;
+			if (started && addPosting(b, previous << 16 | code, base + previousOffset) != 0)
+				return -1;
+			previous = code;
+			previousOffset = offset + i;
+			started = 1;
+			i += step;
+		}
+		carry = total - i;
+		memmove(buffer, buffer + i, carry);
+		offset += i;
+		if (final)
+			break;
+	}
+	if (started && addPosting(b, previous << 16, base + previousOffset) != 0)
+		return -1;
+	*size = offset;
+	return 0;
+}
+
+static int compareTerms(const void* a, const void* b)
+{
+	uint32_t x = ((const TermBuilder*)a)->key, y = ((const TermBuilder*)b)->key;
+	return x < y ? -1 : x > y;
+}
+
+static int writeIndex(Builder* b, FILE* fp, const char* const* files, const SearchDoc* docs, int count,
+	unsigned long long* size)
+{
+	// 依次写文件头、文档表、名字区、二元组表、跳表和位置区
+	SearchHeader header;
+	static const char padding[8] = { 0 };
+	uint64_t names = 0, skips = 0, postings = 0;
+	qsort(b->terms, b->count, sizeof(TermBuilder), compareTerms);
+	for (int i = 0; i < count; i++)
+		names += docs[i].nameLength;
+	for (uint32_t i = 0; i < b->count; i++)
+	{
+		skips += (b->terms[i].count - 1) / SEARCH_SKIP_INTERVAL;
+		postings += b->terms[i].length;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SEARCH_MAGIC, 4);
+	header.version = SEARCH_VERSION;
+	header.docCount = count;
+	header.termCount = b->count;
+	header.skipCount = skips;
+	header.postingCount = b->postings;
+	header.docOffset = sizeof(header);
+	header.nameOffset = header.docOffset + count * sizeof(SearchDoc);
+	header.termOffset = (header.nameOffset + names + 7) & ~(uint64_t)7;
+	header.skipOffset = header.termOffset + b->count * sizeof(SearchTerm);
+	header.postingOffset = header.skipOffset + skips * sizeof(SearchSkip);
+	header.size = header.postingOffset + postings;
+	int failed = fwrite(&header, sizeof(header), 1, fp) != 1
+		|| fwrite(docs, sizeof(SearchDoc), count, fp) != (size_t)count;
+	for (int i = 0; i < count && !failed; i++)
+		failed = fwrite(files[i], 1, docs[i].nameLength, fp) != docs[i].nameLength;
+	if (!failed)
+		failed = fwrite(padding, 1, (size_t)(header.termOffset - header.nameOffset - names), fp) != header.termOffset - header.nameOffset - names;
+	postings = 0;
+	skips = 0;
+	for (uint32_t i = 0; i < b->count && !failed; i++)
+	{
+		SearchTerm term;
+		term.key = b->terms[i].key;
+		term.count = b->terms[i].count;
+		term.posting = postings;
+		term.skip = skips;
+		failed = fwrite(&term, sizeof(term), 1, fp) != 1;
+		postings += b->terms[i].length;
+		skips += (b->terms[i].count - 1) / SEARCH_SKIP_INTERVAL;
+	}
+	for (uint32_t i = 0; i < b->count && !failed; i++)
+	{
+		// 解一遍位置表, 每SEARCH_SKIP_INTERVAL个位置记下位置值和之后的字节偏移
+		const TermBuilder* t = &b->terms[i];
+		const unsigned char* p = t->data;
+		SearchSkip skip = { 0, 0 };
+		for (uint32_t k = 0; k < t->count && !failed; k++)
+		{
+			skip.position += readVarint(&p, t->data + t->length);
+			if (k > 0 && k % SEARCH_SKIP_INTERVAL == 0)
+			{
+				skip.offset = p - t->data;
+				failed = fwrite(&skip, sizeof(skip), 1, fp) != 1;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < b->count && !failed; i++)
+		failed = fwrite(b->terms[i].data, 1, b->terms[i].length, fp) != b->terms[i].length;
+	*size = header.size;
+	return failed ? -1 : 0;
+}
+
+int searchBuild(const char* path, const char* const* files, int count, SearchBuildStats* stats)
+{
+	// 先写临时文件再改名; 内存占用约等于压缩后的位置表
+	Builder b;
+	SearchDoc* docs = calloc(count ? count : 1, sizeof(SearchDoc));
+	unsigned char* buffer = malloc(SEARCH_CHUNK + 2);
+	double start = copyNow();
+	uint64_t base = 0;
+	int result = docs == NULL || buffer == NULL ? -1 : 0;
+	memset(&b, 0, sizeof(b));
+	memset(stats, 0, sizeof(*stats));
+	for (int i = 0; i < count && result == 0; i++)
+	{
+		FILE* fp = fopen(files[i], "rb");
+		if (fp == NULL)
+		{
+			result = -1;
+			break;
+		}
+		docs[i].base = base;
+		docs[i].name = (uint32_t)(i == 0 ? 0 : docs[i - 1].name + docs[i - 1].nameLength);
+		docs[i].nameLength = (uint32_t)strlen(files[i]);
+		result = indexFile(&b, fp, base, &docs[i].size, buffer);
+		fclose(fp);
+		base += docs[i].size + 1;
+		stats->bytes += docs[i].size;
+	}
+	free(buffer);
+	if (result == 0)
+	{
+		char temp[1024];
+		snprintf(temp, sizeof(temp), "%s.tmp", path);
+		FILE* fp = fopen(temp, "wb");
+		result = fp == NULL ? -1 : writeIndex(&b, fp, files, docs, count, &stats->size);
+		if (fp != NULL && fclose(fp) != 0)
+			result = -1;
+		if (result != 0)
+			remove(temp);
+		else
+		{
+#ifdef _WIN32
+			remove(path);
+#endif
+			result = rename(temp, path);
+		}
+	}
+	stats->postings = b.postings;
+	stats->terms = b.count;
+	for (uint32_t i = 0; i < b.count; i++)
+		free(b.terms[i].data);
+	free(b.terms);
+	free(b.table);
+	free(docs);
+	stats->seconds = copyNow() - start;
+	return result;
+}
+
+static const void* mapFile(const char* path, size_t* size)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER length;
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	if (!GetFileSizeEx(file, &length) || length.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* map = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(file);
+	*size = (size_t)length.QuadPart;
+	return map;
+#else
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	*size = st.st_size;
+	return map == MAP_FAILED ? NULL : map;
+#endif
+}
+
+static void unmapFile(const void* map, size_t size)
+{
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(map);
+#else
+	munmap((void*)map, size);
+#endif
+}
+
+int searchOpen(SearchIndex* index, const char* path)
+{
+	// 检查各区是否落在文件内, 以及每个文档名和二元组的位置表、跳表是否落在各自的区内;
+	// 位置表的内容在查询时才按需换页进来, 解码时不越过本二元组的位置表
+	memset(index, 0, sizeof(*index));
+	index->base = mapFile(path, &index->size);
+	if (index->base == NULL)
+		return -1;
+	const SearchHeader* h = (const SearchHeader*)index->base;
+	if (index->size < sizeof(SearchHeader) || memcmp(h->magic, SEARCH_MAGIC, 4) != 0 || h->version != SEARCH_VERSION
+		|| h->size != index->size || h->nameOffset != h->docOffset + (uint64_t)h->docCount * sizeof(SearchDoc)
+		|| h->termOffset < h->nameOffset || h->skipOffset != h->termOffset + (uint64_t)h->termCount * sizeof(SearchTerm)
+		|| h->postingOffset != h->skipOffset + h->skipCount * sizeof(SearchSkip) || h->postingOffset > h->size
+		|| (h->docCount == 0 && h->termCount != 0))
+	{
+		unmapFile(index->base, index->size);
+		index->base = NULL;
+		return -1;
+	}
+	index->header = h;
+	index->docs = (const SearchDoc*)(index->base + h->docOffset);
+	index->names = (const char*)(index->base + h->nameOffset);
+	index->terms = (const SearchTerm*)(index->base + h->termOffset);
+	index->skips = (const SearchSkip*)(index->base + h->skipOffset);
+	index->postings = index->base + h->postingOffset;
+	int valid = 1;
+	for (uint32_t i = 0; i < h->docCount && valid; i++)
+	{
+		const SearchDoc* d = &index->docs[i];
+		valid = (uint64_t)d->name + d->nameLength <= h->termOffset - h->nameOffset;
+	}
+	for (uint32_t i = 0; i < h->termCount && valid; i++)
+	{
+		// 位置表偏移不减, 各项的位置表就不会重叠或越界; 跳表项数由出现次数决定
+		const SearchTerm* t = &index->terms[i];
+		valid = t->count > 0 && t->posting <= h->size - h->postingOffset
+			&& (i == 0 || (t->key > t[-1].key && t->posting >= t[-1].posting))
+			&& t->skip <= h->skipCount && (t->count - 1) / SEARCH_SKIP_INTERVAL <= h->skipCount - t->skip;
+	}
+	if (!valid)
+	{
+		unmapFile(index->base, index->size);
+		memset(index, 0, sizeof(*index));
+		return -1;
+	}
+	index->files = calloc(h->docCount ? h->docCount : 1, sizeof(FILE*));
+	for (uint32_t i = 0; i < h->docCount; i++)
+	{
+		char name[1024];
+		struct stat st;
+		if (stat(searchDocName(index, i, name, sizeof(name)), &st) != 0 || (uint64_t)st.st_size != index->docs[i].size)
+			index->stale++;
+	}
+	return 0;
+}
+
+void searchClose(SearchIndex* index)
+{
+	for (uint32_t i = 0; index->files != NULL && i < index->header->docCount; i++)
+	{
+		if (index->files[i] != NULL)
+			fclose(index->files[i]);
+	}
+	free(index->files);
+	if (index->base != NULL)
+		unmapFile(index->base, index->size);
+	memset(index, 0, sizeof(*index));
+}
+
+const char* searchDocName(const SearchIndex* index, uint32_t doc, char* name, size_t size)
+{
+	const SearchDoc* d = &index->docs[doc];
+	size_t length = d->nameLength < size ? d->nameLength : size - 1;
+	memcpy(name, index->names + d->name, length);
+	name[length] = 0;
+	return name;
+}
+
+static const SearchTerm* findTerm(const SearchIndex* index, uint32_t key)
+{
+	// 二元组表按key排好序, 返回第一个不小于key的项, 没有时返回表尾
+	uint32_t low = 0, high = index->header->termCount;
+	while (low < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+		if (index->terms[middle].key < key)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return index->terms + low;
+}
+
+static void prefetch(const SearchIndex* index, const void* start, size_t length)
+{
+	// 把[start, start + length)所在的页一次映射好, 比跳着读时逐页缺页快得多
+#if defined(MADV_POPULATE_READ)
+	uintptr_t page = 4095;
+	uintptr_t from = (uintptr_t)start & ~page, to = ((uintptr_t)start + length + page) & ~page;
+	if (from >= (uintptr_t)index->base)
+		madvise((void*)from, to - from, MADV_POPULATE_READ);
+#else
+	(void)index;
+	(void)start;
+	(void)length;
+#endif
+}
+
+static void prefetchCursor(const SearchIndex* index, const Cursor* c)
+{
+	prefetch(index, c->skips, c->skipCount * sizeof(SearchSkip));
+	prefetch(index, c->data, (size_t)(c->end - c->data));
+}
+
+static void cursorInit(Cursor* c, const SearchIndex* index, const SearchTerm* term, uint64_t delta)
+{
+	const SearchTerm* last = index->terms + index->header->termCount - 1;
+	c->term = term;
+	c->data = index->postings + term->posting;
+	c->next = c->data;
+	c->end = term < last ? index->postings + term[1].posting : index->base + index->header->size;
+	c->skips = index->skips + term->skip;
+	c->skipCount = (term->count - 1) / SEARCH_SKIP_INTERVAL;
+	c->index = 0;
+	c->value = readVarint(&c->next, c->end);
+	c->delta = delta;
+}
+
+static int cursorNext(Cursor* c)
+{
+	if (c->index + 1 >= c->term->count)
+		return 0;
+	c->value += readVarint(&c->next, c->end);
+	c->index++;
+	return 1;
+}
+
+static int cursorSeek(Cursor* c, uint64_t target)
+{
+	// 移到第一个不小于target的位置, 没有时返回0; 目标通常就在附近, 从当前块起倍增步长找到范围,
+	// 再在范围内二分跳表项, 最后在块内逐个解码
+	if (c->value >= target)
+		return 1;
+	uint32_t low = c->index / SEARCH_SKIP_INTERVAL, high = c->skipCount;
+	if (low < high && c->skips[low].position <= target)
+	{
+		uint32_t step = 1;
+		while (low + step < high && c->skips[low + step].position <= target)
+		{
+			low += step;
+			step *= 2;
+		}
+		if (low + step < high)
+			high = low + step;
+		while (high - low > 1)
+		{
+			uint32_t middle = low + (high - low) / 2;
+			if (c->skips[middle].position <= target)
+				low = middle;
+			else
+				high = middle;
+		}
+		c->index = (low + 1) * SEARCH_SKIP_INTERVAL;
+		c->value = c->skips[low].position;
+		c->next = c->skips[low].offset < (uint64_t)(c->end - c->data) ? c->data + c->skips[low].offset : c->end;
+	}
+	while (c->value < target)
+	{
+		if (!cursorNext(c))
+			return 0;
+	}
+	return 1;
+}
+
+static void addHit(const SearchIndex* index, uint64_t position, SearchHit* hits, int* found, int maxHits)
+{
+	// 全局位置换成文档和文档内偏移
+	if (*found >= maxHits)
+		return;
+	uint32_t low = 0, high = index->header->docCount - 1;
+	while (low < high)
+	{
+		uint32_t middle = low + (high - low + 1) / 2;
+		if (index->docs[middle].base <= position)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	hits[*found].doc = low;
+	hits[*found].offset = position - index->docs[low].base;
+	(*found)++;
+}
+
+static void siftDown(Cursor* heap, size_t count, size_t i)
+{
+	for (;;)
+	{
+		size_t smallest = i, left = 2 * i + 1, right = left + 1;
+		if (left < count && heap[left].value < heap[smallest].value)
+			smallest = left;
+		if (right < count && heap[right].value < heap[smallest].value)
+			smallest = right;
+		if (smallest == i)
+			return;
+		Cursor c = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = c;
+		i = smallest;
+	}
+}
+
+static int searchCharacter(const SearchIndex* index, uint32_t code, SearchHit* hits, int maxHits,
+	unsigned long long* total)
+{
+	// 单个字符: 以它开头的二元组在表里连成一段, 次数直接相加; 结果用按当前位置排的小顶堆多路归并
+	const SearchTerm* first = findTerm(index, code << 16);
+	const SearchTerm* last = findTerm(index, (code + 1) << 16);
+	size_t count = last - first;
+	int found = 0;
+	for (const SearchTerm* t = first; t < last; t++)
+		*total += t->count;
+	if (count == 0 || maxHits == 0)
+		return 0;
+	Cursor* heap = malloc(count * sizeof(Cursor));
+	if (heap == NULL)
+		return -1;
+	for (size_t i = 0; i < count; i++)
+		cursorInit(&heap[i], index, first + i, 0);
+	for (size_t i = count / 2; i-- > 0;)
+		siftDown(heap, count, i);
+	while (found < maxHits && count > 0)
+	{
+		addHit(index, heap[0].value, hits, &found, maxHits);
+		if (!cursorNext(&heap[0]))
+			heap[0] = heap[--count];
+		siftDown(heap, count, 0);
+	}
+	free(heap);
+	return found;
+}
+
+int searchPhrase(const SearchIndex* index, const unsigned char* phrase, size_t length,
+	SearchHit* hits, int maxHits, unsigned long long* total)
+{
+	// 返回存入hits的结果数(按位置顺序, 最多maxHits个), total是全部结果数; 短语为空或太长返回-1
+	uint32_t codes[SEARCH_PHRASE_MAX];
+	uint64_t offsets[SEARCH_PHRASE_MAX];
+	Cursor cursors[SEARCH_PHRASE_MAX];
+	int n = 0, found = 0;
+	*total = 0;
+	for (size_t i = 0; i < length; n++)
+	{
+		if (n == SEARCH_PHRASE_MAX)
+			return -1;
+		offsets[n] = i;
+		i += unitAt(phrase + i, length - i, 1, &codes[n]);
+	}
+	if (n == 0)
+		return -1;
+	if (index->header->termCount == 0)
+		return 0;
+	if (n == 1)
+		return searchCharacter(index, codes[0], hits, maxHits, total);
+	// 每个二元组一个游标, 按出现次数从少到多排好, 最少的一个做驱动
+	for (int j = 0; j < n - 1; j++)
+	{
+		uint32_t key = codes[j] << 16 | codes[j + 1];
+		const SearchTerm* t = findTerm(index, key);
+		if (t == index->terms + index->header->termCount || t->key != key)
+			return 0;
+		cursorInit(&cursors[j], index, t, offsets[j]);
+		for (int k = j; k > 0 && cursors[k].term->count < cursors[k - 1].term->count; k--)
+		{
+			Cursor c = cursors[k];
+			cursors[k] = cursors[k - 1];
+			cursors[k - 1] = c;
+		}
+	}
+	// 驱动的游标顺序读, 其余的跳着读, 预先映射好
+	for (int j = 1; j < n - 1; j++)
+		prefetchCursor(index, &cursors[j]);
+	Cursor* driver = &cursors[0];
+	int more = 1;
+	while (more)
+	{
+		if (driver->value < driver->delta)
+		{
+			more = cursorNext(driver);
+			continue;
+		}
+		uint64_t start = driver->value - driver->delta, next = 0;
+		int k;
+		for (k = 1; k < n - 1; k++)
+		{
+			if (!cursorSeek(&cursors[k], start + cursors[k].delta))
+			{
+				more = 0;
+				break;
+			}
+			if (cursors[k].value != start + cursors[k].delta)
+			{
+				next = cursors[k].value - cursors[k].delta;
+				break;
+			}
+		}
+		if (!more)
+			break;
+		if (k == n - 1)
+		{
+			addHit(index, start, hits, &found, maxHits);
+			(*total)++;
+			more = cursorNext(driver);
+		}
+		else
+			more = cursorSeek(driver, next + driver->delta);
+	}
+	return found;
+}
+
+size_t searchSnippet(SearchIndex* index, const SearchHit* hit, size_t length, unsigned char* out, size_t size)
+{
+	// 短语前后各约SEARCH_CONTEXT字节, 用【】括出短语, 换行换成空格; 返回写入out的字节数
+	// 前文的起点: 小于0x81的字节不会是首字节, 它后面一定是字符边界; 全是高位字节时从短语开头往前两两成对
+	unsigned char window[SEARCH_CONTEXT * 2 + SEARCH_PHRASE_MAX * 2];
+	const SearchDoc* doc = &index->docs[hit->doc];
+	if (length > SEARCH_PHRASE_MAX * 2 || size < sizeof(window) + 4)
+		return 0;
+	if (index->files[hit->doc] == NULL)
+	{
+		char name[1024];
+		index->files[hit->doc] = fopen(searchDocName(index, hit->doc, name, sizeof(name)), "rb");
+		if (index->files[hit->doc] == NULL)
+			return 0;
+	}
+	FILE* fp = index->files[hit->doc];
+	uint64_t from = hit->offset > SEARCH_CONTEXT ? hit->offset - SEARCH_CONTEXT : 0;
+	uint64_t to = hit->offset + length + SEARCH_CONTEXT < doc->size ? hit->offset + length + SEARCH_CONTEXT : doc->size;
+	if (to < hit->offset + length || fseeko(fp, from, SEEK_SET) != 0)
+		return 0;
+	size_t n = fread(window, 1, (size_t)(to - from), fp);
+	size_t at = (size_t)(hit->offset - from), s = at % 2, e = at + length, o = 0;
+	if (n < e)
+		return 0;
+	for (size_t i = 0; i < at; i++)
+	{
+		if (window[i] < 0x81)
+		{
+			s = i + 1;
+			break;
+		}
+	}
+	while (e < n)
+	{
+		uint32_t code;
+		size_t step = unitAt(window + e, n - e, 0, &code);
+		if (step == 0)
+			break;
+		e += step;
+	}
+	for (size_t i = s; i < e; i++)
+	{
+		if (i == at || i == at + length)
+		{
+			out[o++] = 0xA1;
+			out[o++] = i == at ? 0xBE : 0xBF;
+		}
+		out[o++] = window[i] == '\r' || window[i] == '\n' || window[i] == '\t' ? ' ' : window[i];
+	}
+	if (e == at + length)
+	{
+		out[o++] = 0xA1;
+		out[o++] = 0xBF;
+	}
+	return o;
+}
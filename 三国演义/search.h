@@ -0,0 +1,94 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// 全文检索: 以GBK字符(汉字或ASCII)为单位, 对相邻两个字符建倒排索引, 记下每个二元组在语料中的位置
+// 位置表按差值 + 变长整数压缩, 每SEARCH_SKIP_INTERVAL个位置一个跳表项; 查询时整个索引文件mmap进来,
+// 短语的各个二元组按出现次数从少到多求交集, 最少的一个逐个给出候选, 其余的借助跳表跳到候选位置
+
+#define SEARCH_MAGIC "SGBI"
+#define SEARCH_VERSION 1
+#define SEARCH_CHUNK (1 << 20)         // 建索引时每次读1MB
+#define SEARCH_SKIP_INTERVAL 64        // 每64个位置一个跳表项
+#define SEARCH_PHRASE_MAX 64           // 查询最多64个字符
+#define SEARCH_CONTEXT 40              // 结果前后各显示约40字节
+
+typedef struct
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t docCount;
+	uint32_t termCount;
+	uint64_t skipCount;
+	uint64_t postingCount;
+	uint64_t docOffset;       // 以下都是相对文件开头的偏移
+	uint64_t nameOffset;
+	uint64_t termOffset;
+	uint64_t skipOffset;
+	uint64_t postingOffset;
+	uint64_t size;            // 整个索引文件的长度
+} SearchHeader;
+
+typedef struct
+{
+	uint64_t base;            // 文档在全局位置空间的起点, 文档之间至少隔1, 二元组不会跨文档
+	uint64_t size;            // 建索引时的文件长度
+	uint32_t name;            // 文件名在名字区的偏移
+	uint32_t nameLength;
+} SearchDoc;
+
+typedef struct
+{
+	uint32_t key;             // 前一个字符 << 16 | 后一个字符, 文档最后一个字符的后一个字符记为0
+	uint32_t count;           // 出现次数
+	uint64_t posting;         // 位置表在位置区的偏移
+	uint64_t skip;            // 第一个跳表项的序号
+} SearchTerm;
+
+typedef struct
+{
+	uint64_t position;        // 第k * SEARCH_SKIP_INTERVAL个位置(k >= 1)
+	uint64_t offset;          // 紧接它之后的字节在位置表中的偏移
+} SearchSkip;
+
+typedef struct
+{
+	uint32_t doc;
+	uint64_t offset;          // 在文档中的字节偏移
+} SearchHit;
+
+typedef struct
+{
+	unsigned long long bytes;     // 建索引读入的字节数
+	unsigned long long postings;  // 位置总数
+	unsigned long long size;      // 索引文件长度
+	unsigned int terms;           // 不同的二元组个数
+	double seconds;
+} SearchBuildStats;
+
+typedef struct
+{
+	const unsigned char* base;    // 映射进来的整个索引文件
+	size_t size;
+	const SearchHeader* header;
+	const SearchDoc* docs;
+	const char* names;
+	const SearchTerm* terms;
+	const SearchSkip* skips;
+	const unsigned char* postings;
+	FILE** files;                 // 取上下文时才打开的文档
+	unsigned int stale;           // 长度与建索引时不同的文档数
+} SearchIndex;
+
+int searchBuild(const char* path, const char* const* files, int count, SearchBuildStats* stats);
+int searchOpen(SearchIndex* index, const char* path);
+void searchClose(SearchIndex* index);
+const char* searchDocName(const SearchIndex* index, uint32_t doc, char* name, size_t size);
+int searchPhrase(const SearchIndex* index, const unsigned char* phrase, size_t length,
+	SearchHit* hits, int maxHits, unsigned long long* total);
+size_t searchSnippet(SearchIndex* index, const SearchHit* hit, size_t length, unsigned char* out, size_t size);
+
+#endif
@@ -0,0 +1,344 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "transcode.h"
+#include "copy.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSCODE_SSE2
+#endif
+
+static unsigned short unicodeToGbk[65536];  // Unicode(BMP)到GBK码(首字节 << 8 | 尾字节), 0表示没有
+static int reverseReady = 0;
+
+static void buildReverse(void)
+{
+	for (int lead = 0; lead < GBK_LEAD_COUNT; lead++)
+	{
+		for (int trail = 0; trail < GBK_TRAIL_COUNT; trail++)
+		{
+			unsigned short u = gbkToUnicode[lead][trail];
+			if (u != 0 && unicodeToGbk[u] == 0)
+				unicodeToGbk[u] = (unsigned short)(((lead + 0x81) << 8) | (trail + 0x40));
+		}
+	}
+	reverseReady = 1;
+}
+
+void transcodeInit(Transcoder* t, TranscodeDirection direction)
+{
+	memset(t, 0, sizeof(*t));
+	t->direction = direction;
+	if (direction == UTF8_TO_GBK && !reverseReady)
+		buildReverse();
+}
+
+size_t transcodeMaxOutput(TranscodeDirection direction, size_t length)
+{
+	// GBK双字节最多变成3字节UTF-8; UTF-8转GBK不会变长. 另加上次留下的不完整字符
+	return direction == GBK_TO_UTF8 ? length / 2 * 3 + length % 2 + 6 : length + 4;
+}
+
+static size_t copyAscii(const unsigned char* in, size_t length, unsigned char* out)
+{
+	// 返回开头连续ASCII字节的个数(按16或8字节整块), 同时复制到out
+	size_t i = 0;
+#ifdef TRANSCODE_SSE2
+	while (i + 16 <= length)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		_mm_storeu_si128((__m128i*)(out + i), v);
+		i += 16;
+	}
+#else
+	while (i + 8 <= length)
+	{
+		uint64_t v;
+		memcpy(&v, in + i, 8);
+		if (v & 0x8080808080808080ULL)
+			break;
+		memcpy(out + i, &v, 8);
+		i += 8;
+	}
+#endif
+	return i;
+}
+
+static TranscodeStatus fail(Transcoder* t, TranscodeStatus status, size_t offset, const unsigned char* at, int length)
+{
+	t->errorOffset = t->consumed + offset;
+	t->errorLength = length;
+	memcpy(t->errorBytes, at, length);
+	return status;
+}
+
+static TranscodeStatus fromGbk(Transcoder* t, const unsigned char* in, size_t length,
+	unsigned char* out, size_t* produced, size_t* used, int final)
+{
+	// 转换完整的字符, 末尾不完整的字符不消耗; 遇到ASCII时才尝试整块复制, 汉字连续时不多做检查
+	size_t i = 0, o = 0;
+	TranscodeStatus status = TRANSCODE_OK;
+	while (i < length)
+	{
+		unsigned char c = in[i];
+		if (c < 0x80)
+		{
+			size_t n = copyAscii(in + i, length - i, out + o);
+			if (n == 0)
+			{
+				out[o] = c;
+				n = 1;
+			}
+			i += n;
+			o += n;
+			continue;
+		}
+		if (c == 0x80 || c == 0xFF)
+		{
+			status = fail(t, TRANSCODE_INVALID, i, in + i, 1);
+			break;
+		}
+		if (i + 1 >= length)
+		{
+			if (final)
+				status = fail(t, TRANSCODE_TRUNCATED, i, in + i, 1);
+			break;
+		}
+		unsigned char c2 = in[i + 1];
+		if (c2 < 0x40 || c2 == 0x7F || c2 == 0xFF)
+		{
+			status = fail(t, TRANSCODE_INVALID, i, in + i, 2);
+			break;
+		}
+		unsigned short u = gbkToUnicode[c - 0x81][c2 - 0x40];
+		if (u == 0)
+		{
+			status = fail(t, TRANSCODE_UNMAPPED, i, in + i, 2);
+			break;
+		}
+		if (u < 0x800)
+		{
+			out[o] = (unsigned char)(0xC0 | (u >> 6));
+			out[o + 1] = (unsigned char)(0x80 | (u & 0x3F));
+			o += 2;
+		}
+		else
+		{
+			out[o] = (unsigned char)(0xE0 | (u >> 12));
+			out[o + 1] = (unsigned char)(0x80 | ((u >> 6) & 0x3F));
+			out[o + 2] = (unsigned char)(0x80 | (u & 0x3F));
+			o += 3;
+		}
+		i += 2;
+	}
+	t->consumed += i;
+	*produced = o;
+	*used = i;
+	return status;
+}
+
+static TranscodeStatus fromUtf8(Transcoder* t, const unsigned char* in, size_t length,
+	unsigned char* out, size_t* produced, size_t* used, int final)
+{
+	// 严格检查: 拒绝超长编码、代理项和U+10FFFF以上的码点; BMP以外的字符GBK中都没有
+	size_t i = 0, o = 0;
+	TranscodeStatus status = TRANSCODE_OK;
+	while (i < length)
+	{
+		unsigned char c = in[i];
+		if (c < 0x80)
+		{
+			size_t n = copyAscii(in + i, length - i, out + o);
+			if (n == 0)
+			{
+				out[o] = c;
+				n = 1;
+			}
+			i += n;
+			o += n;
+			continue;
+		}
+		int need = c >= 0xC2 && c <= 0xDF ? 2 : c >= 0xE0 && c <= 0xEF ? 3 : c >= 0xF0 && c <= 0xF4 ? 4 : 0;
+		if (need == 0)
+		{
+			status = fail(t, TRANSCODE_INVALID, i, in + i, 1);
+			break;
+		}
+		// 逐个检查后续字节, 这样不完整的字符在末尾时也能先发现格式错误
+		unsigned long u = c & (0x7F >> need);
+		int k;
+		for (k = 1; k < need && i + k < length; k++)
+		{
+			unsigned char b = in[i + k];
+			unsigned char low = 0x80, high = 0xBF;
+			if (k == 1)
+			{
+				low = c == 0xE0 ? 0xA0 : c == 0xF0 ? 0x90 : 0x80;
+				high = c == 0xED ? 0x9F : c == 0xF4 ? 0x8F : 0xBF;
+			}
+			if (b < low || b > high)
+				break;
+			u = (u << 6) | (b & 0x3F);
+		}
+		if (k < need && i + k < length)
+		{
+			status = fail(t, TRANSCODE_INVALID, i, in + i, k + 1);
+			break;
+		}
+		if (k < need)
+		{
+			if (final)
+				status = fail(t, TRANSCODE_TRUNCATED, i, in + i, k);
+			break;
+		}
+		unsigned short g = u < 0x10000 ? unicodeToGbk[u] : 0;
+		if (g == 0)
+		{
+			status = fail(t, TRANSCODE_UNMAPPED, i, in + i, need);
+			break;
+		}
+		out[o] = (unsigned char)(g >> 8);
+		out[o + 1] = (unsigned char)g;
+		o += 2;
+		i += need;
+	}
+	t->consumed += i;
+	*produced = o;
+	*used = i;
+	return status;
+}
+
+static TranscodeStatus convert(Transcoder* t, const unsigned char* in, size_t length,
+	unsigned char* out, size_t* produced, size_t* used, int final)
+{
+	return t->direction == GBK_TO_UTF8 ? fromGbk(t, in, length, out, produced, used, final)
+		: fromUtf8(t, in, length, out, produced, used, final);
+}
+
+TranscodeStatus transcodeChunk(Transcoder* t, const unsigned char* in, size_t length,
+	unsigned char* out, size_t* outLength, int final)
+{
+	// 先把上次留下的不完整字符与本次开头的几个字节拼起来转换, 再转换其余部分,
+	// 末尾不完整的字符留到下次; out至少要有transcodeMaxOutput(length)字节
+	size_t produced = 0, n, used;
+	TranscodeStatus status;
+	*outLength = 0;
+	if (t->pendingLength > 0)
+	{
+		unsigned char joined[8];
+		size_t take = length < 4 ? length : 4;
+		size_t pending = t->pendingLength;
+		memcpy(joined, t->pending, pending);
+		memcpy(joined + pending, in, take);
+		status = convert(t, joined, pending + take, out, &produced, &used, final && take == length);
+		if (status != TRANSCODE_OK)
+			return status;
+		if (used < pending)
+		{
+			// 输入不足以补全这个字符, 全部留到下次
+			memcpy(t->pending, joined, pending + take);
+			t->pendingLength = (int)(pending + take);
+			*outLength = produced;
+			t->produced += produced;
+			return TRANSCODE_OK;
+		}
+		in += used - pending;
+		length -= used - pending;
+		t->pendingLength = 0;
+	}
+	status = convert(t, in, length, out + produced, &n, &used, final);
+	produced += n;
+	*outLength = produced;
+	t->produced += produced;
+	if (status == TRANSCODE_OK && used < length)
+	{
+		t->pendingLength = (int)(length - used);
+		memcpy(t->pending, in + used, t->pendingLength);
+	}
+	return status;
+}
+
+TranscodeStatus transcodeStream(Transcoder* t, FILE* in, FILE* out)
+{
+	// 固定大小的输入、输出缓冲区, 任意长度的输入都只占用约2.5MB内存
+	unsigned char* input = malloc(TRANSCODE_CHUNK);
+	unsigned char* output = malloc(transcodeMaxOutput(t->direction, TRANSCODE_CHUNK));
+	TranscodeStatus status = TRANSCODE_OK;
+	double start = copyNow();
+	if (input == NULL || output == NULL)
+		status = TRANSCODE_IO;
+	while (status == TRANSCODE_OK)
+	{
+		size_t length = fread(input, 1, TRANSCODE_CHUNK, in);
+		if (ferror(in))
+		{
+			status = TRANSCODE_IO;
+			break;
+		}
+		int final = length < TRANSCODE_CHUNK;
+		size_t produced;
+		status = transcodeChunk(t, input, length, output, &produced, final);
+		if (produced > 0 && fwrite(output, 1, produced, out) != produced)
+			status = TRANSCODE_IO;
+		if (final)
+			break;
+	}
+	if (fflush(out) != 0 && status == TRANSCODE_OK)
+		status = TRANSCODE_IO;
+	t->seconds = copyNow() - start;
+	free(input);
+	free(output);
+	return status;
+}
+
+int transcodeIsUtf8(const unsigned char* in, size_t length)
+{
+	// 是否为合法UTF-8, 末尾不完整的字符不算错(可能只是截取了文件开头一段)
+	size_t i = 0;
+	while (i < length)
+	{
+		unsigned char c = in[i];
+		int need = c < 0x80 ? 1 : c >= 0xC2 && c <= 0xDF ? 2 : c >= 0xE0 && c <= 0xEF ? 3 : c >= 0xF0 && c <= 0xF4 ? 4 : 0;
+		if (need == 0)
+			return 0;
+		for (int k = 1; k < need; k++)
+		{
+			if (i + k >= length)
+				return 1;
+			unsigned char b = in[i + k];
+			unsigned char low = 0x80, high = 0xBF;
+			if (k == 1)
+			{
+				low = c == 0xE0 ? 0xA0 : c == 0xF0 ? 0x90 : 0x80;
+				high = c == 0xED ? 0x9F : c == 0xF4 ? 0x8F : 0xBF;
+			}
+			if (b < low || b > high)
+				return 0;
+		}
+		i += need;
+	}
+	return 1;
+}
+
+const char* transcodeError(const Transcoder* t, TranscodeStatus status, char* text, size_t size)
+{
+	static const char* messages[] = { "成功", "无效的%s序列", "%s中没有的字符", "%s字符不完整, 输入在字符中间结束", "读写文件失败" };
+	const char* source = t->direction == GBK_TO_UTF8 ? "GBK" : "UTF-8";
+	const char* target = t->direction == GBK_TO_UTF8 ? "Unicode" : "GBK";
+	char message[64];
+	snprintf(message, sizeof(message), messages[status], status == TRANSCODE_UNMAPPED ? target : source);
+	if (status == TRANSCODE_OK || status == TRANSCODE_IO)
+	{
+		snprintf(text, size, "%s", message);
+		return text;
+	}
+	int n = snprintf(text, size, "第%llu字节: %s:", t->errorOffset, message);
+	for (int i = 0; i < t->errorLength && n > 0 && (size_t)n < size; i++)
+		n += snprintf(text + n, size - n, " %02X", t->errorBytes[i]);
+	return text;
+}
@@ -0,0 +1,53 @@
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// GBK与UTF-8之间的流式转码
+// 连续的ASCII字节用SIMD(SSE2, 否则按8字节整字)整块复制; 双字节GBK查 gbkToUnicode 表,
+// 反方向的表在第一次使用时由它反推得到. 多字节字符可以跨越两次调用, 内存用量与输入大小无关
+
+#define GBK_LEAD_COUNT 126            // 首字节 0x81~0xFE
+#define GBK_TRAIL_COUNT 191           // 尾字节 0x40~0xFE (0x7F无定义)
+#define TRANSCODE_CHUNK (1 << 20)     // 流式转码每次读入1MB
+
+typedef enum
+{
+	GBK_TO_UTF8,
+	UTF8_TO_GBK
+} TranscodeDirection;
+
+typedef enum
+{
+	TRANSCODE_OK,
+	TRANSCODE_INVALID,     // 不符合编码规则的字节序列
+	TRANSCODE_UNMAPPED,    // 格式正确但目标编码中没有这个字符
+	TRANSCODE_TRUNCATED,   // 输入在多字节字符中间结束
+	TRANSCODE_IO           // 读写文件失败
+} TranscodeStatus;
+
+typedef struct
+{
+	TranscodeDirection direction;
+	unsigned char pending[4];         // 上次调用末尾不完整的字符
+	int pendingLength;
+	unsigned long long consumed;      // 已转换的输入字节数
+	unsigned long long produced;      // 已输出的字节数
+	unsigned long long errorOffset;   // 出错字符在输入中的位置
+	unsigned char errorBytes[4];      // 出错的字节
+	int errorLength;
+	double seconds;                   // transcodeStream的耗时
+} Transcoder;
+
+extern const unsigned short gbkToUnicode[GBK_LEAD_COUNT][GBK_TRAIL_COUNT];
+
+void transcodeInit(Transcoder* t, TranscodeDirection direction);
+size_t transcodeMaxOutput(TranscodeDirection direction, size_t length);
+TranscodeStatus transcodeChunk(Transcoder* t, const unsigned char* in, size_t length,
+	unsigned char* out, size_t* outLength, int final);
+TranscodeStatus transcodeStream(Transcoder* t, FILE* in, FILE* out);
+int transcodeIsUtf8(const unsigned char* in, size_t length);
+const char* transcodeError(const Transcoder* t, TranscodeStatus status, char* text, size_t size);
+
+#endif